@@ -0,0 +1,56 @@
+// Бенчмарк пакетов VulkanCube: время кадра от числа отдельных элементов
+// VulkanCube в сетке. Запуск: vulkanunderqmlapp --qml benchmarks/cubes.qml,
+// для сравнения - с --no-cube-batching (run_cubes.sh запускает оба).
+// Результат печатается в stdout в формате CSV, после последнего шага
+// приложение завершается.
+
+import QtQuick
+import VulkanUnderQML
+
+VulkanQuickWindow {
+    id: window
+    width: 1280
+    height: 720
+    visible: true
+    title: "VulkanCube batching benchmark"
+    color: "black"
+
+    property var counts: [16, 64, 256, 1024]
+    property int step: 0
+    readonly property int count: counts[step]
+    // Квадратная сетка, заполняющая окно по ширине
+    readonly property int columns: Math.ceil(Math.sqrt(count * width / height))
+    readonly property real cellSize: width / columns
+
+    Repeater {
+        model: window.count
+        VulkanCube {
+            x: (index % window.columns) * window.cellSize
+            y: Math.floor(index / window.columns) * window.cellSize
+            width: window.cellSize
+            height: window.cellSize
+            renderThreadAnimation: true
+            animationSpeed: 0.1
+            animationPhase: index / window.count
+        }
+    }
+
+    VulkanFrameTimer {
+        id: timer
+        sampleCount: 300
+        warmupFrames: 60
+
+        onMeasured: (averageFrameTime, maxFrameTime) => {
+            console.log("cubes," + window.count + "," + averageFrameTime.toFixed(3)
+                        + "," + maxFrameTime.toFixed(3) + "," + (1000 / averageFrameTime).toFixed(1))
+            if (window.step + 1 < window.counts.length) {
+                window.step++
+                timer.restart()
+            } else {
+                Qt.quit()
+            }
+        }
+    }
+
+    Component.onCompleted: timer.restart()
+}
@@ -0,0 +1,72 @@
+// Бенчмарк освещения VulkanCube: время кадра от числа точечных источников
+// при переборе всех источников во фрагментном шейдере и при отборе по
+// кластерам. Запуск: vulkanunderqmlapp --qml benchmarks/lights.qml
+// Результат печатается в stdout в формате CSV, после последнего шага
+// приложение завершается.
+
+import QtQuick
+import VulkanUnderQML
+
+VulkanQuickWindow {
+    id: window
+    width: 1280
+    height: 720
+    visible: true
+    title: "VulkanCube lights benchmark"
+    color: "black"
+
+    property var counts: [16, 64, 256, 1024]
+    property var modes: [VulkanCube.NoLightCulling, VulkanCube.ClusteredLightCulling]
+    property int step: 0
+
+    // Детерминированный генератор, чтобы прогоны были сравнимы
+    function makeLights(count) {
+        let seed = 12345
+        function rand() {
+            seed = (seed * 16807) % 2147483647
+            return seed / 2147483647
+        }
+        let lights = []
+        for (let i = 0; i < count; ++i) {
+            lights.push({
+                position: Qt.vector3d(rand() * 8 - 4, rand() * 6 - 3, -2 - rand() * 6),
+                color: Qt.rgba(0.3 + rand() * 0.7, 0.3 + rand() * 0.7, 0.3 + rand() * 0.7, 1),
+                radius: 1.5,
+                intensity: 4 / Math.sqrt(count)
+            })
+        }
+        return lights
+    }
+
+    VulkanCube {
+        id: cube
+        anchors.fill: parent
+        renderThreadAnimation: true
+        animationSpeed: 0.1
+        lights: window.makeLights(window.counts[Math.floor(window.step / window.modes.length)])
+        lightCulling: window.modes[window.step % window.modes.length]
+    }
+
+    VulkanFrameTimer {
+        id: timer
+        sampleCount: 300
+        warmupFrames: 60
+
+        onMeasured: (averageFrameTime, maxFrameTime) => {
+            console.log("lights," + (cube.lightCulling === VulkanCube.ClusteredLightCulling ? "clustered" : "brute")
+                        + "," + cube.lights.length + "," + averageFrameTime.toFixed(3)
+                        + "," + maxFrameTime.toFixed(3) + "," + (1000 / averageFrameTime).toFixed(1))
+            if (window.step + 1 < window.counts.length * window.modes.length) {
+                window.step++
+                timer.restart()
+            } else {
+                Qt.quit()
+            }
+        }
+    }
+
+    Component.onCompleted: {
+        console.log("benchmark,mode,count,avg_ms,max_ms,fps")
+        timer.restart()
+    }
+}
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+# Сравнение двух прогонов vulkanunderqml_microbench (JSON Google Benchmark).
+# Использование: compare.py <baseline.json> <current.json> [--threshold 0.10]
+# Сравнивается cpu_time; при --benchmark_repetitions берутся медианы.
+# Код возврата 1, если хотя бы один бенчмарк медленнее базы больше порога.
+
+import argparse
+import json
+import sys
+
+UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    results = {}
+    medians = {}
+    for b in data.get("benchmarks", []):
+        if b.get("error_occurred"):
+            continue
+        time = b["cpu_time"] * UNITS[b.get("time_unit", "ns")]
+        if b.get("run_type") == "aggregate":
+            if b.get("aggregate_name") == "median":
+                medians[b["run_name"]] = time
+        else:
+            results.setdefault(b.get("run_name", b["name"]), time)
+    results.update(medians)
+    return results
+
+
+def fmt(ns):
+    for unit, scale in (("s", 1e9), ("ms", 1e6), ("us", 1e3)):
+        if ns >= scale:
+            return "%.3f %s" % (ns / scale, unit)
+    return "%.1f ns" % ns
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two vulkanunderqml_microbench JSON results")
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="relative slowdown reported as a regression (default 0.10)")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+
+    regressions = 0
+    width = max([len(n) for n in current] + [9])
+    print("%-*s %12s %12s %8s" % (width, "benchmark", "baseline", "current", "change"))
+    for name in sorted(current):
+        if name not in baseline:
+            print("%-*s %12s %12s %8s" % (width, name, "-", fmt(current[name]), "new"))
+            continue
+        change = current[name] / baseline[name] - 1.0
+        mark = ""
+        if change > args.threshold:
+            mark = "  REGRESSION"
+            regressions += 1
+        elif change < -args.threshold:
+            mark = "  improved"
+        print("%-*s %12s %12s %+7.1f%%%s" % (width, name, fmt(baseline[name]), fmt(current[name]),
+                                            change * 100, mark))
+    for name in sorted(set(baseline) - set(current)):
+        print("%-*s %12s %12s %8s" % (width, name, fmt(baseline[name]), "-", "missing"))
+
+    if regressions:
+        print("%d regression(s) over %.0f%%" % (regressions, args.threshold * 100))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,151 @@
+// jobstress.cpp
+// Нагрузочная проверка VulkanJobSystem под ThreadSanitizer.
+// Сборка: -DVULKANUNDERQML_BUILD_MICROBENCH=ON, цель vulkanunderqml_jobstress
+// собирается с -fsanitize=thread. Запуск: vulkanunderqml_jobstress [rounds];
+// код возврата 1 при неверном результате, гонки TSan печатает сам.
+//
+// Для каждого числа рабочих от 0 до max(4, ядер) проверяются пути, которыми
+// пул пользуются рендереры: parallelFor из нескольких потоков вне пула
+// (потоки рендеринга окон), задания с after, wait() из задания рабочего
+// потока и группа, уничтоженная сразу после wait().
+
+#include "vulkanjobsystem.h"
+#include <QThread>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+const int RenderThreads = 3;
+
+bool check(bool ok, const char *what, int workers)
+{
+    if (!ok)
+        std::fprintf(stderr, "jobstress: %s failed with %d workers\n", what, workers);
+    return ok;
+}
+
+// Каждый элемент ровно одним заданием; данные без атомиков, их
+// согласованность после wait() и проверяет TSan
+bool parallelForOnce(VulkanJobSystem &jobs, int count, int grain)
+{
+    std::vector<int> data(size_t(count), 0);
+    int *p = data.data();
+    jobs.parallelFor(count, grain, [p](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            ++p[i];
+    });
+    for (int v : data) {
+        if (v != 1)
+            return false;
+    }
+    return true;
+}
+
+// Задания с after видят всё, что записали задания группы after
+bool continuations(VulkanJobSystem &jobs)
+{
+    const int count = 256;
+    std::vector<int> first(count, 0);
+    std::vector<int> second(count, 0);
+    int *a = first.data();
+    int *b = second.data();
+    VulkanJobSystem::Group producers;
+    VulkanJobSystem::Group consumers;
+    jobs.fork(&producers, count, 8, [a](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            a[i] = i + 1;
+    });
+    for (int begin = 0; begin < count; begin += 32) {
+        jobs.run(&consumers, [a, b, begin] {
+            for (int i = begin; i < begin + 32; ++i)
+                b[i] = a[i] * 2;
+        }, &producers);
+    }
+    jobs.wait(&consumers);
+    jobs.wait(&producers);
+    for (int i = 0; i < count; ++i) {
+        if (b[i] != (i + 1) * 2)
+            return false;
+    }
+    return true;
+}
+
+// fork и wait внутри задания: ждущий рабочий поток сам берёт задания
+bool nested(VulkanJobSystem &jobs)
+{
+    const int outer = 8;
+    const int inner = 512;
+    std::vector<int> data(size_t(outer) * inner, 0);
+    int *p = data.data();
+    jobs.parallelFor(outer, 1, [&jobs, p](int begin, int end) {
+        for (int o = begin; o < end; ++o) {
+            int *row = p + size_t(o) * inner;
+            jobs.parallelFor(inner, 16, [row](int b, int e) {
+                for (int i = b; i < e; ++i)
+                    row[i] += 1;
+            });
+        }
+    });
+    for (int v : data) {
+        if (v != 1)
+            return false;
+    }
+    return true;
+}
+
+bool runRound(VulkanJobSystem &jobs, int workers)
+{
+    bool ok = check(parallelForOnce(jobs, 10000, 7), "parallelFor", workers);
+    ok &= check(continuations(jobs), "continuations", workers);
+    ok &= check(nested(jobs), "nested wait", workers);
+
+    // Несколько потоков вне пула одновременно, как окна со своими потоками рендеринга
+    std::atomic<bool> external { true };
+    QList<QThread *> threads;
+    for (int i = 0; i < RenderThreads; ++i) {
+        threads.append(QThread::create([&jobs, &external] {
+            for (int j = 0; j < 16; ++j) {
+                if (!parallelForOnce(jobs, 1000, 13))
+                    external.store(false);
+            }
+        }));
+        threads.last()->start();
+    }
+    for (QThread *thread : std::as_const(threads)) {
+        thread->wait();
+        delete thread;
+    }
+    ok &= check(external.load(), "external threads", workers);
+
+    // Группа на стеке уничтожается сразу после wait(), пока завершившее её
+    // задание может ещё держать мьютекс группы
+    for (int i = 0; i < 64; ++i) {
+        VulkanJobSystem::Group group;
+        std::atomic<int> done { 0 };
+        jobs.fork(&group, 4, 1, [&done](int, int) { done.fetch_add(1, std::memory_order_relaxed); });
+        jobs.wait(&group);
+        ok &= check(done.load(std::memory_order_relaxed) == 4, "group lifetime", workers);
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const int rounds = argc > 1 ? std::atoi(argv[1]) : 20;
+    const int maxWorkers = qMax(4, QThread::idealThreadCount());
+    bool ok = true;
+    for (int workers = 0; workers <= maxWorkers; ++workers) {
+        VulkanJobSystem jobs(workers);
+        for (int round = 0; round < rounds && ok; ++round)
+            ok = runRound(jobs, workers);
+        std::printf("jobstress: %d workers %s\n", workers, ok ? "ok" : "FAILED");
+        if (!ok)
+            return 1;
+    }
+    return 0;
+}
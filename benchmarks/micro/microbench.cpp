@@ -0,0 +1,681 @@
+// microbench.cpp
+// Микробенчмарки горячих путей рендереров на CPU (Google Benchmark).
+// Сборка: -DVULKANUNDERQML_BUILD_MICROBENCH=ON, запуск и сравнение с
+// базой - benchmarks/micro/run_microbench.sh.
+//
+// Вызовы Vulkan идут к устройству lavapipe (или первому доступному, если
+// программного нет), экземпляр создаётся напрямую через загрузчик - для
+// QVulkanInstance понадобилась бы платформа с окнами.
+
+#include "vulkancubeuniforms.h"
+#include "vulkanembeddedshaders.h"
+#include "vulkanjobsystem.h"
+#include "vulkanscenenodes.h"
+#include "vulkanstatesnapshot.h"
+#include "vulkanutils.h"
+#include <benchmark/benchmark.h>
+#include <vulkan/vulkan.h>
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QSize>
+#include <QThread>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct Device {
+    VkInstance instance = VK_NULL_HANDLE;
+    VkPhysicalDevice physDev = VK_NULL_HANDLE;
+    VkDevice dev = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memProps {};
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    QString error;
+};
+
+// Одно устройство на весь прогон; создание не входит в замеры
+Device &device()
+{
+    static Device d = [] {
+        Device d;
+        VkApplicationInfo appInfo{};
+        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        appInfo.pApplicationName = "vulkanunderqml_microbench";
+        appInfo.apiVersion = VK_API_VERSION_1_1;
+        VkInstanceCreateInfo instInfo{};
+        instInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        instInfo.pApplicationInfo = &appInfo;
+        if (vkCreateInstance(&instInfo, nullptr, &d.instance) != VK_SUCCESS) {
+            d.error = QStringLiteral("vkCreateInstance failed");
+            return d;
+        }
+
+        uint32_t count = 0;
+        vkEnumeratePhysicalDevices(d.instance, &count, nullptr);
+        QList<VkPhysicalDevice> physDevs(count);
+        vkEnumeratePhysicalDevices(d.instance, &count, physDevs.data());
+        for (VkPhysicalDevice pd : physDevs) {
+            VkPhysicalDeviceProperties props;
+            vkGetPhysicalDeviceProperties(pd, &props);
+            if (!d.physDev || props.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU)
+                d.physDev = pd;
+        }
+        if (!d.physDev) {
+            d.error = QStringLiteral("no Vulkan physical device");
+            return d;
+        }
+        vkGetPhysicalDeviceMemoryProperties(d.physDev, &d.memProps);
+
+        const float priority = 1.0f;
+        VkDeviceQueueCreateInfo queueInfo{};
+        queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueInfo.queueFamilyIndex = 0;
+        queueInfo.queueCount = 1;
+        queueInfo.pQueuePriorities = &priority;
+        VkDeviceCreateInfo devInfo{};
+        devInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        devInfo.queueCreateInfoCount = 1;
+        devInfo.pQueueCreateInfos = &queueInfo;
+        if (vkCreateDevice(d.physDev, &devInfo, nullptr, &d.dev) != VK_SUCCESS) {
+            d.error = QStringLiteral("vkCreateDevice failed");
+            return d;
+        }
+
+        // Совместимый с основным проходом окна: цвет BGRA8 и глубина
+        VkAttachmentDescription attachments[2]{};
+        attachments[0].format = VK_FORMAT_B8G8R8A8_UNORM;
+        attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        attachments[1].format = VK_FORMAT_D32_SFLOAT;
+        attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        VkAttachmentReference colorRef { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        VkAttachmentReference depthRef { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorRef;
+        subpass.pDepthStencilAttachment = &depthRef;
+        VkRenderPassCreateInfo rpInfo{};
+        rpInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        rpInfo.attachmentCount = 2;
+        rpInfo.pAttachments = attachments;
+        rpInfo.subpassCount = 1;
+        rpInfo.pSubpasses = &subpass;
+        if (vkCreateRenderPass(d.dev, &rpInfo, nullptr, &d.renderPass) != VK_SUCCESS)
+            d.error = QStringLiteral("vkCreateRenderPass failed");
+        return d;
+    }();
+    return d;
+}
+
+bool checkDevice(benchmark::State &state)
+{
+    const Device &d = device();
+    if (d.error.isEmpty())
+        return true;
+    state.SkipWithError(qPrintable(d.error));
+    return false;
+}
+
+VkShaderModule createModule(VkDevice dev, const char *name)
+{
+    const VulkanEmbeddedShader *shader = VulkanEmbeddedShaders::find(QLatin1String(name));
+    if (!shader)
+        qFatal("Shader %s is not embedded", name);
+    VkShaderModuleCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    info.codeSize = shader->size;
+    info.pCode = shader->code;
+    VkShaderModule module = VK_NULL_HANDLE;
+    if (vkCreateShaderModule(dev, &info, nullptr, &module) != VK_SUCCESS)
+        qFatal("Failed to create shader module %s", name);
+    return module;
+}
+
+// Раскладки наборов дескрипторов куба (без bindless), см. CubeRenderer::init():
+// набор 0 - буферы, набор 1 - текстура
+void createCubeSetLayouts(VkDevice dev, VkDescriptorSetLayout *layouts)
+{
+    VkDescriptorSetLayoutBinding bindings[3]{};
+    bindings[0] = { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1,
+                    VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+    bindings[1] = { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+    bindings[2] = { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+    VkDescriptorSetLayoutCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    info.bindingCount = 3;
+    info.pBindings = bindings;
+    vkCreateDescriptorSetLayout(dev, &info, nullptr, &layouts[0]);
+
+    const VkDescriptorSetLayoutBinding texture { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1,
+                                                 VK_SHADER_STAGE_FRAGMENT_BIT, nullptr };
+    info.bindingCount = 1;
+    info.pBindings = &texture;
+    vkCreateDescriptorSetLayout(dev, &info, nullptr, &layouts[1]);
+}
+
+} // namespace
+
+// Матрицы и запись uniform buffer пакета кубов - каждый кадр в CubeRenderer::frameStart()
+static void BM_CubeUniformFill(benchmark::State &state)
+{
+    alignas(16) char buffer[VulkanCubeUniforms::Size];
+    float t = 0;
+    for (auto _ : state) {
+        VulkanCubeUniforms::fill(buffer, t, QSize(128, 128), QSize(1280, 720), 16, true);
+        benchmark::DoNotOptimize(buffer);
+        benchmark::ClobberMemory();
+        t += 0.001f;
+    }
+}
+BENCHMARK(BM_CubeUniformFill);
+
+// Записи экземпляров всех кубов окна - каждый кадр в CubeBatcher::frameStart()
+static void BM_CubeInstanceFill(benchmark::State &state)
+{
+    const int count = int(state.range(0));
+    std::vector<float> instances(size_t(count) * VulkanCubeUniforms::InstanceSize / sizeof(float));
+    float t = 0;
+    for (auto _ : state) {
+        float *dst = instances.data();
+        for (int i = 0; i < count; ++i) {
+            VulkanCubeUniforms::fillInstance(dst, t, QRect((i % 32) * 40, (i / 32) * 40, 40, 40), uint32_t(i % 4));
+            dst += VulkanCubeUniforms::InstanceSize / sizeof(float);
+        }
+        benchmark::DoNotOptimize(instances.data());
+        benchmark::ClobberMemory();
+        t += 0.001f;
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_CubeInstanceFill)->Arg(100)->Arg(1000);
+
+// То же на VulkanJobSystem, как в CubeBatcher::frameStart(): аргументы -
+// рабочих потоков (плюс вызывающий, threads в отчёте) и экземпляров.
+// Масштабирование от 1 до N потоков печатает scaling.py (run_microbench.sh).
+static void BM_CubeInstanceFillJobs(benchmark::State &state)
+{
+    const int workers = int(state.range(0));
+    const int count = int(state.range(1));
+    const int stride = int(VulkanCubeUniforms::InstanceSize / sizeof(float));
+    std::vector<float> instances(size_t(count) * stride);
+    VulkanJobSystem jobs(workers);
+    float t = 0;
+    for (auto _ : state) {
+        float *data = instances.data();
+        jobs.parallelFor(count, 64, [data, stride, t](int begin, int end) {
+            for (int i = begin; i < end; ++i)
+                VulkanCubeUniforms::fillInstance(data + size_t(i) * stride, t, QRect((i % 32) * 40, (i / 32) * 40, 40, 40),
+                                                 uint32_t(i % 4));
+        });
+        benchmark::DoNotOptimize(instances.data());
+        benchmark::ClobberMemory();
+        t += 0.001f;
+    }
+    state.SetItemsProcessed(state.iterations() * count);
+    state.counters["threads"] = workers + 1;
+}
+BENCHMARK(BM_CubeInstanceFillJobs)->Apply([](benchmark::internal::Benchmark *b) {
+    for (int workers = 0; workers < qMax(1, QThread::idealThreadCount()); ++workers) {
+        b->Args({ workers, 1000 });
+        b->Args({ workers, 10000 });
+    }
+})->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+// Поиск типа памяти при создании каждого буфера; худший случай - 32 типа,
+// подходит только последний
+static void BM_FindMemoryTypeWorstCase(benchmark::State &state)
+{
+    VkPhysicalDeviceMemoryProperties props{};
+    props.memoryTypeCount = VK_MAX_MEMORY_TYPES;
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; ++i)
+        props.memoryTypes[i].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    props.memoryTypes[VK_MAX_MEMORY_TYPES - 1].propertyFlags |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+            | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    for (auto _ : state) {
+        uint32_t index = VulkanUtils::findMemoryType(props, ~0u, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                                     | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        benchmark::DoNotOptimize(index);
+    }
+}
+BENCHMARK(BM_FindMemoryTypeWorstCase);
+
+static void BM_FindMemoryTypeDevice(benchmark::State &state)
+{
+    if (!checkDevice(state))
+        return;
+    const VkPhysicalDeviceMemoryProperties &props = device().memProps;
+    for (auto _ : state) {
+        uint32_t index = VulkanUtils::findMemoryType(props, ~0u, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                                     | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        benchmark::DoNotOptimize(index);
+    }
+}
+BENCHMARK(BM_FindMemoryTypeDevice);
+
+// Конвертация PNG текстуры куба в RGBA8888, когда подготовленного блоба нет
+static void BM_TextureConvert(benchmark::State &state)
+{
+    const QImage source(QStringLiteral(VULKANUNDERQML_SOURCE_DIR "/textures/metalplate01_rgba.png"));
+    if (source.isNull()) {
+        state.SkipWithError("texture not found");
+        return;
+    }
+    for (auto _ : state) {
+        QImage image = source;
+        image.convertTo(QImage::Format_RGBA8888);
+        benchmark::DoNotOptimize(image.constBits());
+    }
+    state.SetBytesProcessed(state.iterations() * source.sizeInBytes());
+    state.SetLabel(QStringLiteral("%1x%2 format %3").arg(source.width()).arg(source.height())
+                   .arg(int(source.format())).toStdString());
+}
+BENCHMARK(BM_TextureConvert)->Unit(benchmark::kMicrosecond);
+
+// Пересчёт иерархии VulkanScene в sync(): дерево с ветвлением 8, меняется
+// доля узлов range(1) из 1000 (10 = 1%). Время должно расти с долей
+// изменённых узлов, а не с размером сцены.
+static void BM_SceneUpdate(benchmark::State &state)
+{
+    const int count = int(state.range(0));
+    const int changedPerMille = int(state.range(1));
+    VulkanSceneNodes nodes;
+    for (int i = 0; i < count; ++i)
+        nodes.add(i == 0 ? -1 : (i - 1) / 8);
+    nodes.update();
+    nodes.takeChanged();
+
+    const int changedCount = qMax(1, count * changedPerMille / 1000);
+    quint32 seed = 1;
+    float angle = 0;
+    qint64 recomputed = 0;
+    for (auto _ : state) {
+        angle += 0.01f;
+        for (int i = 0; i < changedCount; ++i) {
+            seed = seed * 1664525u + 1013904223u;
+            nodes.setRotation(int(seed % quint32(count)), QQuaternion::fromAxisAndAngle(0, 1, 0, angle));
+        }
+        nodes.update();
+        const QList<int> changed = nodes.takeChanged();
+        recomputed += changed.size();
+        benchmark::DoNotOptimize(changed.constData());
+    }
+    state.counters["recomputed"] = benchmark::Counter(double(recomputed), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_SceneUpdate)->Args({ 10000, 10 })->Args({ 100000, 10 })->Args({ 100000, 1000 })
+    ->Unit(benchmark::kMicrosecond);
+
+namespace {
+
+// Состояние, которое VulkanSquircle и VulkanCube передают рендереру
+struct ItemState {
+    QSize viewportSize;
+    qreal t = 0;
+    bool renderThreadAnimation = false;
+    qreal animationSpeed = 0;
+    qreal animationPhase = 0;
+    double refreshInterval = 0;
+};
+
+// Заменяет QQuickWindow: сигнал с прямыми подключениями элементов
+class SyncWindow : public QObject
+{
+    Q_OBJECT
+public:
+    QSize size { 1280, 720 };
+    qreal devicePixelRatio = 1;
+
+signals:
+    void beforeSynchronizing();
+};
+
+class SyncItem : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SyncItem(SyncWindow *window) : m_window(window) { }
+
+    void setT(qreal t) { m_t = t; }
+    ItemState state() const
+    {
+        ItemState state;
+        state.viewportSize = m_window->size * m_window->devicePixelRatio;
+        state.t = m_t;
+        state.refreshInterval = 1.0 / 60.0;
+        return state;
+    }
+
+    // Прежний путь: копирование в рендерер в sync() при заблокированном GUI-потоке
+    void sync() { renderer = state(); }
+
+    // Новый путь: публикация из сеттера, рендерер забирает снимок сам
+    void publish() { snapshot.publish(state()); }
+
+    ItemState renderer;
+    VulkanStateSnapshot<ItemState> snapshot;
+
+private:
+    SyncWindow *m_window;
+    qreal m_t = 0;
+};
+
+} // namespace
+
+// Фаза sync с range(0) элементами, у каждого t меняется каждый кадр.
+// Кроме записи t замеряется испускание beforeSynchronizing, то есть время,
+// на которое заблокирован GUI-поток.
+static void BM_SyncBlocking(benchmark::State &state)
+{
+    SyncWindow window;
+    QList<SyncItem *> items;
+    for (int i = 0; i < state.range(0); ++i) {
+        items.append(new SyncItem(&window));
+        QObject::connect(&window, &SyncWindow::beforeSynchronizing, items.last(), &SyncItem::sync,
+                         Qt::DirectConnection);
+    }
+    qreal t = 0;
+    for (auto _ : state) {
+        t += 0.001;
+        for (SyncItem *item : std::as_const(items))
+            item->setT(t);
+        emit window.beforeSynchronizing();
+    }
+    benchmark::DoNotOptimize(items.first()->renderer.t);
+    qDeleteAll(items);
+}
+BENCHMARK(BM_SyncBlocking)->Arg(10)->Arg(100)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+// То же со снимками: элементы отключены от beforeSynchronizing после
+// создания рендерера. Кроме фазы sync в замер входят публикация снимка
+// каждым элементом (GUI-поток, в приложении - из сеттера) и его получение
+// (поток рендеринга, в начале кадра); ни то ни другое не ждёт другой поток.
+static void BM_SyncSnapshot(benchmark::State &state)
+{
+    SyncWindow window;
+    QList<SyncItem *> items;
+    for (int i = 0; i < state.range(0); ++i)
+        items.append(new SyncItem(&window));
+    qreal t = 0;
+    for (auto _ : state) {
+        t += 0.001;
+        for (SyncItem *item : std::as_const(items)) {
+            item->setT(t);
+            item->publish();
+        }
+        emit window.beforeSynchronizing();
+        for (SyncItem *item : std::as_const(items)) {
+            if (item->snapshot.take())
+                item->renderer = item->snapshot.current();
+        }
+    }
+    benchmark::DoNotOptimize(items.first()->renderer.t);
+    qDeleteAll(items);
+}
+BENCHMARK(BM_SyncSnapshot)->Arg(10)->Arg(100)->Arg(1000)->Unit(benchmark::kMicrosecond);
+
+// Раскладки, пул, выделение наборов и запись буферов набора 0 куба.
+// Текстура набора 1 пишется при регистрации текстуры, здесь не замеряется.
+static void BM_CubeDescriptorSetup(benchmark::State &state)
+{
+    if (!checkDevice(state))
+        return;
+    VkDevice dev = device().dev;
+
+    // Один буфер под все три привязки, создаётся вне замера
+    const VkDeviceSize bufferSize = 64 * 1024;
+    VkBufferCreateInfo bufInfo{};
+    bufInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufInfo.size = bufferSize;
+    bufInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    vkCreateBuffer(dev, &bufInfo, nullptr, &buffer);
+    VkMemoryRequirements memReq;
+    vkGetBufferMemoryRequirements(dev, buffer, &memReq);
+    VkMemoryAllocateInfo memInfo{};
+    memInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memInfo.allocationSize = memReq.size;
+    memInfo.memoryTypeIndex = VulkanUtils::findMemoryType(device().memProps, memReq.memoryTypeBits,
+                                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (memInfo.memoryTypeIndex == uint32_t(-1)
+        || vkAllocateMemory(dev, &memInfo, nullptr, &memory) != VK_SUCCESS) {
+        vkDestroyBuffer(dev, buffer, nullptr);
+        state.SkipWithError("buffer memory allocation failed");
+        return;
+    }
+    vkBindBufferMemory(dev, buffer, memory, 0);
+
+    const VkDescriptorBufferInfo uniformInfo { buffer, 0, VulkanCubeUniforms::Size };
+    const VkDescriptorBufferInfo lightInfo { buffer, 4096, 4096 };
+    const VkDescriptorBufferInfo clusterInfo { buffer, 8192, bufferSize - 8192 };
+
+    for (auto _ : state) {
+        VkDescriptorSetLayout layouts[2];
+        createCubeSetLayouts(dev, layouts);
+
+        VkDescriptorPoolSize sizes[] = {
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 }
+        };
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = 2;
+        poolInfo.poolSizeCount = 4;
+        poolInfo.pPoolSizes = sizes;
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+        vkCreateDescriptorPool(dev, &poolInfo, nullptr, &pool);
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = pool;
+        allocInfo.descriptorSetCount = 2;
+        allocInfo.pSetLayouts = layouts;
+        VkDescriptorSet sets[2] = {};
+        vkAllocateDescriptorSets(dev, &allocInfo, sets);
+
+        VkWriteDescriptorSet writes[3]{};
+        writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[0].dstSet = sets[0];
+        writes[0].dstBinding = 0;
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        writes[0].pBufferInfo = &uniformInfo;
+        writes[1] = writes[0];
+        writes[1].dstBinding = 2;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        writes[1].pBufferInfo = &lightInfo;
+        writes[2] = writes[0];
+        writes[2].dstBinding = 3;
+        writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[2].pBufferInfo = &clusterInfo;
+        vkUpdateDescriptorSets(dev, 3, writes, 0, nullptr);
+        benchmark::DoNotOptimize(sets);
+
+        vkDestroyDescriptorPool(dev, pool, nullptr);
+        vkDestroyDescriptorSetLayout(dev, layouts[0], nullptr);
+        vkDestroyDescriptorSetLayout(dev, layouts[1], nullptr);
+    }
+
+    vkDestroyBuffer(dev, buffer, nullptr);
+    vkFreeMemory(dev, memory, nullptr);
+}
+BENCHMARK(BM_CubeDescriptorSetup)->Unit(benchmark::kMicrosecond);
+
+// Compute-пайплайн отбора источников света куба, без кэша пайплайнов
+static void BM_CubeCullPipeline(benchmark::State &state)
+{
+    if (!checkDevice(state))
+        return;
+    VkDevice dev = device().dev;
+    VkShaderModule module = createModule(dev, "cube_lights.comp.spv");
+
+    VkDescriptorSetLayoutBinding bindings[3]{};
+    bindings[0] = { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    bindings[1] = { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    bindings[2] = { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    VkDescriptorSetLayoutCreateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setInfo.bindingCount = 3;
+    setInfo.pBindings = bindings;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    vkCreateDescriptorSetLayout(dev, &setInfo, nullptr, &setLayout);
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &setLayout;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    vkCreatePipelineLayout(dev, &layoutInfo, nullptr, &layout);
+
+    VkComputePipelineCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    info.stage.module = module;
+    info.stage.pName = "main";
+    info.layout = layout;
+    for (auto _ : state) {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        if (vkCreateComputePipelines(dev, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
+            state.SkipWithError("vkCreateComputePipelines failed");
+            break;
+        }
+        vkDestroyPipeline(dev, pipeline, nullptr);
+    }
+
+    vkDestroyPipelineLayout(dev, layout, nullptr);
+    vkDestroyDescriptorSetLayout(dev, setLayout, nullptr);
+    vkDestroyShaderModule(dev, module, nullptr);
+}
+BENCHMARK(BM_CubeCullPipeline)->Unit(benchmark::kMillisecond);
+
+// Графический пайплайн VulkanMesh (треугольники, смешивание, глубина)
+static void BM_MeshGraphicsPipeline(benchmark::State &state)
+{
+    if (!checkDevice(state))
+        return;
+    VkDevice dev = device().dev;
+    VkShaderModule vert = createModule(dev, "mesh.vert.spv");
+    VkShaderModule frag = createModule(dev, "mesh.frag.spv");
+
+    VkDescriptorSetLayoutBinding binding { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1,
+                                           VK_SHADER_STAGE_VERTEX_BIT, nullptr };
+    VkDescriptorSetLayoutCreateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setInfo.bindingCount = 1;
+    setInfo.pBindings = &binding;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    vkCreateDescriptorSetLayout(dev, &setInfo, nullptr, &setLayout);
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &setLayout;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    vkCreatePipelineLayout(dev, &layoutInfo, nullptr, &layout);
+
+    VkPipelineShaderStageCreateInfo stages[2]{};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vert;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = frag;
+    stages[1].pName = "main";
+
+    VkVertexInputBindingDescription vertexBinding { 0, 7 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX };
+    VkVertexInputAttributeDescription attributes[2] = {
+        { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 },
+        { 1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 3 * sizeof(float) }
+    };
+    VkPipelineVertexInputStateCreateInfo vertexInput{};
+    vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInput.vertexBindingDescriptionCount = 1;
+    vertexInput.pVertexBindingDescriptions = &vertexBinding;
+    vertexInput.vertexAttributeDescriptionCount = 2;
+    vertexInput.pVertexAttributeDescriptions = attributes;
+
+    VkPipelineInputAssemblyStateCreateInfo ia{};
+    ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPipelineViewportStateCreateInfo vp{};
+    vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    vp.viewportCount = 1;
+    vp.scissorCount = 1;
+    VkPipelineRasterizationStateCreateInfo rs{};
+    rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rs.polygonMode = VK_POLYGON_MODE_FILL;
+    rs.cullMode = VK_CULL_MODE_NONE;
+    rs.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rs.lineWidth = 1.0f;
+    VkPipelineMultisampleStateCreateInfo ms{};
+    ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkPipelineDepthStencilStateCreateInfo ds{};
+    ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    ds.depthTestEnable = VK_TRUE;
+    ds.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    VkPipelineColorBlendAttachmentState att{};
+    att.blendEnable = VK_TRUE;
+    att.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    att.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    att.colorBlendOp = VK_BLEND_OP_ADD;
+    att.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    att.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    att.alphaBlendOp = VK_BLEND_OP_ADD;
+    att.colorWriteMask = 0xF;
+    VkPipelineColorBlendStateCreateInfo cb{};
+    cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    cb.attachmentCount = 1;
+    cb.pAttachments = &att;
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dyn{};
+    dyn.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dyn.dynamicStateCount = 2;
+    dyn.pDynamicStates = dynamicStates;
+
+    VkGraphicsPipelineCreateInfo info{};
+    info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    info.stageCount = 2;
+    info.pStages = stages;
+    info.pVertexInputState = &vertexInput;
+    info.pInputAssemblyState = &ia;
+    info.pViewportState = &vp;
+    info.pRasterizationState = &rs;
+    info.pMultisampleState = &ms;
+    info.pDepthStencilState = &ds;
+    info.pColorBlendState = &cb;
+    info.pDynamicState = &dyn;
+    info.layout = layout;
+    info.renderPass = device().renderPass;
+
+    for (auto _ : state) {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        if (vkCreateGraphicsPipelines(dev, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline) != VK_SUCCESS) {
+            state.SkipWithError("vkCreateGraphicsPipelines failed");
+            break;
+        }
+        vkDestroyPipeline(dev, pipeline, nullptr);
+    }
+
+    vkDestroyPipelineLayout(dev, layout, nullptr);
+    vkDestroyDescriptorSetLayout(dev, setLayout, nullptr);
+    vkDestroyShaderModule(dev, frag, nullptr);
+    vkDestroyShaderModule(dev, vert, nullptr);
+}
+BENCHMARK(BM_MeshGraphicsPipeline)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
+
+#include "microbench.moc"
@@ -0,0 +1,70 @@
+#!/bin/sh
+# Прогон микробенчмарков на lavapipe и сравнение с базой.
+# Использование:
+#   benchmarks/micro/run_microbench.sh <vulkanunderqml_microbench> [--update]
+#   benchmarks/micro/run_microbench.sh <vulkanunderqml_microbench> --against <rev>
+# Без ключей результат сравнивается с baseline.json рядом со скриптом;
+# перед сравнением печатается масштабирование BM_CubeInstanceFillJobs
+# по числу потоков (scaling.py).
+# --update записывает результат в baseline.json; база имеет смысл только
+# для одной машины, перезаписывайте её вместе с изменениями, которые
+# осознанно меняют время.
+# --against <rev> собирает микробенчмарки ревизии rev в отдельном worktree,
+# прогоняет их здесь же и сравнивает с ними - база с той же машины, без
+# сохранённого файла.
+
+set -e
+
+BENCH=${1:?usage: $0 <vulkanunderqml_microbench> [--update | --against <rev>]}
+DIR=$(cd "$(dirname "$0")" && pwd)
+BASELINE=$DIR/baseline.json
+OUT=$(mktemp)
+WORK=
+cleanup() {
+    rm -f "$OUT"
+    if [ -n "$WORK" ]; then
+        git -C "$DIR" worktree remove --force "$WORK/src" 2>/dev/null || true
+        rm -rf "$WORK"
+    fi
+}
+trap cleanup EXIT
+
+if [ -z "$VK_ICD_FILENAMES" ]; then
+    for icd in /usr/share/vulkan/icd.d/lvp_icd.*.json /usr/local/share/vulkan/icd.d/lvp_icd.*.json; do
+        if [ -f "$icd" ]; then
+            VK_ICD_FILENAMES=$icd
+            break
+        fi
+    done
+fi
+export VK_ICD_FILENAMES
+
+run() {
+    "$1" --benchmark_repetitions=5 --benchmark_report_aggregates_only=true \
+        --benchmark_out="$2" --benchmark_out_format=json
+}
+
+if [ "$2" = "--against" ]; then
+    REV=${3:?--against needs a git revision}
+    WORK=$(mktemp -d)
+    BASELINE=$WORK/baseline.json
+    git -C "$DIR" worktree add --detach "$WORK/src" "$REV"
+    cmake -S "$WORK/src" -B "$WORK/build" -DCMAKE_BUILD_TYPE=Release \
+        -DVULKANUNDERQML_BUILD_MICROBENCH=ON
+    cmake --build "$WORK/build" --target vulkanunderqml_microbench
+    run "$WORK/build/vulkanunderqml_microbench" "$BASELINE"
+fi
+
+run "$BENCH" "$OUT"
+# Масштабирование пула заданий по числу потоков, таблица для этой машины
+python3 "$DIR/scaling.py" "$OUT" || true
+
+if [ "$2" = "--update" ]; then
+    cp "$OUT" "$BASELINE"
+    echo "baseline written to $BASELINE"
+elif [ -f "$BASELINE" ]; then
+    python3 "$DIR/compare.py" "$BASELINE" "$OUT"
+else
+    echo "no baseline: run with --update, or compare with --against <rev>" >&2
+    exit 1
+fi
@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+# Масштабирование BM_CubeInstanceFillJobs по числу потоков из прогона
+# vulkanunderqml_microbench (JSON Google Benchmark).
+# Использование: scaling.py <result.json>
+# Для каждого числа экземпляров - время и ускорение относительно 0 рабочих
+# (всё в вызывающем потоке); при --benchmark_repetitions берутся медианы.
+
+import json
+import sys
+
+NAME = "BM_CubeInstanceFillJobs"
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    results = {}
+    medians = {}
+    for b in data.get("benchmarks", []):
+        if b.get("error_occurred"):
+            continue
+        parts = b.get("run_name", b["name"]).split("/")
+        if parts[0] != NAME or len(parts) < 3:
+            continue
+        key = (int(parts[2]), int(parts[1]))
+        # UseRealTime: важна длительность кадра, а не сумма процессорного времени
+        time = b["real_time"]
+        if b.get("run_type") == "aggregate":
+            if b.get("aggregate_name") == "median":
+                medians[key] = (time, b.get("time_unit", "ns"))
+        else:
+            results.setdefault(key, (time, b.get("time_unit", "ns")))
+    results.update(medians)
+    return results
+
+
+def main():
+    if len(sys.argv) != 2:
+        print("usage: scaling.py <result.json>", file=sys.stderr)
+        return 2
+    results = load(sys.argv[1])
+    if not results:
+        print("no %s results in %s" % (NAME, sys.argv[1]), file=sys.stderr)
+        return 1
+
+    print("%10s %8s %12s %8s" % ("instances", "threads", "time", "speedup"))
+    for count in sorted({c for c, _ in results}):
+        serial = results.get((count, 0))
+        for workers in sorted(w for c, w in results if c == count):
+            time, unit = results[(count, workers)]
+            speedup = "%.2fx" % (serial[0] / time) if serial and time > 0 else "-"
+            print("%10d %8d %9.1f %-2s %8s" % (count, workers + 1, time, unit, speedup))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
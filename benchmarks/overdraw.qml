@@ -0,0 +1,38 @@
+// Сцена main.qml без элементов управления: полноэкранный squircle и куб
+// поверх него. Запуск с --pipeline-stats печатает число вызовов
+// фрагментного шейдера на элемент; приложение завершается после замера.
+
+import QtQuick
+import VulkanUnderQML
+
+VulkanQuickWindow {
+    width: 800
+    height: 600
+    visible: true
+    title: "Overdraw benchmark"
+    color: "black"
+
+    VulkanSquircle {
+        anchors.fill: parent
+        renderThreadAnimation: true
+        animationSpeed: 0.2
+    }
+
+    VulkanCube {
+        anchors.centerIn: parent
+        width: 400
+        height: 400
+        renderThreadAnimation: true
+        animationSpeed: 0.1
+    }
+
+    VulkanFrameTimer {
+        sampleCount: 900
+        warmupFrames: 30
+        onMeasured: (averageFrameTime, maxFrameTime) => {
+            console.log("frame time " + averageFrameTime.toFixed(3) + " ms")
+            Qt.quit()
+        }
+        Component.onCompleted: restart()
+    }
+}
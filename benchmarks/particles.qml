@@ -0,0 +1,49 @@
+// Бенчмарк масштабирования VulkanParticles: время кадра от числа частиц.
+// Запуск: vulkanunderqmlapp --qml benchmarks/particles.qml
+// Результат печатается в stdout в формате CSV, после последнего шага
+// приложение завершается.
+
+import QtQuick
+import VulkanUnderQML
+
+VulkanQuickWindow {
+    id: window
+    width: 1280
+    height: 720
+    visible: true
+    title: "VulkanParticles benchmark"
+    color: "black"
+
+    property var counts: [16384, 65536, 262144, 1048576, 2097152]
+    property int step: 0
+
+    VulkanParticles {
+        id: particles
+        anchors.fill: parent
+        count: window.counts[window.step]
+        emitterPosition: Qt.vector3d(0, -0.5, 0)
+        pointSize: 2
+    }
+
+    VulkanFrameTimer {
+        id: timer
+        sampleCount: 300
+        warmupFrames: 60
+
+        onMeasured: (averageFrameTime, maxFrameTime) => {
+            console.log("particles," + particles.count + "," + averageFrameTime.toFixed(3)
+                        + "," + maxFrameTime.toFixed(3) + "," + (1000 / averageFrameTime).toFixed(1))
+            if (window.step + 1 < window.counts.length) {
+                window.step++
+                timer.restart()
+            } else {
+                Qt.quit()
+            }
+        }
+    }
+
+    Component.onCompleted: {
+        console.log("benchmark,count,avg_ms,max_ms,fps")
+        timer.restart()
+    }
+}
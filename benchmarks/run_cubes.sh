@@ -0,0 +1,25 @@
+#!/bin/sh
+# Время кадра от числа элементов VulkanCube: совместимые кубы одним
+# instanced draw против draw на каждый куб (--no-cube-batching).
+# Использование: benchmarks/run_cubes.sh <путь к vulkanunderqmlapp> [out.csv]
+
+set -e
+
+APP=${1:?usage: $0 <vulkanunderqmlapp> [out.csv]}
+OUT=${2:-cubes.csv}
+DIR=$(cd "$(dirname "$0")" && pwd)
+
+export QSG_NO_VSYNC=1
+export QT_LOGGING_RULES="qt.scenegraph*=false"
+
+echo "benchmark,mode,count,avg_ms,max_ms,fps" > "$OUT"
+for mode in batched separate; do
+    if [ "$mode" = batched ]; then
+        flag=
+    else
+        flag=--no-cube-batching
+    fi
+    "$APP" $flag --qml "$DIR/cubes.qml" 2>&1 | sed -n 's/^.*qml: cubes,//p' \
+        | sed "s/^/cubes,$mode,/" >> "$OUT"
+done
+cat "$OUT"
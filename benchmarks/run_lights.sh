@@ -0,0 +1,16 @@
+#!/bin/sh
+# Время кадра VulkanCube от числа источников света: перебор всех
+# источников против отбора по кластерам.
+# Использование: benchmarks/run_lights.sh <путь к vulkanunderqmlapp> [out.csv]
+
+set -e
+
+APP=${1:?usage: $0 <vulkanunderqmlapp> [out.csv]}
+OUT=${2:-lights.csv}
+DIR=$(cd "$(dirname "$0")" && pwd)
+
+export QSG_NO_VSYNC=1
+export QT_LOGGING_RULES="qt.scenegraph*=false"
+
+"$APP" --qml "$DIR/lights.qml" 2>&1 | sed -n 's/^.*qml: //p' | grep -E '^(benchmark|lights),' > "$OUT"
+cat "$OUT"
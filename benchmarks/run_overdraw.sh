@@ -0,0 +1,16 @@
+#!/bin/sh
+# Сравнение вызовов фрагментного шейдера при прежнем порядке отрисовки
+# (painter: фон, затем куб поверх) и при порядке по глубине (куб, затем
+# фон с early-Z). Использование: benchmarks/run_overdraw.sh <vulkanunderqmlapp>
+
+set -e
+
+APP=${1:?usage: $0 <vulkanunderqmlapp>}
+DIR=$(cd "$(dirname "$0")" && pwd)
+
+export QSG_NO_VSYNC=1
+
+for order in painter depth; do
+    "$APP" --qml "$DIR/overdraw.qml" --pipeline-stats --draw-order $order 2>&1 \
+        | grep -E "draw order|frame time" | tail -n 2
+done
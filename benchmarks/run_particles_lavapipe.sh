@@ -0,0 +1,33 @@
+#!/bin/sh
+# Масштабирование VulkanParticles на программном рендерере lavapipe (Mesa).
+# Использование: benchmarks/run_particles_lavapipe.sh <путь к vulkanunderqmlapp> [out.csv]
+# Без vsync время кадра отражает стоимость симуляции и отрисовки,
+# а не частоту обновления дисплея.
+
+set -e
+
+APP=${1:?usage: $0 <vulkanunderqmlapp> [out.csv]}
+OUT=${2:-particles_lavapipe.csv}
+DIR=$(cd "$(dirname "$0")" && pwd)
+
+if [ -z "$VK_ICD_FILENAMES" ]; then
+    for icd in /usr/share/vulkan/icd.d/lvp_icd.*.json /usr/local/share/vulkan/icd.d/lvp_icd.*.json; do
+        if [ -f "$icd" ]; then
+            VK_ICD_FILENAMES=$icd
+            break
+        fi
+    done
+fi
+if [ -z "$VK_ICD_FILENAMES" ]; then
+    echo "lavapipe ICD (lvp_icd.*.json) not found, install mesa-vulkan-drivers" >&2
+    exit 1
+fi
+export VK_ICD_FILENAMES
+
+export QSG_NO_VSYNC=1
+export QSG_RENDER_LOOP=${QSG_RENDER_LOOP:-threaded}
+export QT_LOGGING_RULES="qt.scenegraph*=false"
+
+echo "ICD: $VK_ICD_FILENAMES" >&2
+"$APP" --qml "$DIR/particles.qml" 2>&1 | sed -n 's/^.*qml: //p' | grep -E '^(benchmark|particles),' > "$OUT"
+cat "$OUT"
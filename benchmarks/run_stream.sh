@@ -0,0 +1,18 @@
+#!/bin/sh
+# Время кадра с потоковой текстурой VulkanCube (60 кадров/с от 720p до 4K).
+# Копирование идёт в рабочем потоке, поэтому max_ms не должен расти с
+# размером кадра.
+# Использование: benchmarks/run_stream.sh <путь к vulkanunderqmlapp> [out.csv]
+
+set -e
+
+APP=${1:?usage: $0 <vulkanunderqmlapp> [out.csv]}
+OUT=${2:-stream.csv}
+DIR=$(cd "$(dirname "$0")" && pwd)
+
+export QSG_NO_VSYNC=1
+export QT_LOGGING_RULES="qt.scenegraph*=false"
+
+echo "benchmark,size,avg_ms,max_ms,fps" > "$OUT"
+"$APP" --qml "$DIR/stream.qml" 2>&1 | sed -n 's/^.*qml: \(stream,\)/\1/p' >> "$OUT"
+cat "$OUT"
@@ -0,0 +1,37 @@
+#!/bin/sh
+# Стоимость нескольких окон: 1, 2 и 4 окна с общим устройством и с
+# устройством на окно. Для каждого прогона - загрузка CPU процесса
+# (user+sys к реальному времени), пиковый RSS и время кадра каждого окна.
+# Использование: benchmarks/run_windows.sh <путь к vulkanunderqmlapp> [out.csv]
+# Нужен GNU time (/usr/bin/time). VSync включён: при отключённом каждый
+# поток рендеринга крутится без ожидания и загрузка CPU ничего не говорит.
+
+set -e
+
+APP=${1:?usage: $0 <vulkanunderqmlapp> [out.csv]}
+OUT=${2:-windows.csv}
+DIR=$(cd "$(dirname "$0")" && pwd)
+TIME=/usr/bin/time
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+export QT_LOGGING_RULES="qt.scenegraph*=false"
+
+echo "windows,device,cpu_percent,max_rss_kb,window,avg_ms,max_ms,fps" > "$OUT"
+for n in 1 2 4; do
+    for device in shared separate; do
+        if [ "$device" = shared ]; then
+            flag=--shared-device
+        else
+            flag=--separate-devices
+        fi
+        "$TIME" -f "%U %S %e %M" -o "$TMP/time" \
+            "$APP" --windows "$n" $flag --qml "$DIR/windows.qml" > "$TMP/log" 2>&1
+        read -r user sys elapsed rss < "$TMP/time"
+        cpu=$(echo "$user $sys $elapsed" | awk '{ printf "%.1f", ($1 + $2) * 100 / $3 }')
+        sed -n 's/^.*qml: window,//p' "$TMP/log" | while IFS=, read -r index avg max fps; do
+            echo "$n,$device,$cpu,$rss,$index,$avg,$max,$fps" >> "$OUT"
+        done
+    done
+done
+cat "$OUT"
@@ -0,0 +1,53 @@
+// Бенчмарк потоковой текстуры VulkanCube: время кадра, пока генератор
+// VulkanTextureSource подаёт кадры 60 раз в секунду, от размера кадра до 4K.
+// Запуск: vulkanunderqmlapp --qml benchmarks/stream.qml (или run_stream.sh).
+// Результат печатается в stdout в формате CSV, после последнего шага
+// приложение завершается.
+
+import QtQuick
+import VulkanUnderQML
+
+VulkanQuickWindow {
+    id: window
+    width: 1280
+    height: 720
+    visible: true
+    title: "VulkanCube streaming texture benchmark"
+    color: "black"
+
+    property var sizes: [Qt.size(1280, 720), Qt.size(1920, 1080), Qt.size(3840, 2160)]
+    property int step: 0
+
+    VulkanTextureSource {
+        id: source
+        testPatternSize: window.sizes[window.step]
+        testPatternRate: 60
+    }
+
+    VulkanCube {
+        anchors.fill: parent
+        renderThreadAnimation: true
+        animationSpeed: 0.1
+        textureSource: source
+    }
+
+    VulkanFrameTimer {
+        id: timer
+        sampleCount: 600
+        warmupFrames: 60
+
+        onMeasured: (averageFrameTime, maxFrameTime) => {
+            const size = window.sizes[window.step]
+            console.log("stream," + size.width + "x" + size.height + "," + averageFrameTime.toFixed(3)
+                        + "," + maxFrameTime.toFixed(3) + "," + (1000 / averageFrameTime).toFixed(1))
+            if (window.step + 1 < window.sizes.length) {
+                window.step++
+                timer.restart()
+            } else {
+                Qt.quit()
+            }
+        }
+    }
+
+    Component.onCompleted: timer.restart()
+}
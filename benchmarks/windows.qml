@@ -0,0 +1,62 @@
+// Бенчмарк нескольких окон с общим устройством: время кадра каждого окна.
+// Запуск: vulkanunderqmlapp --windows <N> --shared-device --qml benchmarks/windows.qml
+// Каждое окно печатает строку CSV после измерения; через duration мс
+// первое окно завершает приложение. Загрузку CPU и память процесса снимает
+// run_windows.sh.
+
+import QtQuick
+import VulkanUnderQML
+
+VulkanQuickWindow {
+    id: window
+    width: 640
+    height: 480
+    visible: true
+    title: "Multi-window benchmark " + windowIndex
+    color: "black"
+
+    // Назначаются из main.cpp после загрузки
+    property int windowIndex: 0
+    property int duration: 20000
+
+    VulkanSquircle {
+        anchors.fill: parent
+        NumberAnimation on t {
+            from: 0; to: 1; duration: 2500
+            loops: Animation.Infinite
+            running: true
+        }
+    }
+
+    VulkanCube {
+        anchors.centerIn: parent
+        width: 320
+        height: 320
+        renderThreadAnimation: true
+        animationSpeed: 0.1
+    }
+
+    VulkanParticles {
+        anchors.fill: parent
+        running: true
+    }
+
+    VulkanFrameTimer {
+        id: timer
+        sampleCount: 600
+        warmupFrames: 120
+
+        onMeasured: (averageFrameTime, maxFrameTime) => {
+            console.log("window," + window.windowIndex + "," + averageFrameTime.toFixed(3)
+                        + "," + maxFrameTime.toFixed(3) + "," + (1000 / averageFrameTime).toFixed(1))
+        }
+    }
+
+    Timer {
+        interval: window.duration
+        running: window.windowIndex === 0
+        onTriggered: Qt.quit()
+    }
+
+    Component.onCompleted: timer.restart()
+}
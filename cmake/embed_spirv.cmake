@@ -0,0 +1,47 @@
+# Встраивание SPIR-V в исходник C++ как выровненных constexpr-массивов uint32_t.
+# cmake -DINPUTS=<a.spv|b.spv|...> -DOUTPUT=<file.cpp> -P embed_spirv.cmake
+
+string(REPLACE "|" ";" INPUTS "${INPUTS}")
+
+set(content "// Generated by cmake/embed_spirv.cmake, do not edit\n\n")
+string(APPEND content "#include \"vulkanembeddedshaders.h\"\n\n")
+string(APPEND content "namespace {\n\n")
+set(entries "")
+set(count 0)
+
+foreach(input ${INPUTS})
+    get_filename_component(name ${input} NAME)
+    string(MAKE_C_IDENTIFIER ${name} ident)
+
+    file(READ ${input} hex HEX)
+    string(LENGTH "${hex}" length)
+    math(EXPR tail "${length} % 8")
+    if(length EQUAL 0 OR NOT tail EQUAL 0)
+        message(FATAL_ERROR "${input} is not a SPIR-V binary")
+    endif()
+
+    # SPIR-V - поток 32-битных слов little-endian (магическое число 0x07230203)
+    set(byte "([0-9a-f][0-9a-f])")
+    string(REGEX REPLACE "${byte}${byte}${byte}${byte}" "0x\\4\\3\\2\\1u, " words "${hex}")
+    # По 8 слов в строке; CMake-регулярки не знают квантификатора {n}
+    set(word "0x[0-9a-f]+u, ")
+    string(REGEX REPLACE "(${word}${word}${word}${word}${word}${word}${word}${word})"
+        "\\1\n    " words "${words}")
+    string(REPLACE ", \n" ",\n" words "${words}")
+    string(STRIP "${words}" words)
+
+    string(APPEND content "alignas(16) constexpr uint32_t ${ident}[] = {\n    ${words}\n};\n\n")
+    string(APPEND entries "    { \"${name}\", ${ident}, sizeof(${ident}) },\n")
+    math(EXPR count "${count} + 1")
+endforeach()
+
+string(APPEND content "} // namespace\n\n")
+if(count EQUAL 0)
+    string(APPEND content "const VulkanEmbeddedShader *const VulkanEmbeddedShaders::table = nullptr;\n")
+else()
+    string(APPEND content "const VulkanEmbeddedShader shaders[] = {\n${entries}};\n\n")
+    string(APPEND content "const VulkanEmbeddedShader *const VulkanEmbeddedShaders::table = shaders;\n")
+endif()
+string(APPEND content "const int VulkanEmbeddedShaders::count = ${count};\n")
+
+file(WRITE ${OUTPUT} "${content}")
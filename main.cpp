@@ -5,15 +5,121 @@
 #include <QtQuick/QQuickView>
 #include <QQmlApplicationEngine>
 #include <QVulkanInstance>
+#include <QCommandLineParser>
 #include <QDebug>
 #include "vulkanquickwindow.h"
 #include "vulkancube.h"
 #include "vulkansquircle.h"
+#include "vulkanparticles.h"
+#include "vulkanmesh.h"
+#include "vulkanscene.h"
+#include "vulkanframetimer.h"
+#include "vulkantrace.h"
+#include "vulkandraworder.h"
+#include "vulkanpipelinestatistics.h"
+#include "vulkanstartup.h"
+#include "vulkanshareddevice.h"
+#include "vulkandevicefeatures.h"
+#include "vulkanframecapture.h"
+#include "vulkantexturesource.h"
+#include "vulkanshape.h"
+#include "vulkanjobsystem.h"
 
 int main(int argc, char **argv)
 {
+    VulkanStartup::markProcessStart();
     QGuiApplication app(argc, argv);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption traceOption(QStringLiteral("trace"),
+                                   QStringLiteral("Write a Chrome/Perfetto trace JSON to <file> on exit."),
+                                   QStringLiteral("file"));
+    parser.addOption(traceOption);
+    QCommandLineOption qmlOption(QStringLiteral("qml"),
+                                 QStringLiteral("Load <file> instead of the built-in main.qml (used by benchmarks/)."),
+                                 QStringLiteral("file"));
+    parser.addOption(qmlOption);
+    QCommandLineOption drawOrderOption(QStringLiteral("draw-order"),
+                                       QStringLiteral("Main pass order of Vulkan items: depth (default) or painter."),
+                                       QStringLiteral("order"), QStringLiteral("depth"));
+    parser.addOption(drawOrderOption);
+    QCommandLineOption pipelineStatsOption(QStringLiteral("pipeline-stats"),
+                                           QStringLiteral("Collect pipeline statistics per Vulkan item."));
+    parser.addOption(pipelineStatsOption);
+    QCommandLineOption noCubeBatchingOption(QStringLiteral("no-cube-batching"),
+                                            QStringLiteral("Draw every VulkanCube with its own draw call."));
+    parser.addOption(noCubeBatchingOption);
+    QCommandLineOption jobWorkersOption(QStringLiteral("job-workers"),
+                                        QStringLiteral("Worker threads for per-frame CPU jobs (default: cores - 1, 0 - serial)."),
+                                        QStringLiteral("count"));
+    parser.addOption(jobWorkersOption);
+    QCommandLineOption noPreloadOption(QStringLiteral("no-preload"),
+                                       QStringLiteral("Do not preload textures and the pipeline cache at startup."));
+    parser.addOption(noPreloadOption);
+    QCommandLineOption windowsOption(QStringLiteral("windows"),
+                                     QStringLiteral("Open <count> windows with the scene, sharing one Vulkan device."),
+                                     QStringLiteral("count"), QStringLiteral("1"));
+    parser.addOption(windowsOption);
+    QCommandLineOption sharedDeviceOption(QStringLiteral("shared-device"),
+                                          QStringLiteral("Create the Vulkan device in the application even for one window."));
+    parser.addOption(sharedDeviceOption);
+    QCommandLineOption separateDevicesOption(QStringLiteral("separate-devices"),
+                                             QStringLiteral("Let Qt create a device per window (for comparison with --windows)."));
+    parser.addOption(separateDevicesOption);
+    QCommandLineOption captureOption(QStringLiteral("capture"),
+                                     QStringLiteral("Record the first window to <path>: a directory for png, a file for yuv."),
+                                     QStringLiteral("path"));
+    parser.addOption(captureOption);
+    QCommandLineOption captureFormatOption(QStringLiteral("capture-format"),
+                                           QStringLiteral("Capture format: png (default) or yuv (raw I420)."),
+                                           QStringLiteral("format"), QStringLiteral("png"));
+    parser.addOption(captureFormatOption);
+    QCommandLineOption captureRateOption(QStringLiteral("capture-rate"),
+                                         QStringLiteral("Captured frames per second, 0 (default) for every frame."),
+                                         QStringLiteral("fps"), QStringLiteral("0"));
+    parser.addOption(captureRateOption);
+    QCommandLineOption captureQueueOption(QStringLiteral("capture-queue"),
+                                          QStringLiteral("Frames in flight to the encoder before frames are dropped."),
+                                          QStringLiteral("frames"), QStringLiteral("4"));
+    parser.addOption(captureQueueOption);
+    QCommandLineOption deviceOption(QStringLiteral("device"),
+                                    QStringLiteral("Physical device: discrete, integrated, virtual, cpu, performance or part of its name."),
+                                    QStringLiteral("selector"));
+    parser.addOption(deviceOption);
+    QCommandLineOption deviceExtensionsOption(QStringLiteral("device-extensions"),
+                                              QStringLiteral("Comma-separated device extensions to enable when supported."),
+                                              QStringLiteral("list"));
+    parser.addOption(deviceExtensionsOption);
+    QCommandLineOption deviceFeaturesOption(QStringLiteral("device-features"),
+                                            QStringLiteral("Comma-separated device features to request, e.g. hostImageCopy."),
+                                            QStringLiteral("list"));
+    parser.addOption(deviceFeaturesOption);
+    parser.process(app);
+    const int windowCount = qMax(1, parser.value(windowsOption).toInt());
+
+    // Рабочие потоки читают и декодируют ресурсы, пока грузится QML
+    if (!parser.isSet(noPreloadOption))
+        VulkanStartup::preload();
+
+    // painter - прежний порядок регистрации, для сравнения перерисовки
+    VulkanDrawOrder::setPainterOrder(parser.value(drawOrderOption) == QLatin1String("painter"));
+    VulkanDrawOrder::setStatisticsEnabled(parser.isSet(pipelineStatsOption));
+    VulkanCube::setBatchingEnabled(!parser.isSet(noCubeBatchingOption));
+    if (parser.isSet(jobWorkersOption))
+        VulkanJobSystem::setDefaultWorkerCount(qMax(0, parser.value(jobWorkersOption).toInt()));
+
+    // Трассировка: ключ --trace или переменная VULKANUNDERQML_TRACE
+    QString traceFile = parser.value(traceOption);
+    if (traceFile.isEmpty())
+        traceFile = qEnvironmentVariable("VULKANUNDERQML_TRACE");
+#ifdef VULKANUNDERQML_TRACING
+    VulkanTrace::start(traceFile);
+#else
+    if (!traceFile.isEmpty())
+        qWarning("Tracing is not compiled in, configure with -DVULKANUNDERQML_ENABLE_TRACING=ON");
+#endif
+
     // Устанавливаем API рендеринга на Vulkan
     QQuickWindow::setGraphicsApi(QSGRendererInterface::Vulkan);
 
@@ -25,6 +131,10 @@ int main(int argc, char **argv)
     inst.setLayers(QByteArrayList() << "VK_LAYER_KHRONOS_validation");
 #endif
 
+    // Метки для GPU-захватов нужны только при включённой трассировке
+    if (VulkanTrace::isActive() && inst.supportedExtensions().contains(QByteArrayLiteral("VK_EXT_debug_utils")))
+        inst.setExtensions(QByteArrayList() << "VK_EXT_debug_utils");
+
     // Пытаемся создать с указанной версией
     if (!inst.create()) {
         qWarning() << "Failed to create Vulkan instance with version 1.3.275, falling back...";
@@ -36,25 +146,98 @@ int main(int argc, char **argv)
 
     qDebug() << "Vulkan instance created with version:" << inst.apiVersion();
 
+    if (VulkanTrace::isActive())
+        VulkanTrace::resolveDebugUtils(&inst);
+
+    // Несколько окон делят одно устройство; создаётся до окон, так как
+    // может переключить render loop
+    // Выбор устройства с командной строки переопределяет заданный в QML
+    const QStringList deviceExtensions = parser.value(deviceExtensionsOption).split(QLatin1Char(','), Qt::SkipEmptyParts);
+    const QStringList deviceFeatures = parser.value(deviceFeaturesOption).split(QLatin1Char(','), Qt::SkipEmptyParts);
+    if ((windowCount > 1 || parser.isSet(sharedDeviceOption)) && !parser.isSet(separateDevicesOption)) {
+        VulkanSharedDevice::DeviceRequest request;
+        request.physicalDevice = parser.value(deviceOption);
+        for (const QString &ext : deviceExtensions)
+            request.extensions.append(ext.toLatin1());
+        request.features = VulkanDeviceFeatures::fromNames(deviceFeatures);
+        if (!VulkanSharedDevice::create(&inst, windowCount, request))
+            qWarning("Failed to create a shared Vulkan device, every window gets its own");
+    }
+
+    // Движок удаляется явно: окна должны уничтожиться раньше общего устройства
+    QQmlApplicationEngine *engine = new QQmlApplicationEngine;
+
     // Регистрируем QML типы
-    QQmlApplicationEngine engine;
     qmlRegisterType<VulkanQuickWindow>("VulkanUnderQML", 1, 0, "VulkanQuickWindow");
     qmlRegisterType<VulkanCube>("VulkanUnderQML", 1, 0, "VulkanCube");
     qmlRegisterType<VulkanSquircle>("VulkanUnderQML", 1, 0, "VulkanSquircle");
+    qmlRegisterType<VulkanParticles>("VulkanUnderQML", 1, 0, "VulkanParticles");
+    qmlRegisterType<VulkanMesh>("VulkanUnderQML", 1, 0, "VulkanMesh");
+    qmlRegisterType<VulkanScene>("VulkanUnderQML", 1, 0, "VulkanScene");
+    qmlRegisterType<VulkanFrameTimer>("VulkanUnderQML", 1, 0, "VulkanFrameTimer");
+    qmlRegisterType<VulkanTextureSource>("VulkanUnderQML", 1, 0, "VulkanTextureSource");
+    qmlRegisterType<VulkanShape>("VulkanUnderQML", 1, 0, "VulkanShape");
+    qmlRegisterUncreatableType<VulkanPipelineStatistics>("VulkanUnderQML", 1, 0, "VulkanPipelineStatistics",
+                                                         QStringLiteral("Available as pipelineStatistics of Vulkan items"));
 
-    // Загружаем QML
-    engine.load(QUrl("qrc:///main.qml"));
+    // Загружаем QML: встроенную сцену или файл, переданный через --qml;
+    // каждое окно - отдельный экземпляр сцены
+    const QString qmlFile = parser.value(qmlOption);
+    for (int i = 0; i < windowCount; ++i)
+        engine->load(qmlFile.isEmpty() ? QUrl("qrc:///main.qml") : QUrl::fromLocalFile(qmlFile));
+    VulkanStartup::markQmlLoaded();
 
-    if (engine.rootObjects().isEmpty())
+    if (engine->rootObjects().isEmpty()) {
+        delete engine;
+        VulkanSharedDevice::destroy();
         return -1;
+    }
 
-    // Получаем корневой объект (окно) и устанавливаем экземпляр Vulkan
-    QObject *rootObject = engine.rootObjects().first();
-    if (QQuickWindow *window = qobject_cast<QQuickWindow *>(rootObject)) {
-        window->setVulkanInstance(&inst);
-    } else {
-        qWarning() << "Root object is not a QQuickWindow";
+    // Корневые объекты (окна): экземпляр Vulkan и общее устройство
+    // назначаются до первого кадра
+    VulkanFrameCapture *capture = nullptr;
+    const QList<QObject *> rootObjects = engine->rootObjects();
+    for (int i = 0; i < rootObjects.size(); ++i) {
+        QQuickWindow *window = qobject_cast<QQuickWindow *>(rootObjects[i]);
+        if (!window) {
+            qWarning() << "Root object is not a QQuickWindow";
+            continue;
+        }
+        if (VulkanQuickWindow *quickWindow = qobject_cast<VulkanQuickWindow *>(window)) {
+            if (parser.isSet(deviceOption))
+                quickWindow->setPhysicalDevice(parser.value(deviceOption));
+            if (parser.isSet(deviceExtensionsOption))
+                quickWindow->setDeviceExtensions(deviceExtensions);
+            if (parser.isSet(deviceFeaturesOption))
+                quickWindow->setDeviceFeatures(deviceFeatures);
+            quickWindow->setupGraphicsDevice(&inst);
+        } else {
+            window->setVulkanInstance(&inst);
+            VulkanSharedDevice::attach(window);
+        }
+        window->setProperty("windowIndex", i);
+        if (i == 0)
+            VulkanStartup::watchFirstFrame(window);
+        else
+            window->setPosition(window->position() + QPoint(40, 40) * i);
+
+        if (i == 0 && parser.isSet(captureOption)) {
+            VulkanFrameCapture::Options options;
+            options.path = parser.value(captureOption);
+            options.format = parser.value(captureFormatOption) == QLatin1String("yuv")
+                    ? VulkanFrameCapture::RawYuv : VulkanFrameCapture::PngSequence;
+            options.rate = parser.value(captureRateOption).toDouble();
+            options.queueDepth = parser.value(captureQueueOption).toInt();
+            capture = new VulkanFrameCapture(window, options);
+        }
     }
 
-    return app.exec();
+    const int result = app.exec();
+    delete engine;
+    // После окон: последние копирования завершаются при уничтожении QRhi
+    delete capture;
+    VulkanSharedDevice::destroy();
+    VulkanStartup::waitForPreload();
+    VulkanTrace::writeReport();
+    return result;
 }
@@ -13,6 +13,8 @@ VulkanQuickWindow {
     visible: true
     title: "Vulkan QML"
     color: "black"
+    // После 30 с без ввода рисуем 10 кадров в секунду
+    idleFps: 10
 
     // VulkanSquircle теперь напрямую в Window и заполняет всё окно
     VulkanSquircle {
@@ -34,12 +36,10 @@ VulkanQuickWindow {
         width: 400
         height: 400
 
-        SequentialAnimation on t {
-            NumberAnimation { to: 1; duration: 5000; easing.type: Easing.InOutQuad }
-            NumberAnimation { to: 0; duration: 5000; easing.type: Easing.InOutQuad }
-            loops: Animation.Infinite
-            running: true
-        }
+        // Вращение считается на потоке рендеринга: оборот за 10 секунд,
+        // GUI-поток не участвует в каждом кадре
+        renderThreadAnimation: true
+        animationSpeed: 0.1
     }
 
     // Кнопка переключения полноэкранного режима
@@ -1,33 +1,6 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
-    mat4 view;
-    mat4 proj;
-    float time;
-} ubo;
-
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec2 inTexCoord;
-layout(location = 2) in vec3 inNormal;
-
-layout(location = 0) out vec2 fragTexCoord;
-layout(location = 1) out vec3 fragNormal;
-layout(location = 2) out vec3 fragPos;
-
-void main() {
-    // Вычисляем позицию в мировом пространстве
-    vec4 worldPos = ubo.model * vec4(inPosition, 1.0);
-    
-    // Вычисляем нормальную матрицу (обратно-транспонированная верхняя левая 3x3 матрица model)
-    mat3 normalMatrix = transpose(inverse(mat3(ubo.model)));
-    
-    // Преобразуем нормаль с помощью нормальной матрицы
-   fragNormal = mat3(transpose(inverse(ubo.model))) * inNormal;
-    
-    // Передаем позицию во фрагментный шейдер для освещения
-    fragPos = worldPos.xyz;
-    
-    gl_Position = ubo.proj * ubo.view * worldPos;
-    fragTexCoord = inTexCoord;
-}
+// Пакет кубов: отсечение по области элемента в шейдере
+#define CUBE_CLIP_DISTANCE
+#include "cube_vertex.glsl"
@@ -0,0 +1,32 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "cube_lights.glsl"
+
+// Частично заполненный массив текстур (descriptor indexing), в своём наборе
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(location = 0) in vec2 fragTexCoord;
+layout(location = 1) in vec3 fragNormal;
+layout(location = 2) in vec3 fragPos;
+layout(location = 3) flat in uint fragTexIndex;
+layout(location = 4) flat in vec2 fragOrigin;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec4 texColor = texture(textures[nonuniformEXT(fragTexIndex)], fragTexCoord);
+
+    vec3 normal = normalize(fragNormal);
+
+    float ambientStrength = 0.4;
+    vec3 ambient = vec3(ambientStrength);
+
+    vec3 diffuse = shadeLights(fragPos, normal, gl_FragCoord.xy - fragOrigin);
+
+    vec3 result = (ambient + diffuse) * texColor.rgb;
+    result = pow(result, vec3(0.9));
+
+    outColor = vec4(result, 1.0);
+}
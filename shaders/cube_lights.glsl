@@ -0,0 +1,89 @@
+// Источники света куба и разбиение кадра на кластеры (плитки экрана x
+// слои глубины). Подключается фрагментными шейдерами куба и
+// cube_lights.comp; номера привязок совпадают в обоих наборах дескрипторов.
+
+const uint CLUSTERS_X = 16u;
+const uint CLUSTERS_Y = 9u;
+const uint CLUSTERS_Z = 24u;
+const uint MAX_LIGHTS_PER_CLUSTER = 128u;
+
+layout(std140, binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+    float time;
+    vec4 viewport;   // xy - размер области элемента в пикселях, z - near, w - far
+    uvec4 lighting;  // x - число источников, y - 1 при отборе по кластерам
+    vec4 target;     // xy - размер цели рендеринга в пикселях
+} ubo;
+
+struct Light {
+    vec4 positionRadius; // xyz - позиция в мировых координатах, w - радиус
+    vec4 color;          // rgb - цвет, a - интенсивность
+};
+
+// droppedLights - попадания источников в кластеры сверх
+// MAX_LIGHTS_PER_CLUSTER за кадр; обнуляет CPU, читает после кадра.
+// Массив источников начинается со смещения 16.
+#ifdef CLUSTER_WRITER
+layout(std430, binding = 2) buffer Lights {
+#else
+layout(std430, binding = 2) readonly buffer Lights {
+#endif
+    uint droppedLights;
+    Light lights[];
+};
+
+// Для каждого кластера - число источников и их индексы
+struct Cluster {
+    uint count;
+    uint indices[MAX_LIGHTS_PER_CLUSTER];
+};
+
+#ifdef CLUSTER_WRITER
+layout(std430, binding = 3) writeonly buffer Clusters {
+#else
+layout(std430, binding = 3) readonly buffer Clusters {
+#endif
+    Cluster clusters[];
+};
+
+#ifndef CLUSTER_WRITER
+uint clusterIndex(vec2 fragCoord, float viewDepth)
+{
+    uvec2 tile = min(uvec2(fragCoord / ubo.viewport.xy * vec2(CLUSTERS_X, CLUSTERS_Y)),
+                     uvec2(CLUSTERS_X - 1u, CLUSTERS_Y - 1u));
+    // Слои глубины растут экспоненциально от near к far
+    float slice = log(viewDepth / ubo.viewport.z) / log(ubo.viewport.w / ubo.viewport.z) * float(CLUSTERS_Z);
+    uint z = uint(clamp(slice, 0.0, float(CLUSTERS_Z - 1u)));
+    return (z * CLUSTERS_Y + tile.y) * CLUSTERS_X + tile.x;
+}
+
+vec3 pointLight(uint i, vec3 pos, vec3 normal)
+{
+    Light light = lights[i];
+    vec3 toLight = light.positionRadius.xyz - pos;
+    float dist = length(toLight);
+    // Плавное затухание до нуля на радиусе источника
+    float falloff = clamp(1.0 - (dist * dist) / (light.positionRadius.w * light.positionRadius.w), 0.0, 1.0);
+    float diff = max(dot(normal, toLight / max(dist, 1e-4)), 0.0);
+    return diff * falloff * falloff * light.color.rgb * light.color.a;
+}
+
+// Сумма вкладов точечных источников; pos - в мировых координатах,
+// fragCoord - в пикселях относительно начала области элемента
+vec3 shadeLights(vec3 pos, vec3 normal, vec2 fragCoord)
+{
+    vec3 result = vec3(0.0);
+    if (ubo.lighting.y != 0u) {
+        float viewDepth = -(ubo.view * vec4(pos, 1.0)).z;
+        uint c = clusterIndex(fragCoord, viewDepth);
+        uint count = clusters[c].count;
+        for (uint i = 0u; i < count; ++i)
+            result += pointLight(clusters[c].indices[i], pos, normal);
+    } else {
+        for (uint i = 0u; i < ubo.lighting.x; ++i)
+            result += pointLight(i, pos, normal);
+    }
+    return result;
+}
+#endif
@@ -0,0 +1,5 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Устройство без shaderClipDistance: по одному кубу на draw, отсечение scissor
+#include "cube_vertex.glsl"
@@ -0,0 +1,62 @@
+// Вершинный шейдер куба, общий для cube.vert и cube_scissor.vert.
+//
+// Экземпляр - один элемент VulkanCube: матрица model, область элемента в
+// пикселях цели и индекс текстуры в bindless массиве (без bindless - 0). Куб проецируется как в собственной области элемента, затем
+// область переносится на своё место в цели, поэтому одним instanced
+// draw рисуются кубы всех элементов пакета. С CUBE_CLIP_DISTANCE
+// примитивы отсекаются по границам области элемента (gl_ClipDistance),
+// без него draw рисует один экземпляр и отсекает scissor.
+
+layout(std140, binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+    float time;
+    vec4 viewport;
+    uvec4 lighting;
+    vec4 target;     // xy - размер цели рендеринга в пикселях
+} ubo;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inTexCoord;
+layout(location = 2) in vec3 inNormal;
+layout(location = 3) in vec4 inModel0;
+layout(location = 4) in vec4 inModel1;
+layout(location = 5) in vec4 inModel2;
+layout(location = 6) in vec4 inModel3;
+layout(location = 7) in vec4 inViewportRect;
+layout(location = 8) in uint inTextureIndex;
+
+layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec3 fragPos;
+layout(location = 3) flat out uint fragTexIndex;
+layout(location = 4) flat out vec2 fragOrigin;
+
+#ifdef CUBE_CLIP_DISTANCE
+out float gl_ClipDistance[4];
+#endif
+
+void main() {
+    mat4 model = mat4(inModel0, inModel1, inModel2, inModel3);
+    vec4 worldPos = model * vec4(inPosition, 1.0);
+
+    // Нормальная матрица - обратно-транспонированная верхняя левая 3x3 матрицы model
+    fragNormal = mat3(transpose(inverse(model))) * inNormal;
+    fragPos = worldPos.xyz;
+    fragTexCoord = inTexCoord;
+    fragTexIndex = inTextureIndex;
+    fragOrigin = inViewportRect.xy;
+
+    vec4 clip = ubo.proj * ubo.view * worldPos;
+#ifdef CUBE_CLIP_DISTANCE
+    gl_ClipDistance[0] = clip.w + clip.x;
+    gl_ClipDistance[1] = clip.w - clip.x;
+    gl_ClipDistance[2] = clip.w + clip.y;
+    gl_ClipDistance[3] = clip.w - clip.y;
+#endif
+
+    // NDC области [-1, 1] -> её прямоугольник в NDC цели
+    vec2 scale = inViewportRect.zw / ubo.target.xy;
+    vec2 offset = (2.0 * inViewportRect.xy + inViewportRect.zw) / ubo.target.xy - 1.0;
+    gl_Position = vec4(clip.xy * scale + clip.w * offset, clip.zw);
+}
@@ -0,0 +1,19 @@
+#version 450
+
+layout(std140, binding = 0) uniform Params {
+    mat4 matrix;
+    vec4 color;
+    vec4 params;   // x - размер точки, y - 1, если цвет берётся из вершин
+} ubo;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec4 inColor;
+
+layout(location = 0) out vec4 vColor;
+
+void main()
+{
+    gl_Position = ubo.matrix * vec4(inPosition, 1.0);
+    gl_PointSize = ubo.params.x;
+    vColor = ubo.params.y > 0.5 ? inColor * ubo.color : ubo.color;
+}
@@ -0,0 +1,23 @@
+#version 450
+
+layout(std140, binding = 0) uniform Params {
+    mat4 mvp;
+    vec4 emitter;
+    vec4 gravity;
+    vec4 params;
+    vec4 color;
+    vec4 sprite;
+} ubo;
+
+layout(location = 0) in vec2 vCorner;
+layout(location = 1) in float vLife;
+
+layout(location = 0) out vec4 fragColor;
+
+void main()
+{
+    float d = dot(vCorner, vCorner);
+    if (d > 1.0)
+        discard;
+    fragColor = vec4(ubo.color.rgb, ubo.color.a * (1.0 - d) * vLife);
+}
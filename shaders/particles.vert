@@ -0,0 +1,27 @@
+#version 450
+
+layout(std140, binding = 0) uniform Params {
+    mat4 mvp;
+    vec4 emitter;
+    vec4 gravity;
+    vec4 params;
+    vec4 color;
+    vec4 sprite;
+} ubo;
+
+// Атрибут на инстанс: буфер частиц читается напрямую, без копирования
+layout(location = 0) in vec4 inPosition;
+
+layout(location = 0) out vec2 vCorner;
+layout(location = 1) out float vLife;
+
+void main()
+{
+    // Четыре вершины triangle strip образуют спрайт
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1) * 2.0 - 1.0;
+    vec4 clip = ubo.mvp * vec4(inPosition.xyz, 1.0);
+    clip.xy += corner * ubo.sprite.xy * clip.w;
+    gl_Position = clip;
+    vCorner = corner;
+    vLife = clamp(inPosition.w / ubo.params.y, 0.0, 1.0);
+}
@@ -0,0 +1,16 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "scene_cube.glsl"
+
+layout(location = 0) out vec4 vColor;
+
+void main()
+{
+    Node node = nodes[gl_InstanceIndex];
+    vec3 position = cubeCorner(gl_VertexIndex);
+    vec3 normal = normalize(mat3(node.world) * normals[gl_VertexIndex / 6]);
+    float light = 0.3 + 0.7 * max(dot(normal, normalize(params.lightDir.xyz)), 0.0);
+    vColor = vec4(node.color.rgb * light, node.color.a);
+    gl_Position = params.matrix * node.world * vec4(position, 1.0);
+}
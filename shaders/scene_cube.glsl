@@ -0,0 +1,31 @@
+// Узел VulkanScene единичным кубом, общее для scene.vert и scene_pick.vert.
+
+// Запись узла, см. VulkanSceneNodes::GpuNode
+struct Node {
+    mat4 world;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Nodes {
+    Node nodes[];
+};
+
+layout(push_constant) uniform Params {
+    mat4 matrix;        // мир -> клип-пространство прямоугольника элемента
+    vec4 lightDir;
+} params;
+
+// Единичный куб без вершинного буфера: 6 граней по 2 треугольника
+const vec3 corners[8] = vec3[](
+    vec3(-0.5, -0.5, -0.5), vec3(0.5, -0.5, -0.5), vec3(0.5, 0.5, -0.5), vec3(-0.5, 0.5, -0.5),
+    vec3(-0.5, -0.5, 0.5), vec3(0.5, -0.5, 0.5), vec3(0.5, 0.5, 0.5), vec3(-0.5, 0.5, 0.5));
+const int faces[24] = int[](
+    4, 5, 6, 7,   1, 0, 3, 2,   5, 1, 2, 6,   0, 4, 7, 3,   7, 6, 2, 3,   0, 1, 5, 4);
+const vec3 normals[6] = vec3[](
+    vec3(0, 0, 1), vec3(0, 0, -1), vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0));
+const int quad[6] = int[](0, 1, 2, 0, 2, 3);
+
+vec3 cubeCorner(int vertex)
+{
+    return corners[faces[(vertex / 6) * 4 + quad[vertex % 6]]];
+}
@@ -0,0 +1,11 @@
+#version 450
+
+layout(location = 0) flat in uint vInstance;
+
+// 0 в цели выбора - пусто
+layout(location = 0) out uint pickId;
+
+void main()
+{
+    pickId = vInstance + 1u;
+}
@@ -0,0 +1,13 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// Проход выбора: params.matrix уже умножена на матрицу VulkanPickPass
+#include "scene_cube.glsl"
+
+layout(location = 0) flat out uint vInstance;
+
+void main()
+{
+    vInstance = uint(gl_InstanceIndex);
+    gl_Position = params.matrix * nodes[gl_InstanceIndex].world * vec4(cubeCorner(gl_VertexIndex), 1.0);
+}
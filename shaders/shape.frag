@@ -0,0 +1,21 @@
+#version 450
+
+layout(std140, binding = 0) uniform Params {
+    mat4 mvp;
+    mat4 model;
+    vec4 color;
+    vec4 lightDir;
+} ubo;
+
+layout(location = 0) in vec3 vNormal;
+
+layout(location = 0) out vec4 fragColor;
+
+void main()
+{
+    vec3 n = normalize(vNormal);
+    float diffuse = max(dot(n, ubo.lightDir.xyz), 0.0);
+    // Блик по Блинну-Фонгу, камера смотрит вдоль -z
+    float specular = pow(max(dot(n, normalize(ubo.lightDir.xyz + vec3(0.0, 0.0, 1.0))), 0.0), 32.0);
+    fragColor = vec4(ubo.color.rgb * (0.15 + 0.85 * diffuse) + vec3(0.3 * specular), ubo.color.a);
+}
@@ -0,0 +1,20 @@
+#version 450
+
+layout(std140, binding = 0) uniform Params {
+    mat4 mvp;
+    mat4 model;     // только поворот, нормали переводятся им же
+    vec4 color;
+    vec4 lightDir;
+} ubo;
+
+// Вершины построены shaders/shape.comp
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inNormal;
+
+layout(location = 0) out vec3 vNormal;
+
+void main()
+{
+    gl_Position = ubo.mvp * vec4(inPosition.xyz, 1.0);
+    vNormal = mat3(ubo.model) * inNormal.xyz;
+}
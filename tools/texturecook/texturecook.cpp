@@ -0,0 +1,171 @@
+// texturecook.cpp
+// Подготовка текстур при сборке: texturecook <input image> <output.vkt>
+// Изображение приводится к RGBA8 (sRGB), строится полная цепочка mip с
+// фильтрацией в линейном пространстве, уровни пишутся подряд после
+// заголовка VulkanTextureBlobHeader.
+#include "vulkantextureblob.h"
+#include <QImage>
+#include <QSaveFile>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Уровень в линейном пространстве, RGBA float подряд
+struct LinearImage
+{
+    int width = 0;
+    int height = 0;
+    std::vector<float> texels;
+};
+
+static float srgbToLinear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float c)
+{
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+static quint8 toByte(float c)
+{
+    return quint8(qBound(0, int(std::lround(c * 255.0f)), 255));
+}
+
+static LinearImage linearize(const QImage &image)
+{
+    float decode[256];
+    for (int i = 0; i < 256; ++i)
+        decode[i] = srgbToLinear(i / 255.0f);
+
+    LinearImage result;
+    result.width = image.width();
+    result.height = image.height();
+    result.texels.resize(size_t(result.width) * result.height * 4);
+    float *dst = result.texels.data();
+    for (int y = 0; y < result.height; ++y) {
+        const uchar *src = image.constScanLine(y);
+        for (int x = 0; x < result.width * 4; x += 4) {
+            *dst++ = decode[src[x]];
+            *dst++ = decode[src[x + 1]];
+            *dst++ = decode[src[x + 2]];
+            // Альфа хранится линейно
+            *dst++ = src[x + 3] / 255.0f;
+        }
+    }
+    return result;
+}
+
+// Следующий уровень: среднее блока 2x2, на нечётном краю повторяется
+// последний столбец или строка
+static LinearImage downsample(const LinearImage &src)
+{
+    LinearImage result;
+    result.width = qMax(1, src.width / 2);
+    result.height = qMax(1, src.height / 2);
+    result.texels.resize(size_t(result.width) * result.height * 4);
+    float *dst = result.texels.data();
+    for (int y = 0; y < result.height; ++y) {
+        const int y0 = qMin(2 * y, src.height - 1);
+        const int y1 = qMin(2 * y + 1, src.height - 1);
+        for (int x = 0; x < result.width; ++x) {
+            const int x0 = qMin(2 * x, src.width - 1);
+            const int x1 = qMin(2 * x + 1, src.width - 1);
+            const float *t00 = &src.texels[(size_t(y0) * src.width + x0) * 4];
+            const float *t01 = &src.texels[(size_t(y0) * src.width + x1) * 4];
+            const float *t10 = &src.texels[(size_t(y1) * src.width + x0) * 4];
+            const float *t11 = &src.texels[(size_t(y1) * src.width + x1) * 4];
+            for (int c = 0; c < 4; ++c)
+                *dst++ = 0.25f * (t00[c] + t01[c] + t10[c] + t11[c]);
+        }
+    }
+    return result;
+}
+
+static QImage encode(const LinearImage &src)
+{
+    QImage image(src.width, src.height, QImage::Format_RGBA8888);
+    const float *texel = src.texels.data();
+    for (int y = 0; y < src.height; ++y) {
+        uchar *dst = image.scanLine(y);
+        for (int x = 0; x < src.width * 4; x += 4) {
+            dst[x] = toByte(linearToSrgb(*texel++));
+            dst[x + 1] = toByte(linearToSrgb(*texel++));
+            dst[x + 2] = toByte(linearToSrgb(*texel++));
+            dst[x + 3] = toByte(*texel++);
+        }
+    }
+    return image;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3) {
+        std::fprintf(stderr, "usage: texturecook <input image> <output.vkt>\n");
+        return 2;
+    }
+
+    QImage image(QString::fromLocal8Bit(argv[1]));
+    if (image.isNull()) {
+        std::fprintf(stderr, "texturecook: cannot read %s\n", argv[1]);
+        return 1;
+    }
+    image.convertTo(QImage::Format_RGBA8888);
+
+    VulkanTextureBlobHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = VulkanTextureBlobHeader::Magic;
+    header.version = VulkanTextureBlobHeader::Version;
+    header.vkFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    header.bytesPerTexel = 4;
+    header.width = quint32(image.width());
+    header.height = quint32(image.height());
+
+    // Уровни до 1x1. Фильтр усредняет линейные значения: среднее
+    // sRGB-кодированных байтов темнее, и уменьшенная текстура темнеет.
+    QList<QImage> levels { image };
+    LinearImage linear = linearize(image);
+    while (levels.size() < VulkanTextureBlobHeader::MaxLevels
+           && (linear.width > 1 || linear.height > 1)) {
+        linear = downsample(linear);
+        levels.append(encode(linear));
+    }
+    header.mipLevels = quint32(levels.size());
+
+    quint64 offset = sizeof(VulkanTextureBlobHeader);
+    for (int i = 0; i < levels.size(); ++i) {
+        VulkanTextureBlobHeader::Level &l = header.levels[i];
+        l.width = quint32(levels[i].width());
+        l.height = quint32(levels[i].height());
+        l.offset = offset;
+        const quint64 rowSize = quint64(l.width) * header.bytesPerTexel;
+        // Размер с выравниванием, чтобы следующий уровень начинался выровненным
+        l.size = (rowSize * l.height + VulkanTextureBlobHeader::LevelAlignment - 1)
+                & ~quint64(VulkanTextureBlobHeader::LevelAlignment - 1);
+        offset += l.size;
+    }
+
+    QSaveFile out(QString::fromLocal8Bit(argv[2]));
+    if (!out.open(QIODevice::WriteOnly)) {
+        std::fprintf(stderr, "texturecook: cannot write %s\n", argv[2]);
+        return 1;
+    }
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    for (int i = 0; i < levels.size(); ++i) {
+        const QImage &level = levels[i];
+        const qint64 rowSize = qint64(level.width()) * header.bytesPerTexel;
+        // Строки без дополнения: bufferRowLength при копировании равен 0
+        for (int y = 0; y < level.height(); ++y)
+            out.write(reinterpret_cast<const char *>(level.constScanLine(y)), rowSize);
+        const qint64 padding = qint64(header.levels[i].size) - rowSize * level.height();
+        if (padding > 0)
+            out.write(QByteArray(padding, '\0'));
+    }
+    if (!out.commit()) {
+        std::fprintf(stderr, "texturecook: cannot write %s\n", argv[2]);
+        return 1;
+    }
+    return 0;
+}
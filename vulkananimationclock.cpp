@@ -0,0 +1,41 @@
+// vulkananimationclock.cpp
+#include "vulkananimationclock.h"
+#include <QElapsedTimer>
+#include <cmath>
+
+double VulkanAnimationClock::now()
+{
+    static const QElapsedTimer timer = [] {
+        QElapsedTimer t;
+        t.start();
+        return t;
+    }();
+    return timer.nsecsElapsed() / 1e9;
+}
+
+double VulkanAnimationClock::advance(double refreshInterval)
+{
+    if (refreshInterval <= 0)
+        refreshInterval = 1.0 / 60.0;
+
+    const double t = now();
+    if (!m_started) {
+        m_started = true;
+        m_lastFrame = t;
+        m_presentationTime = t + refreshInterval;
+        return m_presentationTime;
+    }
+
+    // Кадр показывается на целое число периодов позже предыдущего
+    const double vsyncs = qMax(1.0, std::round((t - m_lastFrame) / refreshInterval));
+    m_presentationTime += vsyncs * refreshInterval;
+    m_lastFrame = t;
+
+    // После паузы (скрытое окно, остановка рендеринга) прогноз
+    // пересинхронизируется с текущим временем
+    const double expected = t + refreshInterval;
+    if (std::abs(m_presentationTime - expected) > 2 * refreshInterval)
+        m_presentationTime = expected;
+
+    return m_presentationTime;
+}
@@ -0,0 +1,39 @@
+// vulkananimationclock.h
+#ifndef VULKANANIMATIONCLOCK_H
+#define VULKANANIMATIONCLOCK_H
+
+#include <QtGlobal>
+#include <QtMath>
+
+// Часы анимации на потоке рендеринга. Вместо момента записи команд
+// возвращают ожидаемое время показа кадра, выровненное по сетке вертикальной
+// синхронизации, поэтому движение остаётся равномерным даже при неровном
+// темпе записи кадров и не зависит от тиков GUI-потока.
+class VulkanAnimationClock
+{
+public:
+    // Общая для процесса монотонная шкала в секундах, чтобы фазы разных
+    // элементов совпадали
+    static double now();
+
+    // Вызывается один раз за кадр; refreshInterval - период обновления экрана
+    double advance(double refreshInterval);
+
+    double presentationTime() const { return m_presentationTime; }
+
+    void reset() { m_started = false; }
+
+private:
+    bool m_started = false;
+    double m_lastFrame = 0;
+    double m_presentationTime = 0;
+};
+
+// t = frac(phase + speed * time), совместимо с диапазоном [0, 1) свойства t
+inline qreal animatedT(qreal speed, qreal phase, double time)
+{
+    const double v = phase + speed * time;
+    return qreal(v - qFloor(v));
+}
+
+#endif
@@ -0,0 +1,117 @@
+// vulkanassetcache.cpp
+#include "vulkanassetcache.h"
+#include "vulkanembeddedshaders.h"
+#include "vulkantextureblob.h"
+#include <QFile>
+#include <QMutexLocker>
+
+VulkanAssetCache *VulkanAssetCache::instance()
+{
+    static VulkanAssetCache cache;
+    return &cache;
+}
+
+// Загрузка выполняется без удержания мьютекса, чтобы несколько потоков
+// могли декодировать разные ресурсы одновременно. Если два потока загрузили
+// один и тот же ресурс, в кэше остаётся первый результат.
+
+QByteArray VulkanAssetCache::shader(const QString &fileName)
+{
+    // Встроенный SPIR-V отдаётся прямо из сегмента данных бинарника
+    if (const VulkanEmbeddedShader *embedded = VulkanEmbeddedShaders::find(fileName))
+        return QByteArray::fromRawData(reinterpret_cast<const char *>(embedded->code),
+                                       qsizetype(embedded->size));
+
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_shaders.constFind(fileName);
+        if (it != m_shaders.cend())
+            return *it;
+    }
+
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly))
+        return QByteArray();
+    const QByteArray contents = f.readAll();
+    if (contents.isEmpty())
+        return QByteArray();
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_shaders.constFind(fileName);
+    if (it != m_shaders.cend())
+        return *it;
+    m_shaders.insert(fileName, contents);
+    return contents;
+}
+
+QImage VulkanAssetCache::image(const QString &fileName, QImage::Format format)
+{
+    const QString key = fileName + QLatin1Char('#') + QString::number(int(format));
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_images.constFind(key);
+        if (it != m_images.cend())
+            return *it;
+    }
+
+    QImage img(fileName);
+    if (img.isNull())
+        return QImage();
+    img.convertTo(format);
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_images.constFind(key);
+    if (it != m_images.cend())
+        return *it;
+    m_images.insert(key, img);
+    return img;
+}
+
+VulkanAssetCache::Mesh VulkanAssetCache::mesh(const QString &key, const std::function<Mesh()> &create)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_meshes.constFind(key);
+        if (it != m_meshes.cend())
+            return *it;
+    }
+
+    const Mesh m = create();
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_meshes.constFind(key);
+    if (it != m_meshes.cend())
+        return *it;
+    m_meshes.insert(key, m);
+    return m;
+}
+
+QSharedPointer<const VulkanTextureBlob> VulkanAssetCache::textureBlob(const QString &fileName)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_textureBlobs.constFind(fileName);
+        if (it != m_textureBlobs.cend())
+            return *it;
+    }
+
+    QSharedPointer<VulkanTextureBlob> blob(new VulkanTextureBlob);
+    if (!blob->open(fileName))
+        return {};
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_textureBlobs.constFind(fileName);
+    if (it != m_textureBlobs.cend())
+        return *it;
+    m_textureBlobs.insert(fileName, blob);
+    return blob;
+}
+
+void VulkanAssetCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_shaders.clear();
+    m_images.clear();
+    m_meshes.clear();
+    m_textureBlobs.clear();
+}
@@ -0,0 +1,48 @@
+// vulkanassetcache.h
+#ifndef VULKANASSETCACHE_H
+#define VULKANASSETCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <functional>
+
+class VulkanTextureBlob;
+
+// Процессный кэш CPU-данных (SPIR-V, декодированные изображения, меши).
+// Живёт дольше рендереров: после sceneGraphInvalidated пересоздаются
+// только GPU-объекты, файлы заново не читаются и не декодируются.
+// Данные отдаются как неявно разделяемые Qt-контейнеры, без копирования.
+class VulkanAssetCache
+{
+public:
+    struct Mesh {
+        QByteArray vertices;
+        QByteArray indices;
+        quint32 vertexStride = 0;
+        quint32 indexCount = 0;
+    };
+
+    static VulkanAssetCache *instance();
+
+    // Пустой QByteArray / null QImage, если файл не найден
+    QByteArray shader(const QString &fileName);
+    QImage image(const QString &fileName, QImage::Format format = QImage::Format_RGBA8888);
+    Mesh mesh(const QString &key, const std::function<Mesh()> &create);
+    // Отображённый в память подготовленный блоб; null, если его нет
+    QSharedPointer<const VulkanTextureBlob> textureBlob(const QString &fileName);
+
+    void clear();
+
+private:
+    QMutex m_mutex;
+    QHash<QString, QByteArray> m_shaders;
+    QHash<QString, QImage> m_images;
+    QHash<QString, Mesh> m_meshes;
+    QHash<QString, QSharedPointer<const VulkanTextureBlob>> m_textureBlobs;
+};
+
+#endif
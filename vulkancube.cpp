@@ -2,8 +2,25 @@
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
 
 #include "vulkancube.h"
+#include "vulkanassetcache.h"
+#include "vulkantrace.h"
+#include "vulkananimationclock.h"
+#include "vulkandraworder.h"
+#include "vulkanjobsystem.h"
+#include "vulkanpipelinecache.h"
+#include "vulkancubeuniforms.h"
+#include "vulkandevicefeatures.h"
+#include "vulkantexturearray.h"
+#include "vulkantexturecache.h"
+#include "vulkanuploadservice.h"
+#include "vulkanstreamtexture.h"
+#include "vulkanutils.h"
+#include "vulkanquickwindow.h"
 #include <QtCore/QRunnable>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
 #include <QtQuick/QQuickWindow>
+#include <QtGui/QScreen>
 
 #include <QVulkanInstance>
 #include <QVulkanFunctions>
@@ -12,21 +29,78 @@
 #include <QMatrix4x4>
 #include <QVector3D>
 #include <QImage>
+#include <QColor>
 #include <QFileInfo>
 
+// Всё, что рендерер берёт у элемента, одним снимком
+struct CubeState
+{
+    // Область элемента в пикселях цели; не обрезается по окну, чтобы
+    // проекция не зависела от того, какая часть элемента видна
+    QRect viewportRect;
+    QSize targetSize;
+    // Элемент и все предки видимы, итоговая непрозрачность больше нуля
+    bool visible = true;
+    qreal t = 0;
+    bool renderThreadAnimation = false;
+    qreal animationSpeed = 0;
+    qreal animationPhase = 0;
+    double refreshInterval = 1.0 / 60.0;
+    QByteArray lightData;
+    bool clusteredLights = true;
+    QSharedPointer<VulkanTextureStream> textureStream;
+};
+
+// Кубы с равным ключом рисуются одним draw: источники света, кластеры и
+// проекция у пакета общие. Текстура выбирается индексом экземпляра в
+// VulkanTextureArray; без массива она тоже общая для пакета - поток
+// кадров или, без него, текстура из ресурсов. Сетка и конвейер у всех
+// кубов одни.
+struct CubeBatchKey
+{
+    QSize viewportSize;
+    bool clusteredLights;
+    const VulkanTextureStream *textureStream;
+    size_t lightHash;
+    QByteArray lightData;
+};
+
+static inline bool operator==(const CubeBatchKey &a, const CubeBatchKey &b)
+{
+    return a.viewportSize == b.viewportSize && a.clusteredLights == b.clusteredLights
+            && a.textureStream == b.textureStream && a.lightHash == b.lightHash && a.lightData == b.lightData;
+}
+
+static inline size_t qHash(const CubeBatchKey &key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.viewportSize.width(), key.viewportSize.height(), key.clusteredLights,
+                      key.textureStream, key.lightHash);
+}
+
 class CubeRenderer : public QObject
 {
     Q_OBJECT
 public:
     ~CubeRenderer();
 
-    void setT(qreal t) { m_t = t; }
-    void setViewportSize(const QSize &size) { m_viewportSize = size; }
+    void setState(const QSharedPointer<VulkanStateSnapshot<CubeState>> &state)
+    {
+        m_state = state;
+        m_state->take();
+        applyState(m_state->current());
+    }
     void setWindow(QQuickWindow *window) { m_window = window; }
 
-public slots:
-    void frameStart();
-    void mainPassRecordingStart();
+    // Начало кадра, для каждого куба окна (CubeBatcher): последний снимок,
+    // анимация и запись экземпляра. true - анимация на потоке рендеринга.
+    bool prepare();
+    bool isVisible() const { return m_visible && m_viewportRect.intersects(QRect(QPoint(0, 0), m_targetSize)); }
+    // sharedTextures - у устройства есть VulkanTextureArray, текстура в ключ не входит
+    CubeBatchKey batchKey(bool sharedTextures) const;
+
+    // Только для первого рендерера пакета, он рисует весь пакет
+    void frameStart(const QList<CubeRenderer *> &batch);
+    void mainPassRecordingStart(VkCommandBuffer cb);
 
 private:
     enum Stage {
@@ -35,34 +109,53 @@ private:
     };
     void prepareShader(Stage stage);
     void init(int framesInFlight);
-    void loadTexture();
-    void destroyTexture();
-    void transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout);
-    void copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-
-    QSize m_viewportSize;
+    void initTextures(int framesInFlight);
+    bool needsTextureCommands() const;
+    void updateTexture(VkCommandBuffer cb);
+    void writeTexture(VkDescriptorSet set, VkImageView view, VkSampler sampler);
+    void bindTexture(int slot);
+    void updateUniformBuffer(int slot);
+    void ensureInstanceBuffer(int count);
+    void initLightCulling(const VkPhysicalDeviceMemoryProperties &memProps, VkDeviceSize storageAlign,
+                          int framesInFlight);
+    VkPipeline createPipeline(VkRenderPass rp) const;
+    VkPipeline createCullPipeline() const;
+    void finishPipelines();
+    void cullLights(VkCommandBuffer cb, int slot);
+    void applyState(const CubeState &state);
+
+    QSharedPointer<VulkanStateSnapshot<CubeState>> m_state;
+    QRect m_viewportRect;
+    QSize m_targetSize;
+    bool m_visible = true;
     qreal m_t = 0;
-    QQuickWindow *m_window;
+    bool m_renderThreadAnimation = false;
+    qreal m_animationSpeed = 0;
+    qreal m_animationPhase = 0;
+    double m_refreshInterval = 0;
+    VulkanAnimationClock m_clock;
+    QByteArray m_lightData;
+    size_t m_lightHash = 0;
+    bool m_clusteredLights = true;
+    QSharedPointer<VulkanTextureStream> m_textureStream;
+    QQuickWindow *m_window = nullptr;
+
+    // Экземпляр этого куба на текущий кадр, копируется в буфер пакета
+    float m_instance[VulkanCubeUniforms::InstanceSize / sizeof(float)];
 
     QByteArray m_vert;
     QByteArray m_frag;
 
     bool m_initialized = false;
+    int m_framesInFlight = 0;
     VkPhysicalDevice m_physDev = VK_NULL_HANDLE;
     VkDevice m_dev = VK_NULL_HANDLE;
     QVulkanDeviceFunctions *m_devFuncs = nullptr;
     QVulkanFunctions *m_funcs = nullptr;
 
     // Texture resources
-    struct Texture {
-        VkImage image = VK_NULL_HANDLE;
-        VkDeviceMemory memory = VK_NULL_HANDLE;
-        VkImageView view = VK_NULL_HANDLE;
-        VkSampler sampler = VK_NULL_HANDLE;
-        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
-        uint32_t width = 0;
-        uint32_t height = 0;
-    } m_texture;
+    // Общая для окон с одним VkDevice, см. VulkanTextureCache
+    const VulkanTextureCache::Texture *m_texture = nullptr;
 
     // Buffer resources
     VkBuffer m_vbuf = VK_NULL_HANDLE;
@@ -73,25 +166,187 @@ private:
     VkDeviceMemory m_ubufMem = VK_NULL_HANDLE;
     VkDeviceSize m_allocPerUbuf = 0;
 
-    // Staging resources for texture
-    VkBuffer m_stagingBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory m_stagingMemory = VK_NULL_HANDLE;
+    // Экземпляры пакета: по участку постоянно отображённого буфера на кадр
+    // в полёте, m_instanceCapacity записей в участке. Заменённый при росте
+    // буфер ждёт в m_retired завершения кадров, которые его читают.
+    VkPhysicalDeviceMemoryProperties m_memProps;
+    VkBuffer m_instanceBuf = VK_NULL_HANDLE;
+    VkDeviceMemory m_instanceBufMem = VK_NULL_HANDLE;
+    char *m_instanceBufPtr = nullptr;
+    int m_instanceCapacity = 0;
+    uint32_t m_instanceCount = 0;
+    QList<VulkanUtils::RetiredBuffer> m_retired;
+    quint64 m_frame = 0;
+
+    // Текстура загружается отдельным submit; куб рисуется, когда
+    // загрузка завершена (m_textureReady). Текстуры есть у каждого куба
+    // пакета (initTextures()), остальное - только у рисующих.
+    VulkanUploadService *m_uploads = nullptr;
+    bool m_textureReady = false;
+
+    // Кадры textureSource; создаётся с первым потоком и остаётся до
+    // уничтожения рендерера, его изображение могут читать кадры в полёте
+    VulkanStreamTexture *m_streamTexture = nullptr;
+
+    // Bindless: общий массив устройства, nullptr без descriptor indexing.
+    // m_textureIndex - элемент текстуры из ресурсов, m_streamIndex -
+    // изображения m_streamView потока; m_instanceTexture пишется в
+    // экземпляр. Элемент прежнего изображения потока освобождается, когда
+    // кадры, читавшие его, завершены (m_textureFrame считает updateTexture()).
+    struct RetiredTexture
+    {
+        VkImageView view;
+        quint64 frame;
+    };
+    VulkanTextureArray *m_textures = nullptr;
+    uint32_t m_textureIndex = 0;
+    uint32_t m_streamIndex = 0;
+    VkImageView m_streamView = VK_NULL_HANDLE;
+    uint32_t m_instanceTexture = 0;
+    QList<RetiredTexture> m_retiredTextures;
+    quint64 m_textureFrame = 0;
 
     // Pipeline resources
     VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
     VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
     VkDescriptorSetLayout m_resLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_textureLayout = VK_NULL_HANDLE;
     VkPipeline m_pipeline = VK_NULL_HANDLE;
+    // Собираются на рабочем потоке, до finishPipelines()
+    std::shared_future<VkPipeline> m_pendingPipeline;
+    std::shared_future<VkPipeline> m_pendingCullPipeline;
 
     VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
-    VkDescriptorSet m_ubufDescriptor = VK_NULL_HANDLE;
+    // Текстуры - в отдельном наборе 1: с bindless это набор
+    // VulkanTextureArray (update-after-bind допустим только для набора без
+    // динамических буферов), без него - свои наборы из своего пула.
+    VkDescriptorPool m_textureDescriptorPool = VK_NULL_HANDLE;
+    // Наборы отрисовки на кадр в полёте: текстура в наборе слота меняется в
+    // начале кадра, когда прошлый кадр этого слота уже завершён.
+    // m_boundTextures - что в наборе: 0 - текстура из ресурсов, иначе
+    // поколение изображения m_streamTexture.
+    VkDescriptorSet m_ubufDescriptors[3] = {};
+    VkDescriptorSet m_textureDescriptors[3] = {};
+    quint64 m_boundTextures[3] = {};
 
     uint32_t m_indexCount = 0;
+
+    // Область элемента отсекается в вершинном шейдере (gl_ClipDistance),
+    // без этой возможности - scissor, и пакет из одного куба
+    bool m_clipDistance = false;
+
+    // Источники света: по участку постоянно отображённого буфера на кадр в
+    // полёте. Список источников кластеров пишется compute-шейдером перед
+    // основным проходом; буфер один, порядок с чтением прошлого кадра
+    // задаёт барьер.
+    VkBuffer m_lightBuf = VK_NULL_HANDLE;
+    VkDeviceMemory m_lightBufMem = VK_NULL_HANDLE;
+    VkDeviceSize m_allocPerLightBuf = 0;
+    char *m_lightBufPtr = nullptr;
+    uint32_t m_lightCount = 0;
+    bool m_lightOverflow = false;
+    VkBuffer m_clusterBuf = VK_NULL_HANDLE;
+    VkDeviceMemory m_clusterBufMem = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_cullLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_cullPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_cullPipeline = VK_NULL_HANDLE;
+    VkDescriptorSet m_cullDescriptor = VK_NULL_HANDLE;
 };
 
+// Кубы окна: в начале кадра собираются в пакеты по CubeBatchKey, первый
+// рендерер пакета пишет экземпляры всех и рисует их одним draw. Остальные
+// остаются в VulkanDrawOrder, но ничего не записывают.
+class CubeBatcher : public QObject
+{
+    Q_OBJECT
+public:
+    static void add(QQuickWindow *window, CubeRenderer *renderer);
+    static void remove(QQuickWindow *window, CubeRenderer *renderer);
+
+public slots:
+    void frameStart();
+
+private:
+    explicit CubeBatcher(QQuickWindow *window);
+    ~CubeBatcher();
+
+    QQuickWindow *m_window;
+    QList<CubeRenderer *> m_renderers;
+    bool m_featuresChecked = false;
+    bool m_clipDistance = false;
+    // Ссылка на массив устройства: с ним текстура не разделяет пакеты
+    VulkanTextureArray *m_textures = nullptr;
+    // Переиспользуются от кадра к кадру
+    QList<bool> m_animating;
+    QHash<CubeBatchKey, int> m_batchIndex;
+    QList<QList<CubeRenderer *>> m_batches;
+};
+
+static bool s_batchingEnabled = true;
+
+// Окна с отдельными потоками рендеринга регистрируются параллельно
+Q_GLOBAL_STATIC(QMutex, s_batchersMutex)
+typedef QHash<QQuickWindow *, CubeBatcher *> CubeBatcherRegistry;
+Q_GLOBAL_STATIC(CubeBatcherRegistry, s_batchers)
+
+static const VkDeviceSize INSTANCE_SIZE = VulkanCubeUniforms::InstanceSize;
+static const int MIN_INSTANCE_CAPACITY = 16;
+// Рендереров и экземпляров на задание VulkanJobSystem: меньше - накладные
+// расходы на задание сравнимы с работой
+static const int PREPARE_GRAIN = 64;
+static const int INSTANCE_COPY_GRAIN = 1024;
+
+// Должны совпадать с shaders/cube_lights.glsl
+static const uint32_t MAX_LIGHTS = 1024;
+static const uint32_t LIGHT_SIZE = 8 * sizeof(float);
+// Счётчик droppedLights перед массивом источников
+static const uint32_t LIGHT_HEADER_SIZE = 16;
+static const uint32_t CLUSTER_COUNT = 16 * 9 * 24;
+static const uint32_t MAX_LIGHTS_PER_CLUSTER = 128;
+static const uint32_t CULL_WORKGROUP_SIZE = 64;
+
+// Источник: vec4 (позиция, радиус) + vec4 (цвет, интенсивность), std430
+static QByteArray packLights(const QVariantList &lights)
+{
+    const qsizetype count = qMin(lights.size(), qsizetype(MAX_LIGHTS));
+    if (count < lights.size())
+        qWarning("VulkanCube: only the first %u of %lld lights are used", MAX_LIGHTS, qint64(lights.size()));
+
+    QByteArray data(count * LIGHT_SIZE, Qt::Uninitialized);
+    float *p = reinterpret_cast<float *>(data.data());
+    for (qsizetype i = 0; i < count; ++i) {
+        const QVariantMap light = lights[i].toMap();
+        const QVector3D pos = light.value(QStringLiteral("position")).value<QVector3D>();
+        const QColor color = light.value(QStringLiteral("color"), QColor(Qt::white)).value<QColor>();
+        *p++ = pos.x();
+        *p++ = pos.y();
+        *p++ = pos.z();
+        *p++ = light.value(QStringLiteral("radius"), 10.0).toFloat();
+        *p++ = color.redF();
+        *p++ = color.greenF();
+        *p++ = color.blueF();
+        *p++ = light.value(QStringLiteral("intensity"), 1.0).toFloat();
+    }
+    return data;
+}
+
+void VulkanCube::setBatchingEnabled(bool enabled)
+{
+    s_batchingEnabled = enabled;
+}
+
 VulkanCube::VulkanCube()
 {
     connect(this, &QQuickItem::windowChanged, this, &VulkanCube::handleWindowChanged);
+
+    // Прежнее освещение: два белых источника, второй слабее
+    setLights({
+        QVariantMap { { QStringLiteral("position"), QVector3D(3.0f, 3.0f, 3.0f) },
+                      { QStringLiteral("radius"), 100.0 } },
+        QVariantMap { { QStringLiteral("position"), QVector3D(-3.0f, -3.0f, 3.0f) },
+                      { QStringLiteral("radius"), 100.0 },
+                      { QStringLiteral("intensity"), 0.3 } }
+    });
 }
 
 void VulkanCube::setT(qreal t)
@@ -100,15 +355,163 @@ void VulkanCube::setT(qreal t)
         return;
     m_t = t;
     emit tChanged();
-    if (window())
-        window()->update();
+    publishState();
+}
+
+void VulkanCube::setRenderThreadAnimation(bool enabled)
+{
+    if (enabled == m_renderThreadAnimation)
+        return;
+    m_renderThreadAnimation = enabled;
+    emit renderThreadAnimationChanged();
+    publishState();
+}
+
+void VulkanCube::setAnimationSpeed(qreal speed)
+{
+    if (speed == m_animationSpeed)
+        return;
+    m_animationSpeed = speed;
+    emit animationSpeedChanged();
+    publishState();
+}
+
+void VulkanCube::setAnimationPhase(qreal phase)
+{
+    if (phase == m_animationPhase)
+        return;
+    m_animationPhase = phase;
+    emit animationPhaseChanged();
+    publishState();
+}
+
+void VulkanCube::setLights(const QVariantList &lights)
+{
+    if (lights == m_lights)
+        return;
+    m_lights = lights;
+    // Упаковка здесь, в снимок попадает готовый буфер без копирования
+    m_lightData = packLights(lights);
+    emit lightsChanged();
+    publishState();
+}
+
+void VulkanCube::setLightCulling(LightCulling culling)
+{
+    if (culling == m_lightCulling)
+        return;
+    m_lightCulling = culling;
+    emit lightCullingChanged();
+    publishState();
+}
+
+void VulkanCube::setTextureSource(VulkanTextureSource *source)
+{
+    if (source == m_textureSource)
+        return;
+    disconnect(m_frameConnection);
+    m_textureSource = source;
+    // Кадр подаётся из любого потока, окно обновляется из GUI-потока
+    if (source) {
+        m_frameConnection = connect(source, &VulkanTextureSource::frameAvailable, this, [this] {
+            if (window())
+                window()->update();
+        });
+    }
+    emit textureSourceChanged();
+    publishState();
+}
+
+void VulkanCube::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+    publishState();
+}
+
+void VulkanCube::itemChange(ItemChange change, const ItemChangeData &value)
+{
+    QQuickItem::itemChange(change, value);
+    if (change == ItemParentHasChanged) {
+        trackAncestors();
+    } else if (change == ItemVisibleHasChanged || change == ItemOpacityHasChanged) {
+        // Невидимый или прозрачный куб не попадает в пакеты
+        publishState();
+    } else if (change == ItemDevicePixelRatioHasChanged) {
+        // Смена коэффициента масштабирования (в том числе на том же экране)
+        // меняет область в пикселях; screenChanged приходит не всегда и
+        // раньше, чем окно узнаёт новый коэффициент
+        publishState();
+    }
+}
+
+// Сдвиг любого предка сдвигает область куба в окне, а его непрозрачность
+// входит в итоговую; поворот и масштаб предков не отслеживаются.
+// Видимость предков приходит в itemChange() сама.
+void VulkanCube::trackAncestors()
+{
+    for (const QMetaObject::Connection &connection : std::as_const(m_ancestorConnections))
+        disconnect(connection);
+    m_ancestorConnections.clear();
+    for (QQuickItem *item = parentItem(); item; item = item->parentItem()) {
+        m_ancestorConnections.append(connect(item, &QQuickItem::xChanged, this, &VulkanCube::publishState));
+        m_ancestorConnections.append(connect(item, &QQuickItem::yChanged, this, &VulkanCube::publishState));
+        m_ancestorConnections.append(connect(item, &QQuickItem::opacityChanged, this, &VulkanCube::publishState));
+        m_ancestorConnections.append(connect(item, &QQuickItem::parentChanged, this, &VulkanCube::trackAncestors));
+    }
+    publishState();
+}
+
+CubeState VulkanCube::rendererState() const
+{
+    CubeState state;
+    const qreal dpr = window()->effectiveDevicePixelRatio();
+    const QRectF sceneRect = mapRectToScene(boundingRect());
+    state.viewportRect = QRectF(sceneRect.topLeft() * dpr, sceneRect.size() * dpr).toAlignedRect();
+    state.targetSize = window()->size() * dpr;
+    qreal opacity = 1;
+    for (const QQuickItem *item = this; item && opacity > 0; item = item->parentItem())
+        opacity *= item->opacity();
+    state.visible = isVisible() && opacity > 0;
+    state.t = m_t;
+    state.renderThreadAnimation = m_renderThreadAnimation;
+    state.animationSpeed = m_animationSpeed;
+    state.animationPhase = m_animationPhase;
+    const qreal refreshRate = window()->screen() ? window()->screen()->refreshRate() : 60;
+    state.refreshInterval = refreshRate > 0 ? 1.0 / refreshRate : 1.0 / 60.0;
+    state.lightData = m_lightData;
+    state.clusteredLights = m_lightCulling == ClusteredLightCulling;
+    if (m_textureSource)
+        state.textureStream = m_textureSource->stream();
+    return state;
+}
+
+// GUI-поток, при каждом изменении того, что использует рендерер; до
+// первого sync() публиковать некому
+void VulkanCube::publishState()
+{
+    if (!window())
+        return;
+    if (m_state)
+        m_state->publish(rendererState());
+    window()->update();
+}
+
+void VulkanCube::connectSync(QQuickWindow *win)
+{
+    disconnect(m_syncConnection);
+    if (win)
+        m_syncConnection = connect(win, &QQuickWindow::beforeSynchronizing, this, &VulkanCube::sync, Qt::DirectConnection);
 }
 
 void VulkanCube::handleWindowChanged(QQuickWindow *win)
 {
+    connectSync(win);
     if (win) {
-        connect(win, &QQuickWindow::beforeSynchronizing, this, &VulkanCube::sync, Qt::DirectConnection);
         connect(win, &QQuickWindow::sceneGraphInvalidated, this, &VulkanCube::cleanup, Qt::DirectConnection);
+        // Размер области отрисовки входит в снимок
+        connect(win, &QWindow::widthChanged, this, &VulkanCube::publishState);
+        connect(win, &QWindow::heightChanged, this, &VulkanCube::publishState);
+        connect(win, &QWindow::screenChanged, this, &VulkanCube::publishState);
         win->setColor(Qt::black);
     }
 }
@@ -117,6 +520,9 @@ void VulkanCube::cleanup()
 {
     delete m_renderer;
     m_renderer = nullptr;
+    m_state.reset();
+    // Следующий рендерер снова создаётся в sync()
+    connectSync(window());
 }
 
 class CubeCleanupJob : public QRunnable
@@ -132,22 +538,50 @@ void VulkanCube::releaseResources()
 {
     window()->scheduleRenderJob(new CubeCleanupJob(m_renderer), QQuickWindow::BeforeSynchronizingStage);
     m_renderer = nullptr;
+    // Старый рендерер ещё может отрисовать кадр со своим снимком, новый
+    // получит свой; sync() переподключает handleWindowChanged()
+    m_state.reset();
 }
 
 CubeRenderer::~CubeRenderer()
 {
     qDebug("cube cleanup");
+    if (m_window) {
+        VulkanDrawOrder::unregister(m_window, this);
+        CubeBatcher::remove(m_window, this);
+    }
+    // Текстуры есть и у кубов, которые сами не рисуют
+    if (m_texture) {
+        if (m_textures) {
+            for (const RetiredTexture &retired : std::as_const(m_retiredTextures))
+                m_textures->remove(retired.view);
+            if (m_streamView)
+                m_textures->remove(m_streamView);
+            m_textures->remove(m_texture->view);
+            VulkanTextureArray::release(m_textures);
+        }
+        VulkanTextureCache::release(m_dev, m_texture);
+        VulkanUploadService::release(m_uploads);
+        delete m_streamTexture;
+    }
     if (!m_devFuncs)
         return;
 
-    destroyTexture();
-
+    // Задания сборки читают члены рендерера и кэш пайплайнов
+    finishPipelines();
     m_devFuncs->vkDestroyPipeline(m_dev, m_pipeline, nullptr);
     m_devFuncs->vkDestroyPipelineLayout(m_dev, m_pipelineLayout, nullptr);
     m_devFuncs->vkDestroyDescriptorSetLayout(m_dev, m_resLayout, nullptr);
+    m_devFuncs->vkDestroyDescriptorSetLayout(m_dev, m_textureLayout, nullptr);
+
+    m_devFuncs->vkDestroyPipeline(m_dev, m_cullPipeline, nullptr);
+    m_devFuncs->vkDestroyPipelineLayout(m_dev, m_cullPipelineLayout, nullptr);
+    m_devFuncs->vkDestroyDescriptorSetLayout(m_dev, m_cullLayout, nullptr);
 
     m_devFuncs->vkDestroyDescriptorPool(m_dev, m_descriptorPool, nullptr);
-    m_devFuncs->vkDestroyPipelineCache(m_dev, m_pipelineCache, nullptr);
+    m_devFuncs->vkDestroyDescriptorPool(m_dev, m_textureDescriptorPool, nullptr);
+    if (m_pipelineCache)
+        VulkanPipelineCache::release(m_dev);
 
     m_devFuncs->vkDestroyBuffer(m_dev, m_vbuf, nullptr);
     m_devFuncs->vkFreeMemory(m_dev, m_vbufMem, nullptr);
@@ -158,61 +592,416 @@ CubeRenderer::~CubeRenderer()
     m_devFuncs->vkDestroyBuffer(m_dev, m_ubuf, nullptr);
     m_devFuncs->vkFreeMemory(m_dev, m_ubufMem, nullptr);
 
+    if (m_instanceBufPtr)
+        m_devFuncs->vkUnmapMemory(m_dev, m_instanceBufMem);
+    VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &m_instanceBuf, &m_instanceBufMem);
+    for (VulkanUtils::RetiredBuffer &retired : m_retired)
+        VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &retired.buf, &retired.mem);
+
+    if (m_lightBufPtr)
+        m_devFuncs->vkUnmapMemory(m_dev, m_lightBufMem);
+    VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &m_lightBuf, &m_lightBufMem);
+    VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &m_clusterBuf, &m_clusterBufMem);
+
     qDebug("cube released");
 }
 
-void CubeRenderer::destroyTexture()
+void VulkanCube::sync()
 {
-    if (m_texture.sampler != VK_NULL_HANDLE) {
-        m_devFuncs->vkDestroySampler(m_dev, m_texture.sampler, nullptr);
-        m_texture.sampler = VK_NULL_HANDLE;
+    VKQ_TRACE_SCOPE("VulkanCube::sync");
+    if (!m_renderer) {
+        m_renderer = new CubeRenderer;
+        // Непрозрачный куб пишет глубину и рисуется раньше фона
+        CubeRenderer *renderer = m_renderer;
+        VulkanDrawOrder::forWindow(window())->add(renderer, VulkanDrawOrder::OpaqueStage, "VulkanCube",
+                                                  [renderer](VkCommandBuffer cb) { renderer->mainPassRecordingStart(cb); });
+        m_renderer->setWindow(window());
+        // GUI-поток заблокирован, первый снимок публикуется отсюда,
+        // следующие - из сеттеров свойств
+        m_state.reset(new VulkanStateSnapshot<CubeState>);
+        m_state->publish(rendererState());
+        m_renderer->setState(m_state);
+        // Кадр начинает CubeBatcher, общий для кубов окна
+        CubeBatcher::add(window(), m_renderer);
     }
-    if (m_texture.view != VK_NULL_HANDLE) {
-        m_devFuncs->vkDestroyImageView(m_dev, m_texture.view, nullptr);
-        m_texture.view = VK_NULL_HANDLE;
+
+    // Сотни элементов со своим sync() надолго блокируют GUI-поток; он
+    // остаётся подключённым только ради статистики конвейера
+    if (!VulkanDrawOrder::statisticsEnabled()) {
+        disconnect(m_syncConnection);
+        return;
     }
-    if (m_texture.image != VK_NULL_HANDLE) {
-        m_devFuncs->vkDestroyImage(m_dev, m_texture.image, nullptr);
-        m_texture.image = VK_NULL_HANDLE;
+    const CubeState state = rendererState();
+    const QRect viewportRect = state.viewportRect.intersected(QRect(QPoint(0, 0), state.targetSize));
+    m_pipelineStatistics->sync(window(), m_renderer, qreal(viewportRect.width()) * viewportRect.height());
+}
+
+void CubeRenderer::applyState(const CubeState &state)
+{
+    if (state.renderThreadAnimation && !m_renderThreadAnimation)
+        m_clock.reset();
+    m_viewportRect = state.viewportRect;
+    m_targetSize = state.targetSize;
+    m_visible = state.visible;
+    m_t = state.t;
+    m_renderThreadAnimation = state.renderThreadAnimation;
+    m_animationSpeed = state.animationSpeed;
+    m_animationPhase = state.animationPhase;
+    m_refreshInterval = state.refreshInterval;
+    // Хэш для CubeBatchKey считается один раз на снимок, а не на кадр
+    if (!m_lightData.isSharedWith(state.lightData)) {
+        m_lightData = state.lightData;
+        m_lightHash = qHash(m_lightData);
     }
-    if (m_texture.memory != VK_NULL_HANDLE) {
-        m_devFuncs->vkFreeMemory(m_dev, m_texture.memory, nullptr);
-        m_texture.memory = VK_NULL_HANDLE;
+    m_clusteredLights = state.clusteredLights;
+    m_textureStream = state.textureStream;
+}
+
+CubeBatchKey CubeRenderer::batchKey(bool sharedTextures) const
+{
+    return { m_viewportRect.size(), m_clusteredLights, sharedTextures ? nullptr : m_textureStream.data(),
+             m_lightHash, m_lightData };
+}
+
+bool CubeRenderer::prepare()
+{
+    if (m_state->take())
+        applyState(m_state->current());
+
+    if (m_renderThreadAnimation)
+        m_t = animatedT(m_animationSpeed, m_animationPhase, m_clock.advance(m_refreshInterval));
+
+    VulkanCubeUniforms::fillInstance(m_instance, float(m_t), m_viewportRect, m_instanceTexture);
+    // Рисует только первый рендерер пакета, его frameStart() задаст число
+    m_instanceCount = 0;
+    return m_renderThreadAnimation;
+}
+
+CubeBatcher::CubeBatcher(QQuickWindow *window)
+    : m_window(window)
+{
+    connect(window, &QQuickWindow::beforeRendering, this, &CubeBatcher::frameStart, Qt::DirectConnection);
+}
+
+CubeBatcher::~CubeBatcher()
+{
+    VulkanTextureArray::release(m_textures);
+}
+
+void CubeBatcher::add(QQuickWindow *window, CubeRenderer *renderer)
+{
+    QMutexLocker lock(s_batchersMutex());
+    CubeBatcher *&batcher((*s_batchers())[window]);
+    if (!batcher)
+        batcher = new CubeBatcher(window);
+    batcher->m_renderers.append(renderer);
+}
+
+void CubeBatcher::remove(QQuickWindow *window, CubeRenderer *renderer)
+{
+    QMutexLocker lock(s_batchersMutex());
+    auto it = s_batchers()->find(window);
+    if (it == s_batchers()->end())
+        return;
+    CubeBatcher *batcher = it.value();
+    batcher->m_renderers.removeOne(renderer);
+    if (batcher->m_renderers.isEmpty()) {
+        s_batchers()->erase(it);
+        delete batcher;
     }
-    if (m_stagingBuffer != VK_NULL_HANDLE) {
-        m_devFuncs->vkDestroyBuffer(m_dev, m_stagingBuffer, nullptr);
-        m_stagingBuffer = VK_NULL_HANDLE;
+}
+
+void CubeBatcher::frameStart()
+{
+    VKQ_TRACE_SCOPE("CubeBatcher::frameStart");
+    if (!m_featuresChecked) {
+        m_featuresChecked = true;
+        m_clipDistance = VulkanDeviceFeatures::enabled(m_window).testFlag(VulkanDeviceFeatures::ShaderClipDistance);
+        m_textures = VulkanTextureArray::acquire(m_window);
+        qDebug("cube: batching %s%s", m_clipDistance && s_batchingEnabled ? "enabled" : "disabled",
+               m_textures ? ", textures per instance" : "");
     }
-    if (m_stagingMemory != VK_NULL_HANDLE) {
-        m_devFuncs->vkFreeMemory(m_dev, m_stagingMemory, nullptr);
-        m_stagingMemory = VK_NULL_HANDLE;
+    // Без отсечения в шейдере область куба задаёт scissor, одна на draw;
+    // статистика конвейера собирается по рендерерам
+    const bool batching = m_clipDistance && s_batchingEnabled && !VulkanDrawOrder::statisticsEnabled();
+
+    // Снимок, анимация и матрицы экземпляра у рендереров независимы
+    m_animating.resize(m_renderers.size());
+    bool *prepared = m_animating.data();
+    CubeRenderer *const *renderers = m_renderers.constData();
+    VulkanJobSystem::instance()->parallelFor(m_renderers.size(), PREPARE_GRAIN, [prepared, renderers](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            prepared[i] = renderers[i]->prepare();
+    });
+
+    bool animating = false;
+    int batchCount = 0;
+    m_batchIndex.clear();
+    for (int i = 0; i < m_renderers.size(); ++i) {
+        CubeRenderer *renderer = m_renderers[i];
+        animating |= m_animating[i];
+        if (!renderer->isVisible())
+            continue;
+
+        int index = batchCount;
+        if (batching) {
+            const CubeBatchKey key = renderer->batchKey(m_textures != nullptr);
+            auto it = m_batchIndex.constFind(key);
+            if (it != m_batchIndex.cend())
+                index = it.value();
+            else
+                m_batchIndex.insert(key, batchCount);
+        }
+        if (index == batchCount) {
+            if (m_batches.size() == batchCount)
+                m_batches.append(QList<CubeRenderer *>());
+            else
+                m_batches[batchCount].clear();
+            ++batchCount;
+        }
+        m_batches[index].append(renderer);
     }
+
+    for (int i = 0; i < batchCount; ++i)
+        m_batches[i].first()->frameStart(m_batches[i]);
+
+    // Следующий кадр запрашивается прямо с потока рендеринга; без
+    // ограничения частоты GUI-поток для анимации не просыпается
+    if (animating)
+        VulkanQuickWindow::requestFrame(m_window);
 }
 
-void VulkanCube::sync()
+void CubeRenderer::frameStart(const QList<CubeRenderer *> &batch)
 {
-    if (!m_renderer) {
-        m_renderer = new CubeRenderer;
-        connect(window(), &QQuickWindow::beforeRendering, m_renderer, &CubeRenderer::frameStart, Qt::DirectConnection);
-        connect(window(), &QQuickWindow::beforeRenderPassRecording, m_renderer, &CubeRenderer::mainPassRecordingStart, Qt::DirectConnection);
+    VKQ_TRACE_SCOPE("CubeRenderer::frameStart");
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    Q_ASSERT(rif->graphicsApi() == QSGRendererInterface::Vulkan);
+
+    // Шейдеры загружаются в init(), так как варианты (bindless, отсечение
+    // в шейдере) зависят от возможностей устройства
+    const QQuickWindow::GraphicsStateInfo &stateInfo(m_window->graphicsStateInfo());
+    if (!m_initialized)
+        init(stateInfo.framesInFlight);
+
+    // Кадры, которые могли читать старый буфер экземпляров, завершены
+    ++m_frame;
+    while (!m_retired.isEmpty() && m_retired.first().frame <= m_frame) {
+        VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &m_retired.first().buf, &m_retired.first().mem);
+        m_retired.removeFirst();
+    }
+
+    ensureInstanceBuffer(batch.size());
+
+    // Матрицы нужны и отбору источников, поэтому буфер заполняется до прохода
+    updateUniformBuffer(stateInfo.currentFrameSlot);
+
+    // С массивом текстур у каждого куба пакета своя текстура, без него
+    // пакет рисуется текстурой первого
+    const bool cull = m_clusteredLights && m_lightCount > 0;
+    bool textureCommands = false;
+    for (CubeRenderer *renderer : batch) {
+        if (renderer == this || m_textures)
+            textureCommands |= renderer->needsTextureCommands();
     }
-    m_renderer->setViewportSize(window()->size() * window()->devicePixelRatio());
-    m_renderer->setT(m_t);
-    m_renderer->setWindow(window());
+    // Проверка загрузки без ожидания; при отдельной очереди передачи в
+    // командный буфер кадра пишется acquire-барьер. Копирование кадра
+    // потока в изображение - передача, отбор источников - compute.
+    // Всё это только вне render pass.
+    VkCommandBuffer cb = VK_NULL_HANDLE;
+    if (textureCommands || cull) {
+        m_window->beginExternalCommands();
+        cb = *reinterpret_cast<VkCommandBuffer *>(
+            rif->getResource(m_window, QSGRendererInterface::CommandListResource));
+    }
+    for (CubeRenderer *renderer : batch) {
+        if (renderer == this || m_textures)
+            renderer->updateTexture(cb);
+    }
+    if (cull)
+        cullLights(cb, stateInfo.currentFrameSlot);
+    if (cb)
+        m_window->endExternalCommands();
+
+    // Буфер экземпляров читает только draw, поэтому копирование идёт
+    // параллельно с остальной подготовкой кадра и ждётся перед записью
+    // прохода. Индексы текстур в экземплярах уже записаны.
+    char *dst = m_instanceBufPtr + VkDeviceSize(stateInfo.currentFrameSlot) * m_instanceCapacity * INSTANCE_SIZE;
+    VulkanJobSystem::instance()->fork(VulkanDrawOrder::forWindow(m_window)->frameJobs(), batch.size(),
+                                      INSTANCE_COPY_GRAIN, [batch, dst](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            memcpy(dst + VkDeviceSize(i) * INSTANCE_SIZE, batch[i]->m_instance, INSTANCE_SIZE);
+    });
+    m_instanceCount = uint32_t(batch.size());
+
+    if (!m_textures)
+        bindTexture(stateInfo.currentFrameSlot);
 }
 
-void CubeRenderer::frameStart()
+// Ресурсы текстур куба; у кубов, которые сами не рисуют, только они
+void CubeRenderer::initTextures(int framesInFlight)
 {
+    m_framesInFlight = framesInFlight;
     QSGRendererInterface *rif = m_window->rendererInterface();
-    Q_ASSERT(rif->graphicsApi() == QSGRendererInterface::Vulkan);
+    m_dev = *reinterpret_cast<VkDevice *>(rif->getResource(m_window, QSGRendererInterface::DeviceResource));
+    Q_ASSERT(m_dev);
+
+    // Текстура создаётся один раз на устройство, другие окна её
+    // переиспользуют; в массиве устройства у неё тоже один элемент
+    m_uploads = VulkanUploadService::acquire(m_window);
+    m_texture = VulkanTextureCache::acquire(m_window, QStringLiteral(":/textures/metalplate01_rgba.png"));
+    m_textures = VulkanTextureArray::acquire(m_window);
+    if (m_textures)
+        m_textureIndex = m_textures->add(m_texture->view, m_texture->sampler);
+}
 
-    if (m_vert.isEmpty())
-        prepareShader(VertexStage);
-    if (m_frag.isEmpty())
-        prepareShader(FragmentStage);
+bool CubeRenderer::needsTextureCommands() const
+{
+    return !m_texture || !m_textureReady || m_textureStream;
+}
 
-    if (!m_initialized)
-        init(m_window->graphicsStateInfo().framesInFlight);
+// Для каждого куба пакета, до копирования экземпляров; cb - командный
+// буфер кадра вне render pass, если needsTextureCommands()
+void CubeRenderer::updateTexture(VkCommandBuffer cb)
+{
+    if (!m_texture)
+        initTextures(m_window->graphicsStateInfo().framesInFlight);
+
+    // Элементы прежних изображений потока освобождаются раньше, чем
+    // m_streamTexture уничтожает сами изображения: счётчики кадров равны,
+    // а update() идёт ниже
+    ++m_textureFrame;
+    while (!m_retiredTextures.isEmpty() && m_retiredTextures.first().frame <= m_textureFrame) {
+        m_textures->remove(m_retiredTextures.first().view);
+        m_retiredTextures.removeFirst();
+    }
+
+    if (!m_textureReady) {
+        m_textureReady = m_uploads->consume(m_texture->upload, cb);
+        if (!m_textureReady)
+            VulkanQuickWindow::requestFrame(m_window);
+    }
+    if (m_textureStream) {
+        if (!m_streamTexture)
+            m_streamTexture = new VulkanStreamTexture(m_window, m_framesInFlight);
+        if (m_streamTexture->stream() != m_textureStream)
+            m_streamTexture->setStream(m_textureStream);
+        m_streamTexture->update(cb);
+    }
+
+    // Без массива текстуру в набор пишет bindTexture()
+    if (!m_textures)
+        return;
+    // Пока в потоке нет кадра, рисуется текстура из ресурсов
+    const bool stream = m_textureStream && m_streamTexture && m_streamTexture->isReady();
+    const VkImageView streamView = stream ? m_streamTexture->view() : VK_NULL_HANDLE;
+    if (streamView != m_streamView) {
+        if (m_streamView)
+            m_retiredTextures.append({ m_streamView, m_textureFrame + quint64(m_framesInFlight) });
+        m_streamView = streamView;
+        if (streamView)
+            m_streamIndex = m_textures->add(streamView, m_streamTexture->sampler());
+    }
+    const uint32_t index = stream ? m_streamIndex : m_textureIndex;
+    if (index != m_instanceTexture) {
+        m_instanceTexture = index;
+        VulkanCubeUniforms::setInstanceTexture(m_instance, index);
+    }
+}
+
+void CubeRenderer::bindTexture(int slot)
+{
+    // Пока в потоке нет кадра, рисуется текстура из ресурсов
+    const bool stream = m_textureStream && m_streamTexture && m_streamTexture->isReady();
+    const quint64 key = stream ? m_streamTexture->generation() : 0;
+    if (m_boundTextures[slot] == key)
+        return;
+    m_boundTextures[slot] = key;
+    if (stream)
+        writeTexture(m_textureDescriptors[slot], m_streamTexture->view(), m_streamTexture->sampler());
+    else
+        writeTexture(m_textureDescriptors[slot], m_texture->view, m_texture->sampler);
+}
+
+void CubeRenderer::updateUniformBuffer(int slot)
+{
+    VkDeviceSize ubufOffset = slot * m_allocPerUbuf;
+    void *p = nullptr;
+    VkResult err = m_devFuncs->vkMapMemory(m_dev, m_ubufMem, ubufOffset, m_allocPerUbuf, 0, &p);
+    if (err != VK_SUCCESS || !p)
+        qFatal("Failed to map uniform buffer memory: %d", err);
+
+    // Кадр, который раньше использовал этот участок, завершён: его счётчик
+    // отброшенных источников уже виден CPU
+    char *lights = m_lightBufPtr + slot * m_allocPerLightBuf;
+    quint32 dropped = 0;
+    memcpy(&dropped, lights, sizeof(dropped));
+    if (dropped && !m_lightOverflow)
+        qWarning("VulkanCube: %u light-cluster intersections exceed %u lights per cluster and are not shaded",
+                 dropped, MAX_LIGHTS_PER_CLUSTER);
+    m_lightOverflow = dropped != 0;
+
+    // Источники света кадра - в свой участок буфера
+    m_lightCount = uint32_t(m_lightData.size() / LIGHT_SIZE);
+    memset(lights, 0, LIGHT_HEADER_SIZE);
+    memcpy(lights + LIGHT_HEADER_SIZE, m_lightData.constData(), m_lightData.size());
+
+    // Матрицы, время и параметры освещения
+    VulkanCubeUniforms::fill(p, float(m_t), m_viewportRect.size(), m_targetSize, m_lightCount, m_clusteredLights);
+
+    m_devFuncs->vkUnmapMemory(m_dev, m_ubufMem);
+}
+
+void CubeRenderer::ensureInstanceBuffer(int count)
+{
+    if (count <= m_instanceCapacity)
+        return;
+
+    // Старый буфер ещё читают кадры в полёте
+    if (m_instanceBuf) {
+        m_devFuncs->vkUnmapMemory(m_dev, m_instanceBufMem);
+        m_retired.append({ m_instanceBuf, m_instanceBufMem, m_frame + quint64(m_framesInFlight) });
+    }
+    m_instanceBuf = VK_NULL_HANDLE;
+    m_instanceBufMem = VK_NULL_HANDLE;
+    m_instanceCapacity = qMax(MIN_INSTANCE_CAPACITY, int(qNextPowerOfTwo(quint32(count))));
+    VulkanUtils::createBuffer(m_devFuncs, m_dev, m_memProps,
+                              VkDeviceSize(m_instanceCapacity) * INSTANCE_SIZE * m_framesInFlight,
+                              VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              &m_instanceBuf, &m_instanceBufMem, "cube instance buffer");
+    void *p = nullptr;
+    VkResult err = m_devFuncs->vkMapMemory(m_dev, m_instanceBufMem, 0, VK_WHOLE_SIZE, 0, &p);
+    if (err != VK_SUCCESS || !p)
+        qFatal("Failed to map cube instance buffer memory: %d", err);
+    m_instanceBufPtr = static_cast<char *>(p);
+}
+
+void CubeRenderer::cullLights(VkCommandBuffer cb, int slot)
+{
+    finishPipelines();
+    VKQ_TRACE_GPU_BEGIN(cb, "VulkanCube light culling");
+
+    // Прошлый кадр мог ещё читать кластеры во фрагментном шейдере
+    m_devFuncs->vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+    m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline);
+    const uint32_t dynamicOffsets[] = { uint32_t(slot * m_allocPerUbuf), uint32_t(slot * m_allocPerLightBuf) };
+    m_devFuncs->vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipelineLayout, 0, 1,
+                                        &m_cullDescriptor, 2, dynamicOffsets);
+    m_devFuncs->vkCmdDispatch(cb, (CLUSTER_COUNT + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+    VkMemoryBarrier barrier;
+    memset(&barrier, 0, sizeof(barrier));
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    // Счётчик отброшенных источников читает CPU после завершения кадра
+    m_devFuncs->vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                                     0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VKQ_TRACE_GPU_END(cb);
 }
 
 // Вершины куба с позицией, текстурными координатами и нормалями
@@ -275,90 +1064,83 @@ static const uint16_t indices[] = {
     20, 21, 22, 22, 23, 20
 };
 
-const int UBUF_SIZE = sizeof(float) * 16 * 3 + sizeof(float); // 3 матрицы 4x4 + время
-
-void CubeRenderer::mainPassRecordingStart()
+static VulkanAssetCache::Mesh cubeMesh()
 {
-    const QQuickWindow::GraphicsStateInfo &stateInfo(m_window->graphicsStateInfo());
-    QSGRendererInterface *rif = m_window->rendererInterface();
-
-    // Обновляем uniform buffer
-    VkDeviceSize ubufOffset = stateInfo.currentFrameSlot * m_allocPerUbuf;
-    void *p = nullptr;
-    VkResult err = m_devFuncs->vkMapMemory(m_dev, m_ubufMem, ubufOffset, m_allocPerUbuf, 0, &p);
-    if (err != VK_SUCCESS || !p)
-        qFatal("Failed to map uniform buffer memory: %d", err);
-
-    // Матрицы для 3D преобразований с вращением
-    QMatrix4x4 model;
-
-    // Сначала перемещаем куб в нужное положение
-    model.translate(0.0f, 0.0f, -5.0f); // Отодвигаем куб
-
-    // Затем применяем вращение вокруг своей оси
-    float angle = m_t * 360.0f; // Полный оборот за 1 секунду
-    model.rotate(angle, QVector3D(1.0f, 0.0f, 0.0f)); // Вращение вокруг X
-    model.rotate(angle * 0.7f, QVector3D(0.0f, 0.0f, 1.0f)); // Вращение вокруг Z
-
-    QMatrix4x4 view;
-    // Камера смотрит на куб
-    view.lookAt(QVector3D(0.0f, 0.0f, 1.0f),  // позиция камеры (смотрим спереди)
-                QVector3D(0.0f, 0.0f, 0.0f),  // цель (центр сцены)
-                QVector3D(0.0f, 1.0f, 0.0f)); // вектор "вверх"
+    // Статические массивы оборачиваются без копирования
+    return VulkanAssetCache::instance()->mesh(QStringLiteral("cube"), [] {
+        VulkanAssetCache::Mesh m;
+        m.vertices = QByteArray::fromRawData(reinterpret_cast<const char *>(vertices), sizeof(vertices));
+        m.indices = QByteArray::fromRawData(reinterpret_cast<const char *>(indices), sizeof(indices));
+        m.vertexStride = sizeof(Vertex);
+        m.indexCount = sizeof(indices) / sizeof(uint16_t);
+        return m;
+    });
+}
 
-    QMatrix4x4 proj;
-    proj.perspective(60.0f, m_viewportSize.width() / (float)m_viewportSize.height(), 0.1f, 100.0f);
+const int UBUF_SIZE = VulkanCubeUniforms::Size;
 
-    // Копируем матрицы и время в uniform buffer
-    float *data = static_cast<float*>(p);
-    memcpy(data, model.constData(), 16 * sizeof(float));
-    memcpy(data + 16, view.constData(), 16 * sizeof(float));
-    memcpy(data + 32, proj.constData(), 16 * sizeof(float));
-    data[48] = m_t * 10.0f; // Ускоряем анимацию
+void CubeRenderer::mainPassRecordingStart(VkCommandBuffer cb)
+{
+    VKQ_TRACE_SCOPE("CubeRenderer::mainPassRecordingStart");
+    // Кубы пакета рисует его первый рендерер; пока текстура не
+    // загружена, куб не рисуется
+    if (!m_instanceCount || !m_textureReady)
+        return;
 
-    m_devFuncs->vkUnmapMemory(m_dev, m_ubufMem);
+    const QQuickWindow::GraphicsStateInfo &stateInfo(m_window->graphicsStateInfo());
 
-    m_window->beginExternalCommands();
+    finishPipelines();
 
-    VkCommandBuffer cb = *reinterpret_cast<VkCommandBuffer *>(
-        rif->getResource(m_window, QSGRendererInterface::CommandListResource));
-    Q_ASSERT(cb);
+    // beginExternalCommands() и командный буфер - забота VulkanDrawOrder
+    VKQ_TRACE_GPU_BEGIN(cb, "VulkanCube");
 
     m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
 
-    VkDeviceSize vbufOffset = 0;
-    m_devFuncs->vkCmdBindVertexBuffers(cb, 0, 1, &m_vbuf, &vbufOffset);
+    const VkBuffer vbufs[] = { m_vbuf, m_instanceBuf };
+    const VkDeviceSize vbufOffsets[] = { 0, VkDeviceSize(stateInfo.currentFrameSlot) * m_instanceCapacity * INSTANCE_SIZE };
+    m_devFuncs->vkCmdBindVertexBuffers(cb, 0, 2, vbufs, vbufOffsets);
     m_devFuncs->vkCmdBindIndexBuffer(cb, m_ibuf, 0, VK_INDEX_TYPE_UINT16);
 
-    uint32_t dynamicOffset = m_allocPerUbuf * stateInfo.currentFrameSlot;
-    m_devFuncs->vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1,
-                                        &m_ubufDescriptor, 1, &dynamicOffset);
-
-    VkViewport vp = { 0, 0, float(m_viewportSize.width()), float(m_viewportSize.height()), 0.0f, 1.0f };
+    const uint32_t dynamicOffsets[] = { uint32_t(m_allocPerUbuf * stateInfo.currentFrameSlot),
+                                        uint32_t(m_allocPerLightBuf * stateInfo.currentFrameSlot) };
+    // С bindless набор текстур один на устройство, текстуру выбирает
+    // индекс экземпляра
+    const VkDescriptorSet descSets[] = { m_ubufDescriptors[stateInfo.currentFrameSlot],
+                                         m_textures ? m_textures->descriptorSet()
+                                                    : m_textureDescriptors[stateInfo.currentFrameSlot] };
+    m_devFuncs->vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 2,
+                                        descSets, 2, dynamicOffsets);
+
+    // Viewport - вся цель, на области элементов куб переносит вершинный
+    // шейдер; отсекают их gl_ClipDistance или scissor
+    const QRect target(QPoint(0, 0), m_targetSize);
+    VkViewport vp = { 0, 0, float(target.width()), float(target.height()), 0.0f, 1.0f };
     m_devFuncs->vkCmdSetViewport(cb, 0, 1, &vp);
-    VkRect2D scissor = { { 0, 0 }, { uint32_t(m_viewportSize.width()), uint32_t(m_viewportSize.height()) } };
+    const QRect scissorRect = m_clipDistance ? target : m_viewportRect.intersected(target);
+    VkRect2D scissor = { { scissorRect.x(), scissorRect.y() },
+                         { uint32_t(scissorRect.width()), uint32_t(scissorRect.height()) } };
     m_devFuncs->vkCmdSetScissor(cb, 0, 1, &scissor);
 
-    m_devFuncs->vkCmdDrawIndexed(cb, m_indexCount, 1, 0, 0, 0);
+    m_devFuncs->vkCmdDrawIndexed(cb, m_indexCount, m_instanceCount, 0, 0, 0);
 
-    m_window->endExternalCommands();
+    VKQ_TRACE_GPU_END(cb);
 }
 
 void CubeRenderer::prepareShader(Stage stage)
 {
+    VKQ_TRACE_SCOPE("CubeRenderer::prepareShader");
     QString filename;
     if (stage == VertexStage) {
-        filename = QLatin1String(":/cube.vert.spv");
+        filename = m_clipDistance ? QLatin1String(":/cube.vert.spv") : QLatin1String(":/cube_scissor.vert.spv");
     } else {
         Q_ASSERT(stage == FragmentStage);
-        filename = QLatin1String(":/cube.frag.spv");
+        filename = m_textures ? QLatin1String(":/cube_bindless.frag.spv") : QLatin1String(":/cube.frag.spv");
     }
-    QFile f(filename);
-    if (!f.open(QIODevice::ReadOnly))
+    // SPIR-V берётся из процессного кэша и переживает пересоздание рендерера
+    const QByteArray contents = VulkanAssetCache::instance()->shader(filename);
+    if (contents.isEmpty())
         qFatal("Failed to read shader %s", qPrintable(filename));
 
-    const QByteArray contents = f.readAll();
-
     if (stage == VertexStage) {
         m_vert = contents;
         Q_ASSERT(!m_vert.isEmpty());
@@ -373,244 +1155,87 @@ static inline VkDeviceSize aligned(VkDeviceSize v, VkDeviceSize byteAlign)
     return (v + byteAlign - 1) & ~(byteAlign - 1);
 }
 
-void CubeRenderer::transitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout)
-{
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = oldLayout;
-    barrier.newLayout = newLayout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-
-    VkPipelineStageFlags sourceStage;
-    VkPipelineStageFlags destinationStage;
-
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    } else {
-        throw std::invalid_argument("unsupported layout transition!");
-    }
-
-    m_devFuncs->vkCmdPipelineBarrier(
-        commandBuffer,
-        sourceStage, destinationStage,
-        0,
-        0, nullptr,
-        0, nullptr,
-        1, &barrier
-    );
-}
-
-void CubeRenderer::copyBufferToImage(VkCommandBuffer commandBuffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
-{
-    VkBufferImageCopy region{};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {width, height, 1};
-
-    m_devFuncs->vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-}
-
-void CubeRenderer::loadTexture()
-{
-    // Загружаем текстуру из файла
-    QImage image(":/textures/metalplate01_rgba.png");
-    qDebug() << image.isNull();
-    if (image.isNull()) {
-        // Если текстура не загружена, создаем простую текстуру программно
-        image = QImage(256, 256, QImage::Format_RGBA8888);
-        for (int y = 0; y < image.height(); ++y) {
-            for (int x = 0; x < image.width(); ++x) {
-                QColor color;
-                if ((x / 32 + y / 32) % 2 == 0) {
-                    color = QColor(0, 255, 255); // Cornflower blue
-                } else {
-                    color = QColor(255, 0, 0); // White
-                }
-                image.setPixelColor(x, y, color);
-            }
-        }
-    }
-
-    image = image.convertToFormat(QImage::Format_RGBA8888);
-    m_texture.width = image.width();
-    m_texture.height = image.height();
-    VkDeviceSize imageSize = m_texture.width * m_texture.height * 4;
-
-    // Создаем staging buffer
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = imageSize;
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    VkResult err = m_devFuncs->vkCreateBuffer(m_dev, &bufferInfo, nullptr, &m_stagingBuffer);
-    if (err != VK_SUCCESS)
-        qFatal("Failed to create staging buffer: %d", err);
-
-    VkMemoryRequirements memRequirements;
-    m_devFuncs->vkGetBufferMemoryRequirements(m_dev, m_stagingBuffer, &memRequirements);
-
-    VkPhysicalDeviceMemoryProperties memProperties;
-    m_funcs->vkGetPhysicalDeviceMemoryProperties(m_physDev, &memProperties);
-
-    uint32_t memoryTypeIndex = uint32_t(-1);
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((memRequirements.memoryTypeBits & (1 << i)) &&
-            (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
-            (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
-            memoryTypeIndex = i;
-            break;
-        }
-    }
-
-    if (memoryTypeIndex == uint32_t(-1))
-        qFatal("Failed to find suitable memory type for staging buffer");
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = memoryTypeIndex;
-
-    err = m_devFuncs->vkAllocateMemory(m_dev, &allocInfo, nullptr, &m_stagingMemory);
-    if (err != VK_SUCCESS)
-        qFatal("Failed to allocate staging memory: %d", err);
-
-    err = m_devFuncs->vkBindBufferMemory(m_dev, m_stagingBuffer, m_stagingMemory, 0);
-    if (err != VK_SUCCESS)
-        qFatal("Failed to bind staging buffer memory: %d", err);
-
-    // Копируем данные изображения в staging buffer
-    void* data;
-    err = m_devFuncs->vkMapMemory(m_dev, m_stagingMemory, 0, imageSize, 0, &data);
-    if (err != VK_SUCCESS)
-        qFatal("Failed to map staging memory: %d", err);
-
-    memcpy(data, image.constBits(), static_cast<size_t>(imageSize));
-    m_devFuncs->vkUnmapMemory(m_dev, m_stagingMemory);
-
-    // Создаем изображение
-    VkImageCreateInfo imageInfo{};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = m_texture.width;
-    imageInfo.extent.height = m_texture.height;
-    imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-
-    err = m_devFuncs->vkCreateImage(m_dev, &imageInfo, nullptr, &m_texture.image);
-    if (err != VK_SUCCESS)
-        qFatal("Failed to create image: %d", err);
-
-    m_devFuncs->vkGetImageMemoryRequirements(m_dev, m_texture.image, &memRequirements);
-
-    memoryTypeIndex = uint32_t(-1);
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((memRequirements.memoryTypeBits & (1 << i)) &&
-            (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
-            memoryTypeIndex = i;
-            break;
-        }
-    }
-
-    if (memoryTypeIndex == uint32_t(-1))
-        qFatal("Failed to find suitable memory type for image");
-
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = memoryTypeIndex;
+// Свой набор из одной текстуры, без VulkanTextureArray
+void CubeRenderer::writeTexture(VkDescriptorSet set, VkImageView view, VkSampler sampler)
+{
+    VkDescriptorImageInfo imageInfo;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = view;
+    imageInfo.sampler = sampler;
+
+    VkWriteDescriptorSet writeDescSet;
+    memset(&writeDescSet, 0, sizeof(writeDescSet));
+    writeDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeDescSet.dstSet = set;
+    writeDescSet.dstBinding = 0;
+    writeDescSet.dstArrayElement = 0;
+    writeDescSet.descriptorCount = 1;
+    writeDescSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writeDescSet.pImageInfo = &imageInfo;
+    m_devFuncs->vkUpdateDescriptorSets(m_dev, 1, &writeDescSet, 0, nullptr);
+}
 
-    err = m_devFuncs->vkAllocateMemory(m_dev, &allocInfo, nullptr, &m_texture.memory);
-    if (err != VK_SUCCESS)
-        qFatal("Failed to allocate image memory: %d", err);
+void CubeRenderer::initLightCulling(const VkPhysicalDeviceMemoryProperties &memProps, VkDeviceSize storageAlign,
+                                    int framesInFlight)
+{
+    m_allocPerLightBuf = VulkanUtils::aligned(LIGHT_HEADER_SIZE + MAX_LIGHTS * LIGHT_SIZE, storageAlign);
+    VulkanUtils::createBuffer(m_devFuncs, m_dev, memProps, m_allocPerLightBuf * framesInFlight,
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              &m_lightBuf, &m_lightBufMem, "light buffer");
+    void *p = nullptr;
+    VkResult err = m_devFuncs->vkMapMemory(m_dev, m_lightBufMem, 0, VK_WHOLE_SIZE, 0, &p);
+    if (err != VK_SUCCESS || !p)
+        qFatal("Failed to map light buffer memory: %d", err);
+    m_lightBufPtr = static_cast<char *>(p);
+    memset(m_lightBufPtr, 0, m_allocPerLightBuf * framesInFlight);
+
+    // Счётчик и индексы на кластер, только для GPU
+    VulkanUtils::createBuffer(m_devFuncs, m_dev, memProps,
+                              CLUSTER_COUNT * (1 + MAX_LIGHTS_PER_CLUSTER) * sizeof(uint32_t),
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                              &m_clusterBuf, &m_clusterBufMem, "cluster buffer");
+
+    VkDescriptorSetLayoutBinding layoutBinding[3];
+    memset(layoutBinding, 0, sizeof(layoutBinding));
+    layoutBinding[0].binding = 0;
+    layoutBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    layoutBinding[0].descriptorCount = 1;
+    layoutBinding[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    layoutBinding[1].binding = 2;
+    layoutBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    layoutBinding[1].descriptorCount = 1;
+    layoutBinding[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    layoutBinding[2].binding = 3;
+    layoutBinding[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    layoutBinding[2].descriptorCount = 1;
+    layoutBinding[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-    err = m_devFuncs->vkBindImageMemory(m_dev, m_texture.image, m_texture.memory, 0);
+    VkDescriptorSetLayoutCreateInfo descLayoutInfo;
+    memset(&descLayoutInfo, 0, sizeof(descLayoutInfo));
+    descLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descLayoutInfo.bindingCount = 3;
+    descLayoutInfo.pBindings = layoutBinding;
+    err = m_devFuncs->vkCreateDescriptorSetLayout(m_dev, &descLayoutInfo, nullptr, &m_cullLayout);
     if (err != VK_SUCCESS)
-        qFatal("Failed to bind image memory: %d", err);
+        qFatal("Failed to create light culling descriptor set layout: %d", err);
 
-    // Копируем данные из staging buffer в изображение
-    QSGRendererInterface *rif = m_window->rendererInterface();
-    VkCommandBuffer commandBuffer = *reinterpret_cast<VkCommandBuffer *>(
-        rif->getResource(m_window, QSGRendererInterface::CommandListResource));
-
-    transitionImageLayout(commandBuffer, m_texture.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copyBufferToImage(commandBuffer, m_stagingBuffer, m_texture.image, m_texture.width, m_texture.height);
-    transitionImageLayout(commandBuffer, m_texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-    m_texture.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    // Создаем image view
-    VkImageViewCreateInfo viewInfo{};
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = m_texture.image;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
-
-    err = m_devFuncs->vkCreateImageView(m_dev, &viewInfo, nullptr, &m_texture.view);
-    if (err != VK_SUCCESS)
-        qFatal("Failed to create texture image view: %d", err);
-
-    // Создаем sampler
-    VkSamplerCreateInfo samplerInfo{};
-    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    samplerInfo.magFilter = VK_FILTER_LINEAR;
-    samplerInfo.minFilter = VK_FILTER_LINEAR;
-    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.anisotropyEnable = VK_FALSE;
-    samplerInfo.maxAnisotropy = 1.0f;
-    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-    samplerInfo.unnormalizedCoordinates = VK_FALSE;
-    samplerInfo.compareEnable = VK_FALSE;
-    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    samplerInfo.mipLodBias = 0.0f;
-    samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
-
-    err = m_devFuncs->vkCreateSampler(m_dev, &samplerInfo, nullptr, &m_texture.sampler);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo;
+    memset(&pipelineLayoutInfo, 0, sizeof(pipelineLayoutInfo));
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_cullLayout;
+    err = m_devFuncs->vkCreatePipelineLayout(m_dev, &pipelineLayoutInfo, nullptr, &m_cullPipelineLayout);
     if (err != VK_SUCCESS)
-        qFatal("Failed to create texture sampler: %d", err);
+        qFatal("Failed to create light culling pipeline layout: %d", err);
 }
 
 void CubeRenderer::init(int framesInFlight)
 {
+    VKQ_TRACE_SCOPE("CubeRenderer::init");
     Q_ASSERT(framesInFlight <= 3);
     m_initialized = true;
+    m_framesInFlight = framesInFlight;
 
     QSGRendererInterface *rif = m_window->rendererInterface();
     QVulkanInstance *inst = reinterpret_cast<QVulkanInstance *>(
@@ -629,8 +1254,17 @@ void CubeRenderer::init(int framesInFlight)
         rif->getResource(m_window, QSGRendererInterface::RenderPassResource));
     Q_ASSERT(rp);
 
-    // Загружаем текстуру
-    loadTexture();
+    // Массив текстур устройства, если есть descriptor indexing, иначе свой
+    // набор с одним COMBINED_IMAGE_SAMPLER; куб мог получить текстуры
+    // раньше, в пакете другого рендерера
+    if (!m_texture)
+        initTextures(framesInFlight);
+    m_clipDistance = VulkanDeviceFeatures::enabled(m_window).testFlag(VulkanDeviceFeatures::ShaderClipDistance);
+
+    if (m_vert.isEmpty())
+        prepareShader(VertexStage);
+    if (m_frag.isEmpty())
+        prepareShader(FragmentStage);
 
     // Vertex buffer
     VkPhysicalDeviceProperties physDevProps;
@@ -638,11 +1272,14 @@ void CubeRenderer::init(int framesInFlight)
 
     VkPhysicalDeviceMemoryProperties physDevMemProps;
     m_funcs->vkGetPhysicalDeviceMemoryProperties(m_physDev, &physDevMemProps);
+    m_memProps = physDevMemProps;
+
+    const VulkanAssetCache::Mesh mesh = cubeMesh();
 
     VkBufferCreateInfo bufferInfo;
     memset(&bufferInfo, 0, sizeof(bufferInfo));
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = sizeof(vertices);
+    bufferInfo.size = mesh.vertices.size();
     bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
     VkResult err = m_devFuncs->vkCreateBuffer(m_dev, &bufferInfo, nullptr, &m_vbuf);
     if (err != VK_SUCCESS)
@@ -655,16 +1292,8 @@ void CubeRenderer::init(int framesInFlight)
     allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
     allocInfo.allocationSize = memReq.size;
 
-    uint32_t memTypeIndex = uint32_t(-1);
-    VkMemoryPropertyFlags memPropFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-    for (uint32_t i = 0; i < physDevMemProps.memoryTypeCount; ++i) {
-        if (memReq.memoryTypeBits & (1 << i)) {
-            if ((physDevMemProps.memoryTypes[i].propertyFlags & memPropFlags) == memPropFlags) {
-                memTypeIndex = i;
-                break;
-            }
-        }
-    }
+    const VkMemoryPropertyFlags memPropFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    uint32_t memTypeIndex = VulkanUtils::findMemoryType(physDevMemProps, memReq.memoryTypeBits, memPropFlags);
     if (memTypeIndex == uint32_t(-1))
         qFatal("Failed to find device memory type for vertex buffer");
 
@@ -681,11 +1310,11 @@ void CubeRenderer::init(int framesInFlight)
     err = m_devFuncs->vkMapMemory(m_dev, m_vbufMem, 0, bufferInfo.size, 0, &p);
     if (err != VK_SUCCESS)
         qFatal("Failed to map vertex buffer memory: %d", err);
-    memcpy(p, vertices, bufferInfo.size);
+    memcpy(p, mesh.vertices.constData(), bufferInfo.size);
     m_devFuncs->vkUnmapMemory(m_dev, m_vbufMem);
 
     // Index buffer
-    bufferInfo.size = sizeof(indices);
+    bufferInfo.size = mesh.indices.size();
     bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
     err = m_devFuncs->vkCreateBuffer(m_dev, &bufferInfo, nullptr, &m_ibuf);
     if (err != VK_SUCCESS)
@@ -693,15 +1322,7 @@ void CubeRenderer::init(int framesInFlight)
 
     m_devFuncs->vkGetBufferMemoryRequirements(m_dev, m_ibuf, &memReq);
     allocInfo.allocationSize = memReq.size;
-    memTypeIndex = uint32_t(-1);
-    for (uint32_t i = 0; i < physDevMemProps.memoryTypeCount; ++i) {
-        if (memReq.memoryTypeBits & (1 << i)) {
-            if ((physDevMemProps.memoryTypes[i].propertyFlags & memPropFlags) == memPropFlags) {
-                memTypeIndex = i;
-                break;
-            }
-        }
-    }
+    memTypeIndex = VulkanUtils::findMemoryType(physDevMemProps, memReq.memoryTypeBits, memPropFlags);
     if (memTypeIndex == uint32_t(-1))
         qFatal("Failed to find device memory type for index buffer");
 
@@ -717,10 +1338,10 @@ void CubeRenderer::init(int framesInFlight)
     err = m_devFuncs->vkMapMemory(m_dev, m_ibufMem, 0, bufferInfo.size, 0, &p);
     if (err != VK_SUCCESS)
         qFatal("Failed to map index buffer memory: %d", err);
-    memcpy(p, indices, bufferInfo.size);
+    memcpy(p, mesh.indices.constData(), bufferInfo.size);
     m_devFuncs->vkUnmapMemory(m_dev, m_ibufMem);
 
-    m_indexCount = sizeof(indices) / sizeof(uint16_t);
+    m_indexCount = mesh.indexCount;
 
     // Uniform buffer
     const VkDeviceSize ubufAlign = physDevProps.limits.minUniformBufferOffsetAlignment;
@@ -733,15 +1354,7 @@ void CubeRenderer::init(int framesInFlight)
 
     m_devFuncs->vkGetBufferMemoryRequirements(m_dev, m_ubuf, &memReq);
     allocInfo.allocationSize = memReq.size;
-    memTypeIndex = uint32_t(-1);
-    for (uint32_t i = 0; i < physDevMemProps.memoryTypeCount; ++i) {
-        if (memReq.memoryTypeBits & (1 << i)) {
-            if ((physDevMemProps.memoryTypes[i].propertyFlags & memPropFlags) == memPropFlags) {
-                memTypeIndex = i;
-                break;
-            }
-        }
-    }
+    memTypeIndex = VulkanUtils::findMemoryType(physDevMemProps, memReq.memoryTypeBits, memPropFlags);
     if (memTypeIndex == uint32_t(-1))
         qFatal("Failed to find device memory type for uniform buffer");
 
@@ -754,104 +1367,179 @@ void CubeRenderer::init(int framesInFlight)
     if (err != VK_SUCCESS)
         qFatal("Failed to bind uniform buffer memory: %d", err);
 
-    // Pipeline layout
-    VkDescriptorSetLayoutBinding layoutBinding[2];
+    // Источники света и кластеры
+    initLightCulling(physDevMemProps, physDevProps.limits.minStorageBufferOffsetAlignment, framesInFlight);
+
+    // Pipeline layout: набор 0 - буферы, набор 1 - текстуры
+    VkDescriptorSetLayoutBinding layoutBinding[3];
     layoutBinding[0].binding = 0;
     layoutBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     layoutBinding[0].descriptorCount = 1;
-    layoutBinding[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    layoutBinding[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
     layoutBinding[0].pImmutableSamplers = nullptr;
 
-    layoutBinding[1].binding = 1;
-    layoutBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    layoutBinding[1].binding = 2;
+    layoutBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     layoutBinding[1].descriptorCount = 1;
     layoutBinding[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
     layoutBinding[1].pImmutableSamplers = nullptr;
 
+    layoutBinding[2].binding = 3;
+    layoutBinding[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    layoutBinding[2].descriptorCount = 1;
+    layoutBinding[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    layoutBinding[2].pImmutableSamplers = nullptr;
+
     VkDescriptorSetLayoutCreateInfo descLayoutInfo;
     memset(&descLayoutInfo, 0, sizeof(descLayoutInfo));
     descLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descLayoutInfo.bindingCount = 2;
+    descLayoutInfo.bindingCount = 3;
     descLayoutInfo.pBindings = layoutBinding;
     err = m_devFuncs->vkCreateDescriptorSetLayout(m_dev, &descLayoutInfo, nullptr, &m_resLayout);
     if (err != VK_SUCCESS)
         qFatal("Failed to create descriptor set layout: %d", err);
 
+    // Без массива устройства - свой набор из одной текстуры
+    if (!m_textures) {
+        VkDescriptorSetLayoutBinding textureBinding;
+        textureBinding.binding = 0;
+        textureBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        textureBinding.descriptorCount = 1;
+        textureBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        textureBinding.pImmutableSamplers = nullptr;
+
+        descLayoutInfo.bindingCount = 1;
+        descLayoutInfo.pBindings = &textureBinding;
+        err = m_devFuncs->vkCreateDescriptorSetLayout(m_dev, &descLayoutInfo, nullptr, &m_textureLayout);
+        if (err != VK_SUCCESS)
+            qFatal("Failed to create texture descriptor set layout: %d", err);
+    }
+
     VkPipelineLayoutCreateInfo pipelineLayoutInfo;
     memset(&pipelineLayoutInfo, 0, sizeof(pipelineLayoutInfo));
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &m_resLayout;
+    const VkDescriptorSetLayout setLayouts[] = { m_resLayout, m_textures ? m_textures->layout() : m_textureLayout };
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = setLayouts;
     err = m_devFuncs->vkCreatePipelineLayout(m_dev, &pipelineLayoutInfo, nullptr, &m_pipelineLayout);
     if (err != VK_SUCCESS)
         qFatal("Failed to create pipeline layout: %d", err);
 
-    // Descriptor pool
-    VkDescriptorPoolSize descPoolSizes[2];
+    // Descriptor pool: наборы отрисовки по кадрам в полёте и набор отбора источников
+    const uint32_t setCount = uint32_t(framesInFlight) + 1;
+    VkDescriptorPoolSize descPoolSizes[3];
     descPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    descPoolSizes[0].descriptorCount = 1;
-    descPoolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descPoolSizes[1].descriptorCount = 1;
+    descPoolSizes[0].descriptorCount = setCount;
+    descPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    descPoolSizes[1].descriptorCount = setCount;
+    descPoolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descPoolSizes[2].descriptorCount = setCount;
 
     VkDescriptorPoolCreateInfo descPoolInfo;
     memset(&descPoolInfo, 0, sizeof(descPoolInfo));
     descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descPoolInfo.maxSets = 1;
-    descPoolInfo.poolSizeCount = 2;
+    descPoolInfo.maxSets = setCount;
+    descPoolInfo.poolSizeCount = 3;
     descPoolInfo.pPoolSizes = descPoolSizes;
     err = m_devFuncs->vkCreateDescriptorPool(m_dev, &descPoolInfo, nullptr, &m_descriptorPool);
     if (err != VK_SUCCESS)
         qFatal("Failed to create descriptor pool: %d", err);
 
-    // Descriptor set
+    // Без массива устройства - пул наборов текстур, по набору на кадр в полёте
+    if (!m_textures) {
+        VkDescriptorPoolSize texturePoolSize;
+        texturePoolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        texturePoolSize.descriptorCount = uint32_t(framesInFlight);
+        descPoolInfo.maxSets = uint32_t(framesInFlight);
+        descPoolInfo.poolSizeCount = 1;
+        descPoolInfo.pPoolSizes = &texturePoolSize;
+        err = m_devFuncs->vkCreateDescriptorPool(m_dev, &descPoolInfo, nullptr, &m_textureDescriptorPool);
+        if (err != VK_SUCCESS)
+            qFatal("Failed to create texture descriptor pool: %d", err);
+    }
+
+    // Descriptor sets
     VkDescriptorSetAllocateInfo descSetAllocInfo;
     memset(&descSetAllocInfo, 0, sizeof(descSetAllocInfo));
     descSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     descSetAllocInfo.descriptorPool = m_descriptorPool;
     descSetAllocInfo.descriptorSetCount = 1;
     descSetAllocInfo.pSetLayouts = &m_resLayout;
-    err = m_devFuncs->vkAllocateDescriptorSets(m_dev, &descSetAllocInfo, &m_ubufDescriptor);
-    if (err != VK_SUCCESS)
-        qFatal("Failed to allocate descriptor set: %d", err);
+    for (int slot = 0; slot < framesInFlight; ++slot) {
+        err = m_devFuncs->vkAllocateDescriptorSets(m_dev, &descSetAllocInfo, &m_ubufDescriptors[slot]);
+        if (err != VK_SUCCESS)
+            qFatal("Failed to allocate descriptor set: %d", err);
+    }
 
-    VkDescriptorBufferInfo bufferInfoDesc;
-    bufferInfoDesc.buffer = m_ubuf;
-    bufferInfoDesc.offset = 0;
-    bufferInfoDesc.range = UBUF_SIZE;
+    // Наборы текстур сразу с текстурой из ресурсов, см. m_boundTextures
+    if (!m_textures) {
+        descSetAllocInfo.descriptorPool = m_textureDescriptorPool;
+        descSetAllocInfo.pSetLayouts = &m_textureLayout;
+        for (int slot = 0; slot < framesInFlight; ++slot) {
+            err = m_devFuncs->vkAllocateDescriptorSets(m_dev, &descSetAllocInfo, &m_textureDescriptors[slot]);
+            if (err != VK_SUCCESS)
+                qFatal("Failed to allocate texture descriptor set: %d", err);
+            writeTexture(m_textureDescriptors[slot], m_texture->view, m_texture->sampler);
+        }
+    }
 
-    VkDescriptorImageInfo imageInfo;
-    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    imageInfo.imageView = m_texture.view;
-    imageInfo.sampler = m_texture.sampler;
-
-    VkWriteDescriptorSet writeDescSet[2];
-    memset(writeDescSet, 0, sizeof(writeDescSet));
-
-    writeDescSet[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    writeDescSet[0].dstSet = m_ubufDescriptor;
-    writeDescSet[0].dstBinding = 0;
-    writeDescSet[0].descriptorCount = 1;
-    writeDescSet[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    writeDescSet[0].pBufferInfo = &bufferInfoDesc;
-
-    writeDescSet[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    writeDescSet[1].dstSet = m_ubufDescriptor;
-    writeDescSet[1].dstBinding = 1;
-    writeDescSet[1].descriptorCount = 1;
-    writeDescSet[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    writeDescSet[1].pImageInfo = &imageInfo;
-
-    m_devFuncs->vkUpdateDescriptorSets(m_dev, 2, writeDescSet, 0, nullptr);
-
-    // Pipeline cache
-    VkPipelineCacheCreateInfo pipelineCacheInfo;
-    memset(&pipelineCacheInfo, 0, sizeof(pipelineCacheInfo));
-    pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-    err = m_devFuncs->vkCreatePipelineCache(m_dev, &pipelineCacheInfo, nullptr, &m_pipelineCache);
+    descSetAllocInfo.descriptorPool = m_descriptorPool;
+    descSetAllocInfo.pSetLayouts = &m_cullLayout;
+    err = m_devFuncs->vkAllocateDescriptorSets(m_dev, &descSetAllocInfo, &m_cullDescriptor);
     if (err != VK_SUCCESS)
-        qFatal("Failed to create pipeline cache: %d", err);
+        qFatal("Failed to allocate light culling descriptor set: %d", err);
+
+    // Одни и те же буферы во всех наборах, привязки 0, 2 и 3 совпадают
+    VkDescriptorBufferInfo bufferInfoDesc[3];
+    bufferInfoDesc[0].buffer = m_ubuf;
+    bufferInfoDesc[0].offset = 0;
+    bufferInfoDesc[0].range = UBUF_SIZE;
+    bufferInfoDesc[1].buffer = m_lightBuf;
+    bufferInfoDesc[1].offset = 0;
+    bufferInfoDesc[1].range = LIGHT_HEADER_SIZE + MAX_LIGHTS * LIGHT_SIZE;
+    bufferInfoDesc[2].buffer = m_clusterBuf;
+    bufferInfoDesc[2].offset = 0;
+    bufferInfoDesc[2].range = VK_WHOLE_SIZE;
+
+    const VkDescriptorType descTypes[3] = {
+        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+    };
+    const uint32_t descBindings[3] = { 0, 2, 3 };
+    VkDescriptorSet descSets[4];
+    for (int slot = 0; slot < framesInFlight; ++slot)
+        descSets[slot] = m_ubufDescriptors[slot];
+    descSets[framesInFlight] = m_cullDescriptor;
+    VkWriteDescriptorSet writeDescSets[12];
+    memset(writeDescSets, 0, sizeof(writeDescSets));
+    for (int set = 0; set < int(setCount); ++set) {
+        for (int i = 0; i < 3; ++i) {
+            VkWriteDescriptorSet &w(writeDescSets[set * 3 + i]);
+            w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            w.dstSet = descSets[set];
+            w.dstBinding = descBindings[i];
+            w.descriptorCount = 1;
+            w.descriptorType = descTypes[i];
+            w.pBufferInfo = &bufferInfoDesc[i];
+        }
+    }
+    m_devFuncs->vkUpdateDescriptorSets(m_dev, setCount * 3, writeDescSets, 0, nullptr);
+
+    // Общий кэш устройства, сохраняемый между запусками
+    m_pipelineCache = VulkanPipelineCache::acquire(m_window);
+
+    // Пайплайны собираются на рабочих потоках, пока готовится остальное;
+    // finishPipelines() забирает их перед первой записью команд
+    m_pendingPipeline = VulkanPipelineCache::createAsync([this, rp] { return createPipeline(rp); });
+    m_pendingCullPipeline = VulkanPipelineCache::createAsync([this] { return createCullPipeline(); });
+
+    qDebug("cube initialized");
+}
 
-    // Graphics pipeline
+// На рабочем потоке: читает только то, что init() уже заполнил и больше не меняет
+VkPipeline CubeRenderer::createPipeline(VkRenderPass rp) const
+{
     VkGraphicsPipelineCreateInfo pipelineInfo;
     memset(&pipelineInfo, 0, sizeof(pipelineInfo));
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -866,7 +1554,7 @@ void CubeRenderer::init(int framesInFlight)
     shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     shaderInfo.codeSize = m_vert.size();
     shaderInfo.pCode = reinterpret_cast<const uint32_t *>(m_vert.constData());
-    err = m_devFuncs->vkCreateShaderModule(m_dev, &shaderInfo, nullptr, &vertModule);
+    VkResult err = m_devFuncs->vkCreateShaderModule(m_dev, &shaderInfo, nullptr, &vertModule);
     if (err != VK_SUCCESS)
         qFatal("Failed to create vertex shader module: %d", err);
     shaderStages[0].module = vertModule;
@@ -884,12 +1572,17 @@ void CubeRenderer::init(int framesInFlight)
     pipelineInfo.stageCount = 2;
     pipelineInfo.pStages = shaderStages;
 
-    VkVertexInputBindingDescription vertexBindingDesc;
-    vertexBindingDesc.binding = 0;
-    vertexBindingDesc.stride = sizeof(Vertex);
-    vertexBindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    VkVertexInputAttributeDescription vertexAttrDesc[3];
+    // Привязка 1 - экземпляры: столбцы матрицы model, область элемента и
+    // индекс текстуры
+    VkVertexInputBindingDescription vertexBindingDesc[2];
+    vertexBindingDesc[0].binding = 0;
+    vertexBindingDesc[0].stride = sizeof(Vertex);
+    vertexBindingDesc[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    vertexBindingDesc[1].binding = 1;
+    vertexBindingDesc[1].stride = INSTANCE_SIZE;
+    vertexBindingDesc[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    VkVertexInputAttributeDescription vertexAttrDesc[9];
     vertexAttrDesc[0].location = 0;
     vertexAttrDesc[0].binding = 0;
     vertexAttrDesc[0].format = VK_FORMAT_R32G32B32_SFLOAT;
@@ -902,13 +1595,23 @@ void CubeRenderer::init(int framesInFlight)
     vertexAttrDesc[2].binding = 0;
     vertexAttrDesc[2].format = VK_FORMAT_R32G32B32_SFLOAT;
     vertexAttrDesc[2].offset = offsetof(Vertex, normal);
+    for (uint32_t i = 0; i < 5; ++i) {
+        vertexAttrDesc[3 + i].location = 3 + i;
+        vertexAttrDesc[3 + i].binding = 1;
+        vertexAttrDesc[3 + i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        vertexAttrDesc[3 + i].offset = i * 4 * sizeof(float);
+    }
+    vertexAttrDesc[8].location = 8;
+    vertexAttrDesc[8].binding = 1;
+    vertexAttrDesc[8].format = VK_FORMAT_R32_UINT;
+    vertexAttrDesc[8].offset = VulkanCubeUniforms::InstanceTextureOffset;
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo;
     memset(&vertexInputInfo, 0, sizeof(vertexInputInfo));
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &vertexBindingDesc;
-    vertexInputInfo.vertexAttributeDescriptionCount = 3;
+    vertexInputInfo.vertexBindingDescriptionCount = 2;
+    vertexInputInfo.pVertexBindingDescriptions = vertexBindingDesc;
+    vertexInputInfo.vertexAttributeDescriptionCount = 9;
     vertexInputInfo.pVertexAttributeDescriptions = vertexAttrDesc;
     pipelineInfo.pVertexInputState = &vertexInputInfo;
 
@@ -969,14 +1672,48 @@ void CubeRenderer::init(int framesInFlight)
     pipelineInfo.layout = m_pipelineLayout;
     pipelineInfo.renderPass = rp;
 
-    err = m_devFuncs->vkCreateGraphicsPipelines(m_dev, m_pipelineCache, 1, &pipelineInfo, nullptr, &m_pipeline);
-    if (err != VK_SUCCESS)
-        qFatal("Failed to create graphics pipeline: %d", err);
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    err = m_devFuncs->vkCreateGraphicsPipelines(m_dev, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
 
     m_devFuncs->vkDestroyShaderModule(m_dev, vertModule, nullptr);
     m_devFuncs->vkDestroyShaderModule(m_dev, fragModule, nullptr);
 
-    qDebug("cube initialized");
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create graphics pipeline: %d", err);
+    return pipeline;
+}
+
+VkPipeline CubeRenderer::createCullPipeline() const
+{
+    const QByteArray comp = VulkanAssetCache::instance()->shader(QStringLiteral(":/cube_lights.comp.spv"));
+    if (comp.isEmpty())
+        qFatal("Failed to read shader :/cube_lights.comp.spv");
+    VkComputePipelineCreateInfo computeInfo;
+    memset(&computeInfo, 0, sizeof(computeInfo));
+    computeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    computeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    computeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    computeInfo.stage.module = VulkanUtils::createShaderModule(m_devFuncs, m_dev, comp);
+    computeInfo.stage.pName = "main";
+    computeInfo.layout = m_cullPipelineLayout;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult err = m_devFuncs->vkCreateComputePipelines(m_dev, m_pipelineCache, 1, &computeInfo, nullptr, &pipeline);
+    m_devFuncs->vkDestroyShaderModule(m_dev, computeInfo.stage.module, nullptr);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create light culling pipeline: %d", err);
+    return pipeline;
+}
+
+void CubeRenderer::finishPipelines()
+{
+    if (m_pendingPipeline.valid()) {
+        m_pipeline = m_pendingPipeline.get();
+        m_pendingPipeline = {};
+    }
+    if (m_pendingCullPipeline.valid()) {
+        m_cullPipeline = m_pendingCullPipeline.get();
+        m_pendingCullPipeline = {};
+    }
 }
 
 #include "vulkancube.moc"
@@ -6,23 +6,77 @@
 
 #include <QtQuick/QQuickItem>
 #include <QtQuick/QQuickWindow>
+#include <QByteArray>
+#include <QVariantList>
+#include <QPointer>
+#include <QSharedPointer>
+#include "vulkanpipelinestatistics.h"
+#include "vulkanstatesnapshot.h"
+#include "vulkantexturesource.h"
 
 class CubeRenderer;
+struct CubeState;
 
 class VulkanCube : public QQuickItem
 {
     Q_OBJECT
     Q_PROPERTY(qreal t READ t WRITE setT NOTIFY tChanged)
+    Q_PROPERTY(bool renderThreadAnimation READ renderThreadAnimation WRITE setRenderThreadAnimation NOTIFY renderThreadAnimationChanged)
+    Q_PROPERTY(qreal animationSpeed READ animationSpeed WRITE setAnimationSpeed NOTIFY animationSpeedChanged)
+    Q_PROPERTY(qreal animationPhase READ animationPhase WRITE setAnimationPhase NOTIFY animationPhaseChanged)
+    Q_PROPERTY(QVariantList lights READ lights WRITE setLights NOTIFY lightsChanged)
+    Q_PROPERTY(LightCulling lightCulling READ lightCulling WRITE setLightCulling NOTIFY lightCullingChanged)
+    Q_PROPERTY(VulkanTextureSource *textureSource READ textureSource WRITE setTextureSource NOTIFY textureSourceChanged)
+    Q_PROPERTY(VulkanPipelineStatistics *pipelineStatistics READ pipelineStatistics CONSTANT)
     QML_ELEMENT
 
 public:
+    enum LightCulling {
+        NoLightCulling,         // каждый фрагмент перебирает все источники
+        ClusteredLightCulling   // только источники своего кластера
+    };
+    Q_ENUM(LightCulling)
+
     VulkanCube();
 
+    // Совместимые кубы окна рисуются одним instanced draw; false - каждый
+    // своим draw (сравнение в benchmarks/run_cubes.sh). До первого кадра.
+    static void setBatchingEnabled(bool enabled);
+
+    VulkanPipelineStatistics *pipelineStatistics() const { return m_pipelineStatistics; }
+
     qreal t() const { return m_t; }
     void setT(qreal t);
 
+    // t = frac(animationPhase + animationSpeed * time) считается на потоке
+    // рендеринга; свойство t в этом режиме не используется
+    bool renderThreadAnimation() const { return m_renderThreadAnimation; }
+    void setRenderThreadAnimation(bool enabled);
+    qreal animationSpeed() const { return m_animationSpeed; }
+    void setAnimationSpeed(qreal speed);
+    qreal animationPhase() const { return m_animationPhase; }
+    void setAnimationPhase(qreal phase);
+
+    // Точечные источники: { position: vector3d, color: color,
+    // radius: real (10), intensity: real (1) }, не больше 1024
+    QVariantList lights() const { return m_lights; }
+    void setLights(const QVariantList &lights);
+    LightCulling lightCulling() const { return m_lightCulling; }
+    void setLightCulling(LightCulling culling);
+
+    // Поток кадров вместо текстуры из ресурсов; пока первый кадр не
+    // загружен, видна прежняя текстура
+    VulkanTextureSource *textureSource() const { return m_textureSource; }
+    void setTextureSource(VulkanTextureSource *source);
+
 signals:
     void tChanged();
+    void renderThreadAnimationChanged();
+    void animationSpeedChanged();
+    void animationPhaseChanged();
+    void lightsChanged();
+    void lightCullingChanged();
+    void textureSourceChanged();
 
 public slots:
     void sync();
@@ -31,11 +85,34 @@ public slots:
 private slots:
     void handleWindowChanged(QQuickWindow *win);
 
+protected:
+    void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+    void itemChange(ItemChange change, const ItemChangeData &value) override;
+
 private:
     void releaseResources() override;
+    void trackAncestors();
+    void connectSync(QQuickWindow *win);
+    CubeState rendererState() const;
+    void publishState();
 
     qreal m_t = 0;
+    bool m_renderThreadAnimation = false;
+    qreal m_animationSpeed = 0;
+    qreal m_animationPhase = 0;
+    QVariantList m_lights;
+    QByteArray m_lightData;
+    LightCulling m_lightCulling = ClusteredLightCulling;
+    QPointer<VulkanTextureSource> m_textureSource;
+    QMetaObject::Connection m_frameConnection;
+    VulkanPipelineStatistics *m_pipelineStatistics = new VulkanPipelineStatistics(this);
     CubeRenderer *m_renderer = nullptr;
+    // Изменения свойств публикуются сразу, рендерер забирает последний
+    // снимок в начале кадра; sync() нужен только для создания рендерера
+    QSharedPointer<VulkanStateSnapshot<CubeState>> m_state;
+    QMetaObject::Connection m_syncConnection;
+    // Область элемента в окне меняется и со сдвигом предков
+    QList<QMetaObject::Connection> m_ancestorConnections;
 };
 
 #endif
@@ -0,0 +1,64 @@
+// vulkancubeuniforms.cpp
+#include "vulkancubeuniforms.h"
+#include <QMatrix4x4>
+#include <cstring>
+
+namespace VulkanCubeUniforms {
+
+void fill(void *dst, float t, const QSize &viewportSize, const QSize &targetSize,
+          uint32_t lightCount, bool clustered)
+{
+    QMatrix4x4 view;
+    // Камера смотрит на куб
+    view.lookAt(QVector3D(0.0f, 0.0f, 1.0f),  // позиция камеры (смотрим спереди)
+                QVector3D(0.0f, 0.0f, 0.0f),  // цель (центр сцены)
+                QVector3D(0.0f, 1.0f, 0.0f)); // вектор "вверх"
+
+    QMatrix4x4 proj;
+    proj.perspective(60.0f, viewportSize.width() / (float)viewportSize.height(), NearPlane, FarPlane);
+
+    // Копируем матрицы и время в uniform buffer
+    float *data = static_cast<float*>(dst);
+    memcpy(data, view.constData(), 16 * sizeof(float));
+    memcpy(data + 16, proj.constData(), 16 * sizeof(float));
+    data[32] = t * 10.0f; // Ускоряем анимацию
+    data[36] = viewportSize.width();
+    data[37] = viewportSize.height();
+    data[38] = NearPlane;
+    data[39] = FarPlane;
+    uint32_t *lighting = reinterpret_cast<uint32_t *>(data + 40);
+    lighting[0] = lightCount;
+    // Без источников отбор не запускается, и кластеры не читаются
+    lighting[1] = clustered && lightCount > 0 ? 1 : 0;
+    lighting[2] = 0;
+    lighting[3] = 0;
+    data[44] = targetSize.width();
+    data[45] = targetSize.height();
+    data[46] = 0.0f;
+    data[47] = 0.0f;
+}
+
+void fillInstance(void *dst, float t, const QRect &viewportRect, uint32_t textureIndex)
+{
+    // Матрицы для 3D преобразований с вращением
+    QMatrix4x4 model;
+
+    // Сначала перемещаем куб в нужное положение
+    model.translate(0.0f, 0.0f, -5.0f); // Отодвигаем куб
+
+    // Затем применяем вращение вокруг своей оси
+    float angle = t * 360.0f; // Полный оборот за 1 секунду
+    model.rotate(angle, QVector3D(1.0f, 0.0f, 0.0f)); // Вращение вокруг X
+    model.rotate(angle * 0.7f, QVector3D(0.0f, 0.0f, 1.0f)); // Вращение вокруг Z
+
+    float *data = static_cast<float *>(dst);
+    memcpy(data, model.constData(), 16 * sizeof(float));
+    data[16] = viewportRect.x();
+    data[17] = viewportRect.y();
+    data[18] = viewportRect.width();
+    data[19] = viewportRect.height();
+    const uint32_t texture[4] = { textureIndex, 0, 0, 0 };
+    memcpy(data + 20, texture, sizeof(texture));
+}
+
+} // namespace VulkanCubeUniforms
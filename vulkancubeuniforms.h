@@ -0,0 +1,46 @@
+// vulkancubeuniforms.h
+#ifndef VULKANCUBEUNIFORMS_H
+#define VULKANCUBEUNIFORMS_H
+
+#include <QRect>
+#include <QSize>
+#include <cstdint>
+#include <cstring>
+
+// Заполнение uniform buffer куба (блок UniformBufferObject в
+// shaders/cube_lights.glsl) и записей экземпляров. Отдельно от
+// CubeRenderer, чтобы benchmarks/micro измерял тот же код, что выполняется
+// в кадре.
+namespace VulkanCubeUniforms {
+
+constexpr float NearPlane = 0.1f;
+constexpr float FarPlane = 100.0f;
+
+// 2 матрицы 4x4, время (с выравниванием std140), область элемента,
+// параметры освещения и размер цели
+constexpr int Size = sizeof(float) * 16 * 2 + sizeof(float) * 4 + sizeof(float) * 4 + sizeof(uint32_t) * 4
+        + sizeof(float) * 4;
+
+// Экземпляр - один элемент VulkanCube: матрица model, область элемента в
+// пикселях цели (x, y, ширина, высота) и индекс текстуры в
+// VulkanTextureArray (uint, дополнен до 16 байт), см. shaders/cube_vertex.glsl
+constexpr int InstanceSize = sizeof(float) * 16 + sizeof(float) * 4 + sizeof(uint32_t) * 4;
+constexpr int InstanceTextureOffset = sizeof(float) * 16 + sizeof(float) * 4;
+
+// dst - Size байт отображённой памяти буфера; viewportSize - размер
+// области элементов пакета, targetSize - цели рендеринга
+void fill(void *dst, float t, const QSize &viewportSize, const QSize &targetSize,
+          uint32_t lightCount, bool clustered);
+
+// dst - InstanceSize байт
+void fillInstance(void *dst, float t, const QRect &viewportRect, uint32_t textureIndex);
+
+// Только индекс текстуры уже заполненного экземпляра
+inline void setInstanceTexture(void *dst, uint32_t textureIndex)
+{
+    memcpy(static_cast<char *>(dst) + InstanceTextureOffset, &textureIndex, sizeof(textureIndex));
+}
+
+} // namespace VulkanCubeUniforms
+
+#endif
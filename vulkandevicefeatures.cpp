@@ -0,0 +1,308 @@
+// vulkandevicefeatures.cpp
+#include "vulkandevicefeatures.h"
+#include <QtQuick/QQuickGraphicsConfiguration>
+#include <QVulkanFunctions>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+
+struct DeviceFeatures {
+    VulkanDeviceFeatures::Features features;
+    QByteArrayList extensions;
+};
+
+typedef QHash<VkDevice, DeviceFeatures> FeatureRegistry;
+Q_GLOBAL_STATIC(QMutex, s_registryMutex)
+Q_GLOBAL_STATIC(FeatureRegistry, s_devices)
+
+static const struct {
+    VulkanDeviceFeatures::Feature feature;
+    const char *name;
+} s_featureNames[] = {
+    { VulkanDeviceFeatures::DescriptorIndexing, "descriptorIndexing" },
+    { VulkanDeviceFeatures::SampledImageUpdateAfterBind, "sampledImageUpdateAfterBind" },
+    { VulkanDeviceFeatures::TimelineSemaphore, "timelineSemaphore" },
+    { VulkanDeviceFeatures::ShaderFloat16, "shaderFloat16" },
+    { VulkanDeviceFeatures::ShaderInt16, "shaderInt16" },
+    { VulkanDeviceFeatures::StorageBuffer16BitAccess, "storageBuffer16BitAccess" },
+    { VulkanDeviceFeatures::BufferDeviceAddress, "bufferDeviceAddress" },
+    { VulkanDeviceFeatures::Synchronization2, "synchronization2" },
+    { VulkanDeviceFeatures::DynamicRendering, "dynamicRendering" },
+    { VulkanDeviceFeatures::HostImageCopy, "hostImageCopy" },
+    { VulkanDeviceFeatures::ShaderClipDistance, "shaderClipDistance" }
+};
+
+static QByteArrayList supportedExtensions(QVulkanInstance *inst, VkPhysicalDevice physDev)
+{
+    QVulkanFunctions *f = inst->functions();
+    uint32_t count = 0;
+    f->vkEnumerateDeviceExtensionProperties(physDev, nullptr, &count, nullptr);
+    QList<VkExtensionProperties> props(count);
+    f->vkEnumerateDeviceExtensionProperties(physDev, nullptr, &count, props.data());
+    QByteArrayList result;
+    result.reserve(int(count));
+    for (const VkExtensionProperties &p : std::as_const(props))
+        result.append(QByteArray(p.extensionName));
+    return result;
+}
+
+VulkanDeviceFeatures::Features VulkanDeviceFeatures::enabled(QQuickWindow *window)
+{
+    QSGRendererInterface *rif = window->rendererInterface();
+    VkDevice dev = *reinterpret_cast<VkDevice *>(rif->getResource(window, QSGRendererInterface::DeviceResource));
+    Q_ASSERT(dev);
+
+    QMutexLocker lock(s_registryMutex());
+    auto it = s_devices()->constFind(dev);
+    if (it != s_devices()->cend())
+        return it->features;
+
+    // Устройство создано Qt: включено всё поддерживаемое ядром и расширения,
+    // запрошенные через QQuickGraphicsConfiguration (неподдерживаемые Qt
+    // пропускает). Запись живёт до уничтожения устройства вместе с scene graph.
+    QVulkanInstance *inst = reinterpret_cast<QVulkanInstance *>(
+        rif->getResource(window, QSGRendererInterface::VulkanInstanceResource));
+    VkPhysicalDevice physDev = *reinterpret_cast<VkPhysicalDevice *>(
+        rif->getResource(window, QSGRendererInterface::PhysicalDeviceResource));
+    DeviceFeatures entry;
+    entry.features = supported(inst, physDev) & ~extensionFeatures();
+    const QByteArrayList available = supportedExtensions(inst, physDev);
+    for (const QByteArray &ext : window->graphicsConfiguration().deviceExtensions()) {
+        if (available.contains(ext))
+            entry.extensions.append(ext);
+    }
+    s_devices()->insert(dev, entry);
+    QObject::connect(window, &QQuickWindow::sceneGraphInvalidated, window, [dev] { unpublish(dev); },
+                     Qt::ConnectionType(Qt::DirectConnection | Qt::SingleShotConnection));
+    return entry.features;
+}
+
+bool VulkanDeviceFeatures::hasExtension(QQuickWindow *window, const QByteArray &name)
+{
+    enabled(window);
+    QSGRendererInterface *rif = window->rendererInterface();
+    VkDevice dev = *reinterpret_cast<VkDevice *>(rif->getResource(window, QSGRendererInterface::DeviceResource));
+    QMutexLocker lock(s_registryMutex());
+    return s_devices()->value(dev).extensions.contains(name);
+}
+
+void VulkanDeviceFeatures::publish(VkDevice dev, Features features, const QByteArrayList &extensions)
+{
+    QMutexLocker lock(s_registryMutex());
+    s_devices()->insert(dev, { features, extensions });
+}
+
+void VulkanDeviceFeatures::unpublish(VkDevice dev)
+{
+    QMutexLocker lock(s_registryMutex());
+    s_devices()->remove(dev);
+}
+
+VulkanDeviceFeatures::Features VulkanDeviceFeatures::supported(QVulkanInstance *inst, VkPhysicalDevice physDev)
+{
+    QVulkanFunctions *f = inst->functions();
+    VkPhysicalDeviceProperties props;
+    f->vkGetPhysicalDeviceProperties(physDev, &props);
+
+    // Возможности 1.1/1.2/1.3 включаются (и Qt, и VulkanSharedDevice) только
+    // при экземпляре и устройстве с версией API не ниже 1.2
+    auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(
+        inst->getInstanceProcAddr("vkGetPhysicalDeviceFeatures2"));
+    if (!getFeatures2 || inst->apiVersion() < QVersionNumber(1, 2) || props.apiVersion < VK_API_VERSION_1_2) {
+        VkPhysicalDeviceFeatures features;
+        f->vkGetPhysicalDeviceFeatures(physDev, &features);
+        Features result;
+        if (features.shaderInt16)
+            result |= ShaderInt16;
+        if (features.shaderClipDistance)
+            result |= ShaderClipDistance;
+        return result;
+    }
+
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    VkPhysicalDeviceVulkan11Features features11{};
+    features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    features2.pNext = &features11;
+    features11.pNext = &features12;
+    void **tail = &features12.pNext;
+#ifdef VK_VERSION_1_3
+    VkPhysicalDeviceVulkan13Features features13{};
+    features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    const bool api13 = props.apiVersion >= VK_API_VERSION_1_3;
+    if (api13) {
+        *tail = &features13;
+        tail = &features13.pNext;
+    }
+#endif
+#if defined(VK_VERSION_1_3) && defined(VK_EXT_host_image_copy)
+    // Зависимости расширения (copy_commands2, format_feature_flags2) в ядре 1.3
+    VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopy{};
+    hostImageCopy.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+    const bool hasHostImageCopy = api13
+            && supportedExtensions(inst, physDev).contains(QByteArrayLiteral(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME));
+    if (hasHostImageCopy)
+        *tail = &hostImageCopy;
+#endif
+    getFeatures2(physDev, &features2);
+
+    Features result;
+    if (features12.descriptorIndexing && features12.runtimeDescriptorArray
+            && features12.descriptorBindingPartiallyBound && features12.shaderSampledImageArrayNonUniformIndexing) {
+        result |= DescriptorIndexing;
+        if (features12.descriptorBindingSampledImageUpdateAfterBind
+                && features12.descriptorBindingUpdateUnusedWhilePending)
+            result |= SampledImageUpdateAfterBind;
+    }
+    if (features12.timelineSemaphore)
+        result |= TimelineSemaphore;
+    if (features12.shaderFloat16)
+        result |= ShaderFloat16;
+    if (features2.features.shaderInt16)
+        result |= ShaderInt16;
+    if (features2.features.shaderClipDistance)
+        result |= ShaderClipDistance;
+    if (features11.storageBuffer16BitAccess)
+        result |= StorageBuffer16BitAccess;
+    if (features12.bufferDeviceAddress)
+        result |= BufferDeviceAddress;
+#ifdef VK_VERSION_1_3
+    if (api13 && features13.synchronization2)
+        result |= Synchronization2;
+    if (api13 && features13.dynamicRendering)
+        result |= DynamicRendering;
+#endif
+#if defined(VK_VERSION_1_3) && defined(VK_EXT_host_image_copy)
+    if (hasHostImageCopy && hostImageCopy.hostImageCopy)
+        result |= HostImageCopy;
+#endif
+    return result;
+}
+
+QByteArrayList VulkanDeviceFeatures::requiredExtensions(Features features)
+{
+    QByteArrayList result;
+#ifdef VK_EXT_host_image_copy
+    if (features.testFlag(HostImageCopy))
+        result.append(QByteArrayLiteral(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME));
+#else
+    Q_UNUSED(features);
+#endif
+    return result;
+}
+
+VulkanDeviceFeatures::Features VulkanDeviceFeatures::fromNames(const QStringList &names)
+{
+    Features result;
+    for (const QString &name : names) {
+        bool found = false;
+        for (const auto &entry : s_featureNames) {
+            if (name.compare(QLatin1String(entry.name), Qt::CaseInsensitive) == 0) {
+                result |= entry.feature;
+                found = true;
+                break;
+            }
+        }
+        if (!found && !name.isEmpty())
+            qWarning("Unknown Vulkan device feature \"%s\"", qPrintable(name));
+    }
+    return result;
+}
+
+QStringList VulkanDeviceFeatures::names(Features features)
+{
+    QStringList result;
+    for (const auto &entry : s_featureNames) {
+        if (features.testFlag(entry.feature))
+            result.append(QLatin1String(entry.name));
+    }
+    return result;
+}
+
+static int performanceRank(VkPhysicalDeviceType type)
+{
+    switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return 4;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return 3;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return 2;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+VkPhysicalDevice VulkanDeviceFeatures::selectPhysicalDevice(QVulkanInstance *inst, const QString &selector)
+{
+    QVulkanFunctions *f = inst->functions();
+    uint32_t count = 0;
+    f->vkEnumeratePhysicalDevices(inst->vkInstance(), &count, nullptr);
+    if (!count)
+        return VK_NULL_HANDLE;
+    QList<VkPhysicalDevice> physDevs(count);
+    f->vkEnumeratePhysicalDevices(inst->vkInstance(), &count, physDevs.data());
+
+    // Тот же выбор, что у Qt: первое устройство или QT_VK_PHYSICAL_DEVICE_INDEX
+    if (selector.isEmpty()) {
+        uint32_t index = 0;
+        if (qEnvironmentVariableIsSet("QT_VK_PHYSICAL_DEVICE_INDEX")) {
+            const uint32_t requested = uint32_t(qEnvironmentVariableIntValue("QT_VK_PHYSICAL_DEVICE_INDEX"));
+            if (requested < count)
+                index = requested;
+        }
+        return physDevs[index];
+    }
+
+    static const struct {
+        const char *name;
+        VkPhysicalDeviceType type;
+    } types[] = {
+        { "discrete", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU },
+        { "integrated", VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU },
+        { "virtual", VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU },
+        { "cpu", VK_PHYSICAL_DEVICE_TYPE_CPU }
+    };
+    int requestedType = -1;
+    for (const auto &t : types) {
+        if (selector.compare(QLatin1String(t.name), Qt::CaseInsensitive) == 0)
+            requestedType = t.type;
+    }
+    const bool byPerformance = selector.compare(QLatin1String("performance"), Qt::CaseInsensitive) == 0;
+
+    VkPhysicalDevice best = VK_NULL_HANDLE;
+    int bestRank = -1;
+    VkDeviceSize bestMemory = 0;
+    for (VkPhysicalDevice physDev : std::as_const(physDevs)) {
+        VkPhysicalDeviceProperties props;
+        f->vkGetPhysicalDeviceProperties(physDev, &props);
+        if (requestedType >= 0) {
+            if (props.deviceType == VkPhysicalDeviceType(requestedType))
+                return physDev;
+        } else if (byPerformance) {
+            VkPhysicalDeviceMemoryProperties memProps;
+            f->vkGetPhysicalDeviceMemoryProperties(physDev, &memProps);
+            VkDeviceSize localMemory = 0;
+            for (uint32_t i = 0; i < memProps.memoryHeapCount; ++i) {
+                if (memProps.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+                    localMemory += memProps.memoryHeaps[i].size;
+            }
+            const int rank = performanceRank(props.deviceType);
+            if (rank > bestRank || (rank == bestRank && localMemory > bestMemory)) {
+                best = physDev;
+                bestRank = rank;
+                bestMemory = localMemory;
+            }
+        } else if (QString::fromUtf8(props.deviceName).contains(selector, Qt::CaseInsensitive)) {
+            return physDev;
+        }
+    }
+    if (!best)
+        qWarning("No Vulkan physical device matches \"%s\"", qPrintable(selector));
+    return best;
+}
@@ -0,0 +1,72 @@
+// vulkandevicefeatures.h
+#ifndef VULKANDEVICEFEATURES_H
+#define VULKANDEVICEFEATURES_H
+
+#include <QtQuick/QQuickWindow>
+#include <QVulkanInstance>
+#include <QByteArrayList>
+#include <QStringList>
+
+// Выбор физического устройства и включённые на VkDevice возможности.
+//
+// Рендереры не проверяют поддержку сами, а спрашивают enabled(window):
+// результат - то, что действительно включено на устройстве окна. Устройство,
+// созданное Qt, получает все поддерживаемые возможности ядра (1.1/1.2/1.3 при
+// версии API не ниже 1.2) и расширения из QQuickGraphicsConfiguration, но не
+// возможности расширений - для них нужна структура в цепочке
+// VkDeviceCreateInfo, и они доступны только на устройстве VulkanSharedDevice,
+// которое публикует свой набор через publish().
+class VulkanDeviceFeatures
+{
+public:
+    enum Feature {
+        // runtimeDescriptorArray, partiallyBound и неоднородная индексация
+        // массивов sampled image
+        DescriptorIndexing = 0x001,
+        // update-after-bind для sampled image и запись элементов, не
+        // используемых кадрами в полёте (VulkanTextureArray)
+        SampledImageUpdateAfterBind = 0x002,
+        TimelineSemaphore = 0x004,
+        ShaderFloat16 = 0x008,
+        ShaderInt16 = 0x010,
+        StorageBuffer16BitAccess = 0x020,
+        BufferDeviceAddress = 0x040,
+        Synchronization2 = 0x080,
+        DynamicRendering = 0x100,
+        // VK_EXT_host_image_copy, только VulkanSharedDevice
+        HostImageCopy = 0x200,
+        // gl_ClipDistance, возможность Vulkan 1.0
+        ShaderClipDistance = 0x400
+    };
+    Q_DECLARE_FLAGS(Features, Feature)
+
+    // Включённое на устройстве окна; вызывать на потоке рендеринга после
+    // инициализации scene graph
+    static Features enabled(QQuickWindow *window);
+    static bool hasExtension(QQuickWindow *window, const QByteArray &name);
+
+    // Для тех, кто создаёт устройство сам: набор действует до unpublish()
+    static void publish(VkDevice dev, Features features, const QByteArrayList &extensions);
+    static void unpublish(VkDevice dev);
+
+    static Features supported(QVulkanInstance *inst, VkPhysicalDevice physDev);
+    // Расширения, без которых возможность нельзя включить
+    static QByteArrayList requiredExtensions(Features features);
+    // Возможности, которые нельзя включить на устройстве, созданном Qt
+    static Features extensionFeatures() { return HostImageCopy; }
+
+    // Имена как в перечислении с маленькой буквы: "descriptorIndexing", ...
+    static Features fromNames(const QStringList &names);
+    static QStringList names(Features features);
+
+    // selector: пусто - как в Qt (первое устройство или
+    // QT_VK_PHYSICAL_DEVICE_INDEX), "discrete", "integrated", "virtual",
+    // "cpu", "performance" (самое быстрое по типу, затем по объёму
+    // DEVICE_LOCAL памяти) или часть имени устройства без учёта регистра.
+    // VK_NULL_HANDLE, если подходящего устройства нет.
+    static VkPhysicalDevice selectPhysicalDevice(QVulkanInstance *inst, const QString &selector);
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(VulkanDeviceFeatures::Features)
+
+#endif
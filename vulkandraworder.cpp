@@ -0,0 +1,288 @@
+// vulkandraworder.cpp
+#include "vulkandraworder.h"
+#include "vulkantrace.h"
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+
+// Записей на окно больше не бывает, лишние рисуются без запросов статистики
+static const int MAX_QUERIES = 16;
+// Отчёт раз в столько кадров со статистикой
+static const int REPORT_INTERVAL = 300;
+// Значения в результате идут в порядке битов, за ними - доступность
+static const VkQueryPipelineStatisticFlags STATISTICS =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT
+        | VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+        | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+        | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+static const int RESULT_VALUES = 5;
+
+static bool s_painterOrder = false;
+static bool s_statisticsEnabled = false;
+
+// Окна с отдельными потоками рендеринга регистрируются параллельно
+Q_GLOBAL_STATIC(QMutex, s_registryMutex)
+typedef QHash<QQuickWindow *, VulkanDrawOrder *> DrawOrderRegistry;
+Q_GLOBAL_STATIC(DrawOrderRegistry, s_registry)
+
+void VulkanDrawOrder::setPainterOrder(bool painter)
+{
+    s_painterOrder = painter;
+}
+
+void VulkanDrawOrder::setStatisticsEnabled(bool enabled)
+{
+    s_statisticsEnabled = enabled;
+}
+
+bool VulkanDrawOrder::statisticsEnabled()
+{
+    return s_statisticsEnabled;
+}
+
+VulkanDrawOrder *VulkanDrawOrder::forWindow(QQuickWindow *window)
+{
+    QMutexLocker lock(s_registryMutex());
+    VulkanDrawOrder *&order((*s_registry())[window]);
+    if (!order)
+        order = new VulkanDrawOrder(window);
+    return order;
+}
+
+void VulkanDrawOrder::unregister(QQuickWindow *window, QObject *renderer)
+{
+    QMutexLocker lock(s_registryMutex());
+    auto it = s_registry()->find(window);
+    if (it == s_registry()->end())
+        return;
+    VulkanDrawOrder *order = it.value();
+    order->remove(renderer);
+    if (order->m_entries.isEmpty()) {
+        s_registry()->erase(it);
+        delete order;
+    }
+}
+
+VulkanDrawOrder::VulkanDrawOrder(QQuickWindow *window)
+    : m_window(window)
+{
+    connect(window, &QQuickWindow::beforeRendering, this, &VulkanDrawOrder::frameStart, Qt::DirectConnection);
+    connect(window, &QQuickWindow::beforeRenderPassRecording, this, &VulkanDrawOrder::recordMainPass, Qt::DirectConnection);
+}
+
+VulkanDrawOrder::~VulkanDrawOrder()
+{
+    if (m_jobsUsed)
+        VulkanJobSystem::instance()->wait(&m_frameJobs);
+    if (m_reportedFrames)
+        report();
+    if (m_queryPool)
+        m_devFuncs->vkDestroyQueryPool(m_dev, m_queryPool, nullptr);
+}
+
+void VulkanDrawOrder::add(QObject *renderer, Stage stage, const char *name, const RecordFunction &record)
+{
+    remove(renderer);
+
+    // Вставка после всех записей той же или более ранней стадии, внутри
+    // стадии сохраняется порядок регистрации
+    int pos = m_entries.size();
+    if (!s_painterOrder) {
+        while (pos > 0 && m_entries[pos - 1].stage > stage)
+            --pos;
+    }
+    m_entries.insert(pos, { renderer, stage, name, record, Statistics(), false });
+}
+
+void VulkanDrawOrder::remove(QObject *renderer)
+{
+    // Результаты ещё не прочитанных запросов удалённого рендерера отбрасываются
+    for (QList<QObject *> &renderers : m_slotQueries)
+        std::replace(renderers.begin(), renderers.end(), renderer, static_cast<QObject *>(nullptr));
+
+    for (int i = 0; i < m_entries.size(); ++i) {
+        if (m_entries[i].renderer == renderer) {
+            m_entries.removeAt(i);
+            return;
+        }
+    }
+}
+
+bool VulkanDrawOrder::initDevice()
+{
+    if (m_devFuncs)
+        return true;
+
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    if (rif->graphicsApi() != QSGRendererInterface::Vulkan)
+        return false;
+
+    QVulkanInstance *inst = reinterpret_cast<QVulkanInstance *>(
+        rif->getResource(m_window, QSGRendererInterface::VulkanInstanceResource));
+    m_dev = *reinterpret_cast<VkDevice *>(rif->getResource(m_window, QSGRendererInterface::DeviceResource));
+    Q_ASSERT(inst && m_dev);
+    m_devFuncs = inst->deviceFunctions(m_dev);
+    return m_devFuncs != nullptr;
+}
+
+void VulkanDrawOrder::initStatistics(int framesInFlight)
+{
+    m_statisticsChecked = true;
+
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    QVulkanInstance *inst = reinterpret_cast<QVulkanInstance *>(
+        rif->getResource(m_window, QSGRendererInterface::VulkanInstanceResource));
+    VkPhysicalDevice physDev = *reinterpret_cast<VkPhysicalDevice *>(
+        rif->getResource(m_window, QSGRendererInterface::PhysicalDeviceResource));
+
+    // Qt включает при создании устройства все поддерживаемые возможности
+    // Vulkan 1.0 (кроме robustBufferAccess), поэтому достаточно проверить поддержку
+    VkPhysicalDeviceFeatures features;
+    inst->functions()->vkGetPhysicalDeviceFeatures(physDev, &features);
+    if (!features.pipelineStatisticsQuery) {
+        qWarning("Pipeline statistics queries are not supported by the device");
+        return;
+    }
+
+    VkQueryPoolCreateInfo poolInfo;
+    memset(&poolInfo, 0, sizeof(poolInfo));
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    poolInfo.queryCount = uint32_t(MAX_QUERIES * framesInFlight);
+    poolInfo.pipelineStatistics = STATISTICS;
+    VkResult err = m_devFuncs->vkCreateQueryPool(m_dev, &poolInfo, nullptr, &m_queryPool);
+    if (err != VK_SUCCESS) {
+        qWarning("Failed to create pipeline statistics query pool: %d", err);
+        m_queryPool = VK_NULL_HANDLE;
+        return;
+    }
+    m_slotQueries.resize(framesInFlight);
+}
+
+void VulkanDrawOrder::frameStart()
+{
+    if (!s_statisticsEnabled || !initDevice())
+        return;
+
+    const QQuickWindow::GraphicsStateInfo &stateInfo(m_window->graphicsStateInfo());
+    if (!m_statisticsChecked)
+        initStatistics(stateInfo.framesInFlight);
+    if (!m_queryPool)
+        return;
+
+    // Кадр, который раньше использовал этот слот, уже завершён на GPU
+    const int slot = stateInfo.currentFrameSlot;
+    collectStatistics(slot);
+
+    // Сброс пула запрещён внутри render pass, поэтому он здесь
+    m_window->beginExternalCommands();
+    VkCommandBuffer cb = *reinterpret_cast<VkCommandBuffer *>(
+        m_window->rendererInterface()->getResource(m_window, QSGRendererInterface::CommandListResource));
+    m_devFuncs->vkCmdResetQueryPool(cb, m_queryPool, uint32_t(slot * MAX_QUERIES), MAX_QUERIES);
+    m_window->endExternalCommands();
+}
+
+void VulkanDrawOrder::recordMainPass()
+{
+    VKQ_TRACE_SCOPE("VulkanDrawOrder::recordMainPass");
+    // Записи читают то, что готовили задания кадра
+    if (m_jobsUsed)
+        VulkanJobSystem::instance()->wait(&m_frameJobs);
+    if (m_entries.isEmpty() || !initDevice())
+        return;
+
+    const int slot = m_window->graphicsStateInfo().currentFrameSlot;
+    const bool queries = m_queryPool && slot < m_slotQueries.size();
+
+    m_window->beginExternalCommands();
+
+    // Запрашивать после beginExternalCommands(): это может быть новый
+    // вторичный командный буфер, а не основной
+    VkCommandBuffer cb = *reinterpret_cast<VkCommandBuffer *>(
+        m_window->rendererInterface()->getResource(m_window, QSGRendererInterface::CommandListResource));
+    Q_ASSERT(cb);
+
+    for (int i = 0; i < m_entries.size(); ++i) {
+        const Entry &e(m_entries[i]);
+        const bool query = queries && i < MAX_QUERIES;
+        if (query)
+            m_devFuncs->vkCmdBeginQuery(cb, m_queryPool, uint32_t(slot * MAX_QUERIES + i), 0);
+        e.record(cb);
+        if (query) {
+            m_devFuncs->vkCmdEndQuery(cb, m_queryPool, uint32_t(slot * MAX_QUERIES + i));
+            m_slotQueries[slot].append(e.renderer);
+        }
+    }
+
+    m_window->endExternalCommands();
+}
+
+void VulkanDrawOrder::collectStatistics(int slot)
+{
+    QList<QObject *> &renderers(m_slotQueries[slot]);
+    if (renderers.isEmpty())
+        return;
+
+    // Кадр слота завершён, поэтому результаты уже должны быть доступны;
+    // не дожидаемся их, неполный кадр пропускается
+    quint64 results[MAX_QUERIES * RESULT_VALUES];
+    VkResult err = m_devFuncs->vkGetQueryPoolResults(m_dev, m_queryPool, uint32_t(slot * MAX_QUERIES),
+                                                     uint32_t(renderers.size()), sizeof(results), results,
+                                                     RESULT_VALUES * sizeof(quint64),
+                                                     VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (err == VK_SUCCESS || err == VK_NOT_READY) {
+        bool complete = true;
+        for (int i = 0; i < renderers.size(); ++i)
+            complete = complete && results[i * RESULT_VALUES + RESULT_VALUES - 1];
+        if (complete) {
+            for (int i = 0; i < renderers.size(); ++i) {
+                if (!renderers[i])
+                    continue;
+                for (Entry &e : m_entries) {
+                    if (e.renderer != renderers[i])
+                        continue;
+                    const quint64 *r = results + i * RESULT_VALUES;
+                    e.statistics.inputAssemblyVertices = r[0];
+                    e.statistics.vertexShaderInvocations = r[1];
+                    e.statistics.clippingPrimitives = r[2];
+                    e.statistics.fragmentShaderInvocations = r[3];
+                    e.statisticsReady = true;
+                    m_invocations[QByteArray(e.name)] += r[3];
+                    break;
+                }
+            }
+            if (++m_reportedFrames == REPORT_INTERVAL)
+                report();
+        }
+    }
+    renderers.clear();
+}
+
+bool VulkanDrawOrder::takeStatistics(QObject *renderer, Statistics *statistics)
+{
+    for (Entry &e : m_entries) {
+        if (e.renderer == renderer) {
+            if (!e.statisticsReady)
+                return false;
+            *statistics = e.statistics;
+            e.statisticsReady = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+void VulkanDrawOrder::report()
+{
+    QByteArray line;
+    quint64 total = 0;
+    for (auto it = m_invocations.cbegin(); it != m_invocations.cend(); ++it) {
+        line += ' ' + it.key() + '=' + QByteArray::number(it.value() / m_reportedFrames);
+        total += it.value();
+    }
+    qInfo("draw order %s: fragment shader invocations per frame:%s total=%llu",
+          s_painterOrder ? "painter" : "depth", line.constData(),
+          (unsigned long long)(total / m_reportedFrames));
+    m_invocations.clear();
+    m_reportedFrames = 0;
+}
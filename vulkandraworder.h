@@ -0,0 +1,110 @@
+// vulkandraworder.h
+#ifndef VULKANDRAWORDER_H
+#define VULKANDRAWORDER_H
+
+#include <QtQuick/QQuickWindow>
+#include <QVulkanInstance>
+#include <QVulkanFunctions>
+#include <QList>
+#include <QMap>
+#include <functional>
+#include "vulkanjobsystem.h"
+
+// Общий порядок отрисовки элементов VulkanUnderQML в основном проходе окна.
+//
+// Рендереры не подключаются к beforeRenderPassRecording сами (тогда порядок
+// определяется порядком подключения), а регистрируются здесь со стадией.
+// Непрозрачные элементы с записью глубины рисуются первыми, фон - после них
+// на дальней глубине с depth test: закрытые фрагменты отбрасываются early-Z
+// и фрагментный шейдер для них не запускается.
+//
+// Все методы вызываются на потоке рендеринга окна.
+class VulkanDrawOrder : public QObject
+{
+    Q_OBJECT
+public:
+    enum Stage {
+        OpaqueStage,        // запись глубины, без смешивания
+        BackgroundStage,    // дальняя глубина, depth test без записи
+        TransparentStage    // смешивание, глубина не пишется
+    };
+
+    using RecordFunction = std::function<void(VkCommandBuffer)>;
+
+    // Счётчики VK_QUERY_TYPE_PIPELINE_STATISTICS одной записи за кадр
+    struct Statistics {
+        quint64 inputAssemblyVertices = 0;
+        quint64 vertexShaderInvocations = 0;
+        quint64 clippingPrimitives = 0;
+        quint64 fragmentShaderInvocations = 0;
+    };
+
+    static VulkanDrawOrder *forWindow(QQuickWindow *window);
+    // Для деструкторов рендереров: объект удаляется вместе с последней записью
+    static void unregister(QQuickWindow *window, QObject *renderer);
+
+    // Повторная регистрация того же рендерера заменяет запись
+    void add(QObject *renderer, Stage stage, const char *name, const RecordFunction &record);
+
+    // Задания подготовки кадра (VulkanJobSystem), запущенные из
+    // beforeRendering: завершаются до записи основного прохода
+    VulkanJobSystem::Group *frameJobs()
+    {
+        m_jobsUsed = true;
+        return &m_frameJobs;
+    }
+
+    // Задаются из main() до создания окон.
+    // painterOrder - прежний порядок (порядок регистрации) для сравнения.
+    // statistics - запросы VK_QUERY_TYPE_PIPELINE_STATISTICS на каждую запись
+    // (результаты - в свойстве pipelineStatistics элементов) и периодический
+    // отчёт о числе вызовов фрагментного шейдера.
+    static void setPainterOrder(bool painter);
+    static void setStatisticsEnabled(bool enabled);
+    static bool statisticsEnabled();
+
+    // Последний прочитанный результат запроса для рендерера; false, если
+    // нового результата с прошлого вызова не было
+    bool takeStatistics(QObject *renderer, Statistics *statistics);
+
+private slots:
+    void frameStart();
+    void recordMainPass();
+
+private:
+    explicit VulkanDrawOrder(QQuickWindow *window);
+    ~VulkanDrawOrder();
+
+    void remove(QObject *renderer);
+    bool initDevice();
+    void initStatistics(int framesInFlight);
+    void collectStatistics(int slot);
+    void report();
+
+    struct Entry {
+        QObject *renderer;
+        Stage stage;
+        const char *name;
+        RecordFunction record;
+        Statistics statistics;
+        bool statisticsReady;
+    };
+
+    QQuickWindow *m_window;
+    QList<Entry> m_entries;
+    VulkanJobSystem::Group m_frameJobs;
+    bool m_jobsUsed = false;
+
+    VkDevice m_dev = VK_NULL_HANDLE;
+    QVulkanDeviceFunctions *m_devFuncs = nullptr;
+
+    // Пул запросов: MAX_QUERIES на каждый кадр в полёте
+    VkQueryPool m_queryPool = VK_NULL_HANDLE;
+    bool m_statisticsChecked = false;
+    // Рендереры в порядке запросов слота; удалённые заменяются на nullptr
+    QList<QList<QObject *>> m_slotQueries;
+    QMap<QByteArray, quint64> m_invocations;
+    int m_reportedFrames = 0;
+};
+
+#endif
@@ -0,0 +1,13 @@
+// vulkanembeddedshaders.cpp
+#include "vulkanembeddedshaders.h"
+
+const VulkanEmbeddedShader *VulkanEmbeddedShaders::find(const QString &fileName)
+{
+    const qsizetype slash = fileName.lastIndexOf(QLatin1Char('/'));
+    const QStringView name = QStringView(fileName).mid(slash + 1);
+    for (int i = 0; i < count; ++i) {
+        if (name == QLatin1String(table[i].name))
+            return &table[i];
+    }
+    return nullptr;
+}
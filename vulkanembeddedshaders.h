@@ -0,0 +1,30 @@
+// vulkanembeddedshaders.h
+#ifndef VULKANEMBEDDEDSHADERS_H
+#define VULKANEMBEDDEDSHADERS_H
+
+#include <QString>
+#include <cstddef>
+#include <cstdint>
+
+// SPIR-V, встроенный при сборке (cmake/embed_spirv.cmake). В Release он
+// прогнан через spirv-opt -O и без отладочной информации. Код выровнен и
+// передаётся в vkCreateShaderModule напрямую, без чтения файлов и копий.
+struct VulkanEmbeddedShader
+{
+    const char *name;
+    const uint32_t *code;
+    size_t size;
+};
+
+namespace VulkanEmbeddedShaders
+{
+    // Таблица определена в сгенерированном vulkanembeddedshaders_data.cpp
+    extern const VulkanEmbeddedShader *const table;
+    extern const int count;
+
+    // По пути ресурса (":/cube.vert.spv") или имени файла; nullptr, если
+    // шейдер не встроен
+    const VulkanEmbeddedShader *find(const QString &fileName);
+}
+
+#endif
@@ -0,0 +1,164 @@
+// vulkanframecapture.cpp
+#include "vulkanframecapture.h"
+#include "vulkantrace.h"
+#include <rhi/qrhi.h>
+#include <QDir>
+#include <QImage>
+
+VulkanFrameCapture::VulkanFrameCapture(QQuickWindow *window, const Options &options)
+    : m_window(window),
+      m_options(options)
+{
+    m_options.queueDepth = qMax(1, m_options.queueDepth);
+    m_encoder.setMaxThreadCount(1);
+
+    if (m_options.format == PngSequence) {
+        QDir().mkpath(m_options.path);
+    } else {
+        m_yuvFile.setFileName(m_options.path);
+        if (!m_yuvFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            qWarning("capture: cannot open %s", qPrintable(m_options.path));
+    }
+
+    m_clock.start();
+    connect(window, &QQuickWindow::afterRendering, this, &VulkanFrameCapture::afterRendering, Qt::DirectConnection);
+}
+
+VulkanFrameCapture::~VulkanFrameCapture()
+{
+    m_encoder.waitForDone();
+    if (m_options.format == RawYuv && m_yuvSize.isValid())
+        qDebug("capture: %s is I420 %dx%d", qPrintable(m_options.path), m_yuvSize.width(), m_yuvSize.height());
+    qDebug("capture: %llu frames written, %llu dropped", capturedFrames(), droppedFrames());
+}
+
+void VulkanFrameCapture::afterRendering()
+{
+    // Поток рендеринга; render pass кадра закрыт, командный буфер ещё пишется
+    VKQ_TRACE_SCOPE("VulkanFrameCapture::afterRendering");
+    if (m_options.rate > 0) {
+        const qint64 now = m_clock.nsecsElapsed();
+        if (now < m_nextCapture)
+            return;
+        const qint64 interval = qint64(1e9 / m_options.rate);
+        // После долгого простоя не догоняем пропущенные интервалы
+        m_nextCapture = qMax(m_nextCapture + interval, now);
+    }
+
+    if (m_pending.load(std::memory_order_acquire) >= m_options.queueDepth) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    QRhi *rhi = m_window->rhi();
+    QRhiSwapChain *swapChain = m_window->swapChain();
+    if (!rhi || !swapChain)
+        return;
+
+    m_pending.fetch_add(1, std::memory_order_acq_rel);
+    const quint64 index = m_nextIndex++;
+    // Живёт до completed; QRhi вызывает его на потоке рендеринга, когда
+    // fence слота кадра сигнализирован (в том числе при уничтожении QRhi)
+    QRhiReadbackResult *result = new QRhiReadbackResult;
+    result->completed = [this, result, index] { readbackCompleted(result, index); };
+
+    // Пустое описание - текущий backbuffer swapchain
+    QRhiResourceUpdateBatch *batch = rhi->nextResourceUpdateBatch();
+    batch->readBackTexture(QRhiReadbackDescription(), result);
+    swapChain->currentFrameCommandBuffer()->resourceUpdate(batch);
+}
+
+void VulkanFrameCapture::readbackCompleted(QRhiReadbackResult *result, quint64 index)
+{
+    QImage::Format format = QImage::Format_Invalid;
+    if (result->format == QRhiTexture::RGBA8)
+        format = QImage::Format_RGBX8888;
+    else if (result->format == QRhiTexture::BGRA8)
+        format = QImage::Format_RGB32;
+
+    const QSize size = result->pixelSize;
+    QByteArray data = std::move(result->data);
+    delete result;
+
+    if (format == QImage::Format_Invalid || data.size() < qsizetype(size.width()) * size.height() * 4) {
+        static bool warned = false;
+        if (!warned) {
+            warned = true;
+            qWarning("capture: unsupported swapchain format, frames are dropped");
+        }
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        m_pending.fetch_sub(1, std::memory_order_acq_rel);
+        return;
+    }
+
+    // Данные переходят в задачу без копирования; QImage ссылается на них
+    m_encoder.start([this, data, size, format, index] {
+        const QImage image(reinterpret_cast<const uchar *>(data.constData()), size.width(), size.height(),
+                           size.width() * 4, format);
+        encode(image, index);
+        m_pending.fetch_sub(1, std::memory_order_acq_rel);
+    });
+}
+
+static inline uchar clampByte(int v)
+{
+    return uchar(qBound(0, v, 255));
+}
+
+void VulkanFrameCapture::encode(const QImage &image, quint64 index)
+{
+    VKQ_TRACE_SCOPE("VulkanFrameCapture::encode");
+    if (m_options.format == PngSequence) {
+        const QString fileName = m_options.path + QString::asprintf("/frame_%06llu.png", index);
+        if (!image.save(fileName, "PNG")) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        m_captured.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // I420: размер потока фиксируется первым кадром, кадры другого размера
+    // (после изменения размера окна) пропускаются
+    const QSize size(image.width() & ~1, image.height() & ~1);
+    if (!m_yuvSize.isValid())
+        m_yuvSize = size;
+    if (size != m_yuvSize || !m_yuvFile.isOpen()) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const QImage rgb = image.format() == QImage::Format_RGB32 ? image : image.convertToFormat(QImage::Format_RGB32);
+    const int w = size.width();
+    const int h = size.height();
+    QByteArray frame(w * h * 3 / 2, Qt::Uninitialized);
+    uchar *yPlane = reinterpret_cast<uchar *>(frame.data());
+    uchar *uPlane = yPlane + w * h;
+    uchar *vPlane = uPlane + (w / 2) * (h / 2);
+    for (int y = 0; y < h; ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(rgb.constScanLine(y));
+        for (int x = 0; x < w; ++x) {
+            const QRgb p = line[x];
+            yPlane[y * w + x] = clampByte(((66 * qRed(p) + 129 * qGreen(p) + 25 * qBlue(p) + 128) >> 8) + 16);
+        }
+    }
+    // Цветность - среднее по блоку 2x2
+    for (int y = 0; y < h; y += 2) {
+        const QRgb *l0 = reinterpret_cast<const QRgb *>(rgb.constScanLine(y));
+        const QRgb *l1 = reinterpret_cast<const QRgb *>(rgb.constScanLine(y + 1));
+        for (int x = 0; x < w; x += 2) {
+            const int r = (qRed(l0[x]) + qRed(l0[x + 1]) + qRed(l1[x]) + qRed(l1[x + 1]) + 2) >> 2;
+            const int g = (qGreen(l0[x]) + qGreen(l0[x + 1]) + qGreen(l1[x]) + qGreen(l1[x + 1]) + 2) >> 2;
+            const int b = (qBlue(l0[x]) + qBlue(l0[x + 1]) + qBlue(l1[x]) + qBlue(l1[x + 1]) + 2) >> 2;
+            const int i = (y / 2) * (w / 2) + x / 2;
+            uPlane[i] = clampByte(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            vPlane[i] = clampByte(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+
+    if (m_yuvFile.write(frame) != frame.size()) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_captured.fetch_add(1, std::memory_order_relaxed);
+}
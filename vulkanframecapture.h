@@ -0,0 +1,76 @@
+// vulkanframecapture.h
+#ifndef VULKANFRAMECAPTURE_H
+#define VULKANFRAMECAPTURE_H
+
+#include <QtQuick/QQuickWindow>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThreadPool>
+#include <atomic>
+
+class QRhiReadbackResult;
+
+// Запись вывода окна без остановки рендеринга.
+//
+// QQuickWindow::grabWindow() ждёт GPU (QRhi::finish()) и рвёт время кадра.
+// Здесь после каждого кадра (afterRendering, поток рендеринга) в командный
+// буфер кадра ставится копирование backbuffer в host-visible буфер QRhi.
+// Буфер отслеживается fence слота кадра: результат забирается, когда слот
+// переиспользуется через framesInFlight кадров, поэтому кадр GPU не ждёт.
+// Готовые кадры кодируются в отдельном потоке в последовательность PNG или
+// в сырой YUV (I420, BT.601 limited range).
+//
+// Одновременно в работе (копирование + очередь кодирования) не больше
+// queueDepth кадров; лишние кадры пропускаются и считаются в droppedFrames().
+class VulkanFrameCapture : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Format {
+        PngSequence,
+        RawYuv
+    };
+
+    struct Options {
+        // Каталог для PNG или файл для YUV
+        QString path;
+        Format format = PngSequence;
+        // Кадров в секунду; 0 - каждый отрисованный кадр
+        double rate = 0;
+        int queueDepth = 4;
+    };
+
+    VulkanFrameCapture(QQuickWindow *window, const Options &options);
+    // Дожидается кодирования; окно к этому времени должно быть уничтожено
+    ~VulkanFrameCapture();
+
+    quint64 capturedFrames() const { return m_captured.load(std::memory_order_relaxed); }
+    quint64 droppedFrames() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private slots:
+    void afterRendering();
+
+private:
+    void readbackCompleted(QRhiReadbackResult *result, quint64 index);
+    void encode(const QImage &image, quint64 index);
+
+    QQuickWindow *m_window;
+    Options m_options;
+
+    // Поток рендеринга
+    QElapsedTimer m_clock;
+    qint64 m_nextCapture = 0;
+    quint64 m_nextIndex = 0;
+
+    std::atomic<int> m_pending { 0 };
+    std::atomic<quint64> m_captured { 0 };
+    std::atomic<quint64> m_dropped { 0 };
+
+    // Один поток: кадры кодируются и пишутся по порядку
+    QThreadPool m_encoder;
+    QFile m_yuvFile;
+    QSize m_yuvSize;
+};
+
+#endif
@@ -0,0 +1,79 @@
+// vulkanframetimer.cpp
+#include "vulkanframetimer.h"
+#include "vulkanquickwindow.h"
+
+VulkanFrameTimer::VulkanFrameTimer()
+{
+    connect(this, &QQuickItem::windowChanged, this, &VulkanFrameTimer::handleWindowChanged);
+}
+
+void VulkanFrameTimer::setSampleCount(int count)
+{
+    count = qMax(1, count);
+    if (count == m_sampleCount)
+        return;
+    m_sampleCount = count;
+    emit sampleCountChanged();
+}
+
+void VulkanFrameTimer::setWarmupFrames(int frames)
+{
+    frames = qMax(0, frames);
+    if (frames == m_warmupFrames)
+        return;
+    m_warmupFrames = frames;
+    emit warmupFramesChanged();
+}
+
+void VulkanFrameTimer::restart()
+{
+    m_restartRequested.store(true, std::memory_order_release);
+    if (window())
+        window()->update();
+}
+
+void VulkanFrameTimer::handleWindowChanged(QQuickWindow *win)
+{
+    if (win)
+        connect(win, &QQuickWindow::frameSwapped, this, &VulkanFrameTimer::frameSwapped, Qt::DirectConnection);
+}
+
+void VulkanFrameTimer::frameSwapped()
+{
+    // Вызывается на потоке рендеринга после present
+    if (m_restartRequested.exchange(false, std::memory_order_acq_rel)) {
+        m_measuring = true;
+        m_warmup = m_warmupFrames;
+        m_samples = m_sampleCount;
+        m_frame = 0;
+        m_total = 0;
+        m_max = 0;
+        m_timer.invalidate();
+    }
+
+    if (!m_measuring)
+        return;
+
+    if (m_warmup > 0) {
+        --m_warmup;
+    } else if (!m_timer.isValid()) {
+        m_timer.start();
+    } else {
+        const double ms = m_timer.nsecsElapsed() / 1000000.0;
+        m_timer.start();
+        m_total += ms;
+        m_max = qMax(m_max, ms);
+        if (++m_frame == m_samples) {
+            m_measuring = false;
+            const qreal average = m_total / m_samples;
+            const qreal maximum = m_max;
+            QMetaObject::invokeMethod(this, [this, average, maximum] {
+                m_averageFrameTime = average;
+                emit measured(average, maximum);
+            }, Qt::QueuedConnection);
+            return;
+        }
+    }
+
+    VulkanQuickWindow::requestFrame(window());
+}
@@ -0,0 +1,63 @@
+// vulkanframetimer.h
+#ifndef VULKANFRAMETIMER_H
+#define VULKANFRAMETIMER_H
+
+#include <QtQuick/QQuickItem>
+#include <QtQuick/QQuickWindow>
+#include <QElapsedTimer>
+#include <atomic>
+
+// Измеряет время кадра на потоке рендеринга по сигналу frameSwapped.
+// Пока идёт замер, элемент сам запрашивает следующие кадры, поэтому
+// результат не зависит от анимаций сцены. Итог приходит в GUI-поток
+// сигналом measured(). Используется бенчмарками из benchmarks/.
+class VulkanFrameTimer : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(int sampleCount READ sampleCount WRITE setSampleCount NOTIFY sampleCountChanged)
+    Q_PROPERTY(int warmupFrames READ warmupFrames WRITE setWarmupFrames NOTIFY warmupFramesChanged)
+    Q_PROPERTY(qreal averageFrameTime READ averageFrameTime NOTIFY measured)
+    QML_ELEMENT
+
+public:
+    VulkanFrameTimer();
+
+    int sampleCount() const { return m_sampleCount; }
+    void setSampleCount(int count);
+    int warmupFrames() const { return m_warmupFrames; }
+    void setWarmupFrames(int frames);
+    qreal averageFrameTime() const { return m_averageFrameTime; }
+
+    // Начать новый замер: warmupFrames кадров пропускаются, затем
+    // усредняются sampleCount интервалов между кадрами
+    Q_INVOKABLE void restart();
+
+signals:
+    void sampleCountChanged();
+    void warmupFramesChanged();
+    // Время в миллисекундах
+    void measured(qreal averageFrameTime, qreal maxFrameTime);
+
+private slots:
+    void handleWindowChanged(QQuickWindow *win);
+    void frameSwapped();
+
+private:
+    int m_sampleCount = 300;
+    int m_warmupFrames = 30;
+    qreal m_averageFrameTime = 0;
+
+    // Запрос от GUI-потока; поток рендеринга сбрасывает состояние замера
+    std::atomic<bool> m_restartRequested { false };
+
+    // Состояние ниже принадлежит потоку рендеринга
+    bool m_measuring = false;
+    int m_frame = 0;
+    int m_warmup = 0;
+    int m_samples = 0;
+    double m_total = 0;
+    double m_max = 0;
+    QElapsedTimer m_timer;
+};
+
+#endif
@@ -0,0 +1,172 @@
+// vulkanjobsystem.cpp
+#include "vulkanjobsystem.h"
+
+static int s_defaultWorkerCount = -1;
+
+// Рабочий поток знает свою очередь; у потоков вне пула t_system == nullptr
+static thread_local const VulkanJobSystem *t_system = nullptr;
+static thread_local int t_workerIndex = -1;
+
+void VulkanJobSystem::setDefaultWorkerCount(int count)
+{
+    s_defaultWorkerCount = count;
+}
+
+VulkanJobSystem *VulkanJobSystem::instance()
+{
+    static VulkanJobSystem system(s_defaultWorkerCount >= 0 ? s_defaultWorkerCount
+                                                            : qMax(0, QThread::idealThreadCount() - 1));
+    return &system;
+}
+
+VulkanJobSystem::VulkanJobSystem(int workerCount)
+    : m_queues(new Queue[workerCount + 1]),
+      m_queueCount(workerCount + 1)
+{
+    for (int i = 0; i < workerCount; ++i) {
+        QThread *thread = QThread::create([this, i] { workerLoop(i); });
+        thread->setObjectName(QStringLiteral("VulkanJobSystem %1").arg(i));
+        m_workers.append(thread);
+        thread->start();
+    }
+    qDebug("jobs: %d workers", workerCount);
+}
+
+VulkanJobSystem::~VulkanJobSystem()
+{
+    {
+        QMutexLocker lock(&m_sleepMutex);
+        m_quit = true;
+        m_wake.wakeAll();
+    }
+    for (QThread *thread : std::as_const(m_workers)) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+void VulkanJobSystem::run(Group *group, Job job, Group *after)
+{
+    group->m_pending.fetch_add(1);
+    Task task { std::move(job), group };
+    if (after) {
+        // Последнее задание after уменьшает счётчик под этим мьютексом и
+        // забирает отложенные задания
+        QMutexLocker lock(&after->m_mutex);
+        if (after->m_pending.load(std::memory_order_acquire) > 0) {
+            after->m_continuations.append(std::move(task));
+            return;
+        }
+    }
+    push(std::move(task));
+}
+
+void VulkanJobSystem::wait(Group *group)
+{
+    const int self = t_system == this ? t_workerIndex : -1;
+    while (!group->isDone()) {
+        Task task;
+        if (pop(self, &task))
+            execute(task);
+        else
+            QThread::yieldCurrentThread();
+    }
+    // Завершившее группу задание могло ещё не отпустить её мьютекс
+    QMutexLocker lock(&group->m_mutex);
+}
+
+void VulkanJobSystem::push(Task task)
+{
+    Queue &queue(m_queues[t_system == this ? t_workerIndex : m_queueCount - 1]);
+    {
+        QMutexLocker lock(&queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    // Пара с workerLoop(): либо поток увидит задание, либо мы - спящий поток
+    m_queued.fetch_add(1);
+    if (m_sleeping.load() > 0) {
+        QMutexLocker lock(&m_sleepMutex);
+        m_wake.wakeOne();
+    }
+}
+
+bool VulkanJobSystem::pop(int self, Task *task)
+{
+    if (m_queued.load(std::memory_order_relaxed) == 0)
+        return false;
+
+    // Своя очередь - с конца
+    Queue &own(m_queues[self >= 0 ? self : m_queueCount - 1]);
+    {
+        QMutexLocker lock(&own.mutex);
+        if (!own.tasks.empty()) {
+            *task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            m_queued.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // Чужие - с начала; обход с разных мест, чтобы воры не толпились у одной
+    const unsigned start = m_nextSteal.fetch_add(1, std::memory_order_relaxed);
+    for (int i = 0; i < m_queueCount; ++i) {
+        Queue &victim(m_queues[(start + unsigned(i)) % unsigned(m_queueCount)]);
+        if (&victim == &own)
+            continue;
+        QMutexLocker lock(&victim.mutex);
+        if (!victim.tasks.empty()) {
+            *task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            m_queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void VulkanJobSystem::execute(Task &task)
+{
+    task.job();
+    finish(task.group);
+}
+
+void VulkanJobSystem::finish(Group *group)
+{
+    // Не последнее задание - без мьютекса
+    int pending = group->m_pending.load(std::memory_order_relaxed);
+    while (pending > 1) {
+        if (group->m_pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel,
+                                                   std::memory_order_relaxed))
+            return;
+    }
+
+    // После разблокировки группа может быть уже уничтожена ждущим потоком
+    QList<Task> continuations;
+    {
+        QMutexLocker lock(&group->m_mutex);
+        if (group->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            continuations.swap(group->m_continuations);
+    }
+    for (Task &task : continuations)
+        push(std::move(task));
+}
+
+void VulkanJobSystem::workerLoop(int index)
+{
+    t_system = this;
+    t_workerIndex = index;
+    for (;;) {
+        Task task;
+        if (pop(index, &task)) {
+            execute(task);
+            continue;
+        }
+        QMutexLocker lock(&m_sleepMutex);
+        if (m_quit)
+            return;
+        m_sleeping.fetch_add(1);
+        if (m_queued.load() == 0)
+            m_wake.wait(&m_sleepMutex);
+        m_sleeping.fetch_sub(1);
+    }
+}
@@ -0,0 +1,123 @@
+// vulkanjobsystem.h
+#ifndef VULKANJOBSYSTEM_H
+#define VULKANJOBSYSTEM_H
+
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+
+// Пул потоков для подготовки кадра на CPU: fork/join с перехватом заданий.
+//
+// У каждого рабочего потока своя очередь: свои задания он берёт с конца
+// (последнее добавленное, данные ещё в кэше), а без своих забирает самые
+// старые из чужих очередей. Задания потоков вне пула (потоков рендеринга
+// окон) идут в общую очередь. Поток, ждущий группу в wait(), сам выполняет
+// задания, поэтому рабочих потоков на один меньше, чем ядер, а при нуле
+// рабочих всё выполняется последовательно в wait().
+//
+// Group - счётчик незавершённых заданий. Задание с after запускается,
+// только когда завершены все задания группы after. Рендереры запускают
+// задания кадра в группе VulkanDrawOrder::frameJobs() из beforeRendering:
+// VulkanDrawOrder дожидается её перед записью основного прохода.
+//
+// Задания короткие (доли миллисекунды), поэтому wait() не спит, а уступает
+// процессор, пока чужие задания группы не завершатся.
+class VulkanJobSystem
+{
+public:
+    using Job = std::function<void()>;
+    class Group;
+
+private:
+    struct Task {
+        Job job;
+        Group *group;
+    };
+
+public:
+    class Group
+    {
+    public:
+        Group() = default;
+        ~Group() { Q_ASSERT(isDone()); }
+        bool isDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend class VulkanJobSystem;
+        Q_DISABLE_COPY(Group)
+
+        std::atomic<int> m_pending { 0 };
+        // Последнее задание группы завершается под мьютексом, задания с
+        // after = эта группа ждут здесь
+        QMutex m_mutex;
+        QList<Task> m_continuations;
+    };
+
+    // Общий пул; размер задаётся до первого вызова, по умолчанию - ядер - 1
+    static VulkanJobSystem *instance();
+    static void setDefaultWorkerCount(int count);
+
+    explicit VulkanJobSystem(int workerCount);
+    ~VulkanJobSystem();
+
+    int workerCount() const { return int(m_workers.size()); }
+
+    void run(Group *group, Job job, Group *after = nullptr);
+    // Join: выполняет задания, пока в группе есть незавершённые; после
+    // возврата группу можно уничтожить
+    void wait(Group *group);
+
+    // [0, count) делится на части по grain элементов, f(begin, end) - задание
+    // на часть. fork() не ждёт, parallelFor() ждёт; если часть одна, она
+    // выполняется сразу в вызывающем потоке.
+    template<typename F>
+    void fork(Group *group, int count, int grain, F f)
+    {
+        if (count <= grain) {
+            if (count > 0)
+                f(0, count);
+            return;
+        }
+        for (int begin = 0; begin < count; begin += grain) {
+            const int end = qMin(count, begin + grain);
+            run(group, [f, begin, end] { f(begin, end); });
+        }
+    }
+    template<typename F>
+    void parallelFor(int count, int grain, F f)
+    {
+        Group group;
+        fork(&group, count, grain, f);
+        wait(&group);
+    }
+
+private:
+    struct Queue {
+        QMutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void push(Task task);
+    bool pop(int self, Task *task);
+    void execute(Task &task);
+    void finish(Group *group);
+    void workerLoop(int index);
+
+    // Очереди рабочих потоков, последняя - для потоков вне пула
+    std::unique_ptr<Queue[]> m_queues;
+    int m_queueCount = 0;
+    QList<QThread *> m_workers;
+    std::atomic<int> m_queued { 0 };
+    std::atomic<int> m_sleeping { 0 };
+    std::atomic<unsigned> m_nextSteal { 0 };
+    QMutex m_sleepMutex;
+    QWaitCondition m_wake;
+    bool m_quit = false;
+};
+
+#endif
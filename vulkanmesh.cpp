@@ -0,0 +1,788 @@
+// vulkanmesh.cpp
+#include "vulkanmesh.h"
+#include "vulkanassetcache.h"
+#include "vulkandraworder.h"
+#include "vulkanpipelinecache.h"
+#include "vulkantrace.h"
+#include "vulkanutils.h"
+#include <QtCore/QRunnable>
+#include <QtQuick/QQuickWindow>
+#include <utility>
+
+#include <QVulkanInstance>
+#include <QVulkanFunctions>
+
+// Данные для следующего рендерера элемента. Уничтожаемый рендерер
+// сохраняет сюда содержимое своих буферов, новый забирает его как полную
+// замену. Пишется и читается при заблокированном GUI-потоке (sync(),
+// задания BeforeSynchronizingStage, sceneGraphInvalidated).
+struct MeshData
+{
+    QByteArray vertices;
+    QByteArray indices;
+};
+
+// Буферы потока данных (вершины или индексы), по одному на кадр в полёте.
+// Обновления пишутся прямо в буфер текущего слота, он становится latest.
+// Остальные слоты помнят диапазон, изменённый с их последней записи, и
+// догоняют его из буфера latest, когда снова становятся текущими.
+struct MeshStream
+{
+    struct Slot {
+        VkBuffer buf = VK_NULL_HANDLE;
+        VkDeviceMemory mem = VK_NULL_HANDLE;
+        char *ptr = nullptr;
+        VkDeviceSize capacity = 0;
+        qsizetype dirtyBegin = 0;
+        qsizetype dirtyEnd = 0;
+    };
+
+    Slot frames[3];
+    // Слот с актуальными данными, -1 до первой записи
+    int latest = -1;
+    // Размер актуальных данных
+    qsizetype size = 0;
+    // Обновления, переданные в sync() и ещё не записанные в буфер
+    QList<VulkanMeshUpdate> pending;
+};
+
+struct MeshParams
+{
+    VulkanMesh::Primitive primitive = VulkanMesh::Points;
+    int vertexStride = 12;
+    int colorOffset = -1;
+    QMatrix4x4 matrix;
+    QColor color;
+    float pointSize = 1;
+};
+
+class MeshRenderer : public QObject
+{
+    Q_OBJECT
+public:
+    ~MeshRenderer();
+
+    void setParams(const MeshParams &params) { m_params = params; }
+    void setData(const QSharedPointer<MeshData> &data);
+    void addUpdates(QList<VulkanMeshUpdate> &vertexUpdates, QList<VulkanMeshUpdate> &indexUpdates);
+    void setViewportRect(const QRect &rect) { m_viewportRect = rect; }
+    void setWindow(QQuickWindow *window) { m_window = window; }
+
+    void mainPassRecordingStart(VkCommandBuffer cb);
+
+public slots:
+    void frameStart();
+
+private:
+    void init(int framesInFlight);
+    static void addUpdates(MeshStream &stream, QList<VulkanMeshUpdate> &updates);
+    void refreshSlot(MeshStream &stream, int slot, VkBufferUsageFlags usage, const char *what);
+    static QByteArray snapshot(MeshStream &stream);
+    void destroyStream(MeshStream &stream);
+    VkPipeline pipeline();
+
+    MeshParams m_params;
+    QRect m_viewportRect;
+    QQuickWindow *m_window = nullptr;
+    int m_framesInFlight = 0;
+
+    bool m_initialized = false;
+    VkPhysicalDevice m_physDev = VK_NULL_HANDLE;
+    VkDevice m_dev = VK_NULL_HANDLE;
+    QVulkanDeviceFunctions *m_devFuncs = nullptr;
+    QVulkanFunctions *m_funcs = nullptr;
+    VkPhysicalDeviceMemoryProperties m_memProps;
+    VkRenderPass m_renderPass = VK_NULL_HANDLE;
+
+    QSharedPointer<MeshData> m_data;
+    MeshStream m_vertices;
+    MeshStream m_indices;
+
+    VkBuffer m_ubuf = VK_NULL_HANDLE;
+    VkDeviceMemory m_ubufMem = VK_NULL_HANDLE;
+    VkDeviceSize m_allocPerUbuf = 0;
+    char *m_ubufPtr = nullptr;
+
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_resLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+    // Пайплайны по (примитив, шаг, смещение цвета): эти параметры
+    // входят в состояние пайплайна
+    QHash<quint64, VkPipeline> m_pipelines;
+};
+
+// mat4 + 2 vec4, см. блок Params в mesh.vert
+const int MESH_UBUF_SIZE = 16 * sizeof(float) + 2 * 4 * sizeof(float);
+// Минимальная ёмкость буфера кадра, дальше рост до степени двойки
+const VkDeviceSize MESH_MIN_CAPACITY = 4096;
+
+// Цвет вершины должен целиком помещаться в шаг, иначе он не используется
+static int effectiveColorOffset(const MeshParams &params)
+{
+    return params.colorOffset >= 0 && params.colorOffset + 4 <= params.vertexStride ? params.colorOffset : -1;
+}
+
+VulkanMesh::VulkanMesh()
+    : m_data(new MeshData)
+{
+    connect(this, &QQuickItem::windowChanged, this, &VulkanMesh::handleWindowChanged);
+}
+
+void VulkanMesh::changed()
+{
+    if (window())
+        window()->update();
+}
+
+void VulkanMesh::setPrimitive(Primitive primitive)
+{
+    if (primitive == m_primitive)
+        return;
+    m_primitive = primitive;
+    emit primitiveChanged();
+    changed();
+}
+
+void VulkanMesh::setVertexStride(int stride)
+{
+    stride = qMax(12, stride);
+    if (stride == m_vertexStride)
+        return;
+    m_vertexStride = stride;
+    emit vertexStrideChanged();
+    changed();
+}
+
+void VulkanMesh::setColorOffset(int offset)
+{
+    if (offset == m_colorOffset)
+        return;
+    m_colorOffset = offset;
+    emit colorOffsetChanged();
+    changed();
+}
+
+void VulkanMesh::setMatrix(const QMatrix4x4 &matrix)
+{
+    if (matrix == m_matrix)
+        return;
+    m_matrix = matrix;
+    emit matrixChanged();
+    changed();
+}
+
+void VulkanMesh::setColor(const QColor &color)
+{
+    if (color == m_color)
+        return;
+    m_color = color;
+    emit colorChanged();
+    changed();
+}
+
+void VulkanMesh::setPointSize(qreal size)
+{
+    if (size == m_pointSize)
+        return;
+    m_pointSize = size;
+    emit pointSizeChanged();
+    changed();
+}
+
+void VulkanMesh::setVertexData(const QByteArray &data)
+{
+    // Полная замена делает ненужными ещё не переданные обновления
+    m_vertexUpdates.clear();
+    m_vertexUpdates.append({ -1, data });
+    m_vertexSize = data.size();
+    changed();
+}
+
+void VulkanMesh::setIndexData(const QByteArray &data)
+{
+    m_indexUpdates.clear();
+    m_indexUpdates.append({ -1, data });
+    m_indexSize = data.size();
+    changed();
+}
+
+bool VulkanMesh::updateVertexData(qsizetype offset, const QByteArray &data)
+{
+    if (offset < 0 || offset + data.size() > m_vertexSize) {
+        qWarning("VulkanMesh: vertex update [%lld, %lld) is out of range (%lld bytes)",
+                 qint64(offset), qint64(offset + data.size()), qint64(m_vertexSize));
+        return false;
+    }
+    m_vertexUpdates.append({ offset, data });
+    changed();
+    return true;
+}
+
+bool VulkanMesh::updateIndexData(qsizetype offset, const QByteArray &data)
+{
+    if (offset < 0 || offset + data.size() > m_indexSize) {
+        qWarning("VulkanMesh: index update [%lld, %lld) is out of range (%lld bytes)",
+                 qint64(offset), qint64(offset + data.size()), qint64(m_indexSize));
+        return false;
+    }
+    m_indexUpdates.append({ offset, data });
+    changed();
+    return true;
+}
+
+void VulkanMesh::handleWindowChanged(QQuickWindow *win)
+{
+    if (win) {
+        connect(win, &QQuickWindow::beforeSynchronizing, this, &VulkanMesh::sync, Qt::DirectConnection);
+        connect(win, &QQuickWindow::sceneGraphInvalidated, this, &VulkanMesh::cleanup, Qt::DirectConnection);
+    }
+}
+
+void VulkanMesh::cleanup()
+{
+    delete m_renderer;
+    m_renderer = nullptr;
+}
+
+class MeshCleanupJob : public QRunnable
+{
+public:
+    MeshCleanupJob(MeshRenderer *renderer) : m_renderer(renderer) { }
+    void run() override { delete m_renderer; }
+private:
+    MeshRenderer *m_renderer;
+};
+
+void VulkanMesh::releaseResources()
+{
+    window()->scheduleRenderJob(new MeshCleanupJob(m_renderer), QQuickWindow::BeforeSynchronizingStage);
+    m_renderer = nullptr;
+}
+
+void VulkanMesh::sync()
+{
+    VKQ_TRACE_SCOPE("VulkanMesh::sync");
+    if (!m_renderer) {
+        // Новый рендерер после пересоздания графа сцены заполнит свои
+        // буферы из данных, сохранённых прежним
+        m_renderer = new MeshRenderer;
+        m_renderer->setData(m_data);
+        connect(window(), &QQuickWindow::beforeRendering, m_renderer, &MeshRenderer::frameStart, Qt::DirectConnection);
+        MeshRenderer *renderer = m_renderer;
+        VulkanDrawOrder::forWindow(window())->add(renderer, VulkanDrawOrder::TransparentStage, "VulkanMesh",
+                                                  [renderer](VkCommandBuffer cb) { renderer->mainPassRecordingStart(cb); });
+    }
+
+    MeshParams params;
+    params.primitive = m_primitive;
+    params.vertexStride = m_vertexStride;
+    params.colorOffset = m_colorOffset;
+    params.matrix = m_matrix;
+    params.color = m_color;
+    params.pointSize = m_pointSize;
+    m_renderer->setParams(params);
+
+    // Обновления уходят рендереру без копирования, в буфер кадра они
+    // пишутся в frameStart()
+    m_renderer->addUpdates(m_vertexUpdates, m_indexUpdates);
+
+    const qreal dpr = window()->effectiveDevicePixelRatio();
+    const QRectF sceneRect = mapRectToScene(boundingRect());
+    const QRect windowRect(QPoint(0, 0), window()->size() * dpr);
+    const QRect viewportRect = QRectF(sceneRect.topLeft() * dpr, sceneRect.size() * dpr)
+            .toAlignedRect().intersected(windowRect);
+    m_renderer->setViewportRect(viewportRect);
+    m_renderer->setWindow(window());
+    m_pipelineStatistics->sync(window(), m_renderer, qreal(viewportRect.width()) * viewportRect.height());
+}
+
+MeshRenderer::~MeshRenderer()
+{
+    qDebug("mesh cleanup");
+    if (m_window)
+        VulkanDrawOrder::unregister(m_window, this);
+    if (!m_devFuncs) {
+        m_data->vertices = snapshot(m_vertices);
+        m_data->indices = snapshot(m_indices);
+        return;
+    }
+
+    for (VkPipeline pipeline : std::as_const(m_pipelines))
+        m_devFuncs->vkDestroyPipeline(m_dev, pipeline, nullptr);
+    m_devFuncs->vkDestroyPipelineLayout(m_dev, m_pipelineLayout, nullptr);
+    m_devFuncs->vkDestroyDescriptorSetLayout(m_dev, m_resLayout, nullptr);
+    m_devFuncs->vkDestroyDescriptorPool(m_dev, m_descriptorPool, nullptr);
+    if (m_pipelineCache)
+        VulkanPipelineCache::release(m_dev);
+
+    // Следующему рендереру элемента
+    m_data->vertices = snapshot(m_vertices);
+    m_data->indices = snapshot(m_indices);
+    destroyStream(m_vertices);
+    destroyStream(m_indices);
+
+    if (m_ubufPtr)
+        m_devFuncs->vkUnmapMemory(m_dev, m_ubufMem);
+    VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &m_ubuf, &m_ubufMem);
+
+    qDebug("mesh released");
+}
+
+void MeshRenderer::destroyStream(MeshStream &stream)
+{
+    for (MeshStream::Slot &slot : stream.frames) {
+        if (slot.ptr)
+            m_devFuncs->vkUnmapMemory(m_dev, slot.mem);
+        VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &slot.buf, &slot.mem);
+        slot = MeshStream::Slot();
+    }
+}
+
+void MeshRenderer::setData(const QSharedPointer<MeshData> &data)
+{
+    m_data = data;
+    // Данные прежнего рендерера - полная замена, без копирования
+    if (!m_data->vertices.isEmpty())
+        m_vertices.pending.append({ -1, std::exchange(m_data->vertices, QByteArray()) });
+    if (!m_data->indices.isEmpty())
+        m_indices.pending.append({ -1, std::exchange(m_data->indices, QByteArray()) });
+}
+
+void MeshRenderer::addUpdates(QList<VulkanMeshUpdate> &vertexUpdates, QList<VulkanMeshUpdate> &indexUpdates)
+{
+    addUpdates(m_vertices, vertexUpdates);
+    addUpdates(m_indices, indexUpdates);
+}
+
+void MeshRenderer::addUpdates(MeshStream &stream, QList<VulkanMeshUpdate> &updates)
+{
+    for (VulkanMeshUpdate &u : updates) {
+        // Полная замена делает ненужными ещё не записанные обновления
+        if (u.offset < 0)
+            stream.pending.clear();
+        stream.pending.append(std::move(u));
+    }
+    updates.clear();
+}
+
+void MeshRenderer::refreshSlot(MeshStream &stream, int slotIndex, VkBufferUsageFlags usage, const char *what)
+{
+    MeshStream::Slot &slot(stream.frames[slotIndex]);
+    qsizetype size = stream.size;
+    bool replaced = false;
+    for (const VulkanMeshUpdate &u : std::as_const(stream.pending)) {
+        if (u.offset < 0) {
+            size = u.data.size();
+            replaced = true;
+        }
+    }
+    if (size == 0) {
+        stream.size = 0;
+        stream.pending.clear();
+        return;
+    }
+
+    // Кадр, который раньше использовал этот слот, завершён: буфер можно
+    // перезаписывать и, если мал, пересоздавать. Новый буфер пуст и
+    // догоняет latest целиком. Память с HOST_CACHED, если есть: из буфера
+    // latest читают при догоне, а из write-combined памяти чтение медленное.
+    if (VkDeviceSize(size) > slot.capacity) {
+        if (slot.ptr)
+            m_devFuncs->vkUnmapMemory(m_dev, slot.mem);
+        VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &slot.buf, &slot.mem);
+        slot.capacity = qMax(MESH_MIN_CAPACITY, VkDeviceSize(qNextPowerOfTwo(quint64(size))));
+        VulkanUtils::createBuffer(m_devFuncs, m_dev, m_memProps, slot.capacity, usage,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                  &slot.buf, &slot.mem, what, VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+        void *p = nullptr;
+        VkResult err = m_devFuncs->vkMapMemory(m_dev, slot.mem, 0, VK_WHOLE_SIZE, 0, &p);
+        if (err != VK_SUCCESS || !p)
+            qFatal("Failed to map %s memory: %d", what, err);
+        slot.ptr = static_cast<char *>(p);
+        slot.dirtyBegin = 0;
+        slot.dirtyEnd = stream.size;
+    }
+
+    // Догон из latest: один memcpy на слот за кадр, сколько бы обновлений
+    // ни попало в другие слоты. После полной замены догонять нечего.
+    if (!replaced && stream.latest >= 0 && stream.latest != slotIndex) {
+        const qsizetype end = qMin(slot.dirtyEnd, stream.size);
+        if (slot.dirtyBegin < end)
+            memcpy(slot.ptr + slot.dirtyBegin, stream.frames[stream.latest].ptr + slot.dirtyBegin,
+                   size_t(end - slot.dirtyBegin));
+    }
+    slot.dirtyBegin = 0;
+    slot.dirtyEnd = 0;
+
+    // Обновления - единственная копия данных производителя
+    qsizetype begin = 0;
+    qsizetype end = 0;
+    for (const VulkanMeshUpdate &u : std::as_const(stream.pending)) {
+        const qsizetype offset = qMax(u.offset, qsizetype(0));
+        if (u.data.isEmpty())
+            continue;
+        memcpy(slot.ptr + offset, u.data.constData(), size_t(u.data.size()));
+        begin = begin < end ? qMin(begin, offset) : offset;
+        end = qMax(end, offset + u.data.size());
+    }
+    stream.pending.clear();
+    stream.size = size;
+    stream.latest = slotIndex;
+
+    if (begin >= end)
+        return;
+    for (int i = 0; i < m_framesInFlight; ++i) {
+        if (i == slotIndex)
+            continue;
+        MeshStream::Slot &other(stream.frames[i]);
+        if (other.dirtyBegin >= other.dirtyEnd) {
+            other.dirtyBegin = begin;
+            other.dirtyEnd = end;
+        } else {
+            other.dirtyBegin = qMin(other.dirtyBegin, begin);
+            other.dirtyEnd = qMax(other.dirtyEnd, end);
+        }
+    }
+}
+
+// Содержимое потока с ещё не записанными обновлениями; вызывается
+// только при уничтожении рендерера
+QByteArray MeshRenderer::snapshot(MeshStream &stream)
+{
+    QByteArray data;
+    if (stream.latest >= 0)
+        data = QByteArray(stream.frames[stream.latest].ptr, stream.size);
+    for (VulkanMeshUpdate &u : stream.pending) {
+        if (u.offset < 0)
+            data = std::move(u.data);
+        else if (!u.data.isEmpty() && u.offset + u.data.size() <= data.size())
+            memcpy(data.data() + u.offset, u.data.constData(), size_t(u.data.size()));
+    }
+    stream.pending.clear();
+    return data;
+}
+
+void MeshRenderer::frameStart()
+{
+    VKQ_TRACE_SCOPE("MeshRenderer::frameStart");
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    Q_ASSERT(rif->graphicsApi() == QSGRendererInterface::Vulkan);
+
+    const QQuickWindow::GraphicsStateInfo &stateInfo(m_window->graphicsStateInfo());
+    if (!m_initialized)
+        init(stateInfo.framesInFlight);
+
+    // Только запись в отображённую память, команды не нужны
+    const int slot = stateInfo.currentFrameSlot;
+    refreshSlot(m_vertices, slot, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, "mesh vertex buffer");
+    refreshSlot(m_indices, slot, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, "mesh index buffer");
+
+    float *data = reinterpret_cast<float *>(m_ubufPtr + slot * m_allocPerUbuf);
+    memcpy(data, m_params.matrix.constData(), 16 * sizeof(float));
+    data[16] = m_params.color.redF();
+    data[17] = m_params.color.greenF();
+    data[18] = m_params.color.blueF();
+    data[19] = m_params.color.alphaF();
+    data[20] = m_params.pointSize;
+    data[21] = effectiveColorOffset(m_params) >= 0 ? 1.0f : 0.0f;
+    data[22] = 0.0f;
+    data[23] = 0.0f;
+}
+
+void MeshRenderer::mainPassRecordingStart(VkCommandBuffer cb)
+{
+    VKQ_TRACE_SCOPE("MeshRenderer::mainPassRecordingStart");
+    if (!m_initialized || m_viewportRect.isEmpty())
+        return;
+
+    const QQuickWindow::GraphicsStateInfo &stateInfo(m_window->graphicsStateInfo());
+    const int slot = stateInfo.currentFrameSlot;
+    const MeshStream::Slot &vslot(m_vertices.frames[slot]);
+    const uint32_t vertexCount = uint32_t(m_vertices.size / m_params.vertexStride);
+    if (!vslot.buf || vertexCount == 0)
+        return;
+
+    VkPipeline pipeline = this->pipeline();
+    if (!pipeline)
+        return;
+
+    VKQ_TRACE_GPU_BEGIN(cb, "VulkanMesh");
+
+    m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+    VkDeviceSize vbufOffset = 0;
+    m_devFuncs->vkCmdBindVertexBuffers(cb, 0, 1, &vslot.buf, &vbufOffset);
+
+    uint32_t dynamicOffset = m_allocPerUbuf * slot;
+    m_devFuncs->vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1,
+                                        &m_descriptorSet, 1, &dynamicOffset);
+
+    VkViewport vp = { float(m_viewportRect.x()), float(m_viewportRect.y()),
+                      float(m_viewportRect.width()), float(m_viewportRect.height()), 0.0f, 1.0f };
+    m_devFuncs->vkCmdSetViewport(cb, 0, 1, &vp);
+    VkRect2D scissor = { { m_viewportRect.x(), m_viewportRect.y() },
+                         { uint32_t(m_viewportRect.width()), uint32_t(m_viewportRect.height()) } };
+    m_devFuncs->vkCmdSetScissor(cb, 0, 1, &scissor);
+
+    const MeshStream::Slot &islot(m_indices.frames[slot]);
+    const uint32_t indexCount = uint32_t(m_indices.size / sizeof(quint32));
+    if (islot.buf && indexCount) {
+        m_devFuncs->vkCmdBindIndexBuffer(cb, islot.buf, 0, VK_INDEX_TYPE_UINT32);
+        m_devFuncs->vkCmdDrawIndexed(cb, indexCount, 1, 0, 0, 0);
+    } else {
+        m_devFuncs->vkCmdDraw(cb, vertexCount, 1, 0, 0);
+    }
+
+    VKQ_TRACE_GPU_END(cb);
+}
+
+void MeshRenderer::init(int framesInFlight)
+{
+    VKQ_TRACE_SCOPE("MeshRenderer::init");
+    Q_ASSERT(framesInFlight <= 3);
+    m_initialized = true;
+    m_framesInFlight = framesInFlight;
+
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    QVulkanInstance *inst = reinterpret_cast<QVulkanInstance *>(
+        rif->getResource(m_window, QSGRendererInterface::VulkanInstanceResource));
+    Q_ASSERT(inst && inst->isValid());
+
+    m_physDev = *reinterpret_cast<VkPhysicalDevice *>(rif->getResource(m_window, QSGRendererInterface::PhysicalDeviceResource));
+    m_dev = *reinterpret_cast<VkDevice *>(rif->getResource(m_window, QSGRendererInterface::DeviceResource));
+    Q_ASSERT(m_physDev && m_dev);
+
+    m_devFuncs = inst->deviceFunctions(m_dev);
+    m_funcs = inst->functions();
+    Q_ASSERT(m_devFuncs && m_funcs);
+
+    m_renderPass = *reinterpret_cast<VkRenderPass *>(
+        rif->getResource(m_window, QSGRendererInterface::RenderPassResource));
+    Q_ASSERT(m_renderPass);
+
+    VkPhysicalDeviceProperties physDevProps;
+    m_funcs->vkGetPhysicalDeviceProperties(m_physDev, &physDevProps);
+    m_funcs->vkGetPhysicalDeviceMemoryProperties(m_physDev, &m_memProps);
+
+    m_allocPerUbuf = VulkanUtils::aligned(MESH_UBUF_SIZE, physDevProps.limits.minUniformBufferOffsetAlignment);
+    VulkanUtils::createBuffer(m_devFuncs, m_dev, m_memProps, m_allocPerUbuf * framesInFlight,
+                              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              &m_ubuf, &m_ubufMem, "mesh uniform buffer");
+    void *p = nullptr;
+    VkResult err = m_devFuncs->vkMapMemory(m_dev, m_ubufMem, 0, VK_WHOLE_SIZE, 0, &p);
+    if (err != VK_SUCCESS || !p)
+        qFatal("Failed to map mesh uniform buffer memory: %d", err);
+    m_ubufPtr = static_cast<char *>(p);
+
+    VkDescriptorSetLayoutBinding layoutBinding;
+    memset(&layoutBinding, 0, sizeof(layoutBinding));
+    layoutBinding.binding = 0;
+    layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    layoutBinding.descriptorCount = 1;
+    layoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo descLayoutInfo;
+    memset(&descLayoutInfo, 0, sizeof(descLayoutInfo));
+    descLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descLayoutInfo.bindingCount = 1;
+    descLayoutInfo.pBindings = &layoutBinding;
+    err = m_devFuncs->vkCreateDescriptorSetLayout(m_dev, &descLayoutInfo, nullptr, &m_resLayout);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create descriptor set layout: %d", err);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo;
+    memset(&pipelineLayoutInfo, 0, sizeof(pipelineLayoutInfo));
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_resLayout;
+    err = m_devFuncs->vkCreatePipelineLayout(m_dev, &pipelineLayoutInfo, nullptr, &m_pipelineLayout);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create pipeline layout: %d", err);
+
+    VkDescriptorPoolSize descPoolSize = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 };
+    VkDescriptorPoolCreateInfo descPoolInfo;
+    memset(&descPoolInfo, 0, sizeof(descPoolInfo));
+    descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descPoolInfo.maxSets = 1;
+    descPoolInfo.poolSizeCount = 1;
+    descPoolInfo.pPoolSizes = &descPoolSize;
+    err = m_devFuncs->vkCreateDescriptorPool(m_dev, &descPoolInfo, nullptr, &m_descriptorPool);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create descriptor pool: %d", err);
+
+    VkDescriptorSetAllocateInfo descSetAllocInfo;
+    memset(&descSetAllocInfo, 0, sizeof(descSetAllocInfo));
+    descSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descSetAllocInfo.descriptorPool = m_descriptorPool;
+    descSetAllocInfo.descriptorSetCount = 1;
+    descSetAllocInfo.pSetLayouts = &m_resLayout;
+    err = m_devFuncs->vkAllocateDescriptorSets(m_dev, &descSetAllocInfo, &m_descriptorSet);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to allocate descriptor set: %d", err);
+
+    VkDescriptorBufferInfo bufInfo;
+    bufInfo.buffer = m_ubuf;
+    bufInfo.offset = 0;
+    bufInfo.range = MESH_UBUF_SIZE;
+    VkWriteDescriptorSet writeInfo;
+    memset(&writeInfo, 0, sizeof(writeInfo));
+    writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeInfo.dstSet = m_descriptorSet;
+    writeInfo.dstBinding = 0;
+    writeInfo.descriptorCount = 1;
+    writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    writeInfo.pBufferInfo = &bufInfo;
+    m_devFuncs->vkUpdateDescriptorSets(m_dev, 1, &writeInfo, 0, nullptr);
+
+    // Общий кэш устройства, сохраняемый между запусками
+    m_pipelineCache = VulkanPipelineCache::acquire(m_window);
+
+    qDebug("mesh initialized");
+}
+
+VkPipeline MeshRenderer::pipeline()
+{
+    const int colorOffset = effectiveColorOffset(m_params);
+    const quint64 key = quint64(m_params.primitive)
+            | (quint64(m_params.vertexStride) << 8)
+            | (quint64(colorOffset + 1) << 32);
+    VkPipeline &pipeline(m_pipelines[key]);
+    if (pipeline)
+        return pipeline;
+
+    VulkanAssetCache *cache = VulkanAssetCache::instance();
+    const QByteArray vert = cache->shader(QStringLiteral(":/mesh.vert.spv"));
+    const QByteArray frag = cache->shader(QStringLiteral(":/mesh.frag.spv"));
+    if (vert.isEmpty() || frag.isEmpty())
+        qFatal("Failed to read mesh shaders");
+
+    VkShaderModule vertModule = VulkanUtils::createShaderModule(m_devFuncs, m_dev, vert);
+    VkShaderModule fragModule = VulkanUtils::createShaderModule(m_devFuncs, m_dev, frag);
+
+    VkGraphicsPipelineCreateInfo pipelineInfo;
+    memset(&pipelineInfo, 0, sizeof(pipelineInfo));
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+
+    VkPipelineShaderStageCreateInfo shaderStages[2];
+    memset(shaderStages, 0, sizeof(shaderStages));
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragModule;
+    shaderStages[1].pName = "main";
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+
+    VkVertexInputBindingDescription vertexBindingDesc;
+    vertexBindingDesc.binding = 0;
+    vertexBindingDesc.stride = uint32_t(m_params.vertexStride);
+    vertexBindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    // Без цвета в вершине атрибут 1 читает байты позиции, шейдер
+    // его не использует (params.y == 0)
+    VkVertexInputAttributeDescription vertexAttrDesc[2];
+    vertexAttrDesc[0].location = 0;
+    vertexAttrDesc[0].binding = 0;
+    vertexAttrDesc[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    vertexAttrDesc[0].offset = 0;
+    vertexAttrDesc[1].location = 1;
+    vertexAttrDesc[1].binding = 0;
+    vertexAttrDesc[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+    vertexAttrDesc[1].offset = uint32_t(qMax(0, colorOffset));
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo;
+    memset(&vertexInputInfo, 0, sizeof(vertexInputInfo));
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &vertexBindingDesc;
+    vertexInputInfo.vertexAttributeDescriptionCount = 2;
+    vertexInputInfo.pVertexAttributeDescriptions = vertexAttrDesc;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+
+    static const VkPrimitiveTopology topologies[] = {
+        VK_PRIMITIVE_TOPOLOGY_POINT_LIST,
+        VK_PRIMITIVE_TOPOLOGY_LINE_LIST,
+        VK_PRIMITIVE_TOPOLOGY_LINE_STRIP,
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP
+    };
+    VkPipelineInputAssemblyStateCreateInfo ia;
+    memset(&ia, 0, sizeof(ia));
+    ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    ia.topology = topologies[m_params.primitive];
+    pipelineInfo.pInputAssemblyState = &ia;
+
+    VkPipelineViewportStateCreateInfo vp;
+    memset(&vp, 0, sizeof(vp));
+    vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    vp.viewportCount = 1;
+    vp.scissorCount = 1;
+    pipelineInfo.pViewportState = &vp;
+
+    VkPipelineRasterizationStateCreateInfo rs;
+    memset(&rs, 0, sizeof(rs));
+    rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rs.polygonMode = VK_POLYGON_MODE_FILL;
+    rs.cullMode = VK_CULL_MODE_NONE;
+    rs.lineWidth = 1.0f;
+    pipelineInfo.pRasterizationState = &rs;
+
+    VkPipelineMultisampleStateCreateInfo ms;
+    memset(&ms, 0, sizeof(ms));
+    ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    pipelineInfo.pMultisampleState = &ms;
+
+    VkPipelineDepthStencilStateCreateInfo ds;
+    memset(&ds, 0, sizeof(ds));
+    ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    pipelineInfo.pDepthStencilState = &ds;
+
+    // Обычное смешивание по альфе (цвет не предумножен)
+    VkPipelineColorBlendAttachmentState blend;
+    memset(&blend, 0, sizeof(blend));
+    blend.blendEnable = VK_TRUE;
+    blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blend.colorBlendOp = VK_BLEND_OP_ADD;
+    blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blend.alphaBlendOp = VK_BLEND_OP_ADD;
+    blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
+            | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo cb;
+    memset(&cb, 0, sizeof(cb));
+    cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    cb.attachmentCount = 1;
+    cb.pAttachments = &blend;
+    pipelineInfo.pColorBlendState = &cb;
+
+    VkDynamicState dynStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dyn;
+    memset(&dyn, 0, sizeof(dyn));
+    dyn.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dyn.dynamicStateCount = 2;
+    dyn.pDynamicStates = dynStates;
+    pipelineInfo.pDynamicState = &dyn;
+
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.renderPass = m_renderPass;
+
+    VkResult err = m_devFuncs->vkCreateGraphicsPipelines(m_dev, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+
+    m_devFuncs->vkDestroyShaderModule(m_dev, vertModule, nullptr);
+    m_devFuncs->vkDestroyShaderModule(m_dev, fragModule, nullptr);
+
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create graphics pipeline: %d", err);
+    return pipeline;
+}
+
+#include "vulkanmesh.moc"
@@ -0,0 +1,125 @@
+// vulkanmesh.h
+#ifndef VULKANMESH_H
+#define VULKANMESH_H
+
+#include <QtQuick/QQuickItem>
+#include <QtQuick/QQuickWindow>
+#include <QByteArray>
+#include <QColor>
+#include <QList>
+#include <QMatrix4x4>
+#include <QSharedPointer>
+#include "vulkanpipelinestatistics.h"
+
+class MeshRenderer;
+struct MeshData;
+
+// Полная замена (offset < 0) или запись диапазона байт
+struct VulkanMeshUpdate
+{
+    qsizetype offset = -1;
+    QByteArray data;
+};
+
+// Геометрия, меняющаяся каждый кадр (облака точек, графики).
+//
+// Вершина: vec3 float позиция со смещением 0, необязательный цвет RGBA8
+// со смещением colorOffset, шаг vertexStride. Индексы - uint32, если не заданы,
+// рисуются вершины по порядку. matrix переводит позиции в клип-пространство
+// Vulkan внутри прямоугольника элемента.
+//
+// Данные производителя копируются один раз - прямо в буфер текущего кадра
+// (currentFrameSlot): sync() передаёт рендереру накопленные обновления без
+// копирования, рендерер пишет их в слот кадра. Остальные слоты лишь
+// помечаются устаревшими и, став текущими, догоняют изменённый диапазон
+// одним memcpy из буфера последнего записанного слота (память с
+// HOST_CACHED, если она есть). CPU-копии нет. Буферы растут до степени
+// двойки и в устойчивом режиме не пересоздаются.
+// QML передаёт ArrayBuffer, он приходит как QByteArray. C++-производитель может
+// отдать QByteArray::fromRawData(), если его память живёт до следующей полной
+// замены. При пересоздании графа сцены (releaseResources,
+// sceneGraphInvalidated) рендерер перед уничтожением сохраняет содержимое
+// своих буферов, и новый рендерер начинает с него.
+class VulkanMesh : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(Primitive primitive READ primitive WRITE setPrimitive NOTIFY primitiveChanged)
+    Q_PROPERTY(int vertexStride READ vertexStride WRITE setVertexStride NOTIFY vertexStrideChanged)
+    Q_PROPERTY(int colorOffset READ colorOffset WRITE setColorOffset NOTIFY colorOffsetChanged)
+    Q_PROPERTY(QMatrix4x4 matrix READ matrix WRITE setMatrix NOTIFY matrixChanged)
+    Q_PROPERTY(QColor color READ color WRITE setColor NOTIFY colorChanged)
+    Q_PROPERTY(qreal pointSize READ pointSize WRITE setPointSize NOTIFY pointSizeChanged)
+    Q_PROPERTY(VulkanPipelineStatistics *pipelineStatistics READ pipelineStatistics CONSTANT)
+    QML_ELEMENT
+
+public:
+    enum Primitive {
+        Points,
+        Lines,
+        LineStrip,
+        Triangles,
+        TriangleStrip
+    };
+    Q_ENUM(Primitive)
+
+    VulkanMesh();
+
+    VulkanPipelineStatistics *pipelineStatistics() const { return m_pipelineStatistics; }
+
+    Primitive primitive() const { return m_primitive; }
+    void setPrimitive(Primitive primitive);
+    int vertexStride() const { return m_vertexStride; }
+    void setVertexStride(int stride);
+    int colorOffset() const { return m_colorOffset; }
+    void setColorOffset(int offset);
+    QMatrix4x4 matrix() const { return m_matrix; }
+    void setMatrix(const QMatrix4x4 &matrix);
+    QColor color() const { return m_color; }
+    void setColor(const QColor &color);
+    qreal pointSize() const { return m_pointSize; }
+    void setPointSize(qreal size);
+
+    Q_INVOKABLE void setVertexData(const QByteArray &data);
+    Q_INVOKABLE void setIndexData(const QByteArray &data);
+    // Диапазон должен лежать внутри текущих данных
+    Q_INVOKABLE bool updateVertexData(qsizetype offset, const QByteArray &data);
+    Q_INVOKABLE bool updateIndexData(qsizetype offset, const QByteArray &data);
+
+signals:
+    void primitiveChanged();
+    void vertexStrideChanged();
+    void colorOffsetChanged();
+    void matrixChanged();
+    void colorChanged();
+    void pointSizeChanged();
+
+public slots:
+    void sync();
+    void cleanup();
+
+private slots:
+    void handleWindowChanged(QQuickWindow *win);
+
+private:
+    void releaseResources() override;
+    void changed();
+
+    Primitive m_primitive = Points;
+    int m_vertexStride = 12;
+    int m_colorOffset = -1;
+    QMatrix4x4 m_matrix;
+    QColor m_color = Qt::white;
+    qreal m_pointSize = 1;
+
+    qsizetype m_vertexSize = 0;
+    qsizetype m_indexSize = 0;
+    QList<VulkanMeshUpdate> m_vertexUpdates;
+    QList<VulkanMeshUpdate> m_indexUpdates;
+    // Данные между рендерерами, см. MeshData
+    QSharedPointer<MeshData> m_data;
+
+    VulkanPipelineStatistics *m_pipelineStatistics = new VulkanPipelineStatistics(this);
+    MeshRenderer *m_renderer = nullptr;
+};
+
+#endif
@@ -0,0 +1,754 @@
+// vulkanparticles.cpp
+#include "vulkanparticles.h"
+#include "vulkanassetcache.h"
+#include "vulkananimationclock.h"
+#include "vulkantrace.h"
+#include "vulkanutils.h"
+#include "vulkandraworder.h"
+#include "vulkanpipelinecache.h"
+#include "vulkanquickwindow.h"
+#include <QtCore/QRunnable>
+#include <QtQuick/QQuickWindow>
+
+#include <QVulkanInstance>
+#include <QVulkanFunctions>
+#include <QMatrix4x4>
+
+struct ParticleParams
+{
+    int count = 0;
+    bool running = true;
+    QVector3D emitterPosition;
+    float emitterRadius = 0;
+    QVector3D gravity;
+    float speed = 0;
+    float lifetime = 1;
+    QColor color;
+    float pointSize = 1;
+};
+
+class ParticleRenderer : public QObject
+{
+    Q_OBJECT
+public:
+    ~ParticleRenderer();
+
+    void setParams(const ParticleParams &params) { m_params = params; }
+    void setViewportRect(const QRect &rect) { m_viewportRect = rect; }
+    void setWindow(QQuickWindow *window) { m_window = window; }
+
+    void mainPassRecordingStart(VkCommandBuffer cb);
+
+public slots:
+    void frameStart();
+
+private:
+    void init(int framesInFlight);
+    void createPipelines(VkRenderPass rp);
+    void createParticleBuffer(VkCommandBuffer cb);
+    void writeUniforms(int frameSlot, float dt);
+
+    ParticleParams m_params;
+    QRect m_viewportRect;
+    QQuickWindow *m_window = nullptr;
+
+    bool m_initialized = false;
+    VkPhysicalDevice m_physDev = VK_NULL_HANDLE;
+    VkDevice m_dev = VK_NULL_HANDLE;
+    QVulkanDeviceFunctions *m_devFuncs = nullptr;
+    QVulkanFunctions *m_funcs = nullptr;
+    VkPhysicalDeviceMemoryProperties m_memProps;
+
+    // Буфер частиц: storage buffer для compute и вершинный буфер (на инстанс) для отрисовки
+    VkBuffer m_particleBuf = VK_NULL_HANDLE;
+    VkDeviceMemory m_particleMem = VK_NULL_HANDLE;
+    int m_particleCount = 0;
+
+    // Параметры эмиттера, по слоту на кадр в полёте; память отображена постоянно
+    VkBuffer m_ubuf = VK_NULL_HANDLE;
+    VkDeviceMemory m_ubufMem = VK_NULL_HANDLE;
+    VkDeviceSize m_allocPerUbuf = 0;
+    char *m_ubufPtr = nullptr;
+
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_resLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_computePipeline = VK_NULL_HANDLE;
+    VkPipeline m_graphicsPipeline = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+    double m_lastTime = -1;
+    double m_simTime = 0;
+};
+
+// Раскладка должна совпадать с Particle в particles.comp
+struct Particle {
+    float position[4];
+    float velocity[4];
+};
+
+// mat4 + 5 vec4, см. блок Params в шейдерах
+const int PARTICLE_UBUF_SIZE = 16 * sizeof(float) + 5 * 4 * sizeof(float);
+const int PARTICLE_WORKGROUP_SIZE = 256;
+// Число частиц передаётся в шейдер как float, поэтому ограничиваем 2^24
+const int MAX_PARTICLES = 1 << 24;
+
+VulkanParticles::VulkanParticles()
+{
+    connect(this, &QQuickItem::windowChanged, this, &VulkanParticles::handleWindowChanged);
+}
+
+void VulkanParticles::setCount(int count)
+{
+    count = qBound(0, count, MAX_PARTICLES);
+    if (count == m_count)
+        return;
+    m_count = count;
+    emit countChanged();
+    if (window())
+        window()->update();
+}
+
+void VulkanParticles::setRunning(bool running)
+{
+    if (running == m_running)
+        return;
+    m_running = running;
+    emit runningChanged();
+    if (window())
+        window()->update();
+}
+
+void VulkanParticles::setEmitterPosition(const QVector3D &pos)
+{
+    if (pos == m_emitterPosition)
+        return;
+    m_emitterPosition = pos;
+    emit emitterPositionChanged();
+    if (window())
+        window()->update();
+}
+
+void VulkanParticles::setEmitterRadius(qreal radius)
+{
+    if (radius == m_emitterRadius)
+        return;
+    m_emitterRadius = radius;
+    emit emitterRadiusChanged();
+    if (window())
+        window()->update();
+}
+
+void VulkanParticles::setGravity(const QVector3D &gravity)
+{
+    if (gravity == m_gravity)
+        return;
+    m_gravity = gravity;
+    emit gravityChanged();
+    if (window())
+        window()->update();
+}
+
+void VulkanParticles::setSpeed(qreal speed)
+{
+    if (speed == m_speed)
+        return;
+    m_speed = speed;
+    emit speedChanged();
+    if (window())
+        window()->update();
+}
+
+void VulkanParticles::setLifetime(qreal lifetime)
+{
+    if (lifetime == m_lifetime)
+        return;
+    m_lifetime = lifetime;
+    emit lifetimeChanged();
+    if (window())
+        window()->update();
+}
+
+void VulkanParticles::setColor(const QColor &color)
+{
+    if (color == m_color)
+        return;
+    m_color = color;
+    emit colorChanged();
+    if (window())
+        window()->update();
+}
+
+void VulkanParticles::setPointSize(qreal size)
+{
+    if (size == m_pointSize)
+        return;
+    m_pointSize = size;
+    emit pointSizeChanged();
+    if (window())
+        window()->update();
+}
+
+void VulkanParticles::handleWindowChanged(QQuickWindow *win)
+{
+    if (win) {
+        connect(win, &QQuickWindow::beforeSynchronizing, this, &VulkanParticles::sync, Qt::DirectConnection);
+        connect(win, &QQuickWindow::sceneGraphInvalidated, this, &VulkanParticles::cleanup, Qt::DirectConnection);
+    }
+}
+
+void VulkanParticles::cleanup()
+{
+    delete m_renderer;
+    m_renderer = nullptr;
+}
+
+class ParticleCleanupJob : public QRunnable
+{
+public:
+    ParticleCleanupJob(ParticleRenderer *renderer) : m_renderer(renderer) { }
+    void run() override { delete m_renderer; }
+private:
+    ParticleRenderer *m_renderer;
+};
+
+void VulkanParticles::releaseResources()
+{
+    window()->scheduleRenderJob(new ParticleCleanupJob(m_renderer), QQuickWindow::BeforeSynchronizingStage);
+    m_renderer = nullptr;
+}
+
+void VulkanParticles::sync()
+{
+    VKQ_TRACE_SCOPE("VulkanParticles::sync");
+    if (!m_renderer) {
+        m_renderer = new ParticleRenderer;
+        // Симуляция (compute) записывается до начала основного прохода,
+        // отрисовка - в начале прохода, после непрозрачных элементов и фона
+        connect(window(), &QQuickWindow::beforeRendering, m_renderer, &ParticleRenderer::frameStart, Qt::DirectConnection);
+        ParticleRenderer *renderer = m_renderer;
+        VulkanDrawOrder::forWindow(window())->add(renderer, VulkanDrawOrder::TransparentStage, "VulkanParticles",
+                                                  [renderer](VkCommandBuffer cb) { renderer->mainPassRecordingStart(cb); });
+    }
+
+    ParticleParams params;
+    params.count = m_count;
+    params.running = m_running;
+    params.emitterPosition = m_emitterPosition;
+    params.emitterRadius = m_emitterRadius;
+    params.gravity = m_gravity;
+    params.speed = m_speed;
+    params.lifetime = qMax(qreal(0.01), m_lifetime);
+    params.color = m_color;
+    params.pointSize = m_pointSize;
+    m_renderer->setParams(params);
+
+    // Частицы рисуются в пределах элемента
+    const qreal dpr = window()->effectiveDevicePixelRatio();
+    const QRectF sceneRect = mapRectToScene(boundingRect());
+    const QRect windowRect(QPoint(0, 0), window()->size() * dpr);
+    const QRect viewportRect = QRectF(sceneRect.topLeft() * dpr, sceneRect.size() * dpr)
+            .toAlignedRect().intersected(windowRect);
+    m_renderer->setViewportRect(viewportRect);
+    m_renderer->setWindow(window());
+    m_pipelineStatistics->sync(window(), m_renderer, qreal(viewportRect.width()) * viewportRect.height());
+}
+
+ParticleRenderer::~ParticleRenderer()
+{
+    qDebug("particles cleanup");
+    if (m_window)
+        VulkanDrawOrder::unregister(m_window, this);
+    if (!m_devFuncs)
+        return;
+
+    m_devFuncs->vkDestroyPipeline(m_dev, m_graphicsPipeline, nullptr);
+    m_devFuncs->vkDestroyPipeline(m_dev, m_computePipeline, nullptr);
+    m_devFuncs->vkDestroyPipelineLayout(m_dev, m_pipelineLayout, nullptr);
+    m_devFuncs->vkDestroyDescriptorSetLayout(m_dev, m_resLayout, nullptr);
+    m_devFuncs->vkDestroyDescriptorPool(m_dev, m_descriptorPool, nullptr);
+    if (m_pipelineCache)
+        VulkanPipelineCache::release(m_dev);
+
+    VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &m_particleBuf, &m_particleMem);
+
+    if (m_ubufPtr)
+        m_devFuncs->vkUnmapMemory(m_dev, m_ubufMem);
+    VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &m_ubuf, &m_ubufMem);
+
+    qDebug("particles released");
+}
+
+void ParticleRenderer::frameStart()
+{
+    VKQ_TRACE_SCOPE("ParticleRenderer::frameStart");
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    Q_ASSERT(rif->graphicsApi() == QSGRendererInterface::Vulkan);
+
+    const QQuickWindow::GraphicsStateInfo &stateInfo(m_window->graphicsStateInfo());
+    if (!m_initialized)
+        init(stateInfo.framesInFlight);
+
+    if (m_params.count <= 0 && m_particleCount == 0)
+        return;
+
+    const double now = VulkanAnimationClock::now();
+    const float dt = (m_lastTime < 0 || !m_params.running) ? 0.0f : float(qMin(now - m_lastTime, 0.1));
+    m_lastTime = now;
+    m_simTime += dt;
+
+    const bool resized = m_particleCount != m_params.count;
+    if (!resized && !m_params.running) {
+        // Симуляция стоит, параметры нужны только отрисовке
+        writeUniforms(stateInfo.currentFrameSlot, dt);
+        return;
+    }
+
+    // Команды пишутся в основной командный буфер сцены вне render pass.
+    // beginExternalCommands() гарантирует, что отложенные команды Qt уже
+    // записаны и наши окажутся после них.
+    m_window->beginExternalCommands();
+
+    VkCommandBuffer cb = *reinterpret_cast<VkCommandBuffer *>(
+        rif->getResource(m_window, QSGRendererInterface::CommandListResource));
+    Q_ASSERT(cb);
+
+    if (resized)
+        createParticleBuffer(cb);
+
+    // Число частиц в параметрах - уже для нового буфера: шейдер сверяет с
+    // ним индекс, старое число при уменьшении вывело бы запись за буфер
+    writeUniforms(stateInfo.currentFrameSlot, dt);
+
+    if (m_particleCount > 0) {
+        VKQ_TRACE_GPU_BEGIN(cb, "VulkanParticles simulate");
+
+        // WAR: предыдущий кадр читал буфер как вершинный атрибут, для этого
+        // достаточно зависимости по исполнению. RAW/WAW: его же dispatch
+        // писал частицы, которые этот dispatch читает и перезаписывает.
+        VkMemoryBarrier simBarrier;
+        memset(&simBarrier, 0, sizeof(simBarrier));
+        simBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        simBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        simBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        m_devFuncs->vkCmdPipelineBarrier(cb,
+                                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                         0, 1, &simBarrier, 0, nullptr, 0, nullptr);
+
+        m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
+        uint32_t dynamicOffset = m_allocPerUbuf * stateInfo.currentFrameSlot;
+        m_devFuncs->vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1,
+                                            &m_descriptorSet, 1, &dynamicOffset);
+        m_devFuncs->vkCmdDispatch(cb, (m_particleCount + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE, 1, 1);
+
+        // RAW: результат compute читается как вершинный атрибут на инстанс
+        VkBufferMemoryBarrier barrier;
+        memset(&barrier, 0, sizeof(barrier));
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = m_particleBuf;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        m_devFuncs->vkCmdPipelineBarrier(cb,
+                                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                         0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+        VKQ_TRACE_GPU_END(cb);
+    }
+
+    m_window->endExternalCommands();
+
+    // Симуляция непрерывна, следующий кадр запрашивается с потока рендеринга
+    if (m_params.running)
+        VulkanQuickWindow::requestFrame(m_window);
+}
+
+void ParticleRenderer::mainPassRecordingStart(VkCommandBuffer cb)
+{
+    VKQ_TRACE_SCOPE("ParticleRenderer::mainPassRecordingStart");
+    if (!m_initialized || m_particleCount <= 0 || m_viewportRect.isEmpty())
+        return;
+
+    const QQuickWindow::GraphicsStateInfo &stateInfo(m_window->graphicsStateInfo());
+
+    VKQ_TRACE_GPU_BEGIN(cb, "VulkanParticles draw");
+
+    m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline);
+
+    VkDeviceSize vbufOffset = 0;
+    m_devFuncs->vkCmdBindVertexBuffers(cb, 0, 1, &m_particleBuf, &vbufOffset);
+
+    uint32_t dynamicOffset = m_allocPerUbuf * stateInfo.currentFrameSlot;
+    m_devFuncs->vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1,
+                                        &m_descriptorSet, 1, &dynamicOffset);
+
+    VkViewport vp = { float(m_viewportRect.x()), float(m_viewportRect.y()),
+                      float(m_viewportRect.width()), float(m_viewportRect.height()), 0.0f, 1.0f };
+    m_devFuncs->vkCmdSetViewport(cb, 0, 1, &vp);
+    VkRect2D scissor = { { m_viewportRect.x(), m_viewportRect.y() },
+                         { uint32_t(m_viewportRect.width()), uint32_t(m_viewportRect.height()) } };
+    m_devFuncs->vkCmdSetScissor(cb, 0, 1, &scissor);
+
+    // 4 вершины спрайта на каждую частицу
+    m_devFuncs->vkCmdDraw(cb, 4, uint32_t(m_particleCount), 0, 0);
+
+    VKQ_TRACE_GPU_END(cb);
+}
+
+void ParticleRenderer::writeUniforms(int frameSlot, float dt)
+{
+    const float aspect = m_viewportRect.height() > 0
+            ? m_viewportRect.width() / float(m_viewportRect.height()) : 1.0f;
+
+    // Коррекция клип-пространства: ось Y вниз и глубина [0, 1] в Vulkan
+    const QMatrix4x4 clipCorrection(1.0f, 0.0f, 0.0f, 0.0f,
+                                    0.0f, -1.0f, 0.0f, 0.0f,
+                                    0.0f, 0.0f, 0.5f, 0.5f,
+                                    0.0f, 0.0f, 0.0f, 1.0f);
+    QMatrix4x4 proj;
+    proj.perspective(45.0f, aspect, 0.1f, 100.0f);
+    QMatrix4x4 view;
+    view.lookAt(QVector3D(0.0f, 0.5f, 4.0f), QVector3D(0.0f, 0.5f, 0.0f), QVector3D(0.0f, 1.0f, 0.0f));
+    const QMatrix4x4 mvp = clipCorrection * proj * view;
+
+    float *data = reinterpret_cast<float *>(m_ubufPtr + frameSlot * m_allocPerUbuf);
+    memcpy(data, mvp.constData(), 16 * sizeof(float));
+    data[16] = m_params.emitterPosition.x();
+    data[17] = m_params.emitterPosition.y();
+    data[18] = m_params.emitterPosition.z();
+    data[19] = m_params.emitterRadius;
+    data[20] = m_params.gravity.x();
+    data[21] = m_params.gravity.y();
+    data[22] = m_params.gravity.z();
+    data[23] = dt;
+    data[24] = float(m_simTime);
+    data[25] = m_params.lifetime;
+    data[26] = m_params.speed;
+    data[27] = float(m_particleCount);
+    data[28] = m_params.color.redF();
+    data[29] = m_params.color.greenF();
+    data[30] = m_params.color.blueF();
+    data[31] = m_params.color.alphaF();
+    // Половина размера спрайта в NDC: pointSize в пикселях - диаметр
+    data[32] = m_viewportRect.width() > 0 ? m_params.pointSize / m_viewportRect.width() : 0.0f;
+    data[33] = m_viewportRect.height() > 0 ? m_params.pointSize / m_viewportRect.height() : 0.0f;
+    data[34] = 0.0f;
+    data[35] = 0.0f;
+}
+
+void ParticleRenderer::createParticleBuffer(VkCommandBuffer cb)
+{
+    VKQ_TRACE_SCOPE("ParticleRenderer::createParticleBuffer");
+
+    // Смена числа частиц - редкое событие. Буфер и набор дескрипторов
+    // используются кадрами в полёте, проще дождаться устройства.
+    if (m_particleBuf != VK_NULL_HANDLE) {
+        m_devFuncs->vkDeviceWaitIdle(m_dev);
+        VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &m_particleBuf, &m_particleMem);
+    }
+
+    m_particleCount = m_params.count;
+    if (m_particleCount <= 0)
+        return;
+
+    const VkDeviceSize size = VkDeviceSize(m_particleCount) * sizeof(Particle);
+    VulkanUtils::createBuffer(m_devFuncs, m_dev, m_memProps, size,
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+                              | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                              &m_particleBuf, &m_particleMem, "particle buffer");
+
+    VkDescriptorBufferInfo bufInfo;
+    bufInfo.buffer = m_particleBuf;
+    bufInfo.offset = 0;
+    bufInfo.range = VK_WHOLE_SIZE;
+    VkWriteDescriptorSet writeInfo;
+    memset(&writeInfo, 0, sizeof(writeInfo));
+    writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeInfo.dstSet = m_descriptorSet;
+    writeInfo.dstBinding = 1;
+    writeInfo.descriptorCount = 1;
+    writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writeInfo.pBufferInfo = &bufInfo;
+    m_devFuncs->vkUpdateDescriptorSets(m_dev, 1, &writeInfo, 0, nullptr);
+
+    // Нулевое время жизни - все частицы родятся в первом же dispatch,
+    // начальные данные с CPU не передаются
+    m_devFuncs->vkCmdFillBuffer(cb, m_particleBuf, 0, VK_WHOLE_SIZE, 0);
+
+    VkBufferMemoryBarrier barrier;
+    memset(&barrier, 0, sizeof(barrier));
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = m_particleBuf;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    m_devFuncs->vkCmdPipelineBarrier(cb,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    qDebug("particles: %d particles, %u KB", m_particleCount, uint(size / 1024));
+}
+
+void ParticleRenderer::init(int framesInFlight)
+{
+    VKQ_TRACE_SCOPE("ParticleRenderer::init");
+    Q_ASSERT(framesInFlight <= 3);
+    m_initialized = true;
+
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    QVulkanInstance *inst = reinterpret_cast<QVulkanInstance *>(
+        rif->getResource(m_window, QSGRendererInterface::VulkanInstanceResource));
+    Q_ASSERT(inst && inst->isValid());
+
+    m_physDev = *reinterpret_cast<VkPhysicalDevice *>(rif->getResource(m_window, QSGRendererInterface::PhysicalDeviceResource));
+    m_dev = *reinterpret_cast<VkDevice *>(rif->getResource(m_window, QSGRendererInterface::DeviceResource));
+    Q_ASSERT(m_physDev && m_dev);
+
+    m_devFuncs = inst->deviceFunctions(m_dev);
+    m_funcs = inst->functions();
+    Q_ASSERT(m_devFuncs && m_funcs);
+
+    VkRenderPass rp = *reinterpret_cast<VkRenderPass *>(
+        rif->getResource(m_window, QSGRendererInterface::RenderPassResource));
+    Q_ASSERT(rp);
+
+    VkPhysicalDeviceProperties physDevProps;
+    m_funcs->vkGetPhysicalDeviceProperties(m_physDev, &physDevProps);
+    m_funcs->vkGetPhysicalDeviceMemoryProperties(m_physDev, &m_memProps);
+
+    // Uniform buffer на каждый кадр в полёте, память отображается один раз
+    m_allocPerUbuf = VulkanUtils::aligned(PARTICLE_UBUF_SIZE, physDevProps.limits.minUniformBufferOffsetAlignment);
+    VulkanUtils::createBuffer(m_devFuncs, m_dev, m_memProps, m_allocPerUbuf * framesInFlight,
+                              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              &m_ubuf, &m_ubufMem, "particle uniform buffer");
+    void *p = nullptr;
+    VkResult err = m_devFuncs->vkMapMemory(m_dev, m_ubufMem, 0, VK_WHOLE_SIZE, 0, &p);
+    if (err != VK_SUCCESS || !p)
+        qFatal("Failed to map particle uniform buffer memory: %d", err);
+    m_ubufPtr = static_cast<char *>(p);
+
+    // binding 0 - параметры эмиттера, binding 1 - частицы (только для compute)
+    VkDescriptorSetLayoutBinding layoutBinding[2];
+    memset(layoutBinding, 0, sizeof(layoutBinding));
+    layoutBinding[0].binding = 0;
+    layoutBinding[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    layoutBinding[0].descriptorCount = 1;
+    layoutBinding[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    layoutBinding[1].binding = 1;
+    layoutBinding[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    layoutBinding[1].descriptorCount = 1;
+    layoutBinding[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo descLayoutInfo;
+    memset(&descLayoutInfo, 0, sizeof(descLayoutInfo));
+    descLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descLayoutInfo.bindingCount = 2;
+    descLayoutInfo.pBindings = layoutBinding;
+    err = m_devFuncs->vkCreateDescriptorSetLayout(m_dev, &descLayoutInfo, nullptr, &m_resLayout);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create descriptor set layout: %d", err);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo;
+    memset(&pipelineLayoutInfo, 0, sizeof(pipelineLayoutInfo));
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_resLayout;
+    err = m_devFuncs->vkCreatePipelineLayout(m_dev, &pipelineLayoutInfo, nullptr, &m_pipelineLayout);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create pipeline layout: %d", err);
+
+    VkDescriptorPoolSize descPoolSizes[2];
+    descPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descPoolSizes[0].descriptorCount = 1;
+    descPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descPoolSizes[1].descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo descPoolInfo;
+    memset(&descPoolInfo, 0, sizeof(descPoolInfo));
+    descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descPoolInfo.maxSets = 1;
+    descPoolInfo.poolSizeCount = 2;
+    descPoolInfo.pPoolSizes = descPoolSizes;
+    err = m_devFuncs->vkCreateDescriptorPool(m_dev, &descPoolInfo, nullptr, &m_descriptorPool);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create descriptor pool: %d", err);
+
+    VkDescriptorSetAllocateInfo descSetAllocInfo;
+    memset(&descSetAllocInfo, 0, sizeof(descSetAllocInfo));
+    descSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descSetAllocInfo.descriptorPool = m_descriptorPool;
+    descSetAllocInfo.descriptorSetCount = 1;
+    descSetAllocInfo.pSetLayouts = &m_resLayout;
+    err = m_devFuncs->vkAllocateDescriptorSets(m_dev, &descSetAllocInfo, &m_descriptorSet);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to allocate descriptor set: %d", err);
+
+    VkDescriptorBufferInfo bufInfo;
+    bufInfo.buffer = m_ubuf;
+    bufInfo.offset = 0;
+    bufInfo.range = PARTICLE_UBUF_SIZE;
+    VkWriteDescriptorSet writeInfo;
+    memset(&writeInfo, 0, sizeof(writeInfo));
+    writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeInfo.dstSet = m_descriptorSet;
+    writeInfo.dstBinding = 0;
+    writeInfo.descriptorCount = 1;
+    writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    writeInfo.pBufferInfo = &bufInfo;
+    m_devFuncs->vkUpdateDescriptorSets(m_dev, 1, &writeInfo, 0, nullptr);
+
+    // Общий кэш устройства, сохраняемый между запусками
+    m_pipelineCache = VulkanPipelineCache::acquire(m_window);
+
+    createPipelines(rp);
+
+    qDebug("particles initialized");
+}
+
+void ParticleRenderer::createPipelines(VkRenderPass rp)
+{
+    VulkanAssetCache *cache = VulkanAssetCache::instance();
+    const QByteArray comp = cache->shader(QStringLiteral(":/particles.comp.spv"));
+    const QByteArray vert = cache->shader(QStringLiteral(":/particles.vert.spv"));
+    const QByteArray frag = cache->shader(QStringLiteral(":/particles.frag.spv"));
+    if (comp.isEmpty() || vert.isEmpty() || frag.isEmpty())
+        qFatal("Failed to read particle shaders");
+
+    // Compute pipeline
+    VkShaderModule compModule = VulkanUtils::createShaderModule(m_devFuncs, m_dev, comp);
+    VkComputePipelineCreateInfo computeInfo;
+    memset(&computeInfo, 0, sizeof(computeInfo));
+    computeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    computeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    computeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    computeInfo.stage.module = compModule;
+    computeInfo.stage.pName = "main";
+    computeInfo.layout = m_pipelineLayout;
+    VkResult err = m_devFuncs->vkCreateComputePipelines(m_dev, m_pipelineCache, 1, &computeInfo, nullptr, &m_computePipeline);
+    m_devFuncs->vkDestroyShaderModule(m_dev, compModule, nullptr);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create compute pipeline: %d", err);
+
+    // Graphics pipeline: инстансированные спрайты
+    VkShaderModule vertModule = VulkanUtils::createShaderModule(m_devFuncs, m_dev, vert);
+    VkShaderModule fragModule = VulkanUtils::createShaderModule(m_devFuncs, m_dev, frag);
+
+    VkGraphicsPipelineCreateInfo pipelineInfo;
+    memset(&pipelineInfo, 0, sizeof(pipelineInfo));
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+
+    VkPipelineShaderStageCreateInfo shaderStages[2];
+    memset(shaderStages, 0, sizeof(shaderStages));
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragModule;
+    shaderStages[1].pName = "main";
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+
+    VkVertexInputBindingDescription vertexBindingDesc;
+    vertexBindingDesc.binding = 0;
+    vertexBindingDesc.stride = sizeof(Particle);
+    vertexBindingDesc.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    VkVertexInputAttributeDescription vertexAttrDesc;
+    vertexAttrDesc.location = 0;
+    vertexAttrDesc.binding = 0;
+    vertexAttrDesc.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    vertexAttrDesc.offset = offsetof(Particle, position);
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo;
+    memset(&vertexInputInfo, 0, sizeof(vertexInputInfo));
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &vertexBindingDesc;
+    vertexInputInfo.vertexAttributeDescriptionCount = 1;
+    vertexInputInfo.pVertexAttributeDescriptions = &vertexAttrDesc;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+
+    VkPipelineInputAssemblyStateCreateInfo ia;
+    memset(&ia, 0, sizeof(ia));
+    ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+    pipelineInfo.pInputAssemblyState = &ia;
+
+    VkPipelineViewportStateCreateInfo vp;
+    memset(&vp, 0, sizeof(vp));
+    vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    vp.viewportCount = 1;
+    vp.scissorCount = 1;
+    pipelineInfo.pViewportState = &vp;
+
+    VkPipelineRasterizationStateCreateInfo rs;
+    memset(&rs, 0, sizeof(rs));
+    rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rs.polygonMode = VK_POLYGON_MODE_FILL;
+    rs.cullMode = VK_CULL_MODE_NONE;
+    rs.lineWidth = 1.0f;
+    pipelineInfo.pRasterizationState = &rs;
+
+    VkPipelineMultisampleStateCreateInfo ms;
+    memset(&ms, 0, sizeof(ms));
+    ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    pipelineInfo.pMultisampleState = &ms;
+
+    // Аддитивные частицы не пишут и не проверяют глубину
+    VkPipelineDepthStencilStateCreateInfo ds;
+    memset(&ds, 0, sizeof(ds));
+    ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    pipelineInfo.pDepthStencilState = &ds;
+
+    VkPipelineColorBlendAttachmentState blend;
+    memset(&blend, 0, sizeof(blend));
+    blend.blendEnable = VK_TRUE;
+    blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    blend.colorBlendOp = VK_BLEND_OP_ADD;
+    blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blend.alphaBlendOp = VK_BLEND_OP_ADD;
+    blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
+            | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo cb;
+    memset(&cb, 0, sizeof(cb));
+    cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    cb.attachmentCount = 1;
+    cb.pAttachments = &blend;
+    pipelineInfo.pColorBlendState = &cb;
+
+    VkDynamicState dynStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dyn;
+    memset(&dyn, 0, sizeof(dyn));
+    dyn.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dyn.dynamicStateCount = 2;
+    dyn.pDynamicStates = dynStates;
+    pipelineInfo.pDynamicState = &dyn;
+
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.renderPass = rp;
+
+    err = m_devFuncs->vkCreateGraphicsPipelines(m_dev, m_pipelineCache, 1, &pipelineInfo, nullptr, &m_graphicsPipeline);
+
+    m_devFuncs->vkDestroyShaderModule(m_dev, vertModule, nullptr);
+    m_devFuncs->vkDestroyShaderModule(m_dev, fragModule, nullptr);
+
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create graphics pipeline: %d", err);
+}
+
+#include "vulkanparticles.moc"
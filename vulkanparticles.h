@@ -0,0 +1,89 @@
+// vulkanparticles.h
+#ifndef VULKANPARTICLES_H
+#define VULKANPARTICLES_H
+
+#include <QtQuick/QQuickItem>
+#include <QtQuick/QQuickWindow>
+#include <QColor>
+#include <QVector3D>
+#include "vulkanpipelinestatistics.h"
+
+class ParticleRenderer;
+
+// Система частиц, полностью симулируемая на GPU: compute-шейдер обновляет
+// буфер частиц в beforeRendering, затем частицы рисуются инстансированными
+// спрайтами в основном проходе. CPU передаёт только параметры эмиттера.
+class VulkanParticles : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ count WRITE setCount NOTIFY countChanged)
+    Q_PROPERTY(bool running READ running WRITE setRunning NOTIFY runningChanged)
+    Q_PROPERTY(QVector3D emitterPosition READ emitterPosition WRITE setEmitterPosition NOTIFY emitterPositionChanged)
+    Q_PROPERTY(qreal emitterRadius READ emitterRadius WRITE setEmitterRadius NOTIFY emitterRadiusChanged)
+    Q_PROPERTY(QVector3D gravity READ gravity WRITE setGravity NOTIFY gravityChanged)
+    Q_PROPERTY(qreal speed READ speed WRITE setSpeed NOTIFY speedChanged)
+    Q_PROPERTY(qreal lifetime READ lifetime WRITE setLifetime NOTIFY lifetimeChanged)
+    Q_PROPERTY(QColor color READ color WRITE setColor NOTIFY colorChanged)
+    Q_PROPERTY(qreal pointSize READ pointSize WRITE setPointSize NOTIFY pointSizeChanged)
+    Q_PROPERTY(VulkanPipelineStatistics *pipelineStatistics READ pipelineStatistics CONSTANT)
+    QML_ELEMENT
+
+public:
+    VulkanParticles();
+
+    VulkanPipelineStatistics *pipelineStatistics() const { return m_pipelineStatistics; }
+
+    int count() const { return m_count; }
+    void setCount(int count);
+    bool running() const { return m_running; }
+    void setRunning(bool running);
+    QVector3D emitterPosition() const { return m_emitterPosition; }
+    void setEmitterPosition(const QVector3D &pos);
+    qreal emitterRadius() const { return m_emitterRadius; }
+    void setEmitterRadius(qreal radius);
+    QVector3D gravity() const { return m_gravity; }
+    void setGravity(const QVector3D &gravity);
+    qreal speed() const { return m_speed; }
+    void setSpeed(qreal speed);
+    qreal lifetime() const { return m_lifetime; }
+    void setLifetime(qreal lifetime);
+    QColor color() const { return m_color; }
+    void setColor(const QColor &color);
+    qreal pointSize() const { return m_pointSize; }
+    void setPointSize(qreal size);
+
+signals:
+    void countChanged();
+    void runningChanged();
+    void emitterPositionChanged();
+    void emitterRadiusChanged();
+    void gravityChanged();
+    void speedChanged();
+    void lifetimeChanged();
+    void colorChanged();
+    void pointSizeChanged();
+
+public slots:
+    void sync();
+    void cleanup();
+
+private slots:
+    void handleWindowChanged(QQuickWindow *win);
+
+private:
+    void releaseResources() override;
+
+    int m_count = 65536;
+    bool m_running = true;
+    QVector3D m_emitterPosition;
+    qreal m_emitterRadius = 0.05;
+    QVector3D m_gravity = QVector3D(0.0f, -1.0f, 0.0f);
+    qreal m_speed = 1.2;
+    qreal m_lifetime = 3.0;
+    QColor m_color = QColor(255, 160, 64);
+    qreal m_pointSize = 3.0;
+    VulkanPipelineStatistics *m_pipelineStatistics = new VulkanPipelineStatistics(this);
+    ParticleRenderer *m_renderer = nullptr;
+};
+
+#endif
@@ -0,0 +1,263 @@
+// vulkanpickpass.cpp
+#include "vulkanpickpass.h"
+#include <cstring>
+
+VulkanPickPass::VulkanPickPass(QQuickWindow *window, int framesInFlight)
+{
+    Q_ASSERT(framesInFlight <= 3);
+
+    QSGRendererInterface *rif = window->rendererInterface();
+    QVulkanInstance *inst = reinterpret_cast<QVulkanInstance *>(
+        rif->getResource(window, QSGRendererInterface::VulkanInstanceResource));
+    Q_ASSERT(inst && inst->isValid());
+    VkPhysicalDevice physDev = *reinterpret_cast<VkPhysicalDevice *>(
+        rif->getResource(window, QSGRendererInterface::PhysicalDeviceResource));
+    m_dev = *reinterpret_cast<VkDevice *>(rif->getResource(window, QSGRendererInterface::DeviceResource));
+    Q_ASSERT(physDev && m_dev);
+    m_devFuncs = inst->deviceFunctions(m_dev);
+    inst->functions()->vkGetPhysicalDeviceMemoryProperties(physDev, &m_memProps);
+
+    // D16 как вложение поддерживают все устройства; D32 точнее различает
+    // близкие грани, если есть
+    VkFormatProperties formatProps;
+    inst->functions()->vkGetPhysicalDeviceFormatProperties(physDev, VK_FORMAT_D32_SFLOAT, &formatProps);
+    if (formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+        m_depthFormat = VK_FORMAT_D32_SFLOAT;
+
+    createImage(VK_FORMAT_R32_UINT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT, &m_idImage, &m_idMem, &m_idView, "pick id image");
+    createImage(m_depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                VK_IMAGE_ASPECT_DEPTH_BIT, &m_depthImage, &m_depthMem, &m_depthView, "pick depth image");
+    createRenderPass();
+
+    const VkImageView attachments[2] = { m_idView, m_depthView };
+    VkFramebufferCreateInfo fbInfo;
+    memset(&fbInfo, 0, sizeof(fbInfo));
+    fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    fbInfo.renderPass = m_renderPass;
+    fbInfo.attachmentCount = 2;
+    fbInfo.pAttachments = attachments;
+    fbInfo.width = 1;
+    fbInfo.height = 1;
+    fbInfo.layers = 1;
+    VkResult err = m_devFuncs->vkCreateFramebuffer(m_dev, &fbInfo, nullptr, &m_framebuffer);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create pick framebuffer: %d", err);
+
+    VulkanUtils::createBuffer(m_devFuncs, m_dev, m_memProps, VkDeviceSize(framesInFlight) * sizeof(uint32_t),
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              &m_readbackBuf, &m_readbackMem, "pick readback buffer");
+    void *p = nullptr;
+    err = m_devFuncs->vkMapMemory(m_dev, m_readbackMem, 0, VK_WHOLE_SIZE, 0, &p);
+    if (err != VK_SUCCESS || !p)
+        qFatal("Failed to map pick readback buffer memory: %d", err);
+    m_readbackPtr = static_cast<const uint32_t *>(p);
+}
+
+VulkanPickPass::~VulkanPickPass()
+{
+    if (m_readbackPtr)
+        m_devFuncs->vkUnmapMemory(m_dev, m_readbackMem);
+    VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &m_readbackBuf, &m_readbackMem);
+
+    m_devFuncs->vkDestroyFramebuffer(m_dev, m_framebuffer, nullptr);
+    m_devFuncs->vkDestroyRenderPass(m_dev, m_renderPass, nullptr);
+    m_devFuncs->vkDestroyImageView(m_dev, m_depthView, nullptr);
+    m_devFuncs->vkDestroyImage(m_dev, m_depthImage, nullptr);
+    m_devFuncs->vkFreeMemory(m_dev, m_depthMem, nullptr);
+    m_devFuncs->vkDestroyImageView(m_dev, m_idView, nullptr);
+    m_devFuncs->vkDestroyImage(m_dev, m_idImage, nullptr);
+    m_devFuncs->vkFreeMemory(m_dev, m_idMem, nullptr);
+}
+
+QMatrix4x4 VulkanPickPass::pickMatrix(const QRect &viewportRect, const QPoint &pixel)
+{
+    // Центр пикселя в NDC области; пиксель шириной 2 / w растягивается до 2
+    const float w = float(viewportRect.width());
+    const float h = float(viewportRect.height());
+    const float cx = (pixel.x() + 0.5f - viewportRect.x()) / w * 2.0f - 1.0f;
+    const float cy = (pixel.y() + 0.5f - viewportRect.y()) / h * 2.0f - 1.0f;
+    return QMatrix4x4(w, 0.0f, 0.0f, -cx * w,
+                      0.0f, h, 0.0f, -cy * h,
+                      0.0f, 0.0f, 1.0f, 0.0f,
+                      0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+bool VulkanPickPass::takeResult(int slot, int *instance)
+{
+    // Кадр, записавший проход в этом слоте, завершён
+    if (!m_pending[slot])
+        return false;
+    m_pending[slot] = false;
+    --m_pendingCount;
+    *instance = int(m_readbackPtr[slot]) - 1;
+    return true;
+}
+
+void VulkanPickPass::begin(VkCommandBuffer cb)
+{
+    VkClearValue clearValues[2];
+    memset(clearValues, 0, sizeof(clearValues));
+    clearValues[0].color.uint32[0] = 0;
+    clearValues[1].depthStencil = { 1.0f, 0 };
+
+    VkRenderPassBeginInfo rpBeginInfo;
+    memset(&rpBeginInfo, 0, sizeof(rpBeginInfo));
+    rpBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    rpBeginInfo.renderPass = m_renderPass;
+    rpBeginInfo.framebuffer = m_framebuffer;
+    rpBeginInfo.renderArea = { { 0, 0 }, { 1, 1 } };
+    rpBeginInfo.clearValueCount = 2;
+    rpBeginInfo.pClearValues = clearValues;
+    m_devFuncs->vkCmdBeginRenderPass(cb, &rpBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport vp = { 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
+    m_devFuncs->vkCmdSetViewport(cb, 0, 1, &vp);
+    VkRect2D scissor = { { 0, 0 }, { 1, 1 } };
+    m_devFuncs->vkCmdSetScissor(cb, 0, 1, &scissor);
+}
+
+void VulkanPickPass::end(VkCommandBuffer cb, int slot)
+{
+    m_devFuncs->vkCmdEndRenderPass(cb);
+
+    // Вложение уже в TRANSFER_SRC_OPTIMAL, порядок задаёт зависимость прохода
+    VkBufferImageCopy region;
+    memset(&region, 0, sizeof(region));
+    region.bufferOffset = VkDeviceSize(slot) * sizeof(uint32_t);
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { 1, 1, 1 };
+    m_devFuncs->vkCmdCopyImageToBuffer(cb, m_idImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                       m_readbackBuf, 1, &region);
+
+    VkBufferMemoryBarrier barrier;
+    memset(&barrier, 0, sizeof(barrier));
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = m_readbackBuf;
+    barrier.offset = region.bufferOffset;
+    barrier.size = sizeof(uint32_t);
+    m_devFuncs->vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                                     0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    if (!m_pending[slot]) {
+        m_pending[slot] = true;
+        ++m_pendingCount;
+    }
+}
+
+void VulkanPickPass::createImage(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+                                 VkImage *image, VkDeviceMemory *mem, VkImageView *view, const char *what)
+{
+    VkImageCreateInfo imageInfo;
+    memset(&imageInfo, 0, sizeof(imageInfo));
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = { 1, 1, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = usage;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkResult err = m_devFuncs->vkCreateImage(m_dev, &imageInfo, nullptr, image);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create %s: %d", what, err);
+
+    VkMemoryRequirements memReq;
+    m_devFuncs->vkGetImageMemoryRequirements(m_dev, *image, &memReq);
+    VkMemoryAllocateInfo allocInfo;
+    memset(&allocInfo, 0, sizeof(allocInfo));
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memReq.size;
+    allocInfo.memoryTypeIndex = VulkanUtils::findMemoryType(m_memProps, memReq.memoryTypeBits,
+                                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (allocInfo.memoryTypeIndex == uint32_t(-1))
+        qFatal("Failed to find memory type for %s", what);
+    err = m_devFuncs->vkAllocateMemory(m_dev, &allocInfo, nullptr, mem);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to allocate %s memory: %d", what, err);
+    err = m_devFuncs->vkBindImageMemory(m_dev, *image, *mem, 0);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to bind %s memory: %d", what, err);
+
+    VkImageViewCreateInfo viewInfo;
+    memset(&viewInfo, 0, sizeof(viewInfo));
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = *image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = { aspect, 0, 1, 0, 1 };
+    err = m_devFuncs->vkCreateImageView(m_dev, &viewInfo, nullptr, view);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create %s view: %d", what, err);
+}
+
+void VulkanPickPass::createRenderPass()
+{
+    VkAttachmentDescription attachments[2];
+    memset(attachments, 0, sizeof(attachments));
+    // Содержимое прошлого кадра не нужно; после прохода - источник копирования
+    attachments[0].format = VK_FORMAT_R32_UINT;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    attachments[1].format = m_depthFormat;
+    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colorRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    VkAttachmentReference depthRef = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+    VkSubpassDescription subpass;
+    memset(&subpass, 0, sizeof(subpass));
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorRef;
+    subpass.pDepthStencilAttachment = &depthRef;
+
+    // Цель одна на все кадры: запись ждёт копирования и тестов глубины
+    // прошлого прохода, копирование ждёт записи этого
+    VkSubpassDependency deps[2];
+    memset(deps, 0, sizeof(deps));
+    deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    deps[0].dstSubpass = 0;
+    deps[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    deps[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    deps[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    deps[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+            | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    deps[1].srcSubpass = 0;
+    deps[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    deps[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    deps[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    deps[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    deps[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    VkRenderPassCreateInfo rpInfo;
+    memset(&rpInfo, 0, sizeof(rpInfo));
+    rpInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    rpInfo.attachmentCount = 2;
+    rpInfo.pAttachments = attachments;
+    rpInfo.subpassCount = 1;
+    rpInfo.pSubpasses = &subpass;
+    rpInfo.dependencyCount = 2;
+    rpInfo.pDependencies = deps;
+    VkResult err = m_devFuncs->vkCreateRenderPass(m_dev, &rpInfo, nullptr, &m_renderPass);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create pick render pass: %d", err);
+}
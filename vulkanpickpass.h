@@ -0,0 +1,72 @@
+// vulkanpickpass.h
+#ifndef VULKANPICKPASS_H
+#define VULKANPICKPASS_H
+
+#include <QtQuick/QQuickWindow>
+#include <QVulkanInstance>
+#include <QVulkanFunctions>
+#include <QMatrix4x4>
+#include "vulkanutils.h"
+
+// Выбор объекта под курсором по буферу идентификаторов.
+//
+// Отдельный проход вне основного render pass с целью 1x1 (R32_UINT и
+// глубина): рендерер рисует свои экземпляры ещё раз с pickMatrix(), которая
+// растягивает пиксель под курсором на всю цель, и фрагментный шейдер пишет
+// номер экземпляра + 1 (0 - пусто). Значение копируется в постоянно
+// отображённый буфер слота кадра и читается без ожидания GPU, когда слот
+// становится текущим снова (как запросы VulkanPipelineStatistics).
+// Растеризуется и читается один пиксель, сколько бы экземпляров ни было.
+class VulkanPickPass
+{
+public:
+    VulkanPickPass(QQuickWindow *window, int framesInFlight);
+    ~VulkanPickPass();
+
+    // Для конвейера прохода: одно цветовое вложение R32_UINT, глубина
+    VkRenderPass renderPass() const { return m_renderPass; }
+
+    // Клип-пространство области viewportRect -> клип-пространство цели 1x1
+    // с центром в пикселе pixel (оба - в пикселях цели окна)
+    static QMatrix4x4 pickMatrix(const QRect &viewportRect, const QPoint &pixel);
+
+    // Начало кадра: результат прохода, записанного в этом слоте раньше.
+    // false - прохода не было; *instance = -1 - под курсором пусто
+    bool takeResult(int slot, int *instance);
+    // Записанные проходы, результат которых ещё не прочитан
+    bool isPending() const { return m_pendingCount > 0; }
+
+    // Вне render pass: begin() очищает цель и начинает проход, viewport и
+    // scissor - вся цель 1x1; end() завершает его и копирует результат в
+    // буфер слота
+    void begin(VkCommandBuffer cb);
+    void end(VkCommandBuffer cb, int slot);
+
+private:
+    void createImage(VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect,
+                     VkImage *image, VkDeviceMemory *mem, VkImageView *view, const char *what);
+    void createRenderPass();
+
+    VkDevice m_dev = VK_NULL_HANDLE;
+    QVulkanDeviceFunctions *m_devFuncs = nullptr;
+    VkPhysicalDeviceMemoryProperties m_memProps;
+    VkFormat m_depthFormat = VK_FORMAT_D16_UNORM;
+
+    VkImage m_idImage = VK_NULL_HANDLE;
+    VkDeviceMemory m_idMem = VK_NULL_HANDLE;
+    VkImageView m_idView = VK_NULL_HANDLE;
+    VkImage m_depthImage = VK_NULL_HANDLE;
+    VkDeviceMemory m_depthMem = VK_NULL_HANDLE;
+    VkImageView m_depthView = VK_NULL_HANDLE;
+    VkRenderPass m_renderPass = VK_NULL_HANDLE;
+    VkFramebuffer m_framebuffer = VK_NULL_HANDLE;
+
+    // По uint32_t на слот кадра
+    VkBuffer m_readbackBuf = VK_NULL_HANDLE;
+    VkDeviceMemory m_readbackMem = VK_NULL_HANDLE;
+    const uint32_t *m_readbackPtr = nullptr;
+    bool m_pending[3] = {};
+    int m_pendingCount = 0;
+};
+
+#endif
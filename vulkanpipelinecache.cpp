@@ -0,0 +1,139 @@
+// vulkanpipelinecache.cpp
+#include "vulkanpipelinecache.h"
+#include "vulkantrace.h"
+#include <QVulkanFunctions>
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <memory>
+
+struct SharedPipelineCache {
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    QVulkanDeviceFunctions *devFuncs = nullptr;
+    int refCount = 0;
+};
+
+typedef QHash<VkDevice, SharedPipelineCache> PipelineCacheRegistry;
+Q_GLOBAL_STATIC(QMutex, s_registryMutex)
+Q_GLOBAL_STATIC(PipelineCacheRegistry, s_caches)
+// Содержимое файла, прочитанное preloadData(); null - ещё не читали
+Q_GLOBAL_STATIC(QByteArray, s_fileData)
+static bool s_fileDataLoaded = false;
+
+static QString cacheFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/pipelines.bin");
+}
+
+static QByteArray readCacheFileLocked()
+{
+    if (!s_fileDataLoaded) {
+        s_fileDataLoaded = true;
+        QFile f(cacheFileName());
+        if (f.open(QIODevice::ReadOnly))
+            *s_fileData() = f.readAll();
+    }
+    return *s_fileData();
+}
+
+void VulkanPipelineCache::preloadData()
+{
+    VKQ_TRACE_SCOPE("VulkanPipelineCache::preloadData");
+    QMutexLocker lock(s_registryMutex());
+    readCacheFileLocked();
+}
+
+// Заголовок VkPipelineCacheHeaderVersionOne: длина, версия, vendorID,
+// deviceID, pipelineCacheUUID
+static bool isCompatible(const QByteArray &data, const VkPhysicalDeviceProperties &props)
+{
+    const int headerSize = 16 + VK_UUID_SIZE;
+    if (data.size() < headerSize)
+        return false;
+    quint32 header[4];
+    memcpy(header, data.constData(), sizeof(header));
+    return header[0] >= quint32(headerSize)
+            && header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+            && header[2] == props.vendorID
+            && header[3] == props.deviceID
+            && memcmp(data.constData() + 16, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+VkPipelineCache VulkanPipelineCache::acquire(QQuickWindow *window)
+{
+    QSGRendererInterface *rif = window->rendererInterface();
+    QVulkanInstance *inst = reinterpret_cast<QVulkanInstance *>(
+        rif->getResource(window, QSGRendererInterface::VulkanInstanceResource));
+    VkPhysicalDevice physDev = *reinterpret_cast<VkPhysicalDevice *>(
+        rif->getResource(window, QSGRendererInterface::PhysicalDeviceResource));
+    VkDevice dev = *reinterpret_cast<VkDevice *>(rif->getResource(window, QSGRendererInterface::DeviceResource));
+    Q_ASSERT(inst && physDev && dev);
+
+    QMutexLocker lock(s_registryMutex());
+    SharedPipelineCache &shared((*s_caches())[dev]);
+    if (!shared.cache) {
+        VKQ_TRACE_SCOPE("VulkanPipelineCache::create");
+        shared.devFuncs = inst->deviceFunctions(dev);
+
+        VkPhysicalDeviceProperties props;
+        inst->functions()->vkGetPhysicalDeviceProperties(physDev, &props);
+        const QByteArray data = readCacheFileLocked();
+        const bool useData = isCompatible(data, props);
+
+        VkPipelineCacheCreateInfo pipelineCacheInfo;
+        memset(&pipelineCacheInfo, 0, sizeof(pipelineCacheInfo));
+        pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        if (useData) {
+            pipelineCacheInfo.initialDataSize = size_t(data.size());
+            pipelineCacheInfo.pInitialData = data.constData();
+        }
+        VkResult err = shared.devFuncs->vkCreatePipelineCache(dev, &pipelineCacheInfo, nullptr, &shared.cache);
+        if (err != VK_SUCCESS)
+            qFatal("Failed to create pipeline cache: %d", err);
+        qDebug("pipeline cache: %s", useData ? "restored from disk" : "empty");
+    }
+    ++shared.refCount;
+    return shared.cache;
+}
+
+void VulkanPipelineCache::release(VkDevice dev)
+{
+    QMutexLocker lock(s_registryMutex());
+    auto it = s_caches()->find(dev);
+    if (it == s_caches()->end() || --it->refCount > 0)
+        return;
+
+    VKQ_TRACE_SCOPE("VulkanPipelineCache::save");
+    QVulkanDeviceFunctions *df = it->devFuncs;
+    size_t size = 0;
+    if (df->vkGetPipelineCacheData(dev, it->cache, &size, nullptr) == VK_SUCCESS && size) {
+        QByteArray data(qsizetype(size), Qt::Uninitialized);
+        if (df->vkGetPipelineCacheData(dev, it->cache, &size, data.data()) == VK_SUCCESS) {
+            data.truncate(qsizetype(size));
+            QDir().mkpath(QStandardPaths::writableLocation(QStandardPaths::CacheLocation));
+            QSaveFile f(cacheFileName());
+            if (f.open(QIODevice::WriteOnly) && f.write(data) == data.size() && f.commit())
+                *s_fileData() = data;
+            else
+                qWarning("Failed to write pipeline cache %s", qPrintable(cacheFileName()));
+        }
+    }
+    df->vkDestroyPipelineCache(dev, it->cache, nullptr);
+    s_caches()->erase(it);
+}
+
+std::shared_future<VkPipeline> VulkanPipelineCache::createAsync(std::function<VkPipeline()> create)
+{
+    auto task = std::make_shared<std::packaged_task<VkPipeline()>>([create] {
+        VKQ_TRACE_SCOPE("VulkanPipelineCache::createAsync");
+        return create();
+    });
+    std::shared_future<VkPipeline> result = task->get_future().share();
+    // Впереди заданий предзагрузки: пайплайн ждёт первый кадр
+    QThreadPool::globalInstance()->start([task] { (*task)(); }, 1);
+    return result;
+}
@@ -0,0 +1,35 @@
+// vulkanpipelinecache.h
+#ifndef VULKANPIPELINECACHE_H
+#define VULKANPIPELINECACHE_H
+
+#include <QtQuick/QQuickWindow>
+#include <QVulkanInstance>
+#include <functional>
+#include <future>
+
+// Общий VkPipelineCache на VkDevice, сохраняемый между запусками.
+//
+// Рендереры всех окон берут кэш через acquire() вместо собственного, поэтому
+// одинаковые пайплайны компилируются один раз. Начальные данные читаются с
+// диска заранее (preloadData() на рабочем потоке при старте), при
+// освобождении последней ссылки кэш записывается обратно. Данные другого
+// устройства или драйвера отбрасываются по заголовку (pipelineCacheUUID).
+//
+// createAsync() собирает пайплайн на рабочем потоке глобального пула:
+// драйвер компилирует шейдеры, пока поток рендеринга готовит буферы,
+// дескрипторы и текстуры, а результат забирается перед первой записью
+// команд. VkPipelineCache синхронизирован внутри драйвера.
+class VulkanPipelineCache
+{
+public:
+    static void preloadData();
+
+    static VkPipelineCache acquire(QQuickWindow *window);
+    static void release(VkDevice dev);
+
+    // create выполняется на рабочем потоке: всё, что он читает, не должно
+    // меняться до get(). Ссылку на кэш нельзя отпускать раньше get().
+    static std::shared_future<VkPipeline> createAsync(std::function<VkPipeline()> create);
+};
+
+#endif
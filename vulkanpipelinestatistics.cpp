@@ -0,0 +1,27 @@
+// vulkanpipelinestatistics.cpp
+#include "vulkanpipelinestatistics.h"
+
+VulkanPipelineStatistics::VulkanPipelineStatistics(QObject *parent)
+    : QObject(parent)
+{
+}
+
+qreal VulkanPipelineStatistics::overdraw() const
+{
+    return m_pixelArea > 0 ? qreal(m_statistics.fragmentShaderInvocations) / m_pixelArea : 0;
+}
+
+void VulkanPipelineStatistics::sync(QQuickWindow *window, QObject *renderer, qreal pixelArea)
+{
+    VulkanDrawOrder::Statistics statistics;
+    if (!VulkanDrawOrder::forWindow(window)->takeStatistics(renderer, &statistics))
+        return;
+
+    // Объект живёт в GUI-потоке, свойства меняются там же
+    QMetaObject::invokeMethod(this, [this, statistics, pixelArea] {
+        m_statistics = statistics;
+        m_pixelArea = pixelArea;
+        m_available = true;
+        emit changed();
+    }, Qt::QueuedConnection);
+}
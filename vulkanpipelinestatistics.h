@@ -0,0 +1,51 @@
+// vulkanpipelinestatistics.h
+#ifndef VULKANPIPELINESTATISTICS_H
+#define VULKANPIPELINESTATISTICS_H
+
+#include <QtQuick/QQuickWindow>
+#include <QObject>
+#include "vulkandraworder.h"
+
+// Статистика конвейера для отрисовки одного элемента за последний
+// измеренный кадр: сколько вершин прочитано, сколько раз запущен вершинный
+// шейдер, сколько примитивов дошло до растеризации и сколько раз запущен
+// фрагментный шейдер. overdraw - вызовы фрагментного шейдера на пиксель
+// области элемента. Собирается только с ключом --pipeline-stats, иначе
+// available остаётся false.
+//
+// Запросы читаются без ожидания GPU, когда слот кадра становится текущим
+// снова, поэтому значения отстают на framesInFlight кадров.
+class VulkanPipelineStatistics : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(bool available READ available NOTIFY changed)
+    Q_PROPERTY(qreal inputAssemblyVertices READ inputAssemblyVertices NOTIFY changed)
+    Q_PROPERTY(qreal vertexShaderInvocations READ vertexShaderInvocations NOTIFY changed)
+    Q_PROPERTY(qreal clippingPrimitives READ clippingPrimitives NOTIFY changed)
+    Q_PROPERTY(qreal fragmentShaderInvocations READ fragmentShaderInvocations NOTIFY changed)
+    Q_PROPERTY(qreal overdraw READ overdraw NOTIFY changed)
+
+public:
+    explicit VulkanPipelineStatistics(QObject *parent = nullptr);
+
+    bool available() const { return m_available; }
+    qreal inputAssemblyVertices() const { return qreal(m_statistics.inputAssemblyVertices); }
+    qreal vertexShaderInvocations() const { return qreal(m_statistics.vertexShaderInvocations); }
+    qreal clippingPrimitives() const { return qreal(m_statistics.clippingPrimitives); }
+    qreal fragmentShaderInvocations() const { return qreal(m_statistics.fragmentShaderInvocations); }
+    qreal overdraw() const;
+
+    // Вызывается из sync() элемента на потоке рендеринга; pixelArea -
+    // площадь области отрисовки в пикселях
+    void sync(QQuickWindow *window, QObject *renderer, qreal pixelArea);
+
+signals:
+    void changed();
+
+private:
+    VulkanDrawOrder::Statistics m_statistics;
+    qreal m_pixelArea = 0;
+    bool m_available = false;
+};
+
+#endif
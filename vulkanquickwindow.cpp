@@ -1,12 +1,323 @@
 // vulkanquickwindow.cpp
 #include "vulkanquickwindow.h"
+#include "vulkandevicefeatures.h"
+#include "vulkanshareddevice.h"
+#include <QtQuick/QQuickGraphicsConfiguration>
+#include <QtQuick/QQuickGraphicsDevice>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <atomic>
+
+// Состояние регулятора. Его держит и окно, и обработчик afterFrameEnd:
+// поток рендеринга может оказаться в frameEnded(), когда окно уже разрушается.
+struct VulkanQuickWindow::Pacing
+{
+    Pacing() { clock.start(); }
+
+    qint64 interval() const;
+    void frameEnded();
+    qint64 remaining();
+    void wake();
+
+    // Интервалы в наносекундах, 0 - без ограничения
+    std::atomic<qint64> activeInterval { 0 };
+    std::atomic<qint64> idleInterval { 0 };
+    std::atomic<bool> idle { false };
+    std::atomic<bool> reset { false };
+
+    QElapsedTimer clock;
+    // Момент следующего кадра пишет поток рендеринга, читает GUI-поток
+    QMutex mutex;
+    qint64 nextFrame = 0;
+    bool wakeRequested = false;
+};
+
+qint64 VulkanQuickWindow::Pacing::interval() const
+{
+    return idle.load(std::memory_order_relaxed)
+            ? idleInterval.load(std::memory_order_relaxed)
+            : activeInterval.load(std::memory_order_relaxed);
+}
+
+// Кадр отправлен: следующий не раньше чем через интервал. Поток рендеринга
+// здесь не ждёт, кадр откладывает окно (UpdateRequest в event()).
+void VulkanQuickWindow::Pacing::frameEnded()
+{
+    const qint64 frameInterval = interval();
+    const qint64 now = clock.nsecsElapsed();
+    QMutexLocker lock(&mutex);
+    // После паузы или простоя без кадров часы начинаются заново, а не
+    // догоняют пропущенные интервалы
+    if (reset.exchange(false, std::memory_order_relaxed) || now - nextFrame > frameInterval)
+        nextFrame = now;
+    nextFrame += frameInterval;
+}
+
+// Сколько наносекунд осталось до следующего кадра; ввод и смена настроек
+// (wake()) разрешают кадр сразу
+qint64 VulkanQuickWindow::Pacing::remaining()
+{
+    if (interval() <= 0)
+        return 0;
+    const qint64 now = clock.nsecsElapsed();
+    QMutexLocker lock(&mutex);
+    if (wakeRequested) {
+        nextFrame = now;
+        wakeRequested = false;
+    }
+    return qMax<qint64>(0, nextFrame - now);
+}
+
+void VulkanQuickWindow::Pacing::wake()
+{
+    QMutexLocker lock(&mutex);
+    wakeRequested = true;
+}
 
 VulkanQuickWindow::VulkanQuickWindow()
+    : m_pacing(QSharedPointer<Pacing>::create())
 {
     // Экземпляр Vulkan теперь глобальный, ничего не создаём здесь
+    m_idleTimer.setSingleShot(true);
+    m_idleTimer.setInterval(int(m_idleTimeout * 1000));
+    connect(&m_idleTimer, &QTimer::timeout, this, &VulkanQuickWindow::enterIdle);
+    m_deferredUpdate.setSingleShot(true);
+    m_deferredUpdate.setTimerType(Qt::PreciseTimer);
+    connect(&m_deferredUpdate, &QTimer::timeout, this, &QWindow::requestUpdate);
+    // Обработчик держит свою ссылку на состояние и не трогает окно
+    connect(this, &QQuickWindow::afterFrameEnd, this, [pacing = m_pacing] { pacing->frameEnded(); },
+            Qt::DirectConnection);
+    connect(this, &QWindow::visibilityChanged, this, &VulkanQuickWindow::handleVisibilityChanged);
+    connect(this, &QQuickWindow::sceneGraphInitialized, this, &VulkanQuickWindow::handleSceneGraphInitialized,
+            Qt::DirectConnection);
 }
 
 VulkanQuickWindow::~VulkanQuickWindow()
 {
     // Экземпляр уничтожится после приложения, ничего не удаляем здесь
 }
+
+void VulkanQuickWindow::requestFrame(QQuickWindow *window)
+{
+    auto *paced = qobject_cast<VulkanQuickWindow *>(window);
+    if (!paced || paced->m_pacing->interval() <= 0 || QThread::currentThread() == window->thread()) {
+        window->update();
+        return;
+    }
+    // update() с потока рендеринга threaded render loop перерисовывает без
+    // UpdateRequest, мимо регулятора; через GUI-поток кадр отложится
+    QMetaObject::invokeMethod(window, &QQuickWindow::update, Qt::QueuedConnection);
+}
+
+bool VulkanQuickWindow::isIdle() const
+{
+    return m_pacing->idle.load(std::memory_order_relaxed);
+}
+
+qint64 VulkanQuickWindow::intervalFor(qreal fps)
+{
+    return fps > 0 ? qint64(1e9 / fps) : 0;
+}
+
+void VulkanQuickWindow::setTargetFps(qreal fps)
+{
+    fps = qMax<qreal>(0, fps);
+    if (fps == m_targetFps)
+        return;
+    m_targetFps = fps;
+    m_pacing->activeInterval.store(intervalFor(fps), std::memory_order_relaxed);
+    wakePacing();
+    emit targetFpsChanged();
+}
+
+void VulkanQuickWindow::setIdleFps(qreal fps)
+{
+    fps = qMax<qreal>(0, fps);
+    if (fps == m_idleFps)
+        return;
+    m_idleFps = fps;
+    m_pacing->idleInterval.store(intervalFor(fps), std::memory_order_relaxed);
+    if (fps > 0 && !isIdle())
+        m_idleTimer.start();
+    wakePacing();
+    emit idleFpsChanged();
+}
+
+void VulkanQuickWindow::setIdleTimeout(qreal seconds)
+{
+    seconds = qMax<qreal>(0, seconds);
+    if (seconds == m_idleTimeout)
+        return;
+    m_idleTimeout = seconds;
+    m_idleTimer.setInterval(int(seconds * 1000));
+    if (m_idleFps > 0 && !isIdle())
+        m_idleTimer.start();
+    emit idleTimeoutChanged();
+}
+
+void VulkanQuickWindow::setPauseWhenHidden(bool pause)
+{
+    if (pause == m_pauseWhenHidden)
+        return;
+    m_pauseWhenHidden = pause;
+    emit pauseWhenHiddenChanged();
+}
+
+void VulkanQuickWindow::setPhysicalDevice(const QString &selector)
+{
+    if (selector == m_physicalDevice)
+        return;
+    m_physicalDevice = selector;
+    emit physicalDeviceChanged();
+}
+
+void VulkanQuickWindow::setDeviceExtensions(const QStringList &extensions)
+{
+    if (extensions == m_deviceExtensions)
+        return;
+    m_deviceExtensions = extensions;
+    emit deviceExtensionsChanged();
+}
+
+void VulkanQuickWindow::setDeviceFeatures(const QStringList &features)
+{
+    if (features == m_deviceFeatures)
+        return;
+    m_deviceFeatures = features;
+    emit deviceFeaturesChanged();
+}
+
+void VulkanQuickWindow::setupGraphicsDevice(QVulkanInstance *inst)
+{
+    setVulkanInstance(inst);
+    // Читается потоком рендеринга в handleSceneGraphInitialized()
+    m_requestedFeatures = VulkanDeviceFeatures::fromNames(m_deviceFeatures);
+    if (VulkanSharedDevice::isActive()) {
+        VulkanSharedDevice::attach(this);
+        return;
+    }
+
+    // Устройство создаёт Qt: выбираем физическое устройство и добавляем
+    // расширения; возможности ядра Qt включает все поддерживаемые
+    if (!m_physicalDevice.isEmpty()) {
+        VkPhysicalDevice physDev = VulkanDeviceFeatures::selectPhysicalDevice(inst, m_physicalDevice);
+        if (physDev)
+            setGraphicsDevice(QQuickGraphicsDevice::fromPhysicalDevice(physDev));
+    }
+
+    const VulkanDeviceFeatures::Features extensionOnly = m_requestedFeatures
+            & VulkanDeviceFeatures::extensionFeatures();
+    if (extensionOnly) {
+        qWarning("%s: only available on the application-created device (--shared-device)",
+                 qPrintable(VulkanDeviceFeatures::names(extensionOnly).join(QLatin1String(", "))));
+    }
+
+    QByteArrayList extensions;
+    for (const QString &ext : std::as_const(m_deviceExtensions))
+        extensions.append(ext.toLatin1());
+    if (!extensions.isEmpty()) {
+        QQuickGraphicsConfiguration config = graphicsConfiguration();
+        config.setDeviceExtensions(extensions);
+        setGraphicsConfiguration(config);
+    }
+}
+
+void VulkanQuickWindow::handleSceneGraphInitialized()
+{
+    // Поток рендеринга, устройство уже создано
+    const VulkanDeviceFeatures::Features enabled = VulkanDeviceFeatures::enabled(this);
+    const VulkanDeviceFeatures::Features missing = m_requestedFeatures & ~enabled;
+    if (missing) {
+        qWarning("Requested device features are not enabled: %s",
+                 qPrintable(VulkanDeviceFeatures::names(missing).join(QLatin1String(", "))));
+    }
+    const QStringList names = VulkanDeviceFeatures::names(enabled);
+    QMetaObject::invokeMethod(this, [this, names] {
+        if (names == m_enabledDeviceFeatures)
+            return;
+        m_enabledDeviceFeatures = names;
+        emit enabledDeviceFeaturesChanged();
+    }, Qt::QueuedConnection);
+}
+
+bool VulkanQuickWindow::event(QEvent *e)
+{
+    switch (e->type()) {
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonRelease:
+    case QEvent::MouseButtonDblClick:
+    case QEvent::MouseMove:
+    case QEvent::Wheel:
+    case QEvent::KeyPress:
+    case QEvent::KeyRelease:
+    case QEvent::TouchBegin:
+    case QEvent::TouchUpdate:
+    case QEvent::TouchEnd:
+    case QEvent::TabletPress:
+    case QEvent::TabletMove:
+    case QEvent::TabletRelease:
+        leaveIdle();
+        break;
+    case QEvent::UpdateRequest: {
+        // Кадр откладывается до своего момента, update() до срабатывания
+        // таймера сливаются в один. Ни один поток при этом не ждёт: GUI-поток
+        // не блокируется в синхронизации ни при каком render loop.
+        const qint64 remaining = m_pacing->remaining();
+        if (remaining > 0) {
+            if (!m_deferredUpdate.isActive())
+                m_deferredUpdate.start(int((remaining + 999999) / 1000000));
+            return true;
+        }
+        m_deferredUpdate.stop();
+        break;
+    }
+    default:
+        break;
+    }
+    return QQuickView::event(e);
+}
+
+void VulkanQuickWindow::enterIdle()
+{
+    if (m_idleFps <= 0 || m_pacing->idle.exchange(true, std::memory_order_relaxed))
+        return;
+    emit idleChanged();
+}
+
+void VulkanQuickWindow::leaveIdle()
+{
+    if (m_idleFps > 0)
+        m_idleTimer.start();
+    if (!m_pacing->idle.exchange(false, std::memory_order_relaxed))
+        return;
+    // Кадр, ожидающий по частоте простоя, начинается сразу
+    wakePacing();
+    emit idleChanged();
+}
+
+void VulkanQuickWindow::handleVisibilityChanged(QWindow::Visibility visibility)
+{
+    if (!m_pauseWhenHidden)
+        return;
+    if (visibility == QWindow::Hidden || visibility == QWindow::Minimized) {
+        // Qt не рисует скрытое окно; таймер простоя не нужен, часы кадров
+        // после показа начинаются заново
+        m_idleTimer.stop();
+        m_pacing->reset.store(true, std::memory_order_relaxed);
+        wakePacing();
+    } else {
+        leaveIdle();
+    }
+}
+
+void VulkanQuickWindow::wakePacing()
+{
+    m_pacing->wake();
+    // Отложенный кадр начинается сразу
+    if (m_deferredUpdate.isActive()) {
+        m_deferredUpdate.stop();
+        requestUpdate();
+    }
+}
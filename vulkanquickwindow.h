@@ -3,14 +3,120 @@
 #define VULKANQUICKWINDOW_H
 
 #include <QtQuick/QQuickView>
+#include <QVulkanInstance>
+#include "vulkandevicefeatures.h"
+#include <QSharedPointer>
+#include <QTimer>
 
+// Окно с регулятором частоты кадров.
+//
+// Элементы вызывают update() на каждое изменение, а бесконечные анимации
+// держат рендеринг на частоте vsync, даже когда на экран никто не смотрит.
+// Регулятор не трогает элементы: после каждого кадра (afterFrameEnd) он
+// запоминает момент следующего, а запрос кадра (UpdateRequest), пришедший
+// раньше, откладывает таймером, и все update() за это время сливаются в один
+// кадр. Частота - targetFps, а после idleTimeout секунд без ввода - idleFps;
+// ввод сразу возвращает targetFps. Свёрнутое или скрытое окно Qt не рисует;
+// с pauseWhenHidden регулятор ещё и сбрасывает часы, чтобы после показа не
+// догонять кадры.
+//
+// Никакой поток не ждёт: GUI-поток обрабатывает ввод и таймеры и при
+// threaded, и при basic render loop. Кадры, которые рендереры запрашивают с
+// потока рендеринга, идут через requestFrame(), иначе они миновали бы
+// UpdateRequest и регулятор.
+// 0 в targetFps и idleFps - без ограничения.
+//
+// Устройство: physicalDevice выбирает физическое устройство (см.
+// VulkanDeviceFeatures::selectPhysicalDevice), deviceExtensions и
+// deviceFeatures запрашивают расширения и возможности. Применяются
+// setupGraphicsDevice() до первого показа; окно на VulkanSharedDevice
+// получает устройство, выбранное при его создании. enabledDeviceFeatures -
+// что включено на самом деле, рендереры берут то же из VulkanDeviceFeatures.
 class VulkanQuickWindow : public QQuickView
 {
     Q_OBJECT
+    Q_PROPERTY(qreal targetFps READ targetFps WRITE setTargetFps NOTIFY targetFpsChanged)
+    Q_PROPERTY(qreal idleFps READ idleFps WRITE setIdleFps NOTIFY idleFpsChanged)
+    Q_PROPERTY(qreal idleTimeout READ idleTimeout WRITE setIdleTimeout NOTIFY idleTimeoutChanged)
+    Q_PROPERTY(bool pauseWhenHidden READ pauseWhenHidden WRITE setPauseWhenHidden NOTIFY pauseWhenHiddenChanged)
+    Q_PROPERTY(bool idle READ isIdle NOTIFY idleChanged)
+    Q_PROPERTY(QString physicalDevice READ physicalDevice WRITE setPhysicalDevice NOTIFY physicalDeviceChanged)
+    Q_PROPERTY(QStringList deviceExtensions READ deviceExtensions WRITE setDeviceExtensions NOTIFY deviceExtensionsChanged)
+    Q_PROPERTY(QStringList deviceFeatures READ deviceFeatures WRITE setDeviceFeatures NOTIFY deviceFeaturesChanged)
+    Q_PROPERTY(QStringList enabledDeviceFeatures READ enabledDeviceFeatures NOTIFY enabledDeviceFeaturesChanged)
 
 public:
     VulkanQuickWindow();
     ~VulkanQuickWindow();
+
+    qreal targetFps() const { return m_targetFps; }
+    void setTargetFps(qreal fps);
+    qreal idleFps() const { return m_idleFps; }
+    void setIdleFps(qreal fps);
+    // Секунды
+    qreal idleTimeout() const { return m_idleTimeout; }
+    void setIdleTimeout(qreal seconds);
+    bool pauseWhenHidden() const { return m_pauseWhenHidden; }
+    void setPauseWhenHidden(bool pause);
+    bool isIdle() const;
+
+    QString physicalDevice() const { return m_physicalDevice; }
+    void setPhysicalDevice(const QString &selector);
+    QStringList deviceExtensions() const { return m_deviceExtensions; }
+    void setDeviceExtensions(const QStringList &extensions);
+    QStringList deviceFeatures() const { return m_deviceFeatures; }
+    void setDeviceFeatures(const QStringList &features);
+    QStringList enabledDeviceFeatures() const { return m_enabledDeviceFeatures; }
+
+    // Экземпляр Vulkan и выбор устройства, до первого показа окна
+    void setupGraphicsDevice(QVulkanInstance *inst);
+
+    // Следующий кадр с потока рендеринга (анимация, незавершённая загрузка).
+    // Без ограничения частоты - сразу update(), GUI-поток не просыпается;
+    // с ограничением запрос идёт через GUI-поток, где кадр отложит регулятор.
+    static void requestFrame(QQuickWindow *window);
+
+signals:
+    void targetFpsChanged();
+    void idleFpsChanged();
+    void idleTimeoutChanged();
+    void pauseWhenHiddenChanged();
+    void idleChanged();
+    void physicalDeviceChanged();
+    void deviceExtensionsChanged();
+    void deviceFeaturesChanged();
+    void enabledDeviceFeaturesChanged();
+
+protected:
+    bool event(QEvent *e) override;
+
+private slots:
+    void enterIdle();
+    void handleVisibilityChanged(QWindow::Visibility visibility);
+    void handleSceneGraphInitialized();
+
+private:
+    static qint64 intervalFor(qreal fps);
+    void leaveIdle();
+    void wakePacing();
+
+    qreal m_targetFps = 0;
+    qreal m_idleFps = 0;
+    qreal m_idleTimeout = 30;
+    bool m_pauseWhenHidden = true;
+    QTimer m_idleTimer;
+
+    QString m_physicalDevice;
+    QStringList m_deviceExtensions;
+    QStringList m_deviceFeatures;
+    QStringList m_enabledDeviceFeatures;
+    VulkanDeviceFeatures::Features m_requestedFeatures;
+
+    // Общее с обработчиком afterFrameEnd, переживает окно
+    struct Pacing;
+    QSharedPointer<Pacing> m_pacing;
+    // Отложенный запрос кадра, когда кадры рисует GUI-поток
+    QTimer m_deferredUpdate;
 };
 
 #endif
@@ -0,0 +1,844 @@
+// vulkanscene.cpp
+#include "vulkanscene.h"
+#include "vulkanassetcache.h"
+#include "vulkandraworder.h"
+#include "vulkanpickpass.h"
+#include "vulkanpipelinecache.h"
+#include "vulkanquickwindow.h"
+#include "vulkantrace.h"
+#include "vulkanutils.h"
+#include <QtCore/QRunnable>
+#include <QtQuick/QQuickWindow>
+
+#include <QVulkanInstance>
+#include <QVulkanFunctions>
+#include <QtMath>
+#include <algorithm>
+
+typedef VulkanSceneNodes::GpuNode GpuNode;
+
+class SceneRenderer : public QObject
+{
+    Q_OBJECT
+public:
+    ~SceneRenderer();
+
+    void setParams(const QMatrix4x4 &matrix, const QVector3D &lightDirection)
+    {
+        if (matrix != m_matrix)
+            m_pickDirty = true;
+        m_matrix = matrix;
+        m_lightDirection = lightDirection;
+    }
+    // full - все записи (новый рендерер или clear()), иначе только changed
+    void syncNodes(const VulkanSceneNodes &nodes, const QList<int> &changed, bool full);
+    void setViewportRect(const QRect &rect)
+    {
+        if (rect != m_viewportRect)
+            m_pickDirty = true;
+        m_viewportRect = rect;
+    }
+    void setWindow(QQuickWindow *window) { m_window = window; }
+    // Пиксель цели под курсором; enabled = false - выбор не нужен
+    void setPickPoint(bool enabled, const QPoint &pixel);
+    // Новый результат выбора с прошлого вызова: индекс узла или -1
+    bool takePicked(int *instance);
+
+    void mainPassRecordingStart(VkCommandBuffer cb);
+
+public slots:
+    void frameStart();
+
+private:
+    void init(int framesInFlight);
+    void ensureNodeBuffer(int count);
+    void ensureStaging(int slot, VkDeviceSize size);
+    void uploadNodes(int slot);
+    void pushParams(VkCommandBuffer cb, const QMatrix4x4 &matrix);
+    void pick(int slot);
+    VkPipeline createPipeline(const QString &vertName, const QString &fragName, VkRenderPass renderPass);
+
+    QMatrix4x4 m_matrix;
+    QVector3D m_lightDirection;
+    QRect m_viewportRect;
+    QQuickWindow *m_window = nullptr;
+    int m_framesInFlight = 0;
+
+    // Копия всех записей (нужна для полной загрузки после роста буфера)
+    // и записи, ещё не перенесённые в буфер GPU
+    QList<GpuNode> m_records;
+    QList<int> m_pending;
+    bool m_fullUpload = true;
+    // Узлов в буфере GPU, рисуется столько экземпляров
+    uint32_t m_drawCount = 0;
+
+    bool m_initialized = false;
+    VkPhysicalDevice m_physDev = VK_NULL_HANDLE;
+    VkDevice m_dev = VK_NULL_HANDLE;
+    QVulkanDeviceFunctions *m_devFuncs = nullptr;
+    QVulkanFunctions *m_funcs = nullptr;
+    VkPhysicalDeviceMemoryProperties m_memProps;
+    VkRenderPass m_renderPass = VK_NULL_HANDLE;
+
+    VkBuffer m_nodeBuf = VK_NULL_HANDLE;
+    VkDeviceMemory m_nodeMem = VK_NULL_HANDLE;
+    int m_nodeCapacity = 0;
+    // Номер буфера узлов: дескриптор может ссылаться на уничтоженный буфер
+    // с тем же значением хэндла
+    quint64 m_nodeBufGeneration = 0;
+    QList<VulkanUtils::RetiredBuffer> m_retired;
+    quint64 m_frame = 0;
+
+    struct Staging {
+        VkBuffer buf = VK_NULL_HANDLE;
+        VkDeviceMemory mem = VK_NULL_HANDLE;
+        char *ptr = nullptr;
+        VkDeviceSize capacity = 0;
+    };
+    Staging m_staging[3];
+    // Набор на слот: его можно обновить, когда кадр слота завершён
+    VkDescriptorSet m_descriptorSets[3] = {};
+    quint64 m_boundGenerations[3] = {};
+
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_resLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkPipeline m_pipeline = VK_NULL_HANDLE;
+
+    // Выбор узла под курсором, создаётся с первым запросом
+    VulkanPickPass *m_pickPass = nullptr;
+    VkPipeline m_pickPipeline = VK_NULL_HANDLE;
+    bool m_pickEnabled = false;
+    QPoint m_pickPixel;
+    // Курсор, узлы или проекция изменились после последнего прохода
+    bool m_pickDirty = false;
+    int m_pickResult = -1;
+    bool m_hasPickResult = false;
+};
+
+// mat4 + vec4, см. блок Params в scene.vert
+const uint32_t SCENE_PUSH_CONSTANTS_SIZE = 16 * sizeof(float) + 4 * sizeof(float);
+// Вершин на куб: 6 граней по 2 треугольника
+const uint32_t SCENE_CUBE_VERTICES = 36;
+// Минимальная ёмкость буферов в узлах, дальше рост до степени двойки
+const int SCENE_MIN_CAPACITY = 1024;
+
+VulkanScene::VulkanScene()
+{
+    connect(this, &QQuickItem::windowChanged, this, &VulkanScene::handleWindowChanged);
+}
+
+void VulkanScene::changed()
+{
+    if (window())
+        window()->update();
+}
+
+void VulkanScene::setMatrix(const QMatrix4x4 &matrix)
+{
+    if (matrix == m_matrix)
+        return;
+    m_matrix = matrix;
+    emit matrixChanged();
+    changed();
+}
+
+void VulkanScene::setLightDirection(const QVector3D &direction)
+{
+    if (direction == m_lightDirection)
+        return;
+    m_lightDirection = direction;
+    emit lightDirectionChanged();
+    changed();
+}
+
+bool VulkanScene::isValidNode(int node, const char *what) const
+{
+    if (node >= 0 && node < m_nodes.count())
+        return true;
+    qWarning("VulkanScene::%s: node %d is out of range (%d nodes)", what, node, m_nodes.count());
+    return false;
+}
+
+int VulkanScene::addNode(int parent)
+{
+    if (parent >= 0 && !isValidNode(parent, "addNode"))
+        return -1;
+    const int node = m_nodes.add(parent);
+    emit nodeCountChanged();
+    changed();
+    return node;
+}
+
+void VulkanScene::clear()
+{
+    if (!m_nodes.count())
+        return;
+    m_nodes.clear();
+    m_cleared = true;
+    emit nodeCountChanged();
+    changed();
+}
+
+void VulkanScene::setTranslation(int node, const QVector3D &translation)
+{
+    if (!isValidNode(node, "setTranslation"))
+        return;
+    m_nodes.setTranslation(node, translation);
+    changed();
+}
+
+void VulkanScene::setRotation(int node, const QQuaternion &rotation)
+{
+    if (!isValidNode(node, "setRotation"))
+        return;
+    m_nodes.setRotation(node, rotation);
+    changed();
+}
+
+void VulkanScene::setScale(int node, const QVector3D &scale)
+{
+    if (!isValidNode(node, "setScale"))
+        return;
+    m_nodes.setScale(node, scale);
+    changed();
+}
+
+void VulkanScene::setColor(int node, const QColor &color)
+{
+    if (!isValidNode(node, "setColor"))
+        return;
+    m_nodes.setColor(node, color);
+    changed();
+}
+
+void VulkanScene::setPicking(bool picking)
+{
+    if (picking == m_picking)
+        return;
+    m_picking = picking;
+    setAcceptHoverEvents(picking);
+    if (!picking) {
+        m_hovering = false;
+        m_picked = -1;
+        reportPicked();
+    }
+    emit pickingChanged();
+    changed();
+}
+
+void VulkanScene::hoverEnterEvent(QHoverEvent *event)
+{
+    m_hovering = true;
+    m_cursor = event->position();
+    changed();
+}
+
+void VulkanScene::hoverMoveEvent(QHoverEvent *event)
+{
+    m_cursor = event->position();
+    changed();
+}
+
+void VulkanScene::hoverLeaveEvent(QHoverEvent *event)
+{
+    Q_UNUSED(event);
+    m_hovering = false;
+    m_picked = -1;
+    reportPicked();
+    changed();
+}
+
+// GUI-поток; результат рендерера мог устареть, пока шёл в очереди
+void VulkanScene::reportPicked()
+{
+    if (m_picked == m_reportedPicked)
+        return;
+    m_reportedPicked = m_picked;
+    emit picked(m_reportedPicked);
+}
+
+void VulkanScene::handleWindowChanged(QQuickWindow *win)
+{
+    if (win) {
+        connect(win, &QQuickWindow::beforeSynchronizing, this, &VulkanScene::sync, Qt::DirectConnection);
+        connect(win, &QQuickWindow::sceneGraphInvalidated, this, &VulkanScene::cleanup, Qt::DirectConnection);
+    }
+}
+
+void VulkanScene::cleanup()
+{
+    delete m_renderer;
+    m_renderer = nullptr;
+}
+
+class SceneCleanupJob : public QRunnable
+{
+public:
+    SceneCleanupJob(SceneRenderer *renderer) : m_renderer(renderer) { }
+    void run() override { delete m_renderer; }
+private:
+    SceneRenderer *m_renderer;
+};
+
+void VulkanScene::releaseResources()
+{
+    window()->scheduleRenderJob(new SceneCleanupJob(m_renderer), QQuickWindow::BeforeSynchronizingStage);
+    m_renderer = nullptr;
+}
+
+void VulkanScene::sync()
+{
+    VKQ_TRACE_SCOPE("VulkanScene::sync");
+    // Новый рендерер ничего не знает об узлах и получает все записи
+    bool full = m_cleared;
+    if (!m_renderer) {
+        m_renderer = new SceneRenderer;
+        connect(window(), &QQuickWindow::beforeRendering, m_renderer, &SceneRenderer::frameStart, Qt::DirectConnection);
+        SceneRenderer *renderer = m_renderer;
+        VulkanDrawOrder::forWindow(window())->add(renderer, VulkanDrawOrder::OpaqueStage, "VulkanScene",
+                                                  [renderer](VkCommandBuffer cb) { renderer->mainPassRecordingStart(cb); });
+        full = true;
+    }
+    m_cleared = false;
+
+    // GUI-поток заблокирован: пересчёт изменённых поддеревьев и передача
+    // только изменённых записей
+    m_nodes.update();
+    const QList<int> changedNodes = m_nodes.takeChanged();
+    m_renderer->syncNodes(m_nodes, changedNodes, full);
+    m_renderer->setParams(m_matrix, m_lightDirection);
+
+    const qreal dpr = window()->effectiveDevicePixelRatio();
+    const QRectF sceneRect = mapRectToScene(boundingRect());
+    const QRect windowRect(QPoint(0, 0), window()->size() * dpr);
+    const QRect viewportRect = QRectF(sceneRect.topLeft() * dpr, sceneRect.size() * dpr)
+            .toAlignedRect().intersected(windowRect);
+    m_renderer->setViewportRect(viewportRect);
+    m_renderer->setWindow(window());
+
+    // Результат прошлых кадров; сигнал - в GUI-потоке после sync()
+    const bool picking = m_picking && m_hovering;
+    const QPointF cursor = mapToScene(m_cursor) * dpr;
+    m_renderer->setPickPoint(picking, QPoint(qFloor(cursor.x()), qFloor(cursor.y())));
+    int instance = -1;
+    if (m_renderer->takePicked(&instance) && picking && instance != m_picked) {
+        m_picked = instance;
+        QMetaObject::invokeMethod(this, &VulkanScene::reportPicked, Qt::QueuedConnection);
+    }
+
+    m_pipelineStatistics->sync(window(), m_renderer, qreal(viewportRect.width()) * viewportRect.height());
+}
+
+SceneRenderer::~SceneRenderer()
+{
+    qDebug("scene cleanup");
+    if (m_window)
+        VulkanDrawOrder::unregister(m_window, this);
+    if (!m_devFuncs)
+        return;
+
+    m_devFuncs->vkDestroyPipeline(m_dev, m_pipeline, nullptr);
+    m_devFuncs->vkDestroyPipeline(m_dev, m_pickPipeline, nullptr);
+    delete m_pickPass;
+    m_devFuncs->vkDestroyPipelineLayout(m_dev, m_pipelineLayout, nullptr);
+    m_devFuncs->vkDestroyDescriptorSetLayout(m_dev, m_resLayout, nullptr);
+    m_devFuncs->vkDestroyDescriptorPool(m_dev, m_descriptorPool, nullptr);
+    if (m_pipelineCache)
+        VulkanPipelineCache::release(m_dev);
+
+    for (VulkanUtils::RetiredBuffer &retired : m_retired)
+        VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &retired.buf, &retired.mem);
+    VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &m_nodeBuf, &m_nodeMem);
+    for (Staging &staging : m_staging) {
+        if (staging.ptr)
+            m_devFuncs->vkUnmapMemory(m_dev, staging.mem);
+        VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &staging.buf, &staging.mem);
+    }
+
+    qDebug("scene released");
+}
+
+void SceneRenderer::setPickPoint(bool enabled, const QPoint &pixel)
+{
+    if (enabled != m_pickEnabled || (enabled && pixel != m_pickPixel))
+        m_pickDirty = true;
+    m_pickEnabled = enabled;
+    m_pickPixel = pixel;
+}
+
+bool SceneRenderer::takePicked(int *instance)
+{
+    if (!m_hasPickResult)
+        return false;
+    m_hasPickResult = false;
+    *instance = m_pickResult;
+    return true;
+}
+
+void SceneRenderer::syncNodes(const VulkanSceneNodes &nodes, const QList<int> &changed, bool full)
+{
+    const GpuNode *gpu = nodes.gpuNodes();
+    if (full || !changed.isEmpty())
+        m_pickDirty = true;
+    if (full) {
+        m_records = QList<GpuNode>(gpu, gpu + nodes.count());
+        m_pending.clear();
+        m_fullUpload = true;
+        return;
+    }
+    // Новые узлы всегда среди изменённых
+    m_records.resize(nodes.count());
+    for (int node : changed)
+        m_records[node] = gpu[node];
+    if (m_fullUpload)
+        return;
+    // Больше половины узлов дешевле загрузить одним регионом
+    if (m_pending.size() + changed.size() > m_records.size() / 2) {
+        m_pending.clear();
+        m_fullUpload = true;
+        return;
+    }
+    m_pending.append(changed);
+}
+
+void SceneRenderer::frameStart()
+{
+    VKQ_TRACE_SCOPE("SceneRenderer::frameStart");
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    Q_ASSERT(rif->graphicsApi() == QSGRendererInterface::Vulkan);
+
+    const QQuickWindow::GraphicsStateInfo &stateInfo(m_window->graphicsStateInfo());
+    if (!m_initialized)
+        init(stateInfo.framesInFlight);
+
+    // Кадры, которые могли читать старый буфер узлов, завершены
+    ++m_frame;
+    while (!m_retired.isEmpty() && m_retired.first().frame <= m_frame) {
+        VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &m_retired.first().buf, &m_retired.first().mem);
+        m_retired.removeFirst();
+    }
+
+    const int slot = stateInfo.currentFrameSlot;
+    // Кадр, записавший выбор в этом слоте, завершён; sync() следующего
+    // кадра передаст результат элементу
+    int instance = -1;
+    if (m_pickPass && m_pickPass->takeResult(slot, &instance)) {
+        m_pickResult = instance;
+        m_hasPickResult = true;
+        VulkanQuickWindow::requestFrame(m_window);
+    }
+
+    m_drawCount = uint32_t(m_records.size());
+    if (m_drawCount == 0 || m_viewportRect.isEmpty()) {
+        if (m_pickEnabled && m_pickDirty) {
+            m_pickResult = -1;
+            m_hasPickResult = true;
+            m_pickDirty = false;
+        }
+        return;
+    }
+
+    ensureNodeBuffer(m_records.size());
+    if (m_fullUpload || !m_pending.isEmpty())
+        uploadNodes(slot);
+
+    // Набор слота не используется кадрами в полёте
+    if (m_boundGenerations[slot] != m_nodeBufGeneration) {
+        VkDescriptorBufferInfo bufInfo = { m_nodeBuf, 0, VK_WHOLE_SIZE };
+        VkWriteDescriptorSet writeInfo;
+        memset(&writeInfo, 0, sizeof(writeInfo));
+        writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeInfo.dstSet = m_descriptorSets[slot];
+        writeInfo.dstBinding = 0;
+        writeInfo.descriptorCount = 1;
+        writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeInfo.pBufferInfo = &bufInfo;
+        m_devFuncs->vkUpdateDescriptorSets(m_dev, 1, &writeInfo, 0, nullptr);
+        m_boundGenerations[slot] = m_nodeBufGeneration;
+    }
+
+    if (m_pickEnabled && m_pickDirty) {
+        m_pickDirty = false;
+        if (m_viewportRect.contains(m_pickPixel)) {
+            pick(slot);
+        } else {
+            m_pickResult = -1;
+            m_hasPickResult = true;
+        }
+    }
+    // Результат читается, когда слот станет текущим снова: кадры нужны,
+    // даже если сцена не меняется
+    if (m_pickPass && m_pickPass->isPending())
+        VulkanQuickWindow::requestFrame(m_window);
+}
+
+void SceneRenderer::pick(int slot)
+{
+    VKQ_TRACE_SCOPE("SceneRenderer::pick");
+    if (!m_pickPass) {
+        m_pickPass = new VulkanPickPass(m_window, m_framesInFlight);
+        m_pickPipeline = createPipeline(QStringLiteral(":/scene_pick.vert.spv"), QStringLiteral(":/scene_pick.frag.spv"),
+                                        m_pickPass->renderPass());
+    }
+
+    m_window->beginExternalCommands();
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    VkCommandBuffer cb = *reinterpret_cast<VkCommandBuffer *>(
+        rif->getResource(m_window, QSGRendererInterface::CommandListResource));
+    VKQ_TRACE_GPU_BEGIN(cb, "VulkanScene pick");
+
+    // Те же узлы и проекция, но растеризуется только пиксель под курсором
+    m_pickPass->begin(cb);
+    m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pickPipeline);
+    m_devFuncs->vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1,
+                                        &m_descriptorSets[slot], 0, nullptr);
+    pushParams(cb, VulkanPickPass::pickMatrix(m_viewportRect, m_pickPixel) * m_matrix);
+    m_devFuncs->vkCmdDraw(cb, SCENE_CUBE_VERTICES, m_drawCount, 0, 0);
+    m_pickPass->end(cb, slot);
+
+    VKQ_TRACE_GPU_END(cb);
+    m_window->endExternalCommands();
+}
+
+void SceneRenderer::pushParams(VkCommandBuffer cb, const QMatrix4x4 &matrix)
+{
+    float pushConstants[20];
+    memcpy(pushConstants, matrix.constData(), 16 * sizeof(float));
+    pushConstants[16] = m_lightDirection.x();
+    pushConstants[17] = m_lightDirection.y();
+    pushConstants[18] = m_lightDirection.z();
+    pushConstants[19] = 0.0f;
+    m_devFuncs->vkCmdPushConstants(cb, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                                   SCENE_PUSH_CONSTANTS_SIZE, pushConstants);
+}
+
+void SceneRenderer::ensureNodeBuffer(int count)
+{
+    if (count <= m_nodeCapacity)
+        return;
+
+    // Старый буфер ещё читают кадры в полёте
+    if (m_nodeBuf)
+        m_retired.append({ m_nodeBuf, m_nodeMem, m_frame + quint64(m_framesInFlight) });
+    m_nodeBuf = VK_NULL_HANDLE;
+    m_nodeMem = VK_NULL_HANDLE;
+    m_nodeCapacity = qMax(SCENE_MIN_CAPACITY, int(qNextPowerOfTwo(quint32(count))));
+    VulkanUtils::createBuffer(m_devFuncs, m_dev, m_memProps, VkDeviceSize(m_nodeCapacity) * sizeof(GpuNode),
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &m_nodeBuf, &m_nodeMem, "scene node buffer");
+    ++m_nodeBufGeneration;
+    m_fullUpload = true;
+}
+
+void SceneRenderer::ensureStaging(int slot, VkDeviceSize size)
+{
+    // Кадр, который раньше использовал этот слот, завершён
+    Staging &staging(m_staging[slot]);
+    if (size <= staging.capacity)
+        return;
+    if (staging.ptr)
+        m_devFuncs->vkUnmapMemory(m_dev, staging.mem);
+    VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &staging.buf, &staging.mem);
+    staging.capacity = qMax(VkDeviceSize(SCENE_MIN_CAPACITY) * sizeof(GpuNode),
+                            VkDeviceSize(qNextPowerOfTwo(quint64(size))));
+    VulkanUtils::createBuffer(m_devFuncs, m_dev, m_memProps, staging.capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              &staging.buf, &staging.mem, "scene staging buffer");
+    void *p = nullptr;
+    VkResult err = m_devFuncs->vkMapMemory(m_dev, staging.mem, 0, VK_WHOLE_SIZE, 0, &p);
+    if (err != VK_SUCCESS || !p)
+        qFatal("Failed to map scene staging buffer memory: %d", err);
+    staging.ptr = static_cast<char *>(p);
+}
+
+void SceneRenderer::uploadNodes(int slot)
+{
+    VKQ_TRACE_SCOPE("SceneRenderer::uploadNodes");
+    // Смежные узлы - один регион; записи региона лежат в staging подряд
+    QList<VkBufferCopy> regions;
+    int recordCount = 0;
+    if (m_fullUpload) {
+        recordCount = m_records.size();
+        regions.append({ 0, 0, VkDeviceSize(recordCount) * sizeof(GpuNode) });
+    } else {
+        std::sort(m_pending.begin(), m_pending.end());
+        m_pending.erase(std::unique(m_pending.begin(), m_pending.end()), m_pending.end());
+        // Узлы после clear() с большими индексами уже не существуют
+        while (!m_pending.isEmpty() && m_pending.last() >= m_records.size())
+            m_pending.removeLast();
+        recordCount = m_pending.size();
+        for (int i = 0; i < m_pending.size(); ++i) {
+            const VkDeviceSize dstOffset = VkDeviceSize(m_pending[i]) * sizeof(GpuNode);
+            if (i > 0 && m_pending[i] == m_pending[i - 1] + 1)
+                regions.last().size += sizeof(GpuNode);
+            else
+                regions.append({ VkDeviceSize(i) * sizeof(GpuNode), dstOffset, sizeof(GpuNode) });
+        }
+    }
+    if (regions.isEmpty()) {
+        m_fullUpload = false;
+        return;
+    }
+
+    const VkDeviceSize size = VkDeviceSize(recordCount) * sizeof(GpuNode);
+    ensureStaging(slot, size);
+    GpuNode *dst = reinterpret_cast<GpuNode *>(m_staging[slot].ptr);
+    if (m_fullUpload) {
+        memcpy(dst, m_records.constData(), size);
+    } else {
+        for (int node : std::as_const(m_pending))
+            *dst++ = m_records[node];
+    }
+
+    m_window->beginExternalCommands();
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    VkCommandBuffer cb = *reinterpret_cast<VkCommandBuffer *>(
+        rif->getResource(m_window, QSGRendererInterface::CommandListResource));
+    VKQ_TRACE_GPU_BEGIN(cb, "VulkanScene upload");
+
+    // Прошлый кадр мог ещё читать буфер в вершинном шейдере
+    VkBufferMemoryBarrier barrier;
+    memset(&barrier, 0, sizeof(barrier));
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = m_nodeBuf;
+    barrier.size = VK_WHOLE_SIZE;
+    m_devFuncs->vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    m_devFuncs->vkCmdCopyBuffer(cb, m_staging[slot].buf, m_nodeBuf, uint32_t(regions.size()), regions.constData());
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    m_devFuncs->vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                                     0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    VKQ_TRACE_GPU_END(cb);
+    m_window->endExternalCommands();
+
+    m_pending.clear();
+    m_fullUpload = false;
+}
+
+void SceneRenderer::mainPassRecordingStart(VkCommandBuffer cb)
+{
+    VKQ_TRACE_SCOPE("SceneRenderer::mainPassRecordingStart");
+    if (!m_initialized || m_viewportRect.isEmpty() || m_drawCount == 0)
+        return;
+
+    const int slot = m_window->graphicsStateInfo().currentFrameSlot;
+
+    VKQ_TRACE_GPU_BEGIN(cb, "VulkanScene");
+
+    m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+    m_devFuncs->vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1,
+                                        &m_descriptorSets[slot], 0, nullptr);
+
+    pushParams(cb, m_matrix);
+
+    VkViewport vp = { float(m_viewportRect.x()), float(m_viewportRect.y()),
+                      float(m_viewportRect.width()), float(m_viewportRect.height()), 0.0f, 1.0f };
+    m_devFuncs->vkCmdSetViewport(cb, 0, 1, &vp);
+    VkRect2D scissor = { { m_viewportRect.x(), m_viewportRect.y() },
+                         { uint32_t(m_viewportRect.width()), uint32_t(m_viewportRect.height()) } };
+    m_devFuncs->vkCmdSetScissor(cb, 0, 1, &scissor);
+
+    // Все узлы одним вызовом, запись узла выбирается gl_InstanceIndex
+    m_devFuncs->vkCmdDraw(cb, SCENE_CUBE_VERTICES, m_drawCount, 0, 0);
+
+    VKQ_TRACE_GPU_END(cb);
+}
+
+void SceneRenderer::init(int framesInFlight)
+{
+    VKQ_TRACE_SCOPE("SceneRenderer::init");
+    Q_ASSERT(framesInFlight <= 3);
+    m_initialized = true;
+    m_framesInFlight = framesInFlight;
+
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    QVulkanInstance *inst = reinterpret_cast<QVulkanInstance *>(
+        rif->getResource(m_window, QSGRendererInterface::VulkanInstanceResource));
+    Q_ASSERT(inst && inst->isValid());
+
+    m_physDev = *reinterpret_cast<VkPhysicalDevice *>(rif->getResource(m_window, QSGRendererInterface::PhysicalDeviceResource));
+    m_dev = *reinterpret_cast<VkDevice *>(rif->getResource(m_window, QSGRendererInterface::DeviceResource));
+    Q_ASSERT(m_physDev && m_dev);
+
+    m_devFuncs = inst->deviceFunctions(m_dev);
+    m_funcs = inst->functions();
+    Q_ASSERT(m_devFuncs && m_funcs);
+
+    m_renderPass = *reinterpret_cast<VkRenderPass *>(
+        rif->getResource(m_window, QSGRendererInterface::RenderPassResource));
+    Q_ASSERT(m_renderPass);
+
+    m_funcs->vkGetPhysicalDeviceMemoryProperties(m_physDev, &m_memProps);
+
+    VkDescriptorSetLayoutBinding layoutBinding;
+    memset(&layoutBinding, 0, sizeof(layoutBinding));
+    layoutBinding.binding = 0;
+    layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    layoutBinding.descriptorCount = 1;
+    layoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo descLayoutInfo;
+    memset(&descLayoutInfo, 0, sizeof(descLayoutInfo));
+    descLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descLayoutInfo.bindingCount = 1;
+    descLayoutInfo.pBindings = &layoutBinding;
+    VkResult err = m_devFuncs->vkCreateDescriptorSetLayout(m_dev, &descLayoutInfo, nullptr, &m_resLayout);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create descriptor set layout: %d", err);
+
+    VkPushConstantRange pushConstantRange = { VK_SHADER_STAGE_VERTEX_BIT, 0, SCENE_PUSH_CONSTANTS_SIZE };
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo;
+    memset(&pipelineLayoutInfo, 0, sizeof(pipelineLayoutInfo));
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_resLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    err = m_devFuncs->vkCreatePipelineLayout(m_dev, &pipelineLayoutInfo, nullptr, &m_pipelineLayout);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create pipeline layout: %d", err);
+
+    VkDescriptorPoolSize descPoolSize = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, uint32_t(framesInFlight) };
+    VkDescriptorPoolCreateInfo descPoolInfo;
+    memset(&descPoolInfo, 0, sizeof(descPoolInfo));
+    descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descPoolInfo.maxSets = uint32_t(framesInFlight);
+    descPoolInfo.poolSizeCount = 1;
+    descPoolInfo.pPoolSizes = &descPoolSize;
+    err = m_devFuncs->vkCreateDescriptorPool(m_dev, &descPoolInfo, nullptr, &m_descriptorPool);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create descriptor pool: %d", err);
+
+    const VkDescriptorSetLayout setLayouts[3] = { m_resLayout, m_resLayout, m_resLayout };
+    VkDescriptorSetAllocateInfo descSetAllocInfo;
+    memset(&descSetAllocInfo, 0, sizeof(descSetAllocInfo));
+    descSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descSetAllocInfo.descriptorPool = m_descriptorPool;
+    descSetAllocInfo.descriptorSetCount = uint32_t(framesInFlight);
+    descSetAllocInfo.pSetLayouts = setLayouts;
+    err = m_devFuncs->vkAllocateDescriptorSets(m_dev, &descSetAllocInfo, m_descriptorSets);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to allocate descriptor sets: %d", err);
+
+    // Общий кэш устройства, сохраняемый между запусками
+    m_pipelineCache = VulkanPipelineCache::acquire(m_window);
+    m_pipeline = createPipeline(QStringLiteral(":/scene.vert.spv"), QStringLiteral(":/scene.frag.spv"), m_renderPass);
+
+    qDebug("scene initialized");
+}
+
+VkPipeline SceneRenderer::createPipeline(const QString &vertName, const QString &fragName, VkRenderPass renderPass)
+{
+    VulkanAssetCache *cache = VulkanAssetCache::instance();
+    const QByteArray vert = cache->shader(vertName);
+    const QByteArray frag = cache->shader(fragName);
+    if (vert.isEmpty() || frag.isEmpty())
+        qFatal("Failed to read scene shaders %s, %s", qPrintable(vertName), qPrintable(fragName));
+
+    VkShaderModule vertModule = VulkanUtils::createShaderModule(m_devFuncs, m_dev, vert);
+    VkShaderModule fragModule = VulkanUtils::createShaderModule(m_devFuncs, m_dev, frag);
+
+    VkGraphicsPipelineCreateInfo pipelineInfo;
+    memset(&pipelineInfo, 0, sizeof(pipelineInfo));
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+
+    VkPipelineShaderStageCreateInfo shaderStages[2];
+    memset(shaderStages, 0, sizeof(shaderStages));
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragModule;
+    shaderStages[1].pName = "main";
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+
+    // Вершины куба генерируются в шейдере
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo;
+    memset(&vertexInputInfo, 0, sizeof(vertexInputInfo));
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+
+    VkPipelineInputAssemblyStateCreateInfo ia;
+    memset(&ia, 0, sizeof(ia));
+    ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    pipelineInfo.pInputAssemblyState = &ia;
+
+    VkPipelineViewportStateCreateInfo vp;
+    memset(&vp, 0, sizeof(vp));
+    vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    vp.viewportCount = 1;
+    vp.scissorCount = 1;
+    pipelineInfo.pViewportState = &vp;
+
+    // Ориентация граней зависит от matrix (отражение по Y и т.п.), поэтому
+    // отсечение задних граней выключено; закрытое отбрасывает тест глубины
+    VkPipelineRasterizationStateCreateInfo rs;
+    memset(&rs, 0, sizeof(rs));
+    rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rs.polygonMode = VK_POLYGON_MODE_FILL;
+    rs.cullMode = VK_CULL_MODE_NONE;
+    rs.lineWidth = 1.0f;
+    pipelineInfo.pRasterizationState = &rs;
+
+    VkPipelineMultisampleStateCreateInfo ms;
+    memset(&ms, 0, sizeof(ms));
+    ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    pipelineInfo.pMultisampleState = &ms;
+
+    VkPipelineDepthStencilStateCreateInfo ds;
+    memset(&ds, 0, sizeof(ds));
+    ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    ds.depthTestEnable = VK_TRUE;
+    ds.depthWriteEnable = VK_TRUE;
+    ds.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    pipelineInfo.pDepthStencilState = &ds;
+
+    VkPipelineColorBlendAttachmentState blend;
+    memset(&blend, 0, sizeof(blend));
+    blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
+            | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo cb;
+    memset(&cb, 0, sizeof(cb));
+    cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    cb.attachmentCount = 1;
+    cb.pAttachments = &blend;
+    pipelineInfo.pColorBlendState = &cb;
+
+    VkDynamicState dynStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dyn;
+    memset(&dyn, 0, sizeof(dyn));
+    dyn.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dyn.dynamicStateCount = 2;
+    dyn.pDynamicStates = dynStates;
+    pipelineInfo.pDynamicState = &dyn;
+
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.renderPass = renderPass;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult err = m_devFuncs->vkCreateGraphicsPipelines(m_dev, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+
+    m_devFuncs->vkDestroyShaderModule(m_dev, vertModule, nullptr);
+    m_devFuncs->vkDestroyShaderModule(m_dev, fragModule, nullptr);
+
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create graphics pipeline: %d", err);
+    return pipeline;
+}
+
+#include "vulkanscene.moc"
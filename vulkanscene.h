@@ -0,0 +1,112 @@
+// vulkanscene.h
+#ifndef VULKANSCENE_H
+#define VULKANSCENE_H
+
+#include <QtQuick/QQuickItem>
+#include <QtQuick/QQuickWindow>
+#include <QColor>
+#include <QMatrix4x4>
+#include <QQuaternion>
+#include <QVector3D>
+#include "vulkanpipelinestatistics.h"
+#include "vulkanscenenodes.h"
+
+class SceneRenderer;
+
+// Сцена из большого числа узлов с иерархией трансформаций.
+//
+// Узлы хранятся в VulkanSceneNodes (структура массивов, топологический
+// порядок), каждый рисуется единичным кубом со своей мировой матрицей и
+// цветом - все одним instanced draw. В sync() пересчитываются только
+// изменённые поддеревья, и в буфер GPU копируются только изменённые записи:
+// записи кадра кладутся в staging-буфер слота и переносятся одной
+// vkCmdCopyBuffer со смежными диапазонами, объединёнными в один регион.
+// Буфер узлов в DEVICE_LOCAL памяти, полностью он загружается только после
+// роста или пересоздания рендерера.
+//
+// matrix переводит мировые координаты в клип-пространство Vulkan внутри
+// прямоугольника элемента (как у VulkanMesh). Узлы добавляются только в
+// конец, удаляется вся сцена сразу (clear()).
+//
+// С picking: true узел под курсором мыши определяется на GPU (VulkanPickPass)
+// и сообщается сигналом picked(instanceId) с индексом узла, -1 - пусто.
+// Сигнал приходит при смене узла под курсором, с задержкой в несколько
+// кадров; новый проход записывается, только когда изменились курсор,
+// узлы или matrix.
+class VulkanScene : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(int nodeCount READ nodeCount NOTIFY nodeCountChanged)
+    Q_PROPERTY(QMatrix4x4 matrix READ matrix WRITE setMatrix NOTIFY matrixChanged)
+    Q_PROPERTY(QVector3D lightDirection READ lightDirection WRITE setLightDirection NOTIFY lightDirectionChanged)
+    Q_PROPERTY(bool picking READ picking WRITE setPicking NOTIFY pickingChanged)
+    Q_PROPERTY(VulkanPipelineStatistics *pipelineStatistics READ pipelineStatistics CONSTANT)
+    QML_ELEMENT
+
+public:
+    VulkanScene();
+
+    VulkanPipelineStatistics *pipelineStatistics() const { return m_pipelineStatistics; }
+
+    int nodeCount() const { return m_nodes.count(); }
+    QMatrix4x4 matrix() const { return m_matrix; }
+    void setMatrix(const QMatrix4x4 &matrix);
+    QVector3D lightDirection() const { return m_lightDirection; }
+    void setLightDirection(const QVector3D &direction);
+    bool picking() const { return m_picking; }
+    void setPicking(bool picking);
+
+    // parent < 0 - корень; возвращает индекс нового узла
+    Q_INVOKABLE int addNode(int parent = -1);
+    Q_INVOKABLE void clear();
+    Q_INVOKABLE void setTranslation(int node, const QVector3D &translation);
+    Q_INVOKABLE void setRotation(int node, const QQuaternion &rotation);
+    Q_INVOKABLE void setScale(int node, const QVector3D &scale);
+    Q_INVOKABLE void setColor(int node, const QColor &color);
+
+    // Для C++-производителей: прямой доступ в GUI-потоке, после изменений
+    // нужно вызвать changed()
+    VulkanSceneNodes *nodes() { return &m_nodes; }
+    void changed();
+
+signals:
+    void nodeCountChanged();
+    void matrixChanged();
+    void lightDirectionChanged();
+    void pickingChanged();
+    void picked(int instanceId);
+
+public slots:
+    void sync();
+    void cleanup();
+
+private slots:
+    void handleWindowChanged(QQuickWindow *win);
+
+protected:
+    void hoverEnterEvent(QHoverEvent *event) override;
+    void hoverMoveEvent(QHoverEvent *event) override;
+    void hoverLeaveEvent(QHoverEvent *event) override;
+
+private:
+    void releaseResources() override;
+    bool isValidNode(int node, const char *what) const;
+    void reportPicked();
+
+    VulkanSceneNodes m_nodes;
+    QMatrix4x4 m_matrix;
+    QVector3D m_lightDirection = QVector3D(0.3f, -0.5f, 1.0f);
+    bool m_cleared = false;
+
+    bool m_picking = false;
+    bool m_hovering = false;
+    QPointF m_cursor;
+    // Последний результат рендерера (пишет sync()) и последний сообщённый
+    int m_picked = -1;
+    int m_reportedPicked = -1;
+
+    VulkanPipelineStatistics *m_pipelineStatistics = new VulkanPipelineStatistics(this);
+    SceneRenderer *m_renderer = nullptr;
+};
+
+#endif
@@ -0,0 +1,165 @@
+// vulkanscenenodes.cpp
+#include "vulkanscenenodes.h"
+#include <algorithm>
+
+int VulkanSceneNodes::add(int parent)
+{
+    Q_ASSERT(parent < count());
+    const int node = count();
+    m_translation.append(QVector3D());
+    m_rotation.append(QQuaternion());
+    m_scale.append(QVector3D(1, 1, 1));
+    m_parent.append(parent < 0 ? -1 : parent);
+    m_firstChild.append(-1);
+    m_lastChild.append(-1);
+    m_nextSibling.append(-1);
+    m_flags.append(0);
+    m_gpu.append(GpuNode { {}, { 1, 1, 1, 1 } });
+
+    // Потомки в порядке добавления: обход поддерева идёт по возрастанию индексов
+    if (parent >= 0) {
+        if (m_lastChild[parent] >= 0)
+            m_nextSibling[m_lastChild[parent]] = node;
+        else
+            m_firstChild[parent] = node;
+        m_lastChild[parent] = node;
+    }
+    markDirty(node);
+    return node;
+}
+
+void VulkanSceneNodes::clear()
+{
+    m_translation.clear();
+    m_rotation.clear();
+    m_scale.clear();
+    m_parent.clear();
+    m_firstChild.clear();
+    m_lastChild.clear();
+    m_nextSibling.clear();
+    m_flags.clear();
+    m_gpu.clear();
+    m_dirty.clear();
+    m_changed.clear();
+}
+
+void VulkanSceneNodes::setTranslation(int node, const QVector3D &translation)
+{
+    if (m_translation[node] == translation)
+        return;
+    m_translation[node] = translation;
+    markDirty(node);
+}
+
+void VulkanSceneNodes::setRotation(int node, const QQuaternion &rotation)
+{
+    // Нормализуется один раз здесь, а не при каждом пересчёте
+    const QQuaternion normalized = rotation.normalized();
+    if (m_rotation[node] == normalized)
+        return;
+    m_rotation[node] = normalized;
+    markDirty(node);
+}
+
+void VulkanSceneNodes::setScale(int node, const QVector3D &scale)
+{
+    if (m_scale[node] == scale)
+        return;
+    m_scale[node] = scale;
+    markDirty(node);
+}
+
+void VulkanSceneNodes::setColor(int node, const QColor &color)
+{
+    float *c = m_gpu[node].color;
+    c[0] = color.redF();
+    c[1] = color.greenF();
+    c[2] = color.blueF();
+    c[3] = color.alphaF();
+    markChanged(node);
+}
+
+void VulkanSceneNodes::markDirty(int node)
+{
+    if (m_flags[node] & LocalDirty)
+        return;
+    m_flags[node] |= LocalDirty;
+    m_dirty.append(node);
+}
+
+void VulkanSceneNodes::markChanged(int node)
+{
+    if (m_flags[node] & Changed)
+        return;
+    m_flags[node] |= Changed;
+    m_changed.append(node);
+}
+
+void VulkanSceneNodes::updateWorld(int node)
+{
+    // local = T * R * S, столбцы R умножены на масштаб
+    const QQuaternion &q(m_rotation[node]);
+    const float x = q.x(), y = q.y(), z = q.z(), w = q.scalar();
+    const QVector3D &s(m_scale[node]);
+    const QVector3D &t(m_translation[node]);
+    const float local[16] = {
+        (1 - 2 * (y * y + z * z)) * s.x(), 2 * (x * y + w * z) * s.x(), 2 * (x * z - w * y) * s.x(), 0,
+        2 * (x * y - w * z) * s.y(), (1 - 2 * (x * x + z * z)) * s.y(), 2 * (y * z + w * x) * s.y(), 0,
+        2 * (x * z + w * y) * s.z(), 2 * (y * z - w * x) * s.z(), (1 - 2 * (x * x + y * y)) * s.z(), 0,
+        t.x(), t.y(), t.z(), 1
+    };
+
+    float *world = m_gpu[node].world;
+    const int parent = m_parent[node];
+    if (parent < 0) {
+        std::copy(local, local + 16, world);
+    } else {
+        // Родитель пересчитан раньше: его индекс меньше
+        const float *p = m_gpu[parent].world;
+        for (int col = 0; col < 4; ++col) {
+            const float *l = local + col * 4;
+            for (int row = 0; row < 4; ++row)
+                world[col * 4 + row] = p[row] * l[0] + p[4 + row] * l[1] + p[8 + row] * l[2] + p[12 + row] * l[3];
+        }
+    }
+    m_flags[node] &= ~LocalDirty;
+    markChanged(node);
+}
+
+void VulkanSceneNodes::update()
+{
+    if (m_dirty.isEmpty())
+        return;
+
+    // Предки раньше потомков: узел, пересчитанный с поддеревом предка,
+    // уже не грязный и пропускается
+    std::sort(m_dirty.begin(), m_dirty.end());
+    for (int root : std::as_const(m_dirty)) {
+        if (!(m_flags[root] & LocalDirty))
+            continue;
+        // Прямой обход поддерева по firstChild/nextSibling без стека
+        int node = root;
+        for (;;) {
+            updateWorld(node);
+            if (m_firstChild[node] >= 0) {
+                node = m_firstChild[node];
+                continue;
+            }
+            while (node != root && m_nextSibling[node] < 0)
+                node = m_parent[node];
+            if (node == root)
+                break;
+            node = m_nextSibling[node];
+        }
+    }
+    m_dirty.clear();
+}
+
+QList<int> VulkanSceneNodes::takeChanged()
+{
+    for (int node : std::as_const(m_changed))
+        m_flags[node] &= ~Changed;
+    QList<int> changed;
+    changed.swap(m_changed);
+    return changed;
+}
@@ -0,0 +1,78 @@
+// vulkanscenenodes.h
+#ifndef VULKANSCENENODES_H
+#define VULKANSCENENODES_H
+
+#include <QColor>
+#include <QList>
+#include <QQuaternion>
+#include <QVector3D>
+
+// Иерархия узлов VulkanScene в виде структуры массивов.
+//
+// Каждое поле узла - отдельный массив с индексом узла, родитель всегда
+// добавлен раньше потомка (топологический порядок). Изменение TRS только
+// ставит узел в список грязных; update() сортирует его по индексу (предки
+// раньше потомков) и обходит поддерево каждого грязного узла, пропуская
+// узлы, уже пересчитанные вместе с предком. Стоимость кадра - размер
+// изменённых поддеревьев, а не всей сцены; takeChanged() отдаёт только
+// узлы, чьи записи для GPU изменились.
+//
+// Не потокобезопасно: VulkanScene меняет узлы в GUI-потоке и вызывает
+// update() в sync(), пока GUI-поток заблокирован.
+class VulkanSceneNodes
+{
+public:
+    // Запись узла в буфере GPU (std430, см. shaders/scene.vert)
+    struct GpuNode {
+        float world[16];    // по столбцам
+        float color[4];
+    };
+
+    int count() const { return int(m_parent.size()); }
+
+    // parent < 0 - корень, иначе уже добавленный узел
+    int add(int parent);
+    void clear();
+
+    void setTranslation(int node, const QVector3D &translation);
+    void setRotation(int node, const QQuaternion &rotation);
+    void setScale(int node, const QVector3D &scale);
+    void setColor(int node, const QColor &color);
+
+    QVector3D translation(int node) const { return m_translation[node]; }
+    QQuaternion rotation(int node) const { return m_rotation[node]; }
+    QVector3D scale(int node) const { return m_scale[node]; }
+    int parent(int node) const { return m_parent[node]; }
+
+    // Пересчитать мировые матрицы грязных поддеревьев
+    void update();
+    // Узлы с изменённой записью с прошлого вызова, в порядке пересчёта
+    QList<int> takeChanged();
+
+    const GpuNode *gpuNodes() const { return m_gpu.constData(); }
+
+private:
+    enum Flag : quint8 {
+        LocalDirty = 0x1,   // TRS изменён, узел в m_dirty
+        Changed = 0x2       // запись изменена, узел в m_changed
+    };
+
+    void markDirty(int node);
+    void markChanged(int node);
+    void updateWorld(int node);
+
+    QList<QVector3D> m_translation;
+    QList<QQuaternion> m_rotation;
+    QList<QVector3D> m_scale;
+    QList<int> m_parent;
+    QList<int> m_firstChild;
+    QList<int> m_lastChild;
+    QList<int> m_nextSibling;
+    QList<quint8> m_flags;
+    QList<GpuNode> m_gpu;
+
+    QList<int> m_dirty;
+    QList<int> m_changed;
+};
+
+#endif
@@ -0,0 +1,848 @@
+// vulkanshape.cpp
+#include "vulkanshape.h"
+#include "vulkanassetcache.h"
+#include "vulkandraworder.h"
+#include "vulkanpipelinecache.h"
+#include "vulkantrace.h"
+#include "vulkanutils.h"
+#include <QtCore/QRunnable>
+#include <QtQuick/QQuickWindow>
+
+#include <QVulkanInstance>
+#include <QVulkanFunctions>
+#include <QMatrix4x4>
+#include <QtMath>
+#include <cmath>
+
+struct ShapeState
+{
+    // Область элемента в пикселях цели, не обрезанная по окну
+    QRect viewportRect;
+    QSize targetSize;
+    VulkanShape::Shape shape = VulkanShape::Sphere;
+    float exponent = 4;
+    float tubeRadius = 0.35f;
+    QColor color;
+    float t = 0;
+    float pixelsPerSegment = 8;
+};
+
+class ShapeRenderer : public QObject
+{
+    Q_OBJECT
+public:
+    ~ShapeRenderer();
+
+    void setState(const QSharedPointer<VulkanStateSnapshot<ShapeState>> &state)
+    {
+        m_state = state;
+        m_state->take();
+        applyState(m_state->current());
+    }
+    void setWindow(QQuickWindow *window) { m_window = window; }
+
+    void mainPassRecordingStart(VkCommandBuffer cb);
+
+public slots:
+    void frameStart();
+
+private:
+    // Уровень детализации: вершины и индексы в одном буфере, только для GPU
+    struct Level
+    {
+        VkBuffer buf = VK_NULL_HANDLE;
+        VkDeviceMemory mem = VK_NULL_HANDLE;
+        VkDeviceSize indexOffset = 0;
+        uint32_t indexCount = 0;
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        // Совпадает с m_geometryGeneration, если сетка построена для
+        // текущих параметров фигуры
+        quint64 generation = 0;
+    };
+
+    void init(int framesInFlight);
+    void createPipelines(VkRenderPass rp);
+    void applyState(const ShapeState &state);
+    int selectLevel();
+    void generateLevel(VkCommandBuffer cb, int level);
+    void writeUniforms(int frameSlot);
+
+    QSharedPointer<VulkanStateSnapshot<ShapeState>> m_state;
+    ShapeState m_params;
+    quint64 m_geometryGeneration = 1;
+    QQuickWindow *m_window = nullptr;
+
+    bool m_initialized = false;
+    VkPhysicalDevice m_physDev = VK_NULL_HANDLE;
+    VkDevice m_dev = VK_NULL_HANDLE;
+    QVulkanDeviceFunctions *m_devFuncs = nullptr;
+    QVulkanFunctions *m_funcs = nullptr;
+    VkPhysicalDeviceMemoryProperties m_memProps;
+    VkDeviceSize m_storageAlign = 0;
+
+    static const int LevelCount = 6;
+    Level m_levels[LevelCount];
+    int m_level = -1;
+    int m_drawLevel = -1;
+
+    // Матрицы и цвет, по слоту на кадр в полёте; память отображена постоянно
+    VkBuffer m_ubuf = VK_NULL_HANDLE;
+    VkDeviceMemory m_ubufMem = VK_NULL_HANDLE;
+    VkDeviceSize m_allocPerUbuf = 0;
+    char *m_ubufPtr = nullptr;
+
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_genLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_genPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_genPipeline = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_drawLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_drawPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_drawPipeline = VK_NULL_HANDLE;
+    VkDescriptorSet m_drawSet = VK_NULL_HANDLE;
+};
+
+// Должна совпадать с Vertex в shaders/shape.comp
+struct ShapeVertex {
+    float position[4];
+    float normal[4];
+};
+
+// Должны совпадать с блоком push constant в shaders/shape.comp
+struct ShapeGenParams {
+    uint32_t segmentsU;
+    uint32_t segmentsV;
+    uint32_t shape;
+    float exponent;
+    float tubeRadius;
+};
+
+// 2 mat4 + 2 vec4, см. блок Params в shape.vert
+const int SHAPE_UBUF_SIZE = 2 * 16 * sizeof(float) + 2 * 4 * sizeof(float);
+const int SHAPE_WORKGROUP_SIZE = 64;
+// Сегментов по окружности на уровне 0, каждый следующий уровень - вдвое больше
+const int SHAPE_MIN_SEGMENTS = 8;
+// Переход на более грубый уровень - только когда нужная плотность ниже его
+// порога на эту долю уровня (в log2)
+const float SHAPE_LOD_HYSTERESIS = 0.3f;
+// Камера: вертикальный угол обзора и расстояние до центра фигуры
+const float SHAPE_FOV = 45.0f;
+const float SHAPE_DISTANCE = 4.0f;
+
+VulkanShape::VulkanShape()
+{
+    connect(this, &QQuickItem::windowChanged, this, &VulkanShape::handleWindowChanged);
+}
+
+void VulkanShape::setShape(Shape shape)
+{
+    if (shape == m_shape)
+        return;
+    m_shape = shape;
+    emit shapeChanged();
+    publishState();
+}
+
+void VulkanShape::setExponent(qreal exponent)
+{
+    exponent = qBound(qreal(1), exponent, qreal(64));
+    if (exponent == m_exponent)
+        return;
+    m_exponent = exponent;
+    emit exponentChanged();
+    publishState();
+}
+
+void VulkanShape::setTubeRadius(qreal radius)
+{
+    radius = qBound(qreal(0.01), radius, qreal(0.5));
+    if (radius == m_tubeRadius)
+        return;
+    m_tubeRadius = radius;
+    emit tubeRadiusChanged();
+    publishState();
+}
+
+void VulkanShape::setColor(const QColor &color)
+{
+    if (color == m_color)
+        return;
+    m_color = color;
+    emit colorChanged();
+    publishState();
+}
+
+void VulkanShape::setT(qreal t)
+{
+    if (t == m_t)
+        return;
+    m_t = t;
+    emit tChanged();
+    publishState();
+}
+
+void VulkanShape::setPixelsPerSegment(qreal pixels)
+{
+    pixels = qMax(qreal(1), pixels);
+    if (pixels == m_pixelsPerSegment)
+        return;
+    m_pixelsPerSegment = pixels;
+    emit pixelsPerSegmentChanged();
+    publishState();
+}
+
+void VulkanShape::geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChange(newGeometry, oldGeometry);
+    publishState();
+}
+
+void VulkanShape::itemChange(ItemChange change, const ItemChangeData &value)
+{
+    QQuickItem::itemChange(change, value);
+    if (change == ItemParentHasChanged) {
+        trackAncestors();
+    } else if (change == ItemDevicePixelRatioHasChanged) {
+        // Смена коэффициента масштабирования (в том числе на том же экране)
+        // меняет область в пикселях; screenChanged приходит не всегда и
+        // раньше, чем окно узнаёт новый коэффициент
+        publishState();
+    }
+}
+
+// Как в VulkanCube: сдвиг предка сдвигает область фигуры в окне
+void VulkanShape::trackAncestors()
+{
+    for (const QMetaObject::Connection &connection : std::as_const(m_ancestorConnections))
+        disconnect(connection);
+    m_ancestorConnections.clear();
+    for (QQuickItem *item = parentItem(); item; item = item->parentItem()) {
+        m_ancestorConnections.append(connect(item, &QQuickItem::xChanged, this, &VulkanShape::publishState));
+        m_ancestorConnections.append(connect(item, &QQuickItem::yChanged, this, &VulkanShape::publishState));
+        m_ancestorConnections.append(connect(item, &QQuickItem::parentChanged, this, &VulkanShape::trackAncestors));
+    }
+    publishState();
+}
+
+ShapeState VulkanShape::rendererState() const
+{
+    ShapeState state;
+    const qreal dpr = window()->effectiveDevicePixelRatio();
+    const QRectF sceneRect = mapRectToScene(boundingRect());
+    state.viewportRect = QRectF(sceneRect.topLeft() * dpr, sceneRect.size() * dpr).toAlignedRect();
+    state.targetSize = window()->size() * dpr;
+    state.shape = m_shape;
+    state.exponent = float(m_exponent);
+    state.tubeRadius = float(m_tubeRadius);
+    state.color = m_color;
+    state.t = float(m_t);
+    state.pixelsPerSegment = float(m_pixelsPerSegment);
+    return state;
+}
+
+void VulkanShape::publishState()
+{
+    if (!window())
+        return;
+    if (m_state)
+        m_state->publish(rendererState());
+    window()->update();
+}
+
+void VulkanShape::connectSync(QQuickWindow *win)
+{
+    disconnect(m_syncConnection);
+    if (win)
+        m_syncConnection = connect(win, &QQuickWindow::beforeSynchronizing, this, &VulkanShape::sync, Qt::DirectConnection);
+}
+
+void VulkanShape::handleWindowChanged(QQuickWindow *win)
+{
+    connectSync(win);
+    if (win) {
+        connect(win, &QQuickWindow::sceneGraphInvalidated, this, &VulkanShape::cleanup, Qt::DirectConnection);
+        connect(win, &QWindow::widthChanged, this, &VulkanShape::publishState);
+        connect(win, &QWindow::heightChanged, this, &VulkanShape::publishState);
+        connect(win, &QWindow::screenChanged, this, &VulkanShape::publishState);
+    }
+}
+
+void VulkanShape::cleanup()
+{
+    delete m_renderer;
+    m_renderer = nullptr;
+    m_state.reset();
+    connectSync(window());
+}
+
+class ShapeCleanupJob : public QRunnable
+{
+public:
+    ShapeCleanupJob(ShapeRenderer *renderer) : m_renderer(renderer) { }
+    void run() override { delete m_renderer; }
+private:
+    ShapeRenderer *m_renderer;
+};
+
+void VulkanShape::releaseResources()
+{
+    window()->scheduleRenderJob(new ShapeCleanupJob(m_renderer), QQuickWindow::BeforeSynchronizingStage);
+    m_renderer = nullptr;
+    m_state.reset();
+}
+
+void VulkanShape::sync()
+{
+    VKQ_TRACE_SCOPE("VulkanShape::sync");
+    if (!m_renderer) {
+        m_renderer = new ShapeRenderer;
+        // Сетка строится до основного прохода, непрозрачная фигура
+        // рисуется вместе с остальными непрозрачными элементами
+        connect(window(), &QQuickWindow::beforeRendering, m_renderer, &ShapeRenderer::frameStart, Qt::DirectConnection);
+        ShapeRenderer *renderer = m_renderer;
+        VulkanDrawOrder::forWindow(window())->add(renderer, VulkanDrawOrder::OpaqueStage, "VulkanShape",
+                                                  [renderer](VkCommandBuffer cb) { renderer->mainPassRecordingStart(cb); });
+        m_renderer->setWindow(window());
+        m_state.reset(new VulkanStateSnapshot<ShapeState>);
+        m_state->publish(rendererState());
+        m_renderer->setState(m_state);
+    }
+
+    if (!VulkanDrawOrder::statisticsEnabled()) {
+        disconnect(m_syncConnection);
+        return;
+    }
+    const ShapeState state = rendererState();
+    const QRect viewportRect = state.viewportRect.intersected(QRect(QPoint(0, 0), state.targetSize));
+    m_pipelineStatistics->sync(window(), m_renderer, qreal(viewportRect.width()) * viewportRect.height());
+}
+
+ShapeRenderer::~ShapeRenderer()
+{
+    qDebug("shape cleanup");
+    if (m_window)
+        VulkanDrawOrder::unregister(m_window, this);
+    if (!m_devFuncs)
+        return;
+
+    m_devFuncs->vkDestroyPipeline(m_dev, m_drawPipeline, nullptr);
+    m_devFuncs->vkDestroyPipelineLayout(m_dev, m_drawPipelineLayout, nullptr);
+    m_devFuncs->vkDestroyDescriptorSetLayout(m_dev, m_drawLayout, nullptr);
+    m_devFuncs->vkDestroyPipeline(m_dev, m_genPipeline, nullptr);
+    m_devFuncs->vkDestroyPipelineLayout(m_dev, m_genPipelineLayout, nullptr);
+    m_devFuncs->vkDestroyDescriptorSetLayout(m_dev, m_genLayout, nullptr);
+    m_devFuncs->vkDestroyDescriptorPool(m_dev, m_descriptorPool, nullptr);
+    if (m_pipelineCache)
+        VulkanPipelineCache::release(m_dev);
+
+    for (Level &level : m_levels)
+        VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &level.buf, &level.mem);
+
+    if (m_ubufPtr)
+        m_devFuncs->vkUnmapMemory(m_dev, m_ubufMem);
+    VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &m_ubuf, &m_ubufMem);
+
+    qDebug("shape released");
+}
+
+void ShapeRenderer::applyState(const ShapeState &state)
+{
+    // Другая фигура - все построенные уровни устарели
+    if (state.shape != m_params.shape || state.exponent != m_params.exponent
+            || state.tubeRadius != m_params.tubeRadius)
+        ++m_geometryGeneration;
+    m_params = state;
+}
+
+// Уровень по размеру фигуры на экране: окружность ограничивающей сферы в
+// пикселях, делённая на длину ребра, - нужное число сегментов
+int ShapeRenderer::selectLevel()
+{
+    float radius = 1.0f;
+    // Угол суперэллипсоида (1,1,1)/3^(1/n) дальше единичной оси только при
+    // n > 2; при 1 <= n < 2 самые дальние точки - вершины на осях
+    if (m_params.shape == VulkanShape::Squircle)
+        radius = qMax(1.0f, std::pow(3.0f, 0.5f - 1.0f / m_params.exponent));
+    const float halfFov = qDegreesToRadians(SHAPE_FOV * 0.5f);
+    const float angularRadius = std::asin(qMin(radius / SHAPE_DISTANCE, 1.0f));
+    const float diameter = std::tan(angularRadius) / std::tan(halfFov) * m_params.viewportRect.height();
+    const float segments = float(M_PI) * diameter / m_params.pixelsPerSegment;
+    const float ideal = std::log2(qMax(segments, 1.0f) / SHAPE_MIN_SEGMENTS);
+
+    const int wanted = qBound(0, int(std::ceil(ideal)), LevelCount - 1);
+    if (m_level < 0 || wanted > m_level || (wanted < m_level && ideal < m_level - 1 - SHAPE_LOD_HYSTERESIS)) {
+        if (wanted != m_level)
+            qDebug("shape: LOD %d (%d segments)", wanted, SHAPE_MIN_SEGMENTS << wanted);
+        m_level = wanted;
+    }
+    return m_level;
+}
+
+void ShapeRenderer::frameStart()
+{
+    VKQ_TRACE_SCOPE("ShapeRenderer::frameStart");
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    Q_ASSERT(rif->graphicsApi() == QSGRendererInterface::Vulkan);
+
+    if (m_state->take())
+        applyState(m_state->current());
+
+    const QQuickWindow::GraphicsStateInfo &stateInfo(m_window->graphicsStateInfo());
+    if (!m_initialized)
+        init(stateInfo.framesInFlight);
+
+    m_drawLevel = -1;
+    if (!m_params.viewportRect.intersects(QRect(QPoint(0, 0), m_params.targetSize)))
+        return;
+
+    const int level = selectLevel();
+    writeUniforms(stateInfo.currentFrameSlot);
+
+    if (m_levels[level].generation != m_geometryGeneration) {
+        // Как у частиц: compute пишется в командный буфер кадра вне render pass
+        m_window->beginExternalCommands();
+        VkCommandBuffer cb = *reinterpret_cast<VkCommandBuffer *>(
+            rif->getResource(m_window, QSGRendererInterface::CommandListResource));
+        Q_ASSERT(cb);
+        generateLevel(cb, level);
+        m_window->endExternalCommands();
+    }
+    m_drawLevel = level;
+}
+
+void ShapeRenderer::generateLevel(VkCommandBuffer cb, int index)
+{
+    VKQ_TRACE_SCOPE("ShapeRenderer::generateLevel");
+    Level &level(m_levels[index]);
+    const uint32_t segmentsU = uint32_t(SHAPE_MIN_SEGMENTS) << index;
+    const uint32_t segmentsV = segmentsU / 2;
+    const uint32_t vertexCount = (segmentsU + 1) * (segmentsV + 1);
+    const uint32_t quadCount = segmentsU * segmentsV;
+
+    // Размер уровня не зависит от фигуры: буфер создаётся один раз, при
+    // смене фигуры сетка перестраивается на месте
+    if (!level.buf) {
+        const VkDeviceSize vertexSize = VkDeviceSize(vertexCount) * sizeof(ShapeVertex);
+        const VkDeviceSize indexSize = VkDeviceSize(quadCount) * 6 * sizeof(uint32_t);
+        level.indexOffset = VulkanUtils::aligned(vertexSize, m_storageAlign);
+        level.indexCount = quadCount * 6;
+        VulkanUtils::createBuffer(m_devFuncs, m_dev, m_memProps, level.indexOffset + indexSize,
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+                                  | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                  &level.buf, &level.mem, "shape mesh buffer");
+
+        VkDescriptorSetAllocateInfo descSetAllocInfo;
+        memset(&descSetAllocInfo, 0, sizeof(descSetAllocInfo));
+        descSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descSetAllocInfo.descriptorPool = m_descriptorPool;
+        descSetAllocInfo.descriptorSetCount = 1;
+        descSetAllocInfo.pSetLayouts = &m_genLayout;
+        VkResult err = m_devFuncs->vkAllocateDescriptorSets(m_dev, &descSetAllocInfo, &level.set);
+        if (err != VK_SUCCESS)
+            qFatal("Failed to allocate shape descriptor set: %d", err);
+
+        VkDescriptorBufferInfo bufInfo[2];
+        bufInfo[0] = { level.buf, 0, vertexSize };
+        bufInfo[1] = { level.buf, level.indexOffset, indexSize };
+        VkWriteDescriptorSet writeInfo[2];
+        memset(writeInfo, 0, sizeof(writeInfo));
+        for (uint32_t i = 0; i < 2; ++i) {
+            writeInfo[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeInfo[i].dstSet = level.set;
+            writeInfo[i].dstBinding = i;
+            writeInfo[i].descriptorCount = 1;
+            writeInfo[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writeInfo[i].pBufferInfo = &bufInfo[i];
+        }
+        m_devFuncs->vkUpdateDescriptorSets(m_dev, 2, writeInfo, 0, nullptr);
+
+        qDebug("shape: LOD %d mesh, %u vertices, %u KB", index, vertexCount,
+               uint((level.indexOffset + indexSize) / 1024));
+    }
+
+    VKQ_TRACE_GPU_BEGIN(cb, "VulkanShape generate");
+
+    // WAR: кадры в полёте могли рисовать прежнюю сетку этого уровня
+    m_devFuncs->vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+    ShapeGenParams params;
+    params.segmentsU = segmentsU;
+    params.segmentsV = segmentsV;
+    params.shape = uint32_t(m_params.shape);
+    params.exponent = m_params.exponent;
+    params.tubeRadius = m_params.tubeRadius;
+
+    m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_genPipeline);
+    m_devFuncs->vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_genPipelineLayout, 0, 1,
+                                        &level.set, 0, nullptr);
+    m_devFuncs->vkCmdPushConstants(cb, m_genPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+    const uint32_t threads = qMax(vertexCount, quadCount);
+    m_devFuncs->vkCmdDispatch(cb, (threads + SHAPE_WORKGROUP_SIZE - 1) / SHAPE_WORKGROUP_SIZE, 1, 1);
+
+    // RAW: сетка читается как вершины и индексы
+    VkBufferMemoryBarrier barrier;
+    memset(&barrier, 0, sizeof(barrier));
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = level.buf;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    m_devFuncs->vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                     0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    VKQ_TRACE_GPU_END(cb);
+    level.generation = m_geometryGeneration;
+}
+
+void ShapeRenderer::writeUniforms(int frameSlot)
+{
+    const QRect &rect(m_params.viewportRect);
+    const float aspect = rect.height() > 0 ? rect.width() / float(rect.height()) : 1.0f;
+
+    // Коррекция клип-пространства: ось Y вниз и глубина [0, 1] в Vulkan
+    const QMatrix4x4 clipCorrection(1.0f, 0.0f, 0.0f, 0.0f,
+                                    0.0f, -1.0f, 0.0f, 0.0f,
+                                    0.0f, 0.0f, 0.5f, 0.5f,
+                                    0.0f, 0.0f, 0.0f, 1.0f);
+    QMatrix4x4 proj;
+    proj.perspective(SHAPE_FOV, aspect, 0.1f, 100.0f);
+    QMatrix4x4 view;
+    view.lookAt(QVector3D(0.0f, 0.0f, SHAPE_DISTANCE), QVector3D(0.0f, 0.0f, 0.0f), QVector3D(0.0f, 1.0f, 0.0f));
+    QMatrix4x4 model;
+    model.rotate(m_params.t * 360.0f, QVector3D(0.0f, 1.0f, 0.0f));
+    model.rotate(30.0f + m_params.t * 180.0f, QVector3D(1.0f, 0.0f, 0.0f));
+    const QMatrix4x4 mvp = clipCorrection * proj * view * model;
+
+    float *data = reinterpret_cast<float *>(m_ubufPtr + frameSlot * m_allocPerUbuf);
+    memcpy(data, mvp.constData(), 16 * sizeof(float));
+    memcpy(data + 16, model.constData(), 16 * sizeof(float));
+    data[32] = m_params.color.redF();
+    data[33] = m_params.color.greenF();
+    data[34] = m_params.color.blueF();
+    data[35] = m_params.color.alphaF();
+    const QVector3D lightDir = QVector3D(0.4f, 0.7f, 0.6f).normalized();
+    data[36] = lightDir.x();
+    data[37] = lightDir.y();
+    data[38] = lightDir.z();
+    data[39] = 0.0f;
+}
+
+void ShapeRenderer::mainPassRecordingStart(VkCommandBuffer cb)
+{
+    VKQ_TRACE_SCOPE("ShapeRenderer::mainPassRecordingStart");
+    if (m_drawLevel < 0)
+        return;
+
+    const QQuickWindow::GraphicsStateInfo &stateInfo(m_window->graphicsStateInfo());
+    const Level &level(m_levels[m_drawLevel]);
+
+    VKQ_TRACE_GPU_BEGIN(cb, "VulkanShape draw");
+
+    m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_drawPipeline);
+
+    const VkDeviceSize vbufOffset = 0;
+    m_devFuncs->vkCmdBindVertexBuffers(cb, 0, 1, &level.buf, &vbufOffset);
+    m_devFuncs->vkCmdBindIndexBuffer(cb, level.buf, level.indexOffset, VK_INDEX_TYPE_UINT32);
+
+    const uint32_t dynamicOffset = uint32_t(m_allocPerUbuf * stateInfo.currentFrameSlot);
+    m_devFuncs->vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_drawPipelineLayout, 0, 1,
+                                        &m_drawSet, 1, &dynamicOffset);
+
+    // Viewport - вся область элемента, чтобы проекция не зависела от видимой
+    // части; лишнее отсекает scissor
+    const QRect &rect(m_params.viewportRect);
+    VkViewport vp = { float(rect.x()), float(rect.y()), float(rect.width()), float(rect.height()), 0.0f, 1.0f };
+    m_devFuncs->vkCmdSetViewport(cb, 0, 1, &vp);
+    const QRect scissorRect = rect.intersected(QRect(QPoint(0, 0), m_params.targetSize));
+    VkRect2D scissor = { { scissorRect.x(), scissorRect.y() },
+                         { uint32_t(scissorRect.width()), uint32_t(scissorRect.height()) } };
+    m_devFuncs->vkCmdSetScissor(cb, 0, 1, &scissor);
+
+    m_devFuncs->vkCmdDrawIndexed(cb, level.indexCount, 1, 0, 0, 0);
+
+    VKQ_TRACE_GPU_END(cb);
+}
+
+void ShapeRenderer::init(int framesInFlight)
+{
+    VKQ_TRACE_SCOPE("ShapeRenderer::init");
+    Q_ASSERT(framesInFlight <= 3);
+    m_initialized = true;
+
+    QSGRendererInterface *rif = m_window->rendererInterface();
+    QVulkanInstance *inst = reinterpret_cast<QVulkanInstance *>(
+        rif->getResource(m_window, QSGRendererInterface::VulkanInstanceResource));
+    Q_ASSERT(inst && inst->isValid());
+
+    m_physDev = *reinterpret_cast<VkPhysicalDevice *>(rif->getResource(m_window, QSGRendererInterface::PhysicalDeviceResource));
+    m_dev = *reinterpret_cast<VkDevice *>(rif->getResource(m_window, QSGRendererInterface::DeviceResource));
+    Q_ASSERT(m_physDev && m_dev);
+
+    m_devFuncs = inst->deviceFunctions(m_dev);
+    m_funcs = inst->functions();
+    Q_ASSERT(m_devFuncs && m_funcs);
+
+    VkRenderPass rp = *reinterpret_cast<VkRenderPass *>(
+        rif->getResource(m_window, QSGRendererInterface::RenderPassResource));
+    Q_ASSERT(rp);
+
+    VkPhysicalDeviceProperties physDevProps;
+    m_funcs->vkGetPhysicalDeviceProperties(m_physDev, &physDevProps);
+    m_funcs->vkGetPhysicalDeviceMemoryProperties(m_physDev, &m_memProps);
+    m_storageAlign = physDevProps.limits.minStorageBufferOffsetAlignment;
+
+    m_allocPerUbuf = VulkanUtils::aligned(SHAPE_UBUF_SIZE, physDevProps.limits.minUniformBufferOffsetAlignment);
+    VulkanUtils::createBuffer(m_devFuncs, m_dev, m_memProps, m_allocPerUbuf * framesInFlight,
+                              VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              &m_ubuf, &m_ubufMem, "shape uniform buffer");
+    void *p = nullptr;
+    VkResult err = m_devFuncs->vkMapMemory(m_dev, m_ubufMem, 0, VK_WHOLE_SIZE, 0, &p);
+    if (err != VK_SUCCESS || !p)
+        qFatal("Failed to map shape uniform buffer memory: %d", err);
+    m_ubufPtr = static_cast<char *>(p);
+
+    // Построение сетки: binding 0 - вершины, binding 1 - индексы
+    VkDescriptorSetLayoutBinding genBinding[2];
+    memset(genBinding, 0, sizeof(genBinding));
+    for (uint32_t i = 0; i < 2; ++i) {
+        genBinding[i].binding = i;
+        genBinding[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        genBinding[i].descriptorCount = 1;
+        genBinding[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo descLayoutInfo;
+    memset(&descLayoutInfo, 0, sizeof(descLayoutInfo));
+    descLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descLayoutInfo.bindingCount = 2;
+    descLayoutInfo.pBindings = genBinding;
+    err = m_devFuncs->vkCreateDescriptorSetLayout(m_dev, &descLayoutInfo, nullptr, &m_genLayout);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create shape generation descriptor set layout: %d", err);
+
+    VkPushConstantRange pushConstantRange;
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(ShapeGenParams);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo;
+    memset(&pipelineLayoutInfo, 0, sizeof(pipelineLayoutInfo));
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_genLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    err = m_devFuncs->vkCreatePipelineLayout(m_dev, &pipelineLayoutInfo, nullptr, &m_genPipelineLayout);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create shape generation pipeline layout: %d", err);
+
+    // Отрисовка: binding 0 - матрицы и цвет
+    VkDescriptorSetLayoutBinding drawBinding;
+    memset(&drawBinding, 0, sizeof(drawBinding));
+    drawBinding.binding = 0;
+    drawBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    drawBinding.descriptorCount = 1;
+    drawBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    descLayoutInfo.bindingCount = 1;
+    descLayoutInfo.pBindings = &drawBinding;
+    err = m_devFuncs->vkCreateDescriptorSetLayout(m_dev, &descLayoutInfo, nullptr, &m_drawLayout);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create shape descriptor set layout: %d", err);
+
+    pipelineLayoutInfo.pSetLayouts = &m_drawLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 0;
+    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+    err = m_devFuncs->vkCreatePipelineLayout(m_dev, &pipelineLayoutInfo, nullptr, &m_drawPipelineLayout);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create shape pipeline layout: %d", err);
+
+    // Набор отрисовки и по набору построения на уровень
+    VkDescriptorPoolSize descPoolSizes[2];
+    descPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descPoolSizes[0].descriptorCount = 1;
+    descPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descPoolSizes[1].descriptorCount = 2 * LevelCount;
+
+    VkDescriptorPoolCreateInfo descPoolInfo;
+    memset(&descPoolInfo, 0, sizeof(descPoolInfo));
+    descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descPoolInfo.maxSets = 1 + LevelCount;
+    descPoolInfo.poolSizeCount = 2;
+    descPoolInfo.pPoolSizes = descPoolSizes;
+    err = m_devFuncs->vkCreateDescriptorPool(m_dev, &descPoolInfo, nullptr, &m_descriptorPool);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create shape descriptor pool: %d", err);
+
+    VkDescriptorSetAllocateInfo descSetAllocInfo;
+    memset(&descSetAllocInfo, 0, sizeof(descSetAllocInfo));
+    descSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descSetAllocInfo.descriptorPool = m_descriptorPool;
+    descSetAllocInfo.descriptorSetCount = 1;
+    descSetAllocInfo.pSetLayouts = &m_drawLayout;
+    err = m_devFuncs->vkAllocateDescriptorSets(m_dev, &descSetAllocInfo, &m_drawSet);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to allocate shape descriptor set: %d", err);
+
+    VkDescriptorBufferInfo bufInfo = { m_ubuf, 0, VkDeviceSize(SHAPE_UBUF_SIZE) };
+    VkWriteDescriptorSet writeInfo;
+    memset(&writeInfo, 0, sizeof(writeInfo));
+    writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeInfo.dstSet = m_drawSet;
+    writeInfo.dstBinding = 0;
+    writeInfo.descriptorCount = 1;
+    writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    writeInfo.pBufferInfo = &bufInfo;
+    m_devFuncs->vkUpdateDescriptorSets(m_dev, 1, &writeInfo, 0, nullptr);
+
+    // Общий кэш устройства, сохраняемый между запусками
+    m_pipelineCache = VulkanPipelineCache::acquire(m_window);
+
+    createPipelines(rp);
+
+    qDebug("shape initialized");
+}
+
+void ShapeRenderer::createPipelines(VkRenderPass rp)
+{
+    VulkanAssetCache *cache = VulkanAssetCache::instance();
+    const QByteArray comp = cache->shader(QStringLiteral(":/shape.comp.spv"));
+    const QByteArray vert = cache->shader(QStringLiteral(":/shape.vert.spv"));
+    const QByteArray frag = cache->shader(QStringLiteral(":/shape.frag.spv"));
+    if (comp.isEmpty() || vert.isEmpty() || frag.isEmpty())
+        qFatal("Failed to read shape shaders");
+
+    // Compute pipeline: построение сетки
+    VkShaderModule compModule = VulkanUtils::createShaderModule(m_devFuncs, m_dev, comp);
+    VkComputePipelineCreateInfo computeInfo;
+    memset(&computeInfo, 0, sizeof(computeInfo));
+    computeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    computeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    computeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    computeInfo.stage.module = compModule;
+    computeInfo.stage.pName = "main";
+    computeInfo.layout = m_genPipelineLayout;
+    VkResult err = m_devFuncs->vkCreateComputePipelines(m_dev, m_pipelineCache, 1, &computeInfo, nullptr, &m_genPipeline);
+    m_devFuncs->vkDestroyShaderModule(m_dev, compModule, nullptr);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create shape generation pipeline: %d", err);
+
+    // Graphics pipeline
+    VkShaderModule vertModule = VulkanUtils::createShaderModule(m_devFuncs, m_dev, vert);
+    VkShaderModule fragModule = VulkanUtils::createShaderModule(m_devFuncs, m_dev, frag);
+
+    VkGraphicsPipelineCreateInfo pipelineInfo;
+    memset(&pipelineInfo, 0, sizeof(pipelineInfo));
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+
+    VkPipelineShaderStageCreateInfo shaderStages[2];
+    memset(shaderStages, 0, sizeof(shaderStages));
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertModule;
+    shaderStages[0].pName = "main";
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragModule;
+    shaderStages[1].pName = "main";
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+
+    VkVertexInputBindingDescription vertexBindingDesc;
+    vertexBindingDesc.binding = 0;
+    vertexBindingDesc.stride = sizeof(ShapeVertex);
+    vertexBindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    VkVertexInputAttributeDescription vertexAttrDesc[2];
+    vertexAttrDesc[0].location = 0;
+    vertexAttrDesc[0].binding = 0;
+    vertexAttrDesc[0].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    vertexAttrDesc[0].offset = offsetof(ShapeVertex, position);
+    vertexAttrDesc[1].location = 1;
+    vertexAttrDesc[1].binding = 0;
+    vertexAttrDesc[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    vertexAttrDesc[1].offset = offsetof(ShapeVertex, normal);
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo;
+    memset(&vertexInputInfo, 0, sizeof(vertexInputInfo));
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &vertexBindingDesc;
+    vertexInputInfo.vertexAttributeDescriptionCount = 2;
+    vertexInputInfo.pVertexAttributeDescriptions = vertexAttrDesc;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+
+    VkPipelineInputAssemblyStateCreateInfo ia;
+    memset(&ia, 0, sizeof(ia));
+    ia.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    pipelineInfo.pInputAssemblyState = &ia;
+
+    VkPipelineViewportStateCreateInfo vp;
+    memset(&vp, 0, sizeof(vp));
+    vp.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    vp.viewportCount = 1;
+    vp.scissorCount = 1;
+    pipelineInfo.pViewportState = &vp;
+
+    // Сетка замкнута, но порядок обхода у полюсов и шва не проверяется -
+    // отсечение граней выключено, как у куба
+    VkPipelineRasterizationStateCreateInfo rs;
+    memset(&rs, 0, sizeof(rs));
+    rs.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rs.polygonMode = VK_POLYGON_MODE_FILL;
+    rs.cullMode = VK_CULL_MODE_NONE;
+    rs.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rs.lineWidth = 1.0f;
+    pipelineInfo.pRasterizationState = &rs;
+
+    VkPipelineMultisampleStateCreateInfo ms;
+    memset(&ms, 0, sizeof(ms));
+    ms.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    pipelineInfo.pMultisampleState = &ms;
+
+    VkPipelineDepthStencilStateCreateInfo ds;
+    memset(&ds, 0, sizeof(ds));
+    ds.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    ds.depthTestEnable = VK_TRUE;
+    ds.depthWriteEnable = VK_TRUE;
+    ds.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    pipelineInfo.pDepthStencilState = &ds;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment;
+    memset(&colorBlendAttachment, 0, sizeof(colorBlendAttachment));
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
+            | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo cb;
+    memset(&cb, 0, sizeof(cb));
+    cb.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    cb.attachmentCount = 1;
+    cb.pAttachments = &colorBlendAttachment;
+    pipelineInfo.pColorBlendState = &cb;
+
+    VkDynamicState dynStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dyn;
+    memset(&dyn, 0, sizeof(dyn));
+    dyn.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dyn.dynamicStateCount = 2;
+    dyn.pDynamicStates = dynStates;
+    pipelineInfo.pDynamicState = &dyn;
+
+    pipelineInfo.layout = m_drawPipelineLayout;
+    pipelineInfo.renderPass = rp;
+
+    err = m_devFuncs->vkCreateGraphicsPipelines(m_dev, m_pipelineCache, 1, &pipelineInfo, nullptr, &m_drawPipeline);
+
+    m_devFuncs->vkDestroyShaderModule(m_dev, vertModule, nullptr);
+    m_devFuncs->vkDestroyShaderModule(m_dev, fragModule, nullptr);
+
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create shape graphics pipeline: %d", err);
+}
+
+#include "vulkanshape.moc"
@@ -0,0 +1,105 @@
+// vulkanshape.h
+#ifndef VULKANSHAPE_H
+#define VULKANSHAPE_H
+
+#include <QtQuick/QQuickItem>
+#include <QtQuick/QQuickWindow>
+#include <QColor>
+#include <QSharedPointer>
+#include "vulkanpipelinestatistics.h"
+#include "vulkanstatesnapshot.h"
+
+class ShapeRenderer;
+struct ShapeState;
+
+// Гладкая параметрическая фигура: сфера, тор или суперэллипсоид
+// («трёхмерный squircle», |x|^n + |y|^n + |z|^n = 1).
+//
+// Вершины и индексы строит compute-шейдер (shaders/shape.comp) прямо в
+// буферы отрисовки, CPU геометрию не создаёт. Плотность сетки выбирается по
+// размеру фигуры на экране: одно ребро - около pixelsPerSegment пикселей.
+// Уровни детализации (8 ... 256 сегментов по окружности) строятся при
+// первом использовании и хранятся, переключение - выбор буфера. Более
+// грубый уровень выбирается, только когда размер заметно меньше порога
+// текущего, поэтому на границе уровни не мигают.
+class VulkanShape : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(Shape shape READ shape WRITE setShape NOTIFY shapeChanged)
+    Q_PROPERTY(qreal exponent READ exponent WRITE setExponent NOTIFY exponentChanged)
+    Q_PROPERTY(qreal tubeRadius READ tubeRadius WRITE setTubeRadius NOTIFY tubeRadiusChanged)
+    Q_PROPERTY(QColor color READ color WRITE setColor NOTIFY colorChanged)
+    Q_PROPERTY(qreal t READ t WRITE setT NOTIFY tChanged)
+    Q_PROPERTY(qreal pixelsPerSegment READ pixelsPerSegment WRITE setPixelsPerSegment NOTIFY pixelsPerSegmentChanged)
+    Q_PROPERTY(VulkanPipelineStatistics *pipelineStatistics READ pipelineStatistics CONSTANT)
+    QML_ELEMENT
+
+public:
+    enum Shape {
+        Sphere,
+        Torus,
+        Squircle    // суперэллипсоид с показателем exponent
+    };
+    Q_ENUM(Shape)
+
+    VulkanShape();
+
+    VulkanPipelineStatistics *pipelineStatistics() const { return m_pipelineStatistics; }
+
+    Shape shape() const { return m_shape; }
+    void setShape(Shape shape);
+    // Показатель суперэллипсоида: 2 - сфера, больше - ближе к кубу
+    qreal exponent() const { return m_exponent; }
+    void setExponent(qreal exponent);
+    // Радиус трубки тора относительно внешнего радиуса
+    qreal tubeRadius() const { return m_tubeRadius; }
+    void setTubeRadius(qreal radius);
+    QColor color() const { return m_color; }
+    void setColor(const QColor &color);
+    // Поворот: полный оборот при изменении t на 1
+    qreal t() const { return m_t; }
+    void setT(qreal t);
+    qreal pixelsPerSegment() const { return m_pixelsPerSegment; }
+    void setPixelsPerSegment(qreal pixels);
+
+signals:
+    void shapeChanged();
+    void exponentChanged();
+    void tubeRadiusChanged();
+    void colorChanged();
+    void tChanged();
+    void pixelsPerSegmentChanged();
+
+public slots:
+    void sync();
+    void cleanup();
+
+private slots:
+    void handleWindowChanged(QQuickWindow *win);
+
+protected:
+    void geometryChange(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+    void itemChange(ItemChange change, const ItemChangeData &value) override;
+
+private:
+    void releaseResources() override;
+    void trackAncestors();
+    void connectSync(QQuickWindow *win);
+    ShapeState rendererState() const;
+    void publishState();
+
+    Shape m_shape = Sphere;
+    qreal m_exponent = 4;
+    qreal m_tubeRadius = 0.35;
+    QColor m_color = QColor(80, 160, 255);
+    qreal m_t = 0;
+    qreal m_pixelsPerSegment = 8;
+    VulkanPipelineStatistics *m_pipelineStatistics = new VulkanPipelineStatistics(this);
+    ShapeRenderer *m_renderer = nullptr;
+    // Как у VulkanCube: свойства публикуются сразу, sync() создаёт рендерер
+    QSharedPointer<VulkanStateSnapshot<ShapeState>> m_state;
+    QMetaObject::Connection m_syncConnection;
+    QList<QMetaObject::Connection> m_ancestorConnections;
+};
+
+#endif
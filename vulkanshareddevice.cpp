@@ -0,0 +1,230 @@
+// vulkanshareddevice.cpp
+#include "vulkanshareddevice.h"
+#include "vulkandevicefeatures.h"
+#include "vulkanuploadservice.h"
+#include <QtQuick/QQuickGraphicsDevice>
+#include <QVulkanFunctions>
+#include <QList>
+#include <algorithm>
+
+static QVulkanInstance *s_inst = nullptr;
+static VkPhysicalDevice s_physDev = VK_NULL_HANDLE;
+static VkDevice s_dev = VK_NULL_HANDLE;
+static uint32_t s_queueFamily = 0;
+static int s_windowQueues = 0;
+static int s_attached = 0;
+
+bool VulkanSharedDevice::create(QVulkanInstance *inst, int windowCount, const DeviceRequest &request)
+{
+    Q_ASSERT(!s_dev && windowCount > 0);
+    QVulkanFunctions *f = inst->functions();
+
+    s_physDev = VulkanDeviceFeatures::selectPhysicalDevice(inst, request.physicalDevice);
+    if (!s_physDev)
+        return false;
+
+    uint32_t familyCount = 0;
+    f->vkGetPhysicalDeviceQueueFamilyProperties(s_physDev, &familyCount, nullptr);
+    QList<VkQueueFamilyProperties> families(familyCount);
+    f->vkGetPhysicalDeviceQueueFamilyProperties(s_physDev, &familyCount, families.data());
+    uint32_t queueCount = 0;
+    for (uint32_t i = 0; i < familyCount; ++i) {
+        if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+            s_queueFamily = i;
+            queueCount = families[i].queueCount;
+            break;
+        }
+    }
+    if (!queueCount)
+        return false;
+
+    // Семейство для загрузок без графики: сначала только с передачей
+    // (DMA-движок, копирует параллельно с кадрами), иначе с вычислениями.
+    // Передача есть в любом семействе с графикой или вычислениями, даже если
+    // бит VK_QUEUE_TRANSFER_BIT не выставлен.
+    int transferFamily = -1;
+    for (uint32_t i = 0; i < familyCount; ++i) {
+        const VkQueueFlags flags = families[i].queueFlags;
+        if (!families[i].queueCount || (flags & VK_QUEUE_GRAPHICS_BIT)
+            || !(flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT)))
+            continue;
+        if (!(flags & VK_QUEUE_COMPUTE_BIT)) {
+            transferFamily = int(i);
+            break;
+        }
+        if (transferFamily < 0)
+            transferFamily = int(i);
+    }
+
+    // По очереди на окно и одна для загрузок. VulkanUploadService
+    // отправляет загрузки с потоков рендеринга всех окон, поэтому без своей
+    // очереди он занял бы очередь одного из окон в обход её потока. Очередь
+    // загрузок берётся из семейства передачи, если оно есть, иначе ещё одна
+    // из графического. При нехватке очередей окна рисуются в одном потоке
+    // и делят первую очередь; загрузки без семейства передачи - тоже.
+    const uint32_t graphicsForUploads = transferFamily < 0 ? 1 : 0;
+    const bool ownQueues = queueCount >= uint32_t(windowCount) + graphicsForUploads;
+    if (!ownQueues) {
+        qWarning("shared device: %u graphics queue(s) for %d windows%s, using the basic render loop",
+                 queueCount, windowCount, graphicsForUploads ? " and uploads" : "");
+        qputenv("QSG_RENDER_LOOP", "basic");
+    }
+    s_windowQueues = ownQueues ? windowCount : 1;
+    const bool uploadQueue = transferFamily >= 0 || ownQueues;
+    const uint32_t graphicsCount = uint32_t(s_windowQueues) + (uploadQueue ? graphicsForUploads : 0);
+
+    QList<float> priorities(graphicsCount, 1.0f);
+    VkDeviceQueueCreateInfo queueInfos[2] {};
+    queueInfos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfos[0].queueFamilyIndex = s_queueFamily;
+    queueInfos[0].queueCount = graphicsCount;
+    queueInfos[0].pQueuePriorities = priorities.constData();
+    queueInfos[1] = queueInfos[0];
+    queueInfos[1].queueFamilyIndex = uint32_t(qMax(transferFamily, 0));
+    queueInfos[1].queueCount = 1;
+    const uint32_t queueInfoCount = transferFamily >= 0 ? 2 : 1;
+
+    // Возможности включаются так же, как при создании устройства в Qt: все
+    // поддерживаемые, кроме robustBufferAccess, и возможности 1.1/1.2/1.3 при
+    // экземпляре и устройстве с версией API не ниже 1.2
+    VkPhysicalDeviceProperties props;
+    f->vkGetPhysicalDeviceProperties(s_physDev, &props);
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    VkPhysicalDeviceVulkan11Features features11{};
+    features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+    VkPhysicalDeviceVulkan12Features features12{};
+    features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+#ifdef VK_VERSION_1_3
+    VkPhysicalDeviceVulkan13Features features13{};
+    features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+#endif
+    auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(
+        inst->getInstanceProcAddr("vkGetPhysicalDeviceFeatures2"));
+    const bool useFeatures2 = getFeatures2 && inst->apiVersion() >= QVersionNumber(1, 2)
+            && props.apiVersion >= VK_API_VERSION_1_2;
+    if (useFeatures2) {
+        features2.pNext = &features11;
+        features11.pNext = &features12;
+#ifdef VK_VERSION_1_3
+        if (props.apiVersion >= VK_API_VERSION_1_3)
+            features12.pNext = &features13;
+#endif
+        getFeatures2(s_physDev, &features2);
+    } else {
+        f->vkGetPhysicalDeviceFeatures(s_physDev, &features2.features);
+    }
+    features2.features.robustBufferAccess = VK_FALSE;
+
+    // Возможности расширений включаются только по запросу: своё расширение
+    // и структура в цепочке features2
+    const VulkanDeviceFeatures::Features supported = VulkanDeviceFeatures::supported(inst, s_physDev);
+    const VulkanDeviceFeatures::Features missing = request.features & ~supported;
+    if (missing) {
+        qWarning("shared device: unsupported features ignored: %s",
+                 qPrintable(VulkanDeviceFeatures::names(missing).join(QLatin1String(", "))));
+    }
+    const VulkanDeviceFeatures::Features extensionFeatures = request.features & supported
+            & VulkanDeviceFeatures::extensionFeatures();
+    void **featuresTail = &features12.pNext;
+#ifdef VK_VERSION_1_3
+    if (useFeatures2 && props.apiVersion >= VK_API_VERSION_1_3)
+        featuresTail = &features13.pNext;
+#endif
+#if defined(VK_VERSION_1_3) && defined(VK_EXT_host_image_copy)
+    VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopy{};
+    hostImageCopy.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+    if (extensionFeatures.testFlag(VulkanDeviceFeatures::HostImageCopy)) {
+        hostImageCopy.hostImageCopy = VK_TRUE;
+        *featuresTail = &hostImageCopy;
+        featuresTail = &hostImageCopy.pNext;
+    }
+#endif
+    Q_UNUSED(featuresTail);
+
+    uint32_t availableCount = 0;
+    f->vkEnumerateDeviceExtensionProperties(s_physDev, nullptr, &availableCount, nullptr);
+    QList<VkExtensionProperties> available(availableCount);
+    f->vkEnumerateDeviceExtensionProperties(s_physDev, nullptr, &availableCount, available.data());
+    QByteArrayList enabledExtensions { QByteArrayLiteral("VK_KHR_swapchain") };
+    const QByteArrayList wantedExtensions = request.extensions
+            + VulkanDeviceFeatures::requiredExtensions(extensionFeatures);
+    for (const QByteArray &ext : wantedExtensions) {
+        if (enabledExtensions.contains(ext))
+            continue;
+        const bool isAvailable = std::any_of(available.cbegin(), available.cend(),
+                                             [&ext](const VkExtensionProperties &p) { return ext == p.extensionName; });
+        if (isAvailable)
+            enabledExtensions.append(ext);
+        else
+            qWarning("shared device: extension %s is not supported, skipped", ext.constData());
+    }
+    QList<const char *> extensions;
+    for (const QByteArray &ext : std::as_const(enabledExtensions))
+        extensions.append(ext.constData());
+    VkDeviceCreateInfo devInfo{};
+    devInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    devInfo.pNext = useFeatures2 ? &features2 : nullptr;
+    devInfo.queueCreateInfoCount = queueInfoCount;
+    devInfo.pQueueCreateInfos = queueInfos;
+    devInfo.enabledExtensionCount = uint32_t(extensions.size());
+    devInfo.ppEnabledExtensionNames = extensions.constData();
+    devInfo.pEnabledFeatures = useFeatures2 ? nullptr : &features2.features;
+
+    VkResult err = f->vkCreateDevice(s_physDev, &devInfo, nullptr, &s_dev);
+    if (err != VK_SUCCESS) {
+        qWarning("shared device: vkCreateDevice failed: %d", err);
+        s_dev = VK_NULL_HANDLE;
+        return false;
+    }
+    s_inst = inst;
+    VulkanDeviceFeatures::publish(s_dev, (supported & ~VulkanDeviceFeatures::extensionFeatures()) | extensionFeatures,
+                                  enabledExtensions);
+
+    if (uploadQueue) {
+        const uint32_t uploadFamily = transferFamily >= 0 ? uint32_t(transferFamily) : s_queueFamily;
+        const uint32_t uploadIndex = transferFamily >= 0 ? 0 : uint32_t(s_windowQueues);
+        VkQueue queue = VK_NULL_HANDLE;
+        inst->deviceFunctions(s_dev)->vkGetDeviceQueue(s_dev, uploadFamily, uploadIndex, &queue);
+        VulkanUploadService::setTransferQueue(s_dev, uploadFamily, queue);
+    }
+
+    qDebug("shared device: %s, queue family %u, %d window queue(s)%s", props.deviceName, s_queueFamily,
+           s_windowQueues, !uploadQueue ? "" : transferFamily >= 0 ? " + upload queue in transfer family"
+                                                                    : " + upload queue");
+    if (extensionFeatures) {
+        qDebug("shared device: enabled %s",
+               qPrintable(VulkanDeviceFeatures::names(extensionFeatures).join(QLatin1String(", "))));
+    }
+    return true;
+}
+
+void VulkanSharedDevice::attach(QQuickWindow *window)
+{
+    if (!s_dev)
+        return;
+    if (!s_inst->supportsPresent(s_physDev, s_queueFamily, window))
+        qFatal("Shared device queue family %u cannot present to window", s_queueFamily);
+
+    const int queueIndex = s_attached++ % s_windowQueues;
+    window->setGraphicsDevice(QQuickGraphicsDevice::fromDeviceObjects(s_physDev, s_dev, int(s_queueFamily),
+                                                                      queueIndex));
+}
+
+void VulkanSharedDevice::destroy()
+{
+    if (!s_dev)
+        return;
+    QVulkanDeviceFunctions *df = s_inst->deviceFunctions(s_dev);
+    df->vkDeviceWaitIdle(s_dev);
+    VulkanDeviceFeatures::unpublish(s_dev);
+    df->vkDestroyDevice(s_dev, nullptr);
+    s_inst->resetDeviceFunctions(s_dev);
+    s_dev = VK_NULL_HANDLE;
+    s_attached = 0;
+}
+
+bool VulkanSharedDevice::isActive()
+{
+    return s_dev != VK_NULL_HANDLE;
+}
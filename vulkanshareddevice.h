@@ -0,0 +1,50 @@
+// vulkanshareddevice.h
+#ifndef VULKANSHAREDDEVICE_H
+#define VULKANSHAREDDEVICE_H
+
+#include <QtQuick/QQuickWindow>
+#include <QVulkanInstance>
+#include "vulkandevicefeatures.h"
+
+// Один VkDevice для нескольких VulkanQuickWindow.
+//
+// Без него Qt создаёт устройство на каждое окно, и каждое окно заново
+// загружает текстуры, собирает пайплайны и держит свои копии ресурсов.
+// create() создаёт устройство сам (с теми же возможностями, что включил
+// бы Qt) и по очереди графического семейства на окно: при threaded render
+// loop у каждого окна свой поток рендеринга, а vkQueueSubmit в одну
+// очередь из разных потоков требует внешней синхронизации. Ещё одна
+// очередь отдаётся VulkanUploadService: из семейства без графики с
+// передачей, если оно есть (тогда ресурсы передаются между семействами),
+// иначе из графического (без передачи владения). Если графических
+// очередей не хватает на окна, включается basic render loop - все окна
+// идут из GUI-потока через одну очередь; без семейства передачи загрузки
+// тоже идут через неё.
+//
+// Ресурсы, общие для окон, разделяются по VkDevice: VulkanPipelineCache,
+// VulkanTextureCache, VulkanUploadService; CPU-данные - VulkanAssetCache.
+// Включённые возможности публикуются в VulkanDeviceFeatures; только здесь
+// можно включить возможности расширений (HostImageCopy).
+class VulkanSharedDevice
+{
+public:
+    struct DeviceRequest {
+        // См. VulkanDeviceFeatures::selectPhysicalDevice()
+        QString physicalDevice;
+        // Неподдерживаемые пропускаются с предупреждением
+        QByteArrayList extensions;
+        VulkanDeviceFeatures::Features features;
+    };
+
+    // До создания первого окна (выбор render loop). false - устройство не
+    // создано, окна получат собственные устройства от Qt.
+    static bool create(QVulkanInstance *inst, int windowCount, const DeviceRequest &request = DeviceRequest());
+    // До первого показа окна
+    static void attach(QQuickWindow *window);
+    // После уничтожения всех окон
+    static void destroy();
+
+    static bool isActive();
+};
+
+#endif
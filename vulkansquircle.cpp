@@ -2,26 +2,50 @@
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR BSD-3-Clause
 
 #include "vulkansquircle.h"
+#include "vulkanassetcache.h"
+#include "vulkantrace.h"
+#include "vulkananimationclock.h"
+#include "vulkandraworder.h"
+#include "vulkanpipelinecache.h"
+#include "vulkanutils.h"
+#include "vulkanquickwindow.h"
 #include <QtCore/QRunnable>
 #include <QtQuick/QQuickWindow>
+#include <QtGui/QScreen>
 
 #include <QVulkanInstance>
 #include <QVulkanFunctions>
 #include <QFile>
 
+// Everything the renderer needs from the item, published as one snapshot
+struct SquircleState
+{
+    QSize viewportSize;
+    qreal t = 0;
+    bool renderThreadAnimation = false;
+    qreal animationSpeed = 0;
+    qreal animationPhase = 0;
+    double refreshInterval = 1.0 / 60.0;
+};
+
 class SquircleRenderer : public QObject
 {
     Q_OBJECT
 public:
     ~SquircleRenderer();
 
-    void setT(qreal t) { m_t = t; }
-    void setViewportSize(const QSize &size) { m_viewportSize = size; }
+    void setState(const QSharedPointer<VulkanStateSnapshot<SquircleState>> &state)
+    {
+        m_state = state;
+        m_state->take();
+        applyState(m_state->current());
+    }
     void setWindow(QQuickWindow *window) { m_window = window; }
 
+    void mainPassRecordingStart(VkCommandBuffer cb);
+
 public slots:
     void frameStart();
-    void mainPassRecordingStart();
 
 private:
     enum Stage {
@@ -30,10 +54,19 @@ private:
     };
     void prepareShader(Stage stage);
     void init(int framesInFlight);
+    VkPipeline createPipeline(VkRenderPass rp) const;
+    void finishPipeline();
+    void applyState(const SquircleState &state);
 
+    QSharedPointer<VulkanStateSnapshot<SquircleState>> m_state;
     QSize m_viewportSize;
     qreal m_t = 0;
-    QQuickWindow *m_window;
+    bool m_renderThreadAnimation = false;
+    qreal m_animationSpeed = 0;
+    qreal m_animationPhase = 0;
+    double m_refreshInterval = 0;
+    VulkanAnimationClock m_clock;
+    QQuickWindow *m_window = nullptr;
 
     QByteArray m_vert;
     QByteArray m_frag;
@@ -55,6 +88,8 @@ private:
     VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
     VkDescriptorSetLayout m_resLayout = VK_NULL_HANDLE;
     VkPipeline m_pipeline = VK_NULL_HANDLE;
+    // Being compiled on a worker thread until finishPipeline()
+    std::shared_future<VkPipeline> m_pendingPipeline;
 
     VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
     VkDescriptorSet m_ubufDescriptor = VK_NULL_HANDLE;
@@ -71,15 +106,86 @@ void VulkanSquircle::setT(qreal t)
         return;
     m_t = t;
     emit tChanged();
-    if (window())
-        window()->update();
+    publishState();
+}
+
+void VulkanSquircle::setRenderThreadAnimation(bool enabled)
+{
+    if (enabled == m_renderThreadAnimation)
+        return;
+    m_renderThreadAnimation = enabled;
+    emit renderThreadAnimationChanged();
+    publishState();
+}
+
+void VulkanSquircle::setAnimationSpeed(qreal speed)
+{
+    if (speed == m_animationSpeed)
+        return;
+    m_animationSpeed = speed;
+    emit animationSpeedChanged();
+    publishState();
+}
+
+void VulkanSquircle::setAnimationPhase(qreal phase)
+{
+    if (phase == m_animationPhase)
+        return;
+    m_animationPhase = phase;
+    emit animationPhaseChanged();
+    publishState();
+}
+
+// A device pixel ratio change resizes the viewport in pixels. It also
+// happens without a screen change (display scale setting), and
+// screenChanged can arrive before the window reports the new ratio.
+void VulkanSquircle::itemChange(ItemChange change, const ItemChangeData &value)
+{
+    QQuickItem::itemChange(change, value);
+    if (change == ItemDevicePixelRatioHasChanged)
+        publishState();
+}
+
+SquircleState VulkanSquircle::rendererState() const
+{
+    SquircleState state;
+    state.viewportSize = window()->size() * window()->devicePixelRatio();
+    state.t = m_t;
+    state.renderThreadAnimation = m_renderThreadAnimation;
+    state.animationSpeed = m_animationSpeed;
+    state.animationPhase = m_animationPhase;
+    const qreal refreshRate = window()->screen() ? window()->screen()->refreshRate() : 60;
+    state.refreshInterval = refreshRate > 0 ? 1.0 / refreshRate : 1.0 / 60.0;
+    return state;
+}
+
+// Called on the GUI thread whenever something the renderer uses changes.
+// There is no renderer to publish to before the first sync().
+void VulkanSquircle::publishState()
+{
+    if (!window())
+        return;
+    if (m_state)
+        m_state->publish(rendererState());
+    window()->update();
+}
+
+void VulkanSquircle::connectSync(QQuickWindow *win)
+{
+    disconnect(m_syncConnection);
+    if (win)
+        m_syncConnection = connect(win, &QQuickWindow::beforeSynchronizing, this, &VulkanSquircle::sync, Qt::DirectConnection);
 }
 
 void VulkanSquircle::handleWindowChanged(QQuickWindow *win)
 {
+    connectSync(win);
     if (win) {
-        connect(win, &QQuickWindow::beforeSynchronizing, this, &VulkanSquircle::sync, Qt::DirectConnection);
         connect(win, &QQuickWindow::sceneGraphInvalidated, this, &VulkanSquircle::cleanup, Qt::DirectConnection);
+        // The viewport size is part of the snapshot
+        connect(win, &QWindow::widthChanged, this, &VulkanSquircle::publishState);
+        connect(win, &QWindow::heightChanged, this, &VulkanSquircle::publishState);
+        connect(win, &QWindow::screenChanged, this, &VulkanSquircle::publishState);
 
         // Ensure we start with cleared to black. The squircle's blend mode relies on this.
         win->setColor(Qt::black);
@@ -96,6 +202,9 @@ void VulkanSquircle::cleanup()
 {
     delete m_renderer;
     m_renderer = nullptr;
+    m_state.reset();
+    // The next renderer is created by sync() again
+    connectSync(window());
 }
 
 class CleanupJob : public QRunnable
@@ -111,21 +220,29 @@ void VulkanSquircle::releaseResources()
 {
     window()->scheduleRenderJob(new CleanupJob(m_renderer), QQuickWindow::BeforeSynchronizingStage);
     m_renderer = nullptr;
+    // The old renderer may still render a frame with its snapshot, the next
+    // one gets a fresh snapshot. handleWindowChanged() reconnects sync().
+    m_state.reset();
 }
 
 SquircleRenderer::~SquircleRenderer()
 {
     qDebug("cleanup");
+    if (m_window)
+        VulkanDrawOrder::unregister(m_window, this);
     if (!m_devFuncs)
         return;
 
+    // The compile job reads members and the pipeline cache.
+    finishPipeline();
     m_devFuncs->vkDestroyPipeline(m_dev, m_pipeline, nullptr);
     m_devFuncs->vkDestroyPipelineLayout(m_dev, m_pipelineLayout, nullptr);
     m_devFuncs->vkDestroyDescriptorSetLayout(m_dev, m_resLayout, nullptr);
 
     m_devFuncs->vkDestroyDescriptorPool(m_dev, m_descriptorPool, nullptr);
 
-    m_devFuncs->vkDestroyPipelineCache(m_dev, m_pipelineCache, nullptr);
+    if (m_pipelineCache)
+        VulkanPipelineCache::release(m_dev);
 
     m_devFuncs->vkDestroyBuffer(m_dev, m_vbuf, nullptr);
     m_devFuncs->vkFreeMemory(m_dev, m_vbufMem, nullptr);
@@ -138,23 +255,40 @@ SquircleRenderer::~SquircleRenderer()
 
 void VulkanSquircle::sync()
 {
+    VKQ_TRACE_SCOPE("VulkanSquircle::sync");
     if (!m_renderer) {
         m_renderer = new SquircleRenderer;
         // Initializing resources is done before starting to record the
         // renderpass, regardless of wanting an underlay or overlay.
         connect(window(), &QQuickWindow::beforeRendering, m_renderer, &SquircleRenderer::frameStart, Qt::DirectConnection);
-        // Here we want an underlay and therefore connect to
-        // beforeRenderPassRecording. Changing to afterRenderPassRecording
-        // would render the squircle on top (overlay).
-        connect(window(), &QQuickWindow::beforeRenderPassRecording, m_renderer, &SquircleRenderer::mainPassRecordingStart, Qt::DirectConnection);
+        // Here we want an underlay, recorded at the start of the main pass
+        // (beforeRenderPassRecording) by the window's VulkanDrawOrder. The
+        // squircle is a background: it is drawn after opaque items at the
+        // far depth, so the pixels they cover are rejected by the depth test.
+        SquircleRenderer *renderer = m_renderer;
+        VulkanDrawOrder::forWindow(window())->add(renderer, VulkanDrawOrder::BackgroundStage, "VulkanSquircle",
+                                                  [renderer](VkCommandBuffer cb) { renderer->mainPassRecordingStart(cb); });
+        m_renderer->setWindow(window());
+        // The GUI thread is blocked, so the first snapshot can be published
+        // from here. Later ones come from the property setters.
+        m_state.reset(new VulkanStateSnapshot<SquircleState>);
+        m_state->publish(rendererState());
+        m_renderer->setState(m_state);
+    }
+
+    // With hundreds of items a per-item sync keeps the GUI thread blocked
+    // for long, so it is only kept when the pipeline statistics need it.
+    if (!VulkanDrawOrder::statisticsEnabled()) {
+        disconnect(m_syncConnection);
+        return;
     }
-    m_renderer->setViewportSize(window()->size() * window()->devicePixelRatio());
-    m_renderer->setT(m_t);
-    m_renderer->setWindow(window());
+    const QSize viewportSize = window()->size() * window()->devicePixelRatio();
+    m_pipelineStatistics->sync(window(), m_renderer, qreal(viewportSize.width()) * viewportSize.height());
 }
 
 void SquircleRenderer::frameStart()
 {
+    VKQ_TRACE_SCOPE("SquircleRenderer::frameStart");
     QSGRendererInterface *rif = m_window->rendererInterface();
 
     // We are not prepared for anything other than running with the RHI and its Vulkan backend.
@@ -167,6 +301,29 @@ void SquircleRenderer::frameStart()
 
     if (!m_initialized)
         init(m_window->graphicsStateInfo().framesInFlight);
+
+    if (m_state->take())
+        applyState(m_state->current());
+
+    if (m_renderThreadAnimation) {
+        m_t = animatedT(m_animationSpeed, m_animationPhase, m_clock.advance(m_refreshInterval));
+        // Schedule the next frame from the render thread directly. With the
+        // threaded render loop and no frame rate limit this repaints without
+        // a sync, so the GUI thread does not need to wake up just to animate.
+        VulkanQuickWindow::requestFrame(m_window);
+    }
+}
+
+void SquircleRenderer::applyState(const SquircleState &state)
+{
+    if (state.renderThreadAnimation && !m_renderThreadAnimation)
+        m_clock.reset();
+    m_viewportSize = state.viewportSize;
+    m_t = state.t;
+    m_renderThreadAnimation = state.renderThreadAnimation;
+    m_animationSpeed = state.animationSpeed;
+    m_animationPhase = state.animationPhase;
+    m_refreshInterval = state.refreshInterval;
 }
 
 static const float vertices[] = {
@@ -178,14 +335,14 @@ static const float vertices[] = {
 
 const int UBUF_SIZE = 4;
 
-void SquircleRenderer::mainPassRecordingStart()
+void SquircleRenderer::mainPassRecordingStart(VkCommandBuffer cb)
 {
+    VKQ_TRACE_SCOPE("SquircleRenderer::mainPassRecordingStart");
     // This example demonstrates the simple case: prepending some commands to
     // the scenegraph's main renderpass. It does not create its own passes,
     // rendertargets, etc. so no synchronization is needed.
 
     const QQuickWindow::GraphicsStateInfo &stateInfo(m_window->graphicsStateInfo());
-    QSGRendererInterface *rif = m_window->rendererInterface();
 
     VkDeviceSize ubufOffset = stateInfo.currentFrameSlot * m_allocPerUbuf;
     void *p = nullptr;
@@ -196,18 +353,16 @@ void SquircleRenderer::mainPassRecordingStart()
     memcpy(p, &t, 4);
     m_devFuncs->vkUnmapMemory(m_dev, m_ubufMem);
 
-    m_window->beginExternalCommands();
-
-    // Must query the command buffer _after_ beginExternalCommands(), this is
-    // actually important when running on Vulkan because what we get here is a
-    // new secondary command buffer, not the primary one.
-    VkCommandBuffer cb = *reinterpret_cast<VkCommandBuffer *>(
-                rif->getResource(m_window, QSGRendererInterface::CommandListResource));
-    Q_ASSERT(cb);
+    // cb comes from VulkanDrawOrder, which wraps all items of the window in a
+    // single beginExternalCommands()/endExternalCommands() pair.
 
     // Do not assume any state persists on the command buffer. (it may be a
     // brand new one that just started recording)
 
+    finishPipeline();
+
+    VKQ_TRACE_GPU_BEGIN(cb, "VulkanSquircle");
+
     m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
 
     VkDeviceSize vbufOffset = 0;
@@ -217,18 +372,21 @@ void SquircleRenderer::mainPassRecordingStart()
     m_devFuncs->vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1,
                                         &m_ubufDescriptor, 1, &dynamicOffset);
 
-    VkViewport vp = { 0, 0, float(m_viewportSize.width()), float(m_viewportSize.height()), 0.0f, 1.0f };
+    // minDepth = maxDepth = 1 puts every fragment at the far plane without
+    // touching the shader.
+    VkViewport vp = { 0, 0, float(m_viewportSize.width()), float(m_viewportSize.height()), 1.0f, 1.0f };
     m_devFuncs->vkCmdSetViewport(cb, 0, 1, &vp);
     VkRect2D scissor = { { 0, 0 }, { uint32_t(m_viewportSize.width()), uint32_t(m_viewportSize.height()) } };
     m_devFuncs->vkCmdSetScissor(cb, 0, 1, &scissor);
 
     m_devFuncs->vkCmdDraw(cb, 4, 1, 0, 0);
 
-    m_window->endExternalCommands();
+    VKQ_TRACE_GPU_END(cb);
 }
 
 void SquircleRenderer::prepareShader(Stage stage)
 {
+    VKQ_TRACE_SCOPE("SquircleRenderer::prepareShader");
     QString filename;
     if (stage == VertexStage) {
         filename = QLatin1String(":/squircle.vert.spv");
@@ -236,12 +394,12 @@ void SquircleRenderer::prepareShader(Stage stage)
         Q_ASSERT(stage == FragmentStage);
         filename = QLatin1String(":/squircle.frag.spv");
     }
-    QFile f(filename);
-    if (!f.open(QIODevice::ReadOnly))
+    // The SPIR-V is kept in a process-wide cache so that recreating the
+    // renderer after sceneGraphInvalidated() does not hit the file system again.
+    const QByteArray contents = VulkanAssetCache::instance()->shader(filename);
+    if (contents.isEmpty())
         qFatal("Failed to read shader %s", qPrintable(filename));
 
-    const QByteArray contents = f.readAll();
-
     if (stage == VertexStage) {
         m_vert = contents;
         Q_ASSERT(!m_vert.isEmpty());
@@ -258,6 +416,7 @@ static inline VkDeviceSize aligned(VkDeviceSize v, VkDeviceSize byteAlign)
 
 void SquircleRenderer::init(int framesInFlight)
 {
+    VKQ_TRACE_SCOPE("SquircleRenderer::init");
     Q_ASSERT(framesInFlight <= 3);
     m_initialized = true;
 
@@ -302,18 +461,8 @@ void SquircleRenderer::init(int framesInFlight)
     allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
     allocInfo.allocationSize = memReq.size;
 
-    uint32_t memTypeIndex = uint32_t(-1);
-    const VkMemoryType *memType = physDevMemProps.memoryTypes;
-    for (uint32_t i = 0; i < physDevMemProps.memoryTypeCount; ++i) {
-        if (memReq.memoryTypeBits & (1 << i)) {
-            if ((memType[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
-                    && (memType[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
-            {
-                    memTypeIndex = i;
-                    break;
-            }
-        }
-    }
+    const VkMemoryPropertyFlags memPropFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    uint32_t memTypeIndex = VulkanUtils::findMemoryType(physDevMemProps, memReq.memoryTypeBits, memPropFlags);
     if (memTypeIndex == uint32_t(-1))
         qFatal("Failed to find host visible and coherent memory type");
 
@@ -353,17 +502,7 @@ void SquircleRenderer::init(int framesInFlight)
     if (err != VK_SUCCESS)
         qFatal("Failed to create uniform buffer: %d", err);
     m_devFuncs->vkGetBufferMemoryRequirements(m_dev, m_ubuf, &memReq);
-    memTypeIndex = -1;
-    for (uint32_t i = 0; i < physDevMemProps.memoryTypeCount; ++i) {
-        if (memReq.memoryTypeBits & (1 << i)) {
-            if ((memType[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
-                    && (memType[i].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
-            {
-                    memTypeIndex = i;
-                    break;
-            }
-        }
-    }
+    memTypeIndex = VulkanUtils::findMemoryType(physDevMemProps, memReq.memoryTypeBits, memPropFlags);
     if (memTypeIndex == uint32_t(-1))
         qFatal("Failed to find host visible and coherent memory type");
 
@@ -379,12 +518,8 @@ void SquircleRenderer::init(int framesInFlight)
 
     // Now onto the pipeline.
 
-    VkPipelineCacheCreateInfo pipelineCacheInfo;
-    memset(&pipelineCacheInfo, 0, sizeof(pipelineCacheInfo));
-    pipelineCacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-    err = m_devFuncs->vkCreatePipelineCache(m_dev, &pipelineCacheInfo, nullptr, &m_pipelineCache);
-    if (err != VK_SUCCESS)
-        qFatal("Failed to create pipeline cache: %d", err);
+    // Shared per-device cache, persisted across runs by VulkanPipelineCache.
+    m_pipelineCache = VulkanPipelineCache::acquire(m_window);
 
     VkDescriptorSetLayoutBinding descLayoutBinding;
     memset(&descLayoutBinding, 0, sizeof(descLayoutBinding));
@@ -410,6 +545,54 @@ void SquircleRenderer::init(int framesInFlight)
     if (err != VK_SUCCESS)
         qWarning("Failed to create pipeline layout: %d", err);
 
+    // Compile the pipeline on a worker thread while the rest of the scene
+    // graph initializes. finishPipeline() picks it up before the first draw.
+    m_pendingPipeline = VulkanPipelineCache::createAsync([this, rp] { return createPipeline(rp); });
+
+    // Now just need some descriptors.
+    VkDescriptorPoolSize descPoolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 }
+    };
+    VkDescriptorPoolCreateInfo descPoolInfo;
+    memset(&descPoolInfo, 0, sizeof(descPoolInfo));
+    descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descPoolInfo.flags = 0; // won't use vkFreeDescriptorSets
+    descPoolInfo.maxSets = 1;
+    descPoolInfo.poolSizeCount = sizeof(descPoolSizes) / sizeof(descPoolSizes[0]);
+    descPoolInfo.pPoolSizes = descPoolSizes;
+    err = m_devFuncs->vkCreateDescriptorPool(m_dev, &descPoolInfo, nullptr, &m_descriptorPool);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create descriptor pool: %d", err);
+
+    VkDescriptorSetAllocateInfo descAllocInfo;
+    memset(&descAllocInfo, 0, sizeof(descAllocInfo));
+    descAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descAllocInfo.descriptorPool = m_descriptorPool;
+    descAllocInfo.descriptorSetCount = 1;
+    descAllocInfo.pSetLayouts = &m_resLayout;
+    err = m_devFuncs->vkAllocateDescriptorSets(m_dev, &descAllocInfo, &m_ubufDescriptor);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to allocate descriptor set");
+
+    VkWriteDescriptorSet writeInfo;
+    memset(&writeInfo, 0, sizeof(writeInfo));
+    writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writeInfo.dstSet = m_ubufDescriptor;
+    writeInfo.dstBinding = 0;
+    writeInfo.descriptorCount = 1;
+    writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    VkDescriptorBufferInfo bufInfo;
+    bufInfo.buffer = m_ubuf;
+    bufInfo.offset = 0; // dynamic offset is used so this is ignored
+    bufInfo.range = UBUF_SIZE;
+    writeInfo.pBufferInfo = &bufInfo;
+    m_devFuncs->vkUpdateDescriptorSets(m_dev, 1, &writeInfo, 0, nullptr);
+}
+
+// Runs on a worker thread. It only reads state that init() has set up and
+// does not change afterwards.
+VkPipeline SquircleRenderer::createPipeline(VkRenderPass rp) const
+{
     VkGraphicsPipelineCreateInfo pipelineInfo;
     memset(&pipelineInfo, 0, sizeof(pipelineInfo));
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -420,7 +603,7 @@ void SquircleRenderer::init(int framesInFlight)
     shaderInfo.codeSize = m_vert.size();
     shaderInfo.pCode = reinterpret_cast<const quint32 *>(m_vert.constData());
     VkShaderModule vertShaderModule;
-    err = m_devFuncs->vkCreateShaderModule(m_dev, &shaderInfo, nullptr, &vertShaderModule);
+    VkResult err = m_devFuncs->vkCreateShaderModule(m_dev, &shaderInfo, nullptr, &vertShaderModule);
     if (err != VK_SUCCESS)
         qFatal("Failed to create vertex shader module: %d", err);
 
@@ -499,6 +682,11 @@ void SquircleRenderer::init(int framesInFlight)
     VkPipelineDepthStencilStateCreateInfo dsInfo;
     memset(&dsInfo, 0, sizeof(dsInfo));
     dsInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    // Test against the depth written by opaque items, but do not write: the
+    // main pass clears depth to 1.0, so uncovered pixels still pass.
+    dsInfo.depthTestEnable = VK_TRUE;
+    dsInfo.depthWriteEnable = VK_FALSE;
+    dsInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
     pipelineInfo.pDepthStencilState = &dsInfo;
 
     // SrcAlpha, One
@@ -524,52 +712,23 @@ void SquircleRenderer::init(int framesInFlight)
 
     pipelineInfo.renderPass = rp;
 
-    err = m_devFuncs->vkCreateGraphicsPipelines(m_dev, m_pipelineCache, 1, &pipelineInfo, nullptr, &m_pipeline);
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    err = m_devFuncs->vkCreateGraphicsPipelines(m_dev, m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
 
     m_devFuncs->vkDestroyShaderModule(m_dev, vertShaderModule, nullptr);
     m_devFuncs->vkDestroyShaderModule(m_dev, fragShaderModule, nullptr);
 
     if (err != VK_SUCCESS)
         qFatal("Failed to create graphics pipeline: %d", err);
+    return pipeline;
+}
 
-    // Now just need some descriptors.
-    VkDescriptorPoolSize descPoolSizes[] = {
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 }
-    };
-    VkDescriptorPoolCreateInfo descPoolInfo;
-    memset(&descPoolInfo, 0, sizeof(descPoolInfo));
-    descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    descPoolInfo.flags = 0; // won't use vkFreeDescriptorSets
-    descPoolInfo.maxSets = 1;
-    descPoolInfo.poolSizeCount = sizeof(descPoolSizes) / sizeof(descPoolSizes[0]);
-    descPoolInfo.pPoolSizes = descPoolSizes;
-    err = m_devFuncs->vkCreateDescriptorPool(m_dev, &descPoolInfo, nullptr, &m_descriptorPool);
-    if (err != VK_SUCCESS)
-        qFatal("Failed to create descriptor pool: %d", err);
-
-    VkDescriptorSetAllocateInfo descAllocInfo;
-    memset(&descAllocInfo, 0, sizeof(descAllocInfo));
-    descAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    descAllocInfo.descriptorPool = m_descriptorPool;
-    descAllocInfo.descriptorSetCount = 1;
-    descAllocInfo.pSetLayouts = &m_resLayout;
-    err = m_devFuncs->vkAllocateDescriptorSets(m_dev, &descAllocInfo, &m_ubufDescriptor);
-    if (err != VK_SUCCESS)
-        qFatal("Failed to allocate descriptor set");
-
-    VkWriteDescriptorSet writeInfo;
-    memset(&writeInfo, 0, sizeof(writeInfo));
-    writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    writeInfo.dstSet = m_ubufDescriptor;
-    writeInfo.dstBinding = 0;
-    writeInfo.descriptorCount = 1;
-    writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    VkDescriptorBufferInfo bufInfo;
-    bufInfo.buffer = m_ubuf;
-    bufInfo.offset = 0; // dynamic offset is used so this is ignored
-    bufInfo.range = UBUF_SIZE;
-    writeInfo.pBufferInfo = &bufInfo;
-    m_devFuncs->vkUpdateDescriptorSets(m_dev, 1, &writeInfo, 0, nullptr);
+void SquircleRenderer::finishPipeline()
+{
+    if (m_pendingPipeline.valid()) {
+        m_pipeline = m_pendingPipeline.get();
+        m_pendingPipeline = {};
+    }
 }
 
 #include "vulkansquircle.moc"
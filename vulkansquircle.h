@@ -6,23 +6,45 @@
 
 #include <QtQuick/QQuickItem>
 #include <QtQuick/QQuickWindow>
+#include <QSharedPointer>
+#include "vulkanpipelinestatistics.h"
+#include "vulkanstatesnapshot.h"
 
 class SquircleRenderer;
+struct SquircleState;
 
 class VulkanSquircle : public QQuickItem
 {
     Q_OBJECT
     Q_PROPERTY(qreal t READ t WRITE setT NOTIFY tChanged)
+    Q_PROPERTY(bool renderThreadAnimation READ renderThreadAnimation WRITE setRenderThreadAnimation NOTIFY renderThreadAnimationChanged)
+    Q_PROPERTY(qreal animationSpeed READ animationSpeed WRITE setAnimationSpeed NOTIFY animationSpeedChanged)
+    Q_PROPERTY(qreal animationPhase READ animationPhase WRITE setAnimationPhase NOTIFY animationPhaseChanged)
+    Q_PROPERTY(VulkanPipelineStatistics *pipelineStatistics READ pipelineStatistics CONSTANT)
     QML_ELEMENT
 
 public:
     VulkanSquircle();
 
+    VulkanPipelineStatistics *pipelineStatistics() const { return m_pipelineStatistics; }
+
     qreal t() const { return m_t; }
     void setT(qreal t);
 
+    // When enabled, t = frac(animationPhase + animationSpeed * time) is
+    // computed on the render thread and the t property is ignored.
+    bool renderThreadAnimation() const { return m_renderThreadAnimation; }
+    void setRenderThreadAnimation(bool enabled);
+    qreal animationSpeed() const { return m_animationSpeed; }
+    void setAnimationSpeed(qreal speed);
+    qreal animationPhase() const { return m_animationPhase; }
+    void setAnimationPhase(qreal phase);
+
 signals:
     void tChanged();
+    void renderThreadAnimationChanged();
+    void animationSpeedChanged();
+    void animationPhaseChanged();
 
 public slots:
     void sync();
@@ -31,11 +53,25 @@ public slots:
 private slots:
     void handleWindowChanged(QQuickWindow *win);
 
+protected:
+    void itemChange(ItemChange change, const ItemChangeData &value) override;
+
 private:
     void releaseResources() override;
+    void connectSync(QQuickWindow *win);
+    SquircleState rendererState() const;
+    void publishState();
 
     qreal m_t = 0;
+    bool m_renderThreadAnimation = false;
+    qreal m_animationSpeed = 0;
+    qreal m_animationPhase = 0;
+    VulkanPipelineStatistics *m_pipelineStatistics = new VulkanPipelineStatistics(this);
     SquircleRenderer *m_renderer = nullptr;
+    // Property changes are published here as they happen; the renderer picks
+    // up the latest snapshot at the start of each frame.
+    QSharedPointer<VulkanStateSnapshot<SquircleState>> m_state;
+    QMetaObject::Connection m_syncConnection;
 };
 
 #endif
@@ -0,0 +1,106 @@
+// vulkanstartup.cpp
+#include "vulkanstartup.h"
+#include "vulkanassetcache.h"
+#include "vulkanpipelinecache.h"
+#include "vulkantextureblob.h"
+#include "vulkantrace.h"
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace VulkanStartup {
+
+static QElapsedTimer s_clock;
+static bool s_preloadStarted = false;
+static std::atomic<qint64> s_preloadDone { -1 };
+static std::atomic<int> s_preloadPending { 0 };
+static qint64 s_qmlLoaded = -1;
+static std::atomic<qint64> s_sceneGraphInitialized { -1 };
+
+static double ms(qint64 ns)
+{
+    return ns / 1000000.0;
+}
+
+void markProcessStart()
+{
+    s_clock.start();
+}
+
+static void finishJob()
+{
+    if (--s_preloadPending == 0)
+        s_preloadDone = s_clock.nsecsElapsed();
+}
+
+static void startJob(const std::function<void()> &job)
+{
+    ++s_preloadPending;
+    QThreadPool::globalInstance()->start([job] {
+        job();
+        finishJob();
+    });
+}
+
+void preload()
+{
+    VKQ_TRACE_SCOPE("VulkanStartup::preload");
+    s_preloadStarted = true;
+    // Не даёт счётчику дойти до нуля, пока задания ещё ставятся в очередь
+    s_preloadPending = 1;
+
+    // SPIR-V встроен в бинарник и чтения не требует. Задание на файл: PNG
+    // декодируются параллельно друг с другом
+    QDirIterator images(QStringLiteral(":/textures"), { QStringLiteral("*.png") }, QDir::Files);
+    while (images.hasNext()) {
+        const QString fileName = images.next();
+        startJob([fileName] {
+            VKQ_TRACE_SCOPE("preload image");
+            // Подготовленный блоб только отображается в память, PNG
+            // декодируется лишь при его отсутствии
+            VulkanAssetCache *cache = VulkanAssetCache::instance();
+            if (!cache->textureBlob(VulkanTextureBlob::cookedPath(fileName)))
+                cache->image(fileName);
+        });
+    }
+
+    startJob([] { VulkanPipelineCache::preloadData(); });
+    finishJob();
+}
+
+void waitForPreload()
+{
+    if (s_preloadStarted)
+        QThreadPool::globalInstance()->waitForDone();
+}
+
+void markQmlLoaded()
+{
+    s_qmlLoaded = s_clock.nsecsElapsed();
+}
+
+void watchFirstFrame(QQuickWindow *window)
+{
+    QObject::connect(window, &QQuickWindow::sceneGraphInitialized, window, [] {
+        qint64 expected = -1;
+        s_sceneGraphInitialized.compare_exchange_strong(expected, s_clock.nsecsElapsed());
+    }, Qt::DirectConnection);
+
+    // Отчёт один раз: соединение разрывается после первого кадра
+    auto connection = std::make_shared<QMetaObject::Connection>();
+    *connection = QObject::connect(window, &QQuickWindow::frameSwapped, window, [connection] {
+        const qint64 firstFrame = s_clock.nsecsElapsed();
+        QObject::disconnect(*connection);
+        const qint64 preloadDone = s_preloadDone;
+        qInfo("startup: qml loaded %.1f ms, scene graph initialized %.1f ms, first frame %.1f ms, preload %s",
+              ms(s_qmlLoaded), ms(s_sceneGraphInitialized), ms(firstFrame),
+              !s_preloadStarted ? "off"
+                                : preloadDone < 0 ? "still running"
+                                                  : qPrintable(QString::asprintf("done at %.1f ms", ms(preloadDone))));
+    }, Qt::DirectConnection);
+}
+
+} // namespace VulkanStartup
@@ -0,0 +1,36 @@
+// vulkanstartup.h
+#ifndef VULKANSTARTUP_H
+#define VULKANSTARTUP_H
+
+#include <QtQuick/QQuickWindow>
+
+// Подготовка к первому кадру параллельно с загрузкой QML.
+//
+// preload() ставит в глобальный пул потоков декодирование текстур в
+// VulkanAssetCache и чтение файла кэша пайплайнов; SPIR-V встроен в бинарник.
+// Пока движок QML загружает сцену, а Qt создаёт устройство при показе окна,
+// рабочие потоки успевают подготовить данные, и init() рендереров берёт их
+// из кэшей. Устройства до показа окна нет, поэтому пайплайны сцены при
+// старте (куб, отбор источников, squircle) init() рендереров отдаёт рабочим
+// потокам через VulkanPipelineCache::createAsync() с настоящим render pass
+// окна и забирает перед первой записью команд: компиляция идёт параллельно
+// друг с другом и с остальной инициализацией первого кадра, а после первого
+// запуска - ещё и попаданием в сохранённый кэш.
+//
+// watchFirstFrame() печатает время от начала main() до загрузки QML,
+// инициализации графа сцены и первого показанного кадра.
+namespace VulkanStartup {
+
+// Вызывается первой строкой main()
+void markProcessStart();
+
+void preload();
+// Перед выходом из main(): рабочие потоки не должны пережить кэши
+void waitForPreload();
+
+void markQmlLoaded();
+void watchFirstFrame(QQuickWindow *window);
+
+} // namespace VulkanStartup
+
+#endif
@@ -0,0 +1,54 @@
+// vulkanstatesnapshot.h
+#ifndef VULKANSTATESNAPSHOT_H
+#define VULKANSTATESNAPSHOT_H
+
+#include <atomic>
+
+// Тройной буфер без блокировок для передачи состояния элемента из
+// GUI-потока в поток рендеринга без блокирующей фазы sync.
+//
+// Один писатель (GUI-поток) целиком копирует состояние в свой слот и
+// публикует его обменом с общим слотом; один читатель (поток рендеринга)
+// в начале кадра забирает общий слот, если с прошлого раза была публикация.
+// Промежуточные снимки теряются: читатель всегда видит последний целый
+// снимок, поэтому подходит только для состояния «последнее значение», а не
+// для очередей изменений.
+//
+// Писатель и читатель не должны меняться ролями; пока GUI-поток
+// заблокирован в sync, поток рендеринга может выступать писателем.
+template <typename T>
+class VulkanStateSnapshot
+{
+public:
+    // Писатель
+    void publish(const T &state)
+    {
+        m_slots[m_write] = state;
+        const int previous = m_shared.exchange(m_write | Fresh, std::memory_order_acq_rel);
+        m_write = previous & IndexMask;
+    }
+
+    // Читатель: true, если с прошлого вызова был опубликован новый снимок,
+    // тогда current() возвращает его
+    bool take()
+    {
+        if (!(m_shared.load(std::memory_order_relaxed) & Fresh))
+            return false;
+        const int previous = m_shared.exchange(m_read, std::memory_order_acq_rel);
+        m_read = previous & IndexMask;
+        return true;
+    }
+
+    const T &current() const { return m_slots[m_read]; }
+
+private:
+    enum { IndexMask = 3, Fresh = 4 };
+
+    T m_slots[3];
+    int m_write = 0;
+    int m_read = 1;
+    // Индекс общего слота и флаг Fresh
+    std::atomic<int> m_shared { 2 };
+};
+
+#endif
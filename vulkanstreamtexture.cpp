@@ -0,0 +1,555 @@
+// vulkanstreamtexture.cpp
+#include "vulkanstreamtexture.h"
+#include "vulkanassetcache.h"
+#include "vulkanpipelinecache.h"
+#include "vulkanquickwindow.h"
+#include "vulkantrace.h"
+#include <cstring>
+
+static const uint32_t CONVERT_WORKGROUP_SIZE = 16;
+
+// Должны совпадать с shaders/yuv_to_rgba.comp
+struct YuvParams
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t yPitch;
+    uint32_t uvPitch;
+    uint32_t uOffset;
+    uint32_t vOffset;
+    uint32_t flags;
+};
+static const uint32_t YUV_FLAG_NV12 = 1;
+static const uint32_t YUV_FLAG_BT709 = 2;
+static const uint32_t YUV_FLAG_FULL_RANGE = 4;
+
+VulkanStreamTexture::VulkanStreamTexture(QQuickWindow *window, int framesInFlight)
+    : m_window(window),
+      m_framesInFlight(framesInFlight),
+      m_slotCount(qMin(framesInFlight + 1, int(MaxSlots)))
+{
+    m_copier.setMaxThreadCount(1);
+
+    QSGRendererInterface *rif = window->rendererInterface();
+    QVulkanInstance *inst = reinterpret_cast<QVulkanInstance *>(
+        rif->getResource(window, QSGRendererInterface::VulkanInstanceResource));
+    Q_ASSERT(inst && inst->isValid());
+    VkPhysicalDevice physDev = *reinterpret_cast<VkPhysicalDevice *>(
+        rif->getResource(window, QSGRendererInterface::PhysicalDeviceResource));
+    m_dev = *reinterpret_cast<VkDevice *>(rif->getResource(window, QSGRendererInterface::DeviceResource));
+    Q_ASSERT(physDev && m_dev);
+    m_devFuncs = inst->deviceFunctions(m_dev);
+
+    inst->functions()->vkGetPhysicalDeviceMemoryProperties(physDev, &m_memProps);
+    VkPhysicalDeviceProperties physDevProps;
+    inst->functions()->vkGetPhysicalDeviceProperties(physDev, &physDevProps);
+    m_maxStorageBufferRange = physDevProps.limits.maxStorageBufferRange;
+
+    VkSamplerCreateInfo samplerInfo;
+    memset(&samplerInfo, 0, sizeof(samplerInfo));
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    VkResult err = m_devFuncs->vkCreateSampler(m_dev, &samplerInfo, nullptr, &m_sampler);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create stream texture sampler: %d", err);
+}
+
+VulkanStreamTexture::~VulkanStreamTexture()
+{
+    // Рабочий поток может ещё писать в staging
+    m_copier.waitForDone();
+
+    for (int i = 0; i < m_slotCount; ++i) {
+        Slot &slot(m_slots[i]);
+        if (slot.ptr)
+            m_devFuncs->vkUnmapMemory(m_dev, slot.mem);
+        VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &slot.buf, &slot.mem);
+    }
+    for (VulkanUtils::RetiredBuffer &retired : m_retiredBuffers)
+        VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &retired.buf, &retired.mem);
+    for (const RetiredImage &retired : std::as_const(m_retiredImages)) {
+        m_devFuncs->vkDestroyImageView(m_dev, retired.view, nullptr);
+        m_devFuncs->vkDestroyImage(m_dev, retired.image, nullptr);
+        m_devFuncs->vkFreeMemory(m_dev, retired.mem, nullptr);
+    }
+
+    m_devFuncs->vkDestroyImageView(m_dev, m_view, nullptr);
+    m_devFuncs->vkDestroyImage(m_dev, m_image, nullptr);
+    m_devFuncs->vkFreeMemory(m_dev, m_imageMem, nullptr);
+    m_devFuncs->vkDestroySampler(m_dev, m_sampler, nullptr);
+
+    VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &m_rgbaBuf, &m_rgbaBufMem);
+    m_devFuncs->vkDestroyPipeline(m_dev, m_convertPipeline, nullptr);
+    m_devFuncs->vkDestroyPipelineLayout(m_dev, m_convertPipelineLayout, nullptr);
+    m_devFuncs->vkDestroyDescriptorSetLayout(m_dev, m_convertLayout, nullptr);
+    m_devFuncs->vkDestroyDescriptorPool(m_dev, m_convertPool, nullptr);
+    if (m_pipelineCache)
+        VulkanPipelineCache::release(m_dev);
+}
+
+void VulkanStreamTexture::setStream(const QSharedPointer<VulkanTextureStream> &stream)
+{
+    m_stream = stream;
+    m_streamGeneration = 0;
+}
+
+void VulkanStreamTexture::update(VkCommandBuffer cb)
+{
+    VKQ_TRACE_SCOPE("VulkanStreamTexture::update");
+    ++m_frame;
+    while (!m_retiredBuffers.isEmpty() && m_retiredBuffers.first().frame <= m_frame) {
+        VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &m_retiredBuffers.first().buf, &m_retiredBuffers.first().mem);
+        m_retiredBuffers.removeFirst();
+    }
+    while (!m_retiredImages.isEmpty() && m_retiredImages.first().frame <= m_frame) {
+        const RetiredImage &retired(m_retiredImages.first());
+        m_devFuncs->vkDestroyImageView(m_dev, retired.view, nullptr);
+        m_devFuncs->vkDestroyImage(m_dev, retired.image, nullptr);
+        m_devFuncs->vkFreeMemory(m_dev, retired.mem, nullptr);
+        m_retiredImages.removeFirst();
+    }
+    for (int i = 0; i < m_slotCount; ++i) {
+        Slot &slot(m_slots[i]);
+        if (slot.state.load(std::memory_order_relaxed) == InFlight && slot.releaseFrame <= m_frame)
+            slot.state.store(Free, std::memory_order_relaxed);
+    }
+
+    if (m_copying >= 0) {
+        Slot &slot(m_slots[m_copying]);
+        const int state = slot.state.load(std::memory_order_acquire);
+        if (state == Ready) {
+            recordCopy(cb, slot);
+            slot.releaseFrame = m_frame + quint64(m_framesInFlight);
+            slot.state.store(InFlight, std::memory_order_relaxed);
+            m_copying = -1;
+        } else if (state == Failed) {
+            slot.state.store(Free, std::memory_order_relaxed);
+            // Область этого кадра в изображение не попала
+            m_streamGeneration = 0;
+            m_copying = -1;
+        }
+        // Пиксели уже в staging, буфер кадра возвращается источнику
+        if (m_copying < 0)
+            slot.frame = VulkanTextureFrame();
+    }
+
+    if (m_copying < 0 && m_stream)
+        startCopy();
+
+    // Готовое задание забирается следующим кадром
+    if (m_copying >= 0)
+        VulkanQuickWindow::requestFrame(m_window);
+}
+
+VulkanStreamTexture::StagingLayout VulkanStreamTexture::stagingLayout(const VulkanTextureFrame &frame,
+                                                                      const QRect &dirty)
+{
+    StagingLayout layout;
+    if (frame.format == VulkanTextureFrame::Rgba8) {
+        layout.size = VkDeviceSize(dirty.width()) * dirty.height() * 4;
+        return layout;
+    }
+
+    const uint32_t width = uint32_t(frame.size.width());
+    const uint32_t height = uint32_t(frame.size.height());
+    const uint32_t chromaWidth = (width + 1) / 2;
+    const uint32_t chromaHeight = (height + 1) / 2;
+    layout.yPitch = uint32_t(VulkanUtils::aligned(width, 4));
+    layout.uvPitch = uint32_t(VulkanUtils::aligned(frame.format == VulkanTextureFrame::Nv12 ? chromaWidth * 2
+                                                                                            : chromaWidth, 4));
+    layout.uOffset = layout.yPitch * height;
+    layout.vOffset = layout.uOffset + layout.uvPitch * chromaHeight;
+    layout.size = frame.format == VulkanTextureFrame::Nv12 ? layout.vOffset
+                                                           : layout.vOffset + layout.uvPitch * chromaHeight;
+    return layout;
+}
+
+static void copyRows(char *dst, size_t dstPitch, const uchar *src, qsizetype srcPitch, size_t rowBytes, int rows)
+{
+    for (int y = 0; y < rows; ++y) {
+        memcpy(dst, src, rowBytes);
+        dst += dstPitch;
+        src += srcPitch;
+    }
+}
+
+// Рабочий поток
+bool VulkanStreamTexture::copyToStaging(char *dst, const VulkanTextureFrame &frame, const QRect &dirty,
+                                        const StagingLayout &layout)
+{
+    const size_t dirtyRowBytes = size_t(dirty.width()) * 4;
+    if (!frame.image.isNull()) {
+        copyRows(dst, dirtyRowBytes, frame.image.constScanLine(dirty.y()) + dirty.x() * 4,
+                 frame.image.bytesPerLine(), dirtyRowBytes, dirty.height());
+        return true;
+    }
+
+#ifdef VULKANUNDERQML_MULTIMEDIA
+    QVideoFrame video(frame.video);
+    if (!video.map(QVideoFrame::ReadOnly))
+        return false;
+    const int width = frame.size.width();
+    const int height = frame.size.height();
+    const int chromaWidth = (width + 1) / 2;
+    const int chromaHeight = (height + 1) / 2;
+    bool ok = true;
+    switch (frame.format) {
+    case VulkanTextureFrame::Rgba8:
+        copyRows(dst, dirtyRowBytes, video.bits(0) + dirty.y() * video.bytesPerLine(0) + dirty.x() * 4,
+                 video.bytesPerLine(0), dirtyRowBytes, dirty.height());
+        break;
+    case VulkanTextureFrame::Nv12:
+        ok = video.planeCount() >= 2;
+        if (ok) {
+            copyRows(dst, layout.yPitch, video.bits(0), video.bytesPerLine(0), size_t(width), height);
+            copyRows(dst + layout.uOffset, layout.uvPitch, video.bits(1), video.bytesPerLine(1),
+                     size_t(chromaWidth) * 2, chromaHeight);
+        }
+        break;
+    case VulkanTextureFrame::Yuv420p:
+        ok = video.planeCount() >= 3;
+        if (ok) {
+            copyRows(dst, layout.yPitch, video.bits(0), video.bytesPerLine(0), size_t(width), height);
+            copyRows(dst + layout.uOffset, layout.uvPitch, video.bits(1), video.bytesPerLine(1),
+                     size_t(chromaWidth), chromaHeight);
+            copyRows(dst + layout.vOffset, layout.uvPitch, video.bits(2), video.bytesPerLine(2),
+                     size_t(chromaWidth), chromaHeight);
+        }
+        break;
+    }
+    video.unmap();
+    return ok;
+#else
+    Q_UNUSED(layout);
+    return false;
+#endif
+}
+
+void VulkanStreamTexture::startCopy()
+{
+    int index = 0;
+    while (index < m_slotCount && m_slots[index].state.load(std::memory_order_relaxed) != Free)
+        ++index;
+    // Все буферы ещё у GPU: кадр остаётся в потоке, более новый его заменит
+    if (index == m_slotCount)
+        return;
+
+    quint64 generation = m_streamGeneration;
+    VulkanTextureFrame frame;
+    QRect dirty;
+    if (!m_stream->take(&generation, &frame, &dirty))
+        return;
+    m_streamGeneration = generation;
+    if (frame.size.isEmpty())
+        return;
+
+    // Новое изображение и YUV (перевод - всего кадра) копируются целиком
+    const QRect full(QPoint(0, 0), frame.size);
+    if (frame.size != m_imageSize || frame.format != VulkanTextureFrame::Rgba8)
+        dirty = full;
+    if (dirty.isEmpty())
+        return;
+
+    const StagingLayout layout = stagingLayout(frame, dirty);
+    if (frame.format != VulkanTextureFrame::Rgba8
+            && qMax(layout.size, VkDeviceSize(frame.size.width()) * frame.size.height() * 4) > m_maxStorageBufferRange) {
+        qWarning("VulkanStreamTexture: %dx%d YUV frame exceeds maxStorageBufferRange, dropped",
+                 frame.size.width(), frame.size.height());
+        return;
+    }
+
+    // Буфер свободен - GPU его уже не читает, его можно заменить сразу.
+    // Размер - под весь кадр, чтобы области разного размера его не меняли.
+    Slot &slot(m_slots[index]);
+    const VkDeviceSize capacity = stagingLayout(frame, full).size;
+    if (slot.capacity < capacity) {
+        if (slot.ptr)
+            m_devFuncs->vkUnmapMemory(m_dev, slot.mem);
+        VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &slot.buf, &slot.mem);
+        VulkanUtils::createBuffer(m_devFuncs, m_dev, m_memProps, capacity,
+                                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                  &slot.buf, &slot.mem, "stream texture staging buffer");
+        void *p = nullptr;
+        VkResult err = m_devFuncs->vkMapMemory(m_dev, slot.mem, 0, VK_WHOLE_SIZE, 0, &p);
+        if (err != VK_SUCCESS || !p)
+            qFatal("Failed to map stream texture staging buffer memory: %d", err);
+        slot.ptr = static_cast<char *>(p);
+        slot.capacity = capacity;
+    }
+
+    slot.frame = frame;
+    slot.dirty = dirty;
+    slot.layout = layout;
+    slot.state.store(Copying, std::memory_order_relaxed);
+    m_copying = index;
+
+    Slot *job = &slot;
+    m_copier.start([job] {
+        VKQ_TRACE_SCOPE("VulkanStreamTexture::copyToStaging");
+        const bool ok = copyToStaging(job->ptr, job->frame, job->dirty, job->layout);
+        job->state.store(ok ? Ready : Failed, std::memory_order_release);
+    });
+}
+
+bool VulkanStreamTexture::ensureImage(const QSize &size)
+{
+    if (size == m_imageSize)
+        return false;
+
+    // Старое изображение ещё читают кадры в полёте
+    if (m_image)
+        m_retiredImages.append({ m_image, m_view, m_imageMem, m_frame + quint64(m_framesInFlight) });
+
+    VkImageCreateInfo imageInfo;
+    memset(&imageInfo, 0, sizeof(imageInfo));
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+    imageInfo.extent = { uint32_t(size.width()), uint32_t(size.height()), 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkResult err = m_devFuncs->vkCreateImage(m_dev, &imageInfo, nullptr, &m_image);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create stream texture image: %d", err);
+
+    VkMemoryRequirements memReq;
+    m_devFuncs->vkGetImageMemoryRequirements(m_dev, m_image, &memReq);
+    VkMemoryAllocateInfo allocInfo;
+    memset(&allocInfo, 0, sizeof(allocInfo));
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memReq.size;
+    allocInfo.memoryTypeIndex = VulkanUtils::findMemoryType(m_memProps, memReq.memoryTypeBits,
+                                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (allocInfo.memoryTypeIndex == uint32_t(-1))
+        qFatal("Failed to find memory type for stream texture image");
+    err = m_devFuncs->vkAllocateMemory(m_dev, &allocInfo, nullptr, &m_imageMem);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to allocate stream texture image memory: %d", err);
+    err = m_devFuncs->vkBindImageMemory(m_dev, m_image, m_imageMem, 0);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to bind stream texture image memory: %d", err);
+
+    VkImageViewCreateInfo viewInfo;
+    memset(&viewInfo, 0, sizeof(viewInfo));
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = m_image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = imageInfo.format;
+    viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    err = m_devFuncs->vkCreateImageView(m_dev, &viewInfo, nullptr, &m_view);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create stream texture image view: %d", err);
+
+    m_imageSize = size;
+    ++m_imageGeneration;
+    return true;
+}
+
+void VulkanStreamTexture::recordCopy(VkCommandBuffer cb, Slot &slot)
+{
+    VKQ_TRACE_GPU_BEGIN(cb, "VulkanStreamTexture upload");
+
+    const bool created = ensureImage(slot.frame.size);
+    const bool yuv = slot.frame.format != VulkanTextureFrame::Rgba8;
+    if (yuv)
+        convertYuv(cb, slot);
+
+    // Прошлые кадры могли ещё читать изображение во фрагментном шейдере;
+    // у нового содержимого нет, копируется весь кадр
+    VkImageMemoryBarrier barrier;
+    memset(&barrier, 0, sizeof(barrier));
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = created ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = m_image;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    m_devFuncs->vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region;
+    memset(&region, 0, sizeof(region));
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageOffset = { slot.dirty.x(), slot.dirty.y(), 0 };
+    region.imageExtent = { uint32_t(slot.dirty.width()), uint32_t(slot.dirty.height()), 1 };
+    m_devFuncs->vkCmdCopyBufferToImage(cb, yuv ? m_rgbaBuf : slot.buf, m_image,
+                                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    m_devFuncs->vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                     0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    m_ready = true;
+    VKQ_TRACE_GPU_END(cb);
+}
+
+void VulkanStreamTexture::ensureConverter()
+{
+    if (m_convertPipeline)
+        return;
+
+    VkDescriptorSetLayoutBinding layoutBinding[2];
+    memset(layoutBinding, 0, sizeof(layoutBinding));
+    for (uint32_t i = 0; i < 2; ++i) {
+        layoutBinding[i].binding = i;
+        layoutBinding[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layoutBinding[i].descriptorCount = 1;
+        layoutBinding[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo descLayoutInfo;
+    memset(&descLayoutInfo, 0, sizeof(descLayoutInfo));
+    descLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    descLayoutInfo.bindingCount = 2;
+    descLayoutInfo.pBindings = layoutBinding;
+    VkResult err = m_devFuncs->vkCreateDescriptorSetLayout(m_dev, &descLayoutInfo, nullptr, &m_convertLayout);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create YUV conversion descriptor set layout: %d", err);
+
+    VkPushConstantRange pushConstantRange;
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(YuvParams);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo;
+    memset(&pipelineLayoutInfo, 0, sizeof(pipelineLayoutInfo));
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_convertLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    err = m_devFuncs->vkCreatePipelineLayout(m_dev, &pipelineLayoutInfo, nullptr, &m_convertPipelineLayout);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create YUV conversion pipeline layout: %d", err);
+
+    // По набору на staging-буфер: набор меняется, только пока буфер свободен
+    VkDescriptorPoolSize descPoolSize;
+    descPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descPoolSize.descriptorCount = 2 * uint32_t(m_slotCount);
+    VkDescriptorPoolCreateInfo descPoolInfo;
+    memset(&descPoolInfo, 0, sizeof(descPoolInfo));
+    descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descPoolInfo.maxSets = uint32_t(m_slotCount);
+    descPoolInfo.poolSizeCount = 1;
+    descPoolInfo.pPoolSizes = &descPoolSize;
+    err = m_devFuncs->vkCreateDescriptorPool(m_dev, &descPoolInfo, nullptr, &m_convertPool);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create YUV conversion descriptor pool: %d", err);
+
+    VkDescriptorSetAllocateInfo descSetAllocInfo;
+    memset(&descSetAllocInfo, 0, sizeof(descSetAllocInfo));
+    descSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descSetAllocInfo.descriptorPool = m_convertPool;
+    descSetAllocInfo.descriptorSetCount = 1;
+    descSetAllocInfo.pSetLayouts = &m_convertLayout;
+    for (int i = 0; i < m_slotCount; ++i) {
+        err = m_devFuncs->vkAllocateDescriptorSets(m_dev, &descSetAllocInfo, &m_slots[i].convertSet);
+        if (err != VK_SUCCESS)
+            qFatal("Failed to allocate YUV conversion descriptor set: %d", err);
+    }
+
+    m_pipelineCache = VulkanPipelineCache::acquire(m_window);
+
+    const QByteArray comp = VulkanAssetCache::instance()->shader(QStringLiteral(":/yuv_to_rgba.comp.spv"));
+    if (comp.isEmpty())
+        qFatal("Failed to read shader :/yuv_to_rgba.comp.spv");
+    VkComputePipelineCreateInfo computeInfo;
+    memset(&computeInfo, 0, sizeof(computeInfo));
+    computeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    computeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    computeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    computeInfo.stage.module = VulkanUtils::createShaderModule(m_devFuncs, m_dev, comp);
+    computeInfo.stage.pName = "main";
+    computeInfo.layout = m_convertPipelineLayout;
+    err = m_devFuncs->vkCreateComputePipelines(m_dev, m_pipelineCache, 1, &computeInfo, nullptr, &m_convertPipeline);
+    m_devFuncs->vkDestroyShaderModule(m_dev, computeInfo.stage.module, nullptr);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create YUV conversion pipeline: %d", err);
+}
+
+void VulkanStreamTexture::convertYuv(VkCommandBuffer cb, Slot &slot)
+{
+    ensureConverter();
+
+    const QSize size = slot.frame.size;
+    const VkDeviceSize rgbaSize = VkDeviceSize(size.width()) * size.height() * 4;
+    if (m_rgbaBufSize < rgbaSize) {
+        if (m_rgbaBuf)
+            m_retiredBuffers.append({ m_rgbaBuf, m_rgbaBufMem, m_frame + quint64(m_framesInFlight) });
+        m_rgbaBuf = VK_NULL_HANDLE;
+        m_rgbaBufMem = VK_NULL_HANDLE;
+        VulkanUtils::createBuffer(m_devFuncs, m_dev, m_memProps, rgbaSize,
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                  &m_rgbaBuf, &m_rgbaBufMem, "YUV conversion buffer");
+        m_rgbaBufSize = rgbaSize;
+    }
+
+    // Прошлое использование набора слота завершено (слот был свободен)
+    if (slot.convertSrc != slot.buf || slot.convertDst != m_rgbaBuf) {
+        VkDescriptorBufferInfo bufferInfo[2];
+        bufferInfo[0] = { slot.buf, 0, VK_WHOLE_SIZE };
+        bufferInfo[1] = { m_rgbaBuf, 0, VK_WHOLE_SIZE };
+        VkWriteDescriptorSet writeDescSets[2];
+        memset(writeDescSets, 0, sizeof(writeDescSets));
+        for (uint32_t i = 0; i < 2; ++i) {
+            writeDescSets[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescSets[i].dstSet = slot.convertSet;
+            writeDescSets[i].dstBinding = i;
+            writeDescSets[i].descriptorCount = 1;
+            writeDescSets[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writeDescSets[i].pBufferInfo = &bufferInfo[i];
+        }
+        m_devFuncs->vkUpdateDescriptorSets(m_dev, 2, writeDescSets, 0, nullptr);
+        slot.convertSrc = slot.buf;
+        slot.convertDst = m_rgbaBuf;
+    }
+
+    // Буфер RGBA один: прошлое копирование из него в изображение должно
+    // завершиться до записи. Запись хоста в staging видна после submit.
+    m_devFuncs->vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+    YuvParams params;
+    params.width = uint32_t(size.width());
+    params.height = uint32_t(size.height());
+    params.yPitch = slot.layout.yPitch;
+    params.uvPitch = slot.layout.uvPitch;
+    params.uOffset = slot.layout.uOffset;
+    params.vOffset = slot.layout.vOffset;
+    params.flags = (slot.frame.format == VulkanTextureFrame::Nv12 ? YUV_FLAG_NV12 : 0)
+            | (slot.frame.bt709 ? YUV_FLAG_BT709 : 0)
+            | (slot.frame.fullRange ? YUV_FLAG_FULL_RANGE : 0);
+
+    m_devFuncs->vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_convertPipeline);
+    m_devFuncs->vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_convertPipelineLayout, 0, 1,
+                                        &slot.convertSet, 0, nullptr);
+    m_devFuncs->vkCmdPushConstants(cb, m_convertPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+    m_devFuncs->vkCmdDispatch(cb, (params.width + CONVERT_WORKGROUP_SIZE - 1) / CONVERT_WORKGROUP_SIZE,
+                              (params.height + CONVERT_WORKGROUP_SIZE - 1) / CONVERT_WORKGROUP_SIZE, 1);
+
+    VkMemoryBarrier barrier;
+    memset(&barrier, 0, sizeof(barrier));
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    m_devFuncs->vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
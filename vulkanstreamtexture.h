@@ -0,0 +1,144 @@
+// vulkanstreamtexture.h
+#ifndef VULKANSTREAMTEXTURE_H
+#define VULKANSTREAMTEXTURE_H
+
+#include <QtQuick/QQuickWindow>
+#include <QVulkanInstance>
+#include <QVulkanFunctions>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <atomic>
+#include "vulkantexturesource.h"
+#include "vulkanutils.h"
+
+// Текстура рендерера, обновляемая кадрами VulkanTextureStream.
+//
+// Пиксели копируются в кольцо постоянно отображённых staging-буферов
+// (framesInFlight + 1) в рабочем потоке; update() в начале следующего кадра
+// записывает копирование буфер -> изображение в командный буфер кадра.
+// Поток рендеринга не копирует пиксели и не ждёт: нет готового кадра или
+// свободного буфера - остаётся прежнее содержимое, а устаревшие кадры
+// пропускаются. Задержка - один кадр окна.
+//
+// RGBA копируется только изменённой областью. NV12 и I420 копируются
+// плоскостями и переводятся в RGBA compute-шейдером (yuv_to_rgba.comp),
+// поэтому фрагментный шейдер куба один для всех источников.
+class VulkanStreamTexture
+{
+public:
+    VulkanStreamTexture(QQuickWindow *window, int framesInFlight);
+    ~VulkanStreamTexture();
+
+    // Новый поток копируется целиком
+    void setStream(const QSharedPointer<VulkanTextureStream> &stream);
+    const QSharedPointer<VulkanTextureStream> &stream() const { return m_stream; }
+
+    // Поток рендеринга, вне render pass
+    void update(VkCommandBuffer cb);
+
+    // Содержимое есть после первого записанного копирования
+    bool isReady() const { return m_ready; }
+    VkImageView view() const { return m_view; }
+    VkSampler sampler() const { return m_sampler; }
+    // Меняется с пересозданием изображения: наборы дескрипторов,
+    // ссылающиеся на view(), нужно обновить
+    quint64 generation() const { return m_imageGeneration; }
+
+private:
+    static const int MaxSlots = 4;
+
+    enum SlotState {
+        Free,       // можно занимать
+        Copying,    // рабочий поток пишет пиксели
+        Ready,      // пиксели в буфере, копирование ещё не записано
+        Failed,     // кадр не удалось отобразить в память
+        InFlight    // читается GPU до кадра releaseFrame
+    };
+
+    // Размещение кадра в staging: RGBA - строки изменённой области подряд;
+    // YUV - плоскости с шагом, выровненным до 4 байт (чтение словами в шейдере)
+    struct StagingLayout
+    {
+        VkDeviceSize size = 0;
+        uint32_t yPitch = 0;
+        uint32_t uvPitch = 0;
+        uint32_t uOffset = 0;
+        uint32_t vOffset = 0;
+    };
+
+    struct Slot
+    {
+        VkBuffer buf = VK_NULL_HANDLE;
+        VkDeviceMemory mem = VK_NULL_HANDLE;
+        char *ptr = nullptr;
+        VkDeviceSize capacity = 0;
+        std::atomic<int> state { Free };
+        quint64 releaseFrame = 0;
+        // Задание: пишет поток рендеринга до запуска копирования
+        VulkanTextureFrame frame;
+        QRect dirty;
+        StagingLayout layout;
+        // Набор перевода YUV и буферы, на которые он указывает
+        VkDescriptorSet convertSet = VK_NULL_HANDLE;
+        VkBuffer convertSrc = VK_NULL_HANDLE;
+        VkBuffer convertDst = VK_NULL_HANDLE;
+    };
+
+    struct RetiredImage
+    {
+        VkImage image;
+        VkImageView view;
+        VkDeviceMemory mem;
+        quint64 frame;
+    };
+
+    static StagingLayout stagingLayout(const VulkanTextureFrame &frame, const QRect &dirty);
+    static bool copyToStaging(char *dst, const VulkanTextureFrame &frame, const QRect &dirty,
+                              const StagingLayout &layout);
+
+    void startCopy();
+    void recordCopy(VkCommandBuffer cb, Slot &slot);
+    bool ensureImage(const QSize &size);
+    void ensureConverter();
+    void convertYuv(VkCommandBuffer cb, Slot &slot);
+
+    QQuickWindow *m_window;
+    int m_framesInFlight;
+    int m_slotCount;
+    VkDevice m_dev = VK_NULL_HANDLE;
+    QVulkanDeviceFunctions *m_devFuncs = nullptr;
+    VkPhysicalDeviceMemoryProperties m_memProps;
+    VkDeviceSize m_maxStorageBufferRange = 0;
+
+    QSharedPointer<VulkanTextureStream> m_stream;
+    quint64 m_streamGeneration = 0;
+
+    quint64 m_frame = 0;
+    Slot m_slots[MaxSlots];
+    int m_copying = -1;
+    QList<VulkanUtils::RetiredBuffer> m_retiredBuffers;
+    QList<RetiredImage> m_retiredImages;
+
+    VkImage m_image = VK_NULL_HANDLE;
+    VkImageView m_view = VK_NULL_HANDLE;
+    VkDeviceMemory m_imageMem = VK_NULL_HANDLE;
+    VkSampler m_sampler = VK_NULL_HANDLE;
+    QSize m_imageSize;
+    quint64 m_imageGeneration = 0;
+    bool m_ready = false;
+
+    // Перевод YUV, создаётся с первым YUV-кадром
+    VkBuffer m_rgbaBuf = VK_NULL_HANDLE;
+    VkDeviceMemory m_rgbaBufMem = VK_NULL_HANDLE;
+    VkDeviceSize m_rgbaBufSize = 0;
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+    VkDescriptorSetLayout m_convertLayout = VK_NULL_HANDLE;
+    VkPipelineLayout m_convertPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_convertPipeline = VK_NULL_HANDLE;
+    VkDescriptorPool m_convertPool = VK_NULL_HANDLE;
+
+    // Один поток: задание копирования одно за раз
+    QThreadPool m_copier;
+};
+
+#endif
@@ -0,0 +1,188 @@
+// vulkantexturearray.cpp
+#include "vulkantexturearray.h"
+#include "vulkandevicefeatures.h"
+#include <QMutexLocker>
+#include <cstring>
+
+// Верхняя граница размера массива текстур, реальный размер ограничен лимитами устройства
+static const uint32_t MAX_TEXTURES = 1024;
+
+typedef QHash<VkDevice, VulkanTextureArray *> TextureArrayRegistry;
+Q_GLOBAL_STATIC(QMutex, s_registryMutex)
+Q_GLOBAL_STATIC(TextureArrayRegistry, s_arrays)
+
+// Размер массива по лимитам update-after-bind; 0 - массив не нужен
+static uint32_t arrayCapacity(QQuickWindow *window, QVulkanInstance *inst, VkPhysicalDevice physDev)
+{
+    // Core-функциональность Vulkan 1.2; включена ли она на устройстве окна,
+    // знает VulkanDeviceFeatures
+    const VulkanDeviceFeatures::Features features = VulkanDeviceFeatures::enabled(window);
+    if (!features.testFlag(VulkanDeviceFeatures::DescriptorIndexing)
+            || !features.testFlag(VulkanDeviceFeatures::SampledImageUpdateAfterBind))
+        return 0;
+
+    auto getProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(
+        inst->getInstanceProcAddr("vkGetPhysicalDeviceProperties2"));
+    if (!getProperties2)
+        return 0;
+    VkPhysicalDeviceDescriptorIndexingProperties indexingProps{};
+    indexingProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+    VkPhysicalDeviceProperties2 props2{};
+    props2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props2.pNext = &indexingProps;
+    getProperties2(physDev, &props2);
+    const uint32_t perStage = qMin(indexingProps.maxPerStageDescriptorUpdateAfterBindSamplers,
+                                   indexingProps.maxPerStageDescriptorUpdateAfterBindSampledImages);
+    const uint32_t perSet = qMin(indexingProps.maxDescriptorSetUpdateAfterBindSamplers,
+                                 indexingProps.maxDescriptorSetUpdateAfterBindSampledImages);
+    const uint32_t capacity = qMin(MAX_TEXTURES, qMin(perStage, perSet));
+    return capacity > 1 ? capacity : 0;
+}
+
+VulkanTextureArray *VulkanTextureArray::acquire(QQuickWindow *window)
+{
+    QSGRendererInterface *rif = window->rendererInterface();
+    VkDevice dev = *reinterpret_cast<VkDevice *>(rif->getResource(window, QSGRendererInterface::DeviceResource));
+    Q_ASSERT(dev);
+
+    QMutexLocker lock(s_registryMutex());
+    VulkanTextureArray *&array((*s_arrays())[dev]);
+    if (!array) {
+        QVulkanInstance *inst = reinterpret_cast<QVulkanInstance *>(
+            rif->getResource(window, QSGRendererInterface::VulkanInstanceResource));
+        VkPhysicalDevice physDev = *reinterpret_cast<VkPhysicalDevice *>(
+            rif->getResource(window, QSGRendererInterface::PhysicalDeviceResource));
+        const uint32_t capacity = arrayCapacity(window, inst, physDev);
+        qDebug("texture array: bindless textures %s (capacity %u)", capacity ? "enabled" : "disabled", capacity);
+        if (!capacity) {
+            s_arrays()->remove(dev);
+            return nullptr;
+        }
+        array = new VulkanTextureArray(dev, inst->deviceFunctions(dev), capacity);
+    }
+    ++array->m_refCount;
+    return array;
+}
+
+void VulkanTextureArray::release(VulkanTextureArray *array)
+{
+    if (!array)
+        return;
+    QMutexLocker lock(s_registryMutex());
+    if (--array->m_refCount == 0) {
+        s_arrays()->remove(array->m_dev);
+        delete array;
+    }
+}
+
+VulkanTextureArray::VulkanTextureArray(VkDevice dev, QVulkanDeviceFunctions *devFuncs, uint32_t capacity)
+    : m_dev(dev),
+      m_devFuncs(devFuncs),
+      m_capacity(capacity)
+{
+    VkDescriptorSetLayoutBinding binding;
+    memset(&binding, 0, sizeof(binding));
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    binding.descriptorCount = m_capacity;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    // Массив заполнен частично, элементы пишутся между кадрами в полёте
+    const VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+            | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+            | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo;
+    memset(&bindingFlagsInfo, 0, sizeof(bindingFlagsInfo));
+    bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+    bindingFlagsInfo.bindingCount = 1;
+    bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo;
+    memset(&layoutInfo, 0, sizeof(layoutInfo));
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext = &bindingFlagsInfo;
+    layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &binding;
+    VkResult err = m_devFuncs->vkCreateDescriptorSetLayout(m_dev, &layoutInfo, nullptr, &m_layout);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create texture array descriptor set layout: %d", err);
+
+    VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_capacity };
+    VkDescriptorPoolCreateInfo poolInfo;
+    memset(&poolInfo, 0, sizeof(poolInfo));
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    err = m_devFuncs->vkCreateDescriptorPool(m_dev, &poolInfo, nullptr, &m_pool);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create texture array descriptor pool: %d", err);
+
+    VkDescriptorSetAllocateInfo allocInfo;
+    memset(&allocInfo, 0, sizeof(allocInfo));
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_pool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_layout;
+    err = m_devFuncs->vkAllocateDescriptorSets(m_dev, &allocInfo, &m_set);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to allocate texture array descriptor set: %d", err);
+}
+
+VulkanTextureArray::~VulkanTextureArray()
+{
+    m_devFuncs->vkDestroyDescriptorPool(m_dev, m_pool, nullptr);
+    m_devFuncs->vkDestroyDescriptorSetLayout(m_dev, m_layout, nullptr);
+}
+
+uint32_t VulkanTextureArray::add(VkImageView view, VkSampler sampler)
+{
+    QMutexLocker lock(&m_mutex);
+    auto it = m_elements.find(view);
+    if (it != m_elements.end()) {
+        ++it->refCount;
+        return it->index;
+    }
+
+    uint32_t index;
+    if (!m_free.isEmpty())
+        index = m_free.takeLast();
+    else if (m_used < m_capacity)
+        index = m_used++;
+    else
+        qFatal("Bindless texture array is full (%u entries)", m_capacity);
+    m_elements.insert(view, { index, 1 });
+
+    // Запись набора синхронизируется мьютексом; привязка набора в других
+    // потоках её не требует (update-after-bind)
+    VkDescriptorImageInfo imageInfo;
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = view;
+    imageInfo.sampler = sampler;
+
+    VkWriteDescriptorSet write;
+    memset(&write, 0, sizeof(write));
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = m_set;
+    write.dstBinding = 0;
+    write.dstArrayElement = index;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.pImageInfo = &imageInfo;
+    m_devFuncs->vkUpdateDescriptorSets(m_dev, 1, &write, 0, nullptr);
+    return index;
+}
+
+void VulkanTextureArray::remove(VkImageView view)
+{
+    QMutexLocker lock(&m_mutex);
+    auto it = m_elements.find(view);
+    if (it == m_elements.end())
+        return;
+    if (--it->refCount == 0) {
+        m_free.append(it->index);
+        m_elements.erase(it);
+    }
+}
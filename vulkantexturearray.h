@@ -0,0 +1,67 @@
+// vulkantexturearray.h
+#ifndef VULKANTEXTUREARRAY_H
+#define VULKANTEXTUREARRAY_H
+
+#include <QtQuick/QQuickWindow>
+#include <QVulkanInstance>
+#include <QVulkanFunctions>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+
+// Bindless массив текстур, один на VkDevice.
+//
+// Частично заполненный массив COMBINED_IMAGE_SAMPLER в единственном наборе
+// дескрипторов с update-after-bind; все рендереры всех окон устройства
+// привязывают этот набор и выбирают текстуру индексом, поэтому кубы с
+// разными текстурами рисуются одним draw. Каждое изображение занимает один
+// элемент, сколько бы рендереров его ни использовали: add() того же view
+// увеличивает счётчик ссылок.
+//
+// Элементы пишутся, пока кадры в полёте используют набор, - это допустимо
+// для элементов, которые эти кадры не читают (updateUnusedWhilePending).
+// Поэтому remove() вызывается, только когда кадры, читавшие элемент,
+// завершены: освобождённый элемент может сразу получить другое изображение.
+//
+// acquire() возвращает nullptr, если устройство не поддерживает
+// descriptor indexing с update-after-bind; тогда рендерер использует свой
+// набор из одной текстуры. Методы потокобезопасны.
+class VulkanTextureArray
+{
+public:
+    static VulkanTextureArray *acquire(QQuickWindow *window);
+    static void release(VulkanTextureArray *array);
+
+    VkDescriptorSetLayout layout() const { return m_layout; }
+    VkDescriptorSet descriptorSet() const { return m_set; }
+    uint32_t capacity() const { return m_capacity; }
+
+    // Индекс элемента с view
+    uint32_t add(VkImageView view, VkSampler sampler);
+    void remove(VkImageView view);
+
+private:
+    VulkanTextureArray(VkDevice dev, QVulkanDeviceFunctions *devFuncs, uint32_t capacity);
+    ~VulkanTextureArray();
+
+    struct Element {
+        uint32_t index;
+        int refCount;
+    };
+
+    VkDevice m_dev;
+    QVulkanDeviceFunctions *m_devFuncs;
+    uint32_t m_capacity;
+    VkDescriptorSetLayout m_layout = VK_NULL_HANDLE;
+    VkDescriptorPool m_pool = VK_NULL_HANDLE;
+    VkDescriptorSet m_set = VK_NULL_HANDLE;
+
+    QMutex m_mutex;
+    QHash<VkImageView, Element> m_elements;
+    QList<uint32_t> m_free;
+    uint32_t m_used = 0;
+
+    int m_refCount = 0;
+};
+
+#endif
@@ -0,0 +1,78 @@
+// vulkantextureblob.cpp
+#include "vulkantextureblob.h"
+#include <QCoreApplication>
+#include <QFileInfo>
+
+QString VulkanTextureBlob::cookedPath(const QString &sourceName)
+{
+    return QCoreApplication::applicationDirPath() + QLatin1String("/textures/")
+            + QFileInfo(sourceName).completeBaseName() + QLatin1String(".vkt");
+}
+
+bool VulkanTextureBlob::open(const QString &fileName)
+{
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = m_file.size();
+    if (size < qint64(sizeof(VulkanTextureBlobHeader)))
+        return false;
+    m_data = m_file.map(0, size);
+    if (!m_data)
+        return false;
+
+    m_header = reinterpret_cast<const VulkanTextureBlobHeader *>(m_data);
+    const VulkanTextureBlobHeader &h = *m_header;
+    bool valid = h.magic == VulkanTextureBlobHeader::Magic
+            && h.version == VulkanTextureBlobHeader::Version
+            && h.mipLevels >= 1 && h.mipLevels <= quint32(VulkanTextureBlobHeader::MaxLevels)
+            && h.width > 0 && h.height > 0;
+    // Уровни должны идти подряд и помещаться в файл
+    quint64 expected = h.levels[0].offset;
+    for (quint32 i = 0; valid && i < h.mipLevels; ++i) {
+        const VulkanTextureBlobHeader::Level &l = h.levels[i];
+        valid = l.offset == expected
+                && l.offset % VulkanTextureBlobHeader::LevelAlignment == 0
+                && l.size >= quint64(l.width) * l.height * h.bytesPerTexel
+                && l.offset + l.size <= quint64(size);
+        expected = l.offset + l.size;
+    }
+    if (!valid) {
+        qWarning("Texture blob %s is corrupt or has an unsupported version", qPrintable(fileName));
+        m_file.unmap(const_cast<uchar *>(m_data));
+        m_file.close();
+        m_header = nullptr;
+        m_data = nullptr;
+        return false;
+    }
+    return true;
+}
+
+const uchar *VulkanTextureBlob::levelData() const
+{
+    return m_data + m_header->levels[0].offset;
+}
+
+VkDeviceSize VulkanTextureBlob::levelDataSize() const
+{
+    const VulkanTextureBlobHeader::Level &last = m_header->levels[m_header->mipLevels - 1];
+    return last.offset + last.size - m_header->levels[0].offset;
+}
+
+QList<VkBufferImageCopy> VulkanTextureBlob::copyRegions() const
+{
+    QList<VkBufferImageCopy> regions;
+    regions.reserve(m_header->mipLevels);
+    for (quint32 i = 0; i < m_header->mipLevels; ++i) {
+        const VulkanTextureBlobHeader::Level &l = m_header->levels[i];
+        VkBufferImageCopy region{};
+        region.bufferOffset = l.offset - m_header->levels[0].offset;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = i;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { l.width, l.height, 1 };
+        regions.append(region);
+    }
+    return regions;
+}
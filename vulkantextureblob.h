@@ -0,0 +1,68 @@
+// vulkantextureblob.h
+#ifndef VULKANTEXTUREBLOB_H
+#define VULKANTEXTUREBLOB_H
+
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QVulkanInstance>
+
+// Текстура, подготовленная при сборке (tools/texturecook): итоговый формат
+// Vulkan, все уровни mip и заголовок со смещениями. Файл отображается в
+// память, уровни лежат подряд и копируются в staging одним memcpy - без
+// декодирования и конвертации. Порядок байтов - little-endian.
+struct VulkanTextureBlobHeader
+{
+    static constexpr quint32 Magic = 0x54514b56; // "VKQT"
+    static constexpr quint32 Version = 1;
+    static constexpr int MaxLevels = 16;
+    // Смещения уровней кратны LevelAlignment (требование bufferOffset)
+    static constexpr quint32 LevelAlignment = 16;
+
+    struct Level {
+        quint64 offset;
+        quint64 size;
+        quint32 width;
+        quint32 height;
+    };
+
+    quint32 magic;
+    quint32 version;
+    quint32 vkFormat;
+    quint32 bytesPerTexel;
+    quint32 width;
+    quint32 height;
+    quint32 mipLevels;
+    quint32 reserved;
+    Level levels[MaxLevels];
+};
+
+static_assert(sizeof(VulkanTextureBlobHeader) % VulkanTextureBlobHeader::LevelAlignment == 0,
+              "texture blob levels must start aligned");
+
+class VulkanTextureBlob
+{
+public:
+    // Путь подготовленного блоба для исходного изображения
+    // ("metalplate01_rgba.png" -> <каталог приложения>/textures/metalplate01_rgba.vkt)
+    static QString cookedPath(const QString &sourceName);
+
+    // false, если файла нет, он не отображается в память или не прошёл проверку
+    bool open(const QString &fileName);
+
+    const VulkanTextureBlobHeader &header() const { return *m_header; }
+    VkFormat format() const { return VkFormat(m_header->vkFormat); }
+
+    // Непрерывный диапазон всех уровней и регионы копирования с bufferOffset
+    // относительно его начала
+    const uchar *levelData() const;
+    VkDeviceSize levelDataSize() const;
+    QList<VkBufferImageCopy> copyRegions() const;
+
+private:
+    QFile m_file;
+    const VulkanTextureBlobHeader *m_header = nullptr;
+    const uchar *m_data = nullptr;
+};
+
+#endif
@@ -0,0 +1,327 @@
+// vulkantexturecache.cpp
+#include "vulkantexturecache.h"
+#include "vulkanassetcache.h"
+#include "vulkandevicefeatures.h"
+#include "vulkantextureblob.h"
+#include "vulkantrace.h"
+#include "vulkanuploadservice.h"
+#include "vulkanutils.h"
+#include <QColor>
+#include <QMutex>
+#include <QMutexLocker>
+#include <algorithm>
+
+struct SharedTexture {
+    VulkanTextureCache::Texture texture;
+    QString name;
+    int refCount = 0;
+};
+
+struct DeviceTextures {
+    QVulkanDeviceFunctions *devFuncs = nullptr;
+    VulkanUploadService *uploads = nullptr;
+    QHash<QString, SharedTexture *> textures;
+#if defined(VK_VERSION_1_3) && defined(VK_EXT_host_image_copy)
+    // Заданы, если на устройстве включён VK_EXT_host_image_copy
+    PFN_vkTransitionImageLayoutEXT transitionImageLayout = nullptr;
+    PFN_vkCopyMemoryToImageEXT copyMemoryToImage = nullptr;
+#endif
+};
+
+typedef QHash<VkDevice, DeviceTextures> TextureRegistry;
+Q_GLOBAL_STATIC(QMutex, s_registryMutex)
+Q_GLOBAL_STATIC(TextureRegistry, s_devices)
+
+static QImage placeholderImage()
+{
+    QImage image(256, 256, QImage::Format_RGBA8888);
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x)
+            image.setPixelColor(x, y, (x / 32 + y / 32) % 2 == 0 ? QColor(0, 255, 255) : QColor(255, 0, 0));
+    }
+    return image;
+}
+
+#if defined(VK_VERSION_1_3) && defined(VK_EXT_host_image_copy)
+// Копирование с CPU прямо в изображение: без staging-буфера и submit,
+// текстура готова к выборке сразу. Формат должен поддерживать host transfer,
+// а конечный layout - быть среди разрешённых для копирования.
+static bool canCopyOnHost(QVulkanInstance *inst, VkPhysicalDevice physDev, VkFormat format)
+{
+    auto getProps2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(
+        inst->getInstanceProcAddr("vkGetPhysicalDeviceProperties2"));
+    auto getFormatProps2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFormatProperties2>(
+        inst->getInstanceProcAddr("vkGetPhysicalDeviceFormatProperties2"));
+    if (!getProps2 || !getFormatProps2)
+        return false;
+
+    VkFormatProperties3 formatProps3{};
+    formatProps3.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_3;
+    VkFormatProperties2 formatProps{};
+    formatProps.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2;
+    formatProps.pNext = &formatProps3;
+    getFormatProps2(physDev, format, &formatProps);
+    if (!(formatProps3.optimalTilingFeatures & VK_FORMAT_FEATURE_2_HOST_IMAGE_TRANSFER_BIT_EXT))
+        return false;
+
+    VkImageLayout dstLayouts[32];
+    VkPhysicalDeviceHostImageCopyPropertiesEXT hostProps{};
+    hostProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT;
+    hostProps.copyDstLayoutCount = uint32_t(std::size(dstLayouts));
+    hostProps.pCopyDstLayouts = dstLayouts;
+    VkPhysicalDeviceProperties2 props{};
+    props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    props.pNext = &hostProps;
+    getProps2(physDev, &props);
+    const VkImageLayout *end = dstLayouts + qMin<uint32_t>(hostProps.copyDstLayoutCount, std::size(dstLayouts));
+    return std::find(dstLayouts, end, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) != end;
+}
+
+static void copyOnHost(const DeviceTextures &device, VkDevice dev, VkImage image, uint32_t mipLevels,
+                       const uchar *data, const QList<VkBufferImageCopy> &regions)
+{
+    VKQ_TRACE_SCOPE("VulkanTextureCache::copyOnHost");
+    VkHostImageLayoutTransitionInfoEXT transition{};
+    transition.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT;
+    transition.image = image;
+    transition.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    transition.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    transition.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+    VkResult err = device.transitionImageLayout(dev, 1, &transition);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to transition texture layout on host: %d", err);
+
+    QList<VkMemoryToImageCopyEXT> copies;
+    copies.reserve(regions.size());
+    for (const VkBufferImageCopy &region : regions) {
+        VkMemoryToImageCopyEXT copy{};
+        copy.sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT;
+        copy.pHostPointer = data + region.bufferOffset;
+        copy.memoryRowLength = region.bufferRowLength;
+        copy.memoryImageHeight = region.bufferImageHeight;
+        copy.imageSubresource = region.imageSubresource;
+        copy.imageOffset = region.imageOffset;
+        copy.imageExtent = region.imageExtent;
+        copies.append(copy);
+    }
+    VkCopyMemoryToImageInfoEXT copyInfo{};
+    copyInfo.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT;
+    copyInfo.dstImage = image;
+    copyInfo.dstImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    copyInfo.regionCount = uint32_t(copies.size());
+    copyInfo.pRegions = copies.constData();
+    err = device.copyMemoryToImage(dev, &copyInfo);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to copy texture on host: %d", err);
+}
+#endif
+
+static void createTexture(QQuickWindow *window, DeviceTextures &device, VkDevice dev,
+                          const QString &sourceName, VulkanTextureCache::Texture *t)
+{
+    VKQ_TRACE_SCOPE("VulkanTextureCache::createTexture");
+    QSGRendererInterface *rif = window->rendererInterface();
+    QVulkanInstance *inst = reinterpret_cast<QVulkanInstance *>(
+        rif->getResource(window, QSGRendererInterface::VulkanInstanceResource));
+    VkPhysicalDevice physDev = *reinterpret_cast<VkPhysicalDevice *>(
+        rif->getResource(window, QSGRendererInterface::PhysicalDeviceResource));
+    QVulkanDeviceFunctions *df = device.devFuncs;
+
+    // Подготовленный при сборке блоб: формат и уровни mip уже готовы, файл
+    // отображён в память - загрузка сводится к чтению и копированию в staging
+    const QSharedPointer<const VulkanTextureBlob> blob = VulkanAssetCache::instance()->textureBlob(
+            VulkanTextureBlob::cookedPath(sourceName));
+    QImage image;
+    if (blob) {
+        t->width = blob->header().width;
+        t->height = blob->header().height;
+        t->mipLevels = blob->header().mipLevels;
+        t->format = blob->format();
+    } else {
+        // Декодированная текстура хранится в кэше, повторно PNG не декодируется
+        image = VulkanAssetCache::instance()->image(sourceName);
+        if (image.isNull())
+            image = placeholderImage();
+        if (image.format() != QImage::Format_RGBA8888)
+            image.convertTo(QImage::Format_RGBA8888);
+        t->width = image.width();
+        t->height = image.height();
+        t->mipLevels = 1;
+        t->format = VK_FORMAT_R8G8B8A8_SRGB;
+    }
+
+#if defined(VK_VERSION_1_3) && defined(VK_EXT_host_image_copy)
+    const bool hostCopy = device.copyMemoryToImage && canCopyOnHost(inst, physDev, t->format);
+#endif
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = { t->width, t->height, 1 };
+    imageInfo.mipLevels = t->mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = t->format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+#if defined(VK_VERSION_1_3) && defined(VK_EXT_host_image_copy)
+    if (hostCopy)
+        imageInfo.usage |= VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+#endif
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkResult err = df->vkCreateImage(dev, &imageInfo, nullptr, &t->image);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create image: %d", err);
+
+    VkPhysicalDeviceMemoryProperties memProps;
+    inst->functions()->vkGetPhysicalDeviceMemoryProperties(physDev, &memProps);
+    VkMemoryRequirements memReq;
+    df->vkGetImageMemoryRequirements(dev, t->image, &memReq);
+    const uint32_t memoryTypeIndex = VulkanUtils::findMemoryType(memProps, memReq.memoryTypeBits,
+                                                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (memoryTypeIndex == uint32_t(-1))
+        qFatal("Failed to find suitable memory type for image");
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memReq.size;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+    err = df->vkAllocateMemory(dev, &allocInfo, nullptr, &t->memory);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to allocate image memory: %d", err);
+    err = df->vkBindImageMemory(dev, t->image, t->memory, 0);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to bind image memory: %d", err);
+
+    // Копирование и переходы layout идут отдельным submit сервиса загрузок,
+    // командный буфер кадра не удлиняется; с HostImageCopy копирует сам CPU
+#if defined(VK_VERSION_1_3) && defined(VK_EXT_host_image_copy)
+    if (hostCopy) {
+        if (blob) {
+            copyOnHost(device, dev, t->image, t->mipLevels, blob->levelData(), blob->copyRegions());
+        } else {
+            VkBufferImageCopy region{};
+            region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            region.imageExtent = { t->width, t->height, 1 };
+            copyOnHost(device, dev, t->image, 1, image.constBits(), { region });
+        }
+    } else
+#endif
+    if (blob) {
+        t->upload = device.uploads->uploadImage(blob->levelData(), blob->levelDataSize(), t->image,
+                                                blob->copyRegions(), t->mipLevels,
+                                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    } else {
+        t->upload = device.uploads->uploadImage(image, t->image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                                VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+    if (t->upload)
+        device.uploads->submit();
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = t->image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = t->format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = t->mipLevels;
+    viewInfo.subresourceRange.layerCount = 1;
+    err = df->vkCreateImageView(dev, &viewInfo, nullptr, &t->view);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create texture image view: %d", err);
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.maxLod = float(t->mipLevels);
+    err = df->vkCreateSampler(dev, &samplerInfo, nullptr, &t->sampler);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create texture sampler: %d", err);
+}
+
+const VulkanTextureCache::Texture *VulkanTextureCache::acquire(QQuickWindow *window, const QString &sourceName)
+{
+    QSGRendererInterface *rif = window->rendererInterface();
+    QVulkanInstance *inst = reinterpret_cast<QVulkanInstance *>(
+        rif->getResource(window, QSGRendererInterface::VulkanInstanceResource));
+    VkDevice dev = *reinterpret_cast<VkDevice *>(rif->getResource(window, QSGRendererInterface::DeviceResource));
+    Q_ASSERT(inst && dev);
+
+    // Создание идёт под мьютексом: второе окно, запросившее ту же текстуру,
+    // дождётся первой загрузки, а не начнёт свою
+    QMutexLocker lock(s_registryMutex());
+    DeviceTextures &device((*s_devices())[dev]);
+    if (!device.devFuncs) {
+        device.devFuncs = inst->deviceFunctions(dev);
+        device.uploads = VulkanUploadService::acquire(window);
+#if defined(VK_VERSION_1_3) && defined(VK_EXT_host_image_copy)
+        if (VulkanDeviceFeatures::enabled(window).testFlag(VulkanDeviceFeatures::HostImageCopy)) {
+            auto getDeviceProcAddr = reinterpret_cast<PFN_vkGetDeviceProcAddr>(
+                inst->getInstanceProcAddr("vkGetDeviceProcAddr"));
+            device.transitionImageLayout = reinterpret_cast<PFN_vkTransitionImageLayoutEXT>(
+                getDeviceProcAddr(dev, "vkTransitionImageLayoutEXT"));
+            device.copyMemoryToImage = reinterpret_cast<PFN_vkCopyMemoryToImageEXT>(
+                getDeviceProcAddr(dev, "vkCopyMemoryToImageEXT"));
+            if (!device.transitionImageLayout)
+                device.copyMemoryToImage = nullptr;
+        }
+#endif
+    }
+
+    SharedTexture *&shared(device.textures[sourceName]);
+    if (!shared) {
+        shared = new SharedTexture;
+        shared->name = sourceName;
+        createTexture(window, device, dev, sourceName, &shared->texture);
+    }
+    ++shared->refCount;
+    return &shared->texture;
+}
+
+void VulkanTextureCache::release(VkDevice dev, const Texture *texture)
+{
+    if (!texture)
+        return;
+
+    QMutexLocker lock(s_registryMutex());
+    auto deviceIt = s_devices()->find(dev);
+    Q_ASSERT(deviceIt != s_devices()->end());
+    DeviceTextures &device(*deviceIt);
+    SharedTexture *shared = nullptr;
+    for (SharedTexture *s : std::as_const(device.textures)) {
+        if (&s->texture == texture) {
+            shared = s;
+            break;
+        }
+    }
+    Q_ASSERT(shared);
+    if (--shared->refCount > 0)
+        return;
+
+    // Изображение нельзя уничтожать, пока в него идёт копирование
+    QVulkanDeviceFunctions *df = device.devFuncs;
+    Texture &t(shared->texture);
+    device.uploads->wait(t.upload);
+    df->vkDestroySampler(dev, t.sampler, nullptr);
+    df->vkDestroyImageView(dev, t.view, nullptr);
+    df->vkDestroyImage(dev, t.image, nullptr);
+    df->vkFreeMemory(dev, t.memory, nullptr);
+    device.textures.remove(shared->name);
+    delete shared;
+
+    if (device.textures.isEmpty()) {
+        VulkanUploadService::release(device.uploads);
+        s_devices()->erase(deviceIt);
+    }
+}
@@ -0,0 +1,40 @@
+// vulkantexturecache.h
+#ifndef VULKANTEXTURECACHE_H
+#define VULKANTEXTURECACHE_H
+
+#include <QtQuick/QQuickWindow>
+#include <QVulkanInstance>
+
+// Текстуры на GPU, общие для всех окон одного VkDevice.
+//
+// Окна с общим устройством (VulkanSharedDevice) рендерятся каждое в своём
+// потоке. Первый acquire() создаёт изображение и ставит загрузку в
+// VulkanUploadService, остальные получают тот же объект - память под
+// текстуру не дублируется. Изображение неизменяемо после загрузки, поэтому
+// рендереры читают его без дополнительной синхронизации; готовность для
+// кадра проверяется через VulkanUploadService::consume(upload, cb).
+// Реестр защищён мьютексом, методы можно вызывать из любых потоков рендеринга.
+class VulkanTextureCache
+{
+public:
+    struct Texture {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkSampler sampler = VK_NULL_HANDLE;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t mipLevels = 1;
+        VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+        // 0 - изображение заполнено сразу (HostImageCopy), ждать нечего
+        quint64 upload = 0;
+    };
+
+    // sourceName - исходное изображение в qrc (":/textures/x.png"); если
+    // рядом с приложением есть подготовленный блоб, берётся он. Не найденное
+    // изображение заменяется шахматной доской.
+    static const Texture *acquire(QQuickWindow *window, const QString &sourceName);
+    static void release(VkDevice dev, const Texture *texture);
+};
+
+#endif
@@ -0,0 +1,199 @@
+// vulkantexturesource.cpp
+#include "vulkantexturesource.h"
+#include "vulkantrace.h"
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Изображения генератора, которые рендереры ещё держат; больше - кадр пропускается
+static const int TEST_PATTERN_POOL = 8;
+
+void VulkanTextureStream::push(const VulkanTextureFrame &frame, const QRect &dirtyRect)
+{
+    QMutexLocker lock(&m_mutex);
+    // После смены размера или формата кадр копируется целиком
+    const QRect full(QPoint(0, 0), frame.size);
+    const bool changed = frame.size != m_frame.size || frame.format != m_frame.format;
+    ++m_generation;
+    m_dirty[m_generation % HistorySize] = changed || dirtyRect.isEmpty() ? full : dirtyRect & full;
+    // Прежний кадр освобождается уже без мьютекса
+    VulkanTextureFrame previous = std::exchange(m_frame, frame);
+    lock.unlock();
+}
+
+bool VulkanTextureStream::take(quint64 *generation, VulkanTextureFrame *frame, QRect *dirty) const
+{
+    QMutexLocker lock(&m_mutex);
+    if (m_generation == *generation)
+        return false;
+
+    const QRect full(QPoint(0, 0), m_frame.size);
+    if (*generation == 0 || m_generation - *generation > quint64(HistorySize)) {
+        *dirty = full;
+    } else {
+        QRect united;
+        for (quint64 g = *generation + 1; g <= m_generation; ++g)
+            united |= m_dirty[g % HistorySize];
+        *dirty = united & full;
+    }
+    *frame = m_frame;
+    *generation = m_generation;
+    return true;
+}
+
+VulkanTextureSource::VulkanTextureSource(QObject *parent)
+    : QObject(parent),
+      m_stream(new VulkanTextureStream)
+{
+}
+
+VulkanTextureSource::~VulkanTextureSource()
+{
+    stopTestPattern();
+}
+
+void VulkanTextureSource::setImage(const QImage &image, const QRect &dirtyRect)
+{
+    if (image.isNull())
+        return;
+
+    VulkanTextureFrame frame;
+    frame.size = image.size();
+    if (image.format() == QImage::Format_RGBA8888 || image.format() == QImage::Format_RGBX8888)
+        frame.image = image;
+    else
+        frame.image = image.convertToFormat(QImage::Format_RGBA8888);
+    m_stream->push(frame, dirtyRect);
+    emit frameAvailable();
+}
+
+#ifdef VULKANUNDERQML_MULTIMEDIA
+void VulkanTextureSource::setVideoFrame(const QVideoFrame &videoFrame)
+{
+    if (!videoFrame.isValid())
+        return;
+
+    VulkanTextureFrame frame;
+    frame.size = videoFrame.size();
+    switch (videoFrame.pixelFormat()) {
+    case QVideoFrameFormat::Format_NV12:
+        frame.format = VulkanTextureFrame::Nv12;
+        break;
+    case QVideoFrameFormat::Format_YUV420P:
+        frame.format = VulkanTextureFrame::Yuv420p;
+        break;
+    case QVideoFrameFormat::Format_RGBA8888:
+    case QVideoFrameFormat::Format_RGBX8888:
+        frame.format = VulkanTextureFrame::Rgba8;
+        break;
+    default:
+        setImage(videoFrame.toImage());
+        return;
+    }
+    frame.video = videoFrame;
+
+    // Без явного пространства HD считается BT.709, SD - BT.601
+    const QVideoFrameFormat format = videoFrame.surfaceFormat();
+    frame.bt709 = format.colorSpace() == QVideoFrameFormat::ColorSpace_BT709
+            || (format.colorSpace() == QVideoFrameFormat::ColorSpace_Undefined && frame.size.height() >= 720);
+    frame.fullRange = format.colorRange() == QVideoFrameFormat::ColorRange_Full;
+    m_stream->push(frame, QRect());
+    emit frameAvailable();
+}
+
+QVideoSink *VulkanTextureSource::videoSink()
+{
+    if (!m_videoSink) {
+        m_videoSink = new QVideoSink(this);
+        // Кадры приходят в потоке декодера и без пересылки в GUI-поток
+        // попадают в поток текстуры
+        connect(m_videoSink, &QVideoSink::videoFrameChanged, this, &VulkanTextureSource::setVideoFrame,
+                Qt::DirectConnection);
+    }
+    return m_videoSink;
+}
+#endif
+
+void VulkanTextureSource::setTestPatternSize(const QSize &size)
+{
+    if (size == m_testPatternSize)
+        return;
+    m_testPatternSize = size;
+    emit testPatternSizeChanged();
+    restartTestPattern();
+}
+
+void VulkanTextureSource::setTestPatternRate(qreal rate)
+{
+    if (rate == m_testPatternRate)
+        return;
+    m_testPatternRate = rate;
+    emit testPatternRateChanged();
+    restartTestPattern();
+}
+
+void VulkanTextureSource::restartTestPattern()
+{
+    stopTestPattern();
+    if (m_testPatternSize.isEmpty() || m_testPatternRate <= 0)
+        return;
+
+    const QSize size = m_testPatternSize;
+    const qreal rate = m_testPatternRate;
+    m_testPatternRunning.store(true, std::memory_order_relaxed);
+    m_testPatternThread = QThread::create([this, size, rate] { generateTestPattern(size, rate); });
+    m_testPatternThread->start();
+}
+
+void VulkanTextureSource::stopTestPattern()
+{
+    if (!m_testPatternThread)
+        return;
+    m_testPatternRunning.store(false, std::memory_order_relaxed);
+    m_testPatternThread->wait();
+    delete m_testPatternThread;
+    m_testPatternThread = nullptr;
+}
+
+// Поток генератора: бегущие полосы во весь кадр с частотой rate. Изображения
+// берутся из пула; занятое рендерером не переписывается (isDetached()),
+// вместо него выделяется новое.
+void VulkanTextureSource::generateTestPattern(const QSize &size, qreal rate)
+{
+    QList<QImage> pool;
+    std::vector<quint32> row(size_t(size.width()));
+    const qint64 interval = qint64(1e9 / rate);
+    QElapsedTimer clock;
+    clock.start();
+    qint64 next = 0;
+
+    for (quint64 frame = 0; m_testPatternRunning.load(std::memory_order_relaxed); ++frame) {
+        int index = 0;
+        while (index < pool.size() && !pool[index].isDetached())
+            ++index;
+        if (index == pool.size() && pool.size() < TEST_PATTERN_POOL)
+            pool.append(QImage(size, QImage::Format_RGBA8888));
+
+        if (index < pool.size()) {
+            VKQ_TRACE_SCOPE("VulkanTextureSource::testPattern");
+            // Байты R, G, B, A
+            for (int x = 0; x < size.width(); ++x) {
+                const quint32 v = quint32((x + frame * 8) & 0xff);
+                row[size_t(x)] = v | ((255 - v) << 8) | (quint32((x / 64 + frame) & 1) * 255 << 16) | 0xff000000u;
+            }
+            QImage &image(pool[index]);
+            for (int y = 0; y < size.height(); ++y)
+                memcpy(image.scanLine(y), row.data(), size_t(size.width()) * 4);
+            setImage(image);
+        }
+
+        next += interval;
+        const qint64 wait = next - clock.nsecsElapsed();
+        if (wait > 0)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+    }
+}
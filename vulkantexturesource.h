@@ -0,0 +1,125 @@
+// vulkantexturesource.h
+#ifndef VULKANTEXTURESOURCE_H
+#define VULKANTEXTURESOURCE_H
+
+#include <QtQml/qqmlregistration.h>
+#include <QObject>
+#include <QImage>
+#include <QMutex>
+#include <QRect>
+#include <QSharedPointer>
+#include <QThread>
+#include <atomic>
+#ifdef VULKANUNDERQML_MULTIMEDIA
+#include <QVideoFrame>
+#include <QVideoSink>
+#endif
+
+// Кадр потока текстуры. Пиксели не копируются: QImage и QVideoFrame
+// разделяют буфер с источником, пока рендерер не скопирует их в staging.
+struct VulkanTextureFrame
+{
+    enum Format {
+        Rgba8,      // RGBA8888 (или RGBX8888)
+        Nv12,       // плоскость Y и чередующиеся UV с половинным разрешением
+        Yuv420p     // плоскости Y, U и V, цвет с половинным разрешением (I420)
+    };
+
+    Format format = Rgba8;
+    QSize size;
+    QImage image;
+#ifdef VULKANUNDERQML_MULTIMEDIA
+    // YUV и RGBA из видео; отображается в память при копировании
+    QVideoFrame video;
+#endif
+    // YUV -> RGB: матрица BT.709 (иначе BT.601), полный диапазон (иначе 16-235)
+    bool bt709 = true;
+    bool fullRange = false;
+};
+
+// Последний кадр источника для рендереров, методы потокобезопасны.
+//
+// Очереди нет: новый кадр заменяет непрочитанный, отстающий рендерер
+// пропускает кадры, а не копит задержку. Изменённые области последних
+// кадров хранятся, поэтому рендерер, пропустивший несколько кадров,
+// копирует их объединение, а не весь кадр.
+class VulkanTextureStream
+{
+public:
+    void push(const VulkanTextureFrame &frame, const QRect &dirtyRect);
+
+    // Кадр новее *generation; *dirty - что изменилось после него (весь
+    // кадр, если *generation == 0 или история короче). false - нового нет.
+    bool take(quint64 *generation, VulkanTextureFrame *frame, QRect *dirty) const;
+
+private:
+    static const int HistorySize = 8;
+
+    mutable QMutex m_mutex;
+    VulkanTextureFrame m_frame;
+    quint64 m_generation = 0;
+    // Область кадра generation - в m_dirty[generation % HistorySize]
+    QRect m_dirty[HistorySize];
+};
+
+// Источник кадров для текстуры VulkanCube (свойство textureSource).
+//
+// Кадры подаются из любого потока: setImage() для QImage, setVideoFrame()
+// или videoSink для Qt Multimedia (MediaPlayer, Camera). Рендерер копирует
+// последний кадр в staging в своём рабочем потоке и переносит его в
+// изображение в начале кадра, поток рендеринга на копирование не тратится.
+// testPatternSize включает генератор кадров для бенчмарков.
+class VulkanTextureSource : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QSize testPatternSize READ testPatternSize WRITE setTestPatternSize NOTIFY testPatternSizeChanged)
+    Q_PROPERTY(qreal testPatternRate READ testPatternRate WRITE setTestPatternRate NOTIFY testPatternRateChanged)
+#ifdef VULKANUNDERQML_MULTIMEDIA
+    Q_PROPERTY(QVideoSink *videoSink READ videoSink CONSTANT)
+#endif
+    QML_ELEMENT
+
+public:
+    explicit VulkanTextureSource(QObject *parent = nullptr);
+    ~VulkanTextureSource();
+
+    // dirtyRect - изменившаяся часть кадра в пикселях, пустой - весь кадр.
+    // Форматы, кроме RGBA8888 и RGBX8888, переводятся в вызывающем потоке.
+    void setImage(const QImage &image, const QRect &dirtyRect = QRect());
+#ifdef VULKANUNDERQML_MULTIMEDIA
+    // NV12 и YUV420P переводятся в RGB на GPU, остальные форматы - через
+    // QVideoFrame::toImage() в вызывающем потоке
+    void setVideoFrame(const QVideoFrame &frame);
+    QVideoSink *videoSink();
+#endif
+
+    QSharedPointer<VulkanTextureStream> stream() const { return m_stream; }
+
+    QSize testPatternSize() const { return m_testPatternSize; }
+    void setTestPatternSize(const QSize &size);
+    qreal testPatternRate() const { return m_testPatternRate; }
+    void setTestPatternRate(qreal rate);
+
+signals:
+    void testPatternSizeChanged();
+    void testPatternRateChanged();
+    // Из потока, подавшего кадр; VulkanCube по нему запрашивает кадр окна
+    void frameAvailable();
+
+private:
+    void restartTestPattern();
+    void stopTestPattern();
+    void generateTestPattern(const QSize &size, qreal rate);
+
+    QSharedPointer<VulkanTextureStream> m_stream;
+#ifdef VULKANUNDERQML_MULTIMEDIA
+    QVideoSink *m_videoSink = nullptr;
+#endif
+
+    QSize m_testPatternSize;
+    qreal m_testPatternRate = 60;
+    QThread *m_testPatternThread = nullptr;
+    std::atomic<bool> m_testPatternRunning { false };
+};
+
+#endif
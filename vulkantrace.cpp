@@ -0,0 +1,185 @@
+// vulkantrace.cpp
+#include "vulkantrace.h"
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QDebug>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+namespace VulkanTrace {
+
+namespace {
+
+struct Event {
+    const char *name;
+    quint64 begin;
+    quint64 end;
+};
+
+// Кольцевой буфер одного потока. Пишет только поток-владелец, поэтому
+// достаточно атомарного счётчика с release-публикацией; при переполнении
+// старые события перезаписываются.
+struct ThreadBuffer {
+    static constexpr quint64 Capacity = 1 << 16;
+
+    std::vector<Event> events = std::vector<Event>(Capacity);
+    std::atomic<quint64> head { 0 };
+    quint64 threadId = 0;
+    QString threadName;
+};
+
+std::atomic<bool> g_active { false };
+QString g_outputFile;
+const std::chrono::steady_clock::time_point g_epoch = std::chrono::steady_clock::now();
+
+// Реестр нужен только для выгрузки; мьютекс берётся один раз на поток
+QMutex g_registryMutex;
+std::vector<ThreadBuffer *> g_buffers;
+
+PFN_vkCmdBeginDebugUtilsLabelEXT g_beginLabel = nullptr;
+PFN_vkCmdEndDebugUtilsLabelEXT g_endLabel = nullptr;
+
+ThreadBuffer *threadBuffer()
+{
+    thread_local ThreadBuffer *buffer = nullptr;
+    if (!buffer) {
+        buffer = new ThreadBuffer;
+        QThread *thread = QThread::currentThread();
+        buffer->threadName = thread->objectName();
+        if (buffer->threadName.isEmpty())
+            buffer->threadName = QString::fromLatin1(thread->metaObject()->className());
+        QMutexLocker locker(&g_registryMutex);
+        buffer->threadId = g_buffers.size() + 1;
+        g_buffers.push_back(buffer);
+    }
+    return buffer;
+}
+
+// Строка JSON в кавычках: имя потока задаёт приложение (objectName), в нём
+// могут быть кавычки, обратная косая черта и управляющие символы
+void appendJsonString(QByteArray &out, const QByteArray &value)
+{
+    out += '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (uchar(c) < 0x20) {
+            out += "\\u00";
+            out += "0123456789abcdef"[uchar(c) >> 4];
+            out += "0123456789abcdef"[uchar(c) & 0xf];
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+void start(const QString &outputFile)
+{
+    g_outputFile = outputFile;
+    g_active.store(!outputFile.isEmpty(), std::memory_order_release);
+}
+
+bool isActive()
+{
+    return g_active.load(std::memory_order_relaxed);
+}
+
+quint64 timestamp()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_epoch).count();
+}
+
+void addEvent(const char *name, quint64 beginNs, quint64 endNs)
+{
+    ThreadBuffer *buffer = threadBuffer();
+    const quint64 index = buffer->head.load(std::memory_order_relaxed);
+    buffer->events[index % ThreadBuffer::Capacity] = { name, beginNs, endNs };
+    buffer->head.store(index + 1, std::memory_order_release);
+}
+
+bool writeReport()
+{
+    if (g_outputFile.isEmpty())
+        return false;
+
+    // Новые события больше не пишутся, чтобы не читать перезаписываемые слоты
+    g_active.store(false, std::memory_order_release);
+
+    QFile f(g_outputFile);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Failed to open trace file" << g_outputFile;
+        return false;
+    }
+
+    QByteArray out;
+    out.reserve(1 << 20);
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    auto separator = [&out, &first] {
+        if (!first)
+            out += ",\n";
+        first = false;
+    };
+
+    QMutexLocker locker(&g_registryMutex);
+    for (ThreadBuffer *buffer : g_buffers) {
+        separator();
+        out += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" + QByteArray::number(buffer->threadId)
+                + ",\"args\":{\"name\":";
+        appendJsonString(out, buffer->threadName.toUtf8());
+        out += "}}";
+
+        const quint64 head = buffer->head.load(std::memory_order_acquire);
+        const quint64 count = qMin(head, ThreadBuffer::Capacity);
+        for (quint64 i = head - count; i < head; ++i) {
+            const Event &e(buffer->events[i % ThreadBuffer::Capacity]);
+            separator();
+            out += "{\"ph\":\"X\",\"cat\":\"vulkanunderqml\",\"name\":";
+            appendJsonString(out, QByteArray::fromRawData(e.name, qsizetype(qstrlen(e.name))));
+            out += ",\"pid\":1,\"tid\":" + QByteArray::number(buffer->threadId)
+                    + ",\"ts\":" + QByteArray::number(e.begin / 1000.0, 'f', 3)
+                    + ",\"dur\":" + QByteArray::number((e.end - e.begin) / 1000.0, 'f', 3) + "}";
+        }
+    }
+    out += "\n]}\n";
+
+    f.write(out);
+    qDebug() << "Trace written to" << g_outputFile;
+    return true;
+}
+
+void resolveDebugUtils(QVulkanInstance *inst)
+{
+    if (!inst->extensions().contains(QByteArrayLiteral("VK_EXT_debug_utils")))
+        return;
+    g_beginLabel = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(
+        inst->getInstanceProcAddr("vkCmdBeginDebugUtilsLabelEXT"));
+    g_endLabel = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(
+        inst->getInstanceProcAddr("vkCmdEndDebugUtilsLabelEXT"));
+}
+
+void beginGpuLabel(VkCommandBuffer cb, const char *name)
+{
+    if (!g_beginLabel)
+        return;
+    VkDebugUtilsLabelEXT label{};
+    label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+    label.pLabelName = name;
+    g_beginLabel(cb, &label);
+}
+
+void endGpuLabel(VkCommandBuffer cb)
+{
+    if (!g_endLabel)
+        return;
+    g_endLabel(cb);
+}
+
+} // namespace VulkanTrace
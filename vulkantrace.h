@@ -0,0 +1,63 @@
+// vulkantrace.h
+#ifndef VULKANTRACE_H
+#define VULKANTRACE_H
+
+#include <QString>
+#include <QVulkanInstance>
+
+// Лёгкая CPU-трассировка с экспортом в формат Chrome/Perfetto trace JSON.
+//
+// Зоны компилируются только при определённом VULKANUNDERQML_TRACING
+// (CMake-опция VULKANUNDERQML_ENABLE_TRACING), иначе макросы пустые.
+// Во время работы каждая зона - два чтения часов и одна запись в кольцевой
+// буфер своего потока, без блокировок. Запись включается переменной
+// окружения VULKANUNDERQML_TRACE=<файл> или ключом --trace <файл>.
+//
+// Имена зон должны быть строковыми литералами: сохраняется только указатель.
+
+namespace VulkanTrace {
+
+void start(const QString &outputFile);
+bool isActive();
+bool writeReport();
+
+quint64 timestamp();
+void addEvent(const char *name, quint64 beginNs, quint64 endNs);
+
+// Метки VK_EXT_debug_utils для GPU-захватов (RenderDoc, Nsight и т.п.)
+void resolveDebugUtils(QVulkanInstance *inst);
+void beginGpuLabel(VkCommandBuffer cb, const char *name);
+void endGpuLabel(VkCommandBuffer cb);
+
+class Scope
+{
+public:
+    explicit Scope(const char *name)
+        : m_name(name), m_begin(isActive() ? timestamp() : 0) { }
+    ~Scope()
+    {
+        if (m_begin)
+            addEvent(m_name, m_begin, timestamp());
+    }
+
+private:
+    Q_DISABLE_COPY(Scope)
+    const char *m_name;
+    quint64 m_begin;
+};
+
+} // namespace VulkanTrace
+
+#ifdef VULKANUNDERQML_TRACING
+#define VKQ_TRACE_CONCAT_(a, b) a##b
+#define VKQ_TRACE_CONCAT(a, b) VKQ_TRACE_CONCAT_(a, b)
+#define VKQ_TRACE_SCOPE(name) VulkanTrace::Scope VKQ_TRACE_CONCAT(vkqTraceScope_, __LINE__)(name)
+#define VKQ_TRACE_GPU_BEGIN(cb, name) VulkanTrace::beginGpuLabel(cb, name)
+#define VKQ_TRACE_GPU_END(cb) VulkanTrace::endGpuLabel(cb)
+#else
+#define VKQ_TRACE_SCOPE(name) do { } while (false)
+#define VKQ_TRACE_GPU_BEGIN(cb, name) do { } while (false)
+#define VKQ_TRACE_GPU_END(cb) do { } while (false)
+#endif
+
+#endif
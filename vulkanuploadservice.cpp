@@ -0,0 +1,501 @@
+// vulkanuploadservice.cpp
+#include "vulkanuploadservice.h"
+#include "vulkandevicefeatures.h"
+#include "vulkanutils.h"
+#include "vulkantrace.h"
+#include <QMutexLocker>
+#include <QThread>
+
+// Кольцо staging на устройство; загрузки больше него получают свой буфер
+static const VkDeviceSize STAGING_RING_SIZE = 8 * 1024 * 1024;
+// Смещение данных в буфере для vkCmdCopyBufferToImage: кратно размеру
+// блока любого формата
+static const VkDeviceSize STAGING_ALIGNMENT = 256;
+
+struct TransferQueue {
+    uint32_t family;
+    VkQueue queue;
+};
+
+typedef QHash<VkDevice, VulkanUploadService *> UploadServiceRegistry;
+typedef QHash<VkDevice, TransferQueue> TransferQueueRegistry;
+Q_GLOBAL_STATIC(QMutex, s_registryMutex)
+Q_GLOBAL_STATIC(UploadServiceRegistry, s_services)
+Q_GLOBAL_STATIC(TransferQueueRegistry, s_transferQueues)
+
+VulkanUploadService *VulkanUploadService::acquire(QQuickWindow *window)
+{
+    QSGRendererInterface *rif = window->rendererInterface();
+    VkDevice dev = *reinterpret_cast<VkDevice *>(rif->getResource(window, QSGRendererInterface::DeviceResource));
+    Q_ASSERT(dev);
+
+    QMutexLocker lock(s_registryMutex());
+    VulkanUploadService *&service((*s_services())[dev]);
+    if (!service)
+        service = new VulkanUploadService(window, dev);
+    ++service->m_refCount;
+    return service;
+}
+
+void VulkanUploadService::release(VulkanUploadService *service)
+{
+    if (!service)
+        return;
+    QMutexLocker lock(s_registryMutex());
+    if (--service->m_refCount == 0) {
+        s_services()->remove(service->m_dev);
+        delete service;
+    }
+}
+
+void VulkanUploadService::setTransferQueue(VkDevice dev, uint32_t queueFamilyIndex, VkQueue queue)
+{
+    QMutexLocker lock(s_registryMutex());
+    s_transferQueues()->insert(dev, { queueFamilyIndex, queue });
+}
+
+VulkanUploadService::VulkanUploadService(QQuickWindow *window, VkDevice dev)
+    : m_dev(dev)
+{
+    QSGRendererInterface *rif = window->rendererInterface();
+    QVulkanInstance *inst = reinterpret_cast<QVulkanInstance *>(
+        rif->getResource(window, QSGRendererInterface::VulkanInstanceResource));
+    VkPhysicalDevice physDev = *reinterpret_cast<VkPhysicalDevice *>(
+        rif->getResource(window, QSGRendererInterface::PhysicalDeviceResource));
+    Q_ASSERT(inst && physDev);
+
+    m_devFuncs = inst->deviceFunctions(m_dev);
+    QVulkanFunctions *f = inst->functions();
+    f->vkGetPhysicalDeviceMemoryProperties(physDev, &m_memProps);
+
+    m_graphicsQueueFamily = *reinterpret_cast<uint32_t *>(
+        rif->getResource(window, QSGRendererInterface::GraphicsQueueFamilyIndexResource));
+    m_queueFamily = m_graphicsQueueFamily;
+    m_queue = *reinterpret_cast<VkQueue *>(rif->getResource(window, QSGRendererInterface::CommandQueueResource));
+    m_queueThread = QThread::currentThread();
+
+    // Вызывается под s_registryMutex
+    auto transfer = s_transferQueues()->constFind(m_dev);
+    if (transfer != s_transferQueues()->cend()) {
+        m_queueFamily = transfer->family;
+        m_queue = transfer->queue;
+        m_ownQueue = true;
+        m_queueThread = nullptr;
+    }
+
+    // Timeline-семафоры - core Vulkan 1.2, включены ли они, знает VulkanDeviceFeatures
+    if (VulkanDeviceFeatures::enabled(window).testFlag(VulkanDeviceFeatures::TimelineSemaphore)) {
+        auto getDeviceProcAddr = reinterpret_cast<PFN_vkGetDeviceProcAddr>(
+            inst->getInstanceProcAddr("vkGetDeviceProcAddr"));
+        if (getDeviceProcAddr) {
+            m_getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValue>(
+                getDeviceProcAddr(m_dev, "vkGetSemaphoreCounterValue"));
+            m_waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphores>(
+                getDeviceProcAddr(m_dev, "vkWaitSemaphores"));
+        }
+    }
+
+    if (m_getSemaphoreCounterValue && m_waitSemaphores) {
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+        VkSemaphoreCreateInfo semInfo{};
+        semInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semInfo.pNext = &typeInfo;
+        VkResult err = m_devFuncs->vkCreateSemaphore(m_dev, &semInfo, nullptr, &m_timeline);
+        if (err != VK_SUCCESS)
+            qFatal("Failed to create timeline semaphore: %d", err);
+    }
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = m_queueFamily;
+    VkResult err = m_devFuncs->vkCreateCommandPool(m_dev, &poolInfo, nullptr, &m_cmdPool);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create upload command pool: %d", err);
+
+    qDebug("uploads: queue family %u (%s, %s), %s", m_queueFamily,
+           transfersOwnership() ? "transfer family" : "graphics family",
+           m_ownQueue ? "own queue" : "window queue", m_timeline ? "timeline semaphore" : "fences");
+}
+
+VulkanUploadService::~VulkanUploadService()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        submitLocked();
+        if (!m_pending.isEmpty())
+            waitLocked(m_pending.last().value);
+        Q_ASSERT(m_pending.isEmpty());
+    }
+    if (m_ringPtr)
+        m_devFuncs->vkUnmapMemory(m_dev, m_ringMem);
+    VulkanUtils::destroyBuffer(m_devFuncs, m_dev, &m_ringBuf, &m_ringMem);
+    m_devFuncs->vkDestroyCommandPool(m_dev, m_cmdPool, nullptr);
+    if (m_timeline)
+        m_devFuncs->vkDestroySemaphore(m_dev, m_timeline, nullptr);
+}
+
+void VulkanUploadService::openBatch()
+{
+    if (m_open.cb)
+        return;
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = m_cmdPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    VkResult err = m_devFuncs->vkAllocateCommandBuffers(m_dev, &allocInfo, &m_open.cb);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to allocate upload command buffer: %d", err);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    m_devFuncs->vkBeginCommandBuffer(m_open.cb, &beginInfo);
+    m_open.value = m_nextValue;
+}
+
+bool VulkanUploadService::allocateRing(VkDeviceSize size, VkDeviceSize *offset)
+{
+    // Пустое кольцо заполняется с начала
+    if (m_ringUsed == 0)
+        m_ringHead = 0;
+    // Участок не разрывается: не помещающийся до конца идёт с начала кольца
+    const VkDeviceSize skip = m_ringHead + size > STAGING_RING_SIZE ? STAGING_RING_SIZE - m_ringHead : 0;
+    if (m_ringUsed + skip + size > STAGING_RING_SIZE)
+        return false;
+    *offset = skip ? 0 : m_ringHead;
+    m_ringHead = (*offset + size) % STAGING_RING_SIZE;
+    m_ringUsed += skip + size;
+    m_open.ringBytes += skip + size;
+    return true;
+}
+
+VkBuffer VulkanUploadService::stage(const void *data, VkDeviceSize size, VkDeviceSize *offset)
+{
+    const VkDeviceSize alignedSize = VulkanUtils::aligned(size, STAGING_ALIGNMENT);
+    if (alignedSize > STAGING_RING_SIZE) {
+        VkBuffer buf = VK_NULL_HANDLE;
+        VkDeviceMemory mem = VK_NULL_HANDLE;
+        VulkanUtils::createBuffer(m_devFuncs, m_dev, m_memProps, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                  &buf, &mem, "staging buffer");
+        void *p = nullptr;
+        VkResult err = m_devFuncs->vkMapMemory(m_dev, mem, 0, size, 0, &p);
+        if (err != VK_SUCCESS || !p)
+            qFatal("Failed to map staging memory: %d", err);
+        memcpy(p, data, size_t(size));
+        m_devFuncs->vkUnmapMemory(m_dev, mem);
+        m_open.staging.append(qMakePair(buf, mem));
+        *offset = 0;
+        return buf;
+    }
+
+    if (!m_ringBuf) {
+        VulkanUtils::createBuffer(m_devFuncs, m_dev, m_memProps, STAGING_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                  &m_ringBuf, &m_ringMem, "staging ring");
+        void *p = nullptr;
+        VkResult err = m_devFuncs->vkMapMemory(m_dev, m_ringMem, 0, VK_WHOLE_SIZE, 0, &p);
+        if (err != VK_SUCCESS || !p)
+            qFatal("Failed to map staging ring memory: %d", err);
+        m_ringPtr = static_cast<char *>(p);
+    }
+
+    // Кольцо занято - ждём самый старый пакет; если место держит только
+    // открытый пакет, он отправляется
+    collectLocked();
+    while (!allocateRing(alignedSize, offset)) {
+        if (m_pending.isEmpty())
+            submitLocked();
+        Q_ASSERT(!m_pending.isEmpty());
+        waitLocked(m_pending.first().value);
+    }
+    memcpy(m_ringPtr + *offset, data, size_t(size));
+    return m_ringBuf;
+}
+
+quint64 VulkanUploadService::addUpload(const Upload &upload)
+{
+    const quint64 id = m_nextUpload++;
+    Upload u = upload;
+    u.value = m_open.value;
+    m_uploads.insert(id, u);
+    return id;
+}
+
+quint64 VulkanUploadService::uploadImage(const void *data, VkDeviceSize size, VkImage dst,
+                                         const QList<VkBufferImageCopy> &regions, uint32_t mipLevels,
+                                         VkImageLayout finalLayout, VkAccessFlags dstAccess,
+                                         VkPipelineStageFlags dstStage)
+{
+    VKQ_TRACE_SCOPE("VulkanUploadService::uploadImage");
+    QMutexLocker lock(&m_mutex);
+    // До openBatch(): в ожидании места в кольце открытый пакет может уйти
+    VkDeviceSize stagingOffset = 0;
+    VkBuffer staging = stage(data, size, &stagingOffset);
+    openBatch();
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.image = dst;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.layerCount = 1;
+    m_devFuncs->vkCmdPipelineBarrier(m_open.cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    QList<VkBufferImageCopy> copies = regions;
+    for (VkBufferImageCopy &copy : copies)
+        copy.bufferOffset += stagingOffset;
+    m_devFuncs->vkCmdCopyBufferToImage(m_open.cb, staging, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                       uint32_t(copies.size()), copies.constData());
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = finalLayout;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    Upload upload;
+    upload.isImage = true;
+    if (transfersOwnership()) {
+        // Release в очереди передачи; acquire запишет consume() в кадре
+        barrier.srcQueueFamilyIndex = m_queueFamily;
+        barrier.dstQueueFamilyIndex = m_graphicsQueueFamily;
+        barrier.dstAccessMask = 0;
+        m_devFuncs->vkCmdPipelineBarrier(m_open.cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = dstAccess;
+        upload.imageBarrier = barrier;
+        upload.dstStage = dstStage;
+    } else {
+        barrier.dstAccessMask = dstAccess;
+        m_devFuncs->vkCmdPipelineBarrier(m_open.cb, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage,
+                                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+    return addUpload(upload);
+}
+
+quint64 VulkanUploadService::uploadImage(const QImage &image, VkImage dst,
+                                         VkImageLayout finalLayout, VkAccessFlags dstAccess,
+                                         VkPipelineStageFlags dstStage)
+{
+    const QImage rgba = image.format() == QImage::Format_RGBA8888
+            ? image : image.convertToFormat(QImage::Format_RGBA8888);
+
+    VkBufferImageCopy region{};
+    region.bufferRowLength = uint32_t(rgba.bytesPerLine() / 4);
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = { uint32_t(rgba.width()), uint32_t(rgba.height()), 1 };
+
+    return uploadImage(rgba.constBits(), VkDeviceSize(rgba.sizeInBytes()), dst, { region }, 1,
+                       finalLayout, dstAccess, dstStage);
+}
+
+quint64 VulkanUploadService::uploadBuffer(const void *data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset,
+                                          VkAccessFlags dstAccess, VkPipelineStageFlags dstStage)
+{
+    VKQ_TRACE_SCOPE("VulkanUploadService::uploadBuffer");
+    QMutexLocker lock(&m_mutex);
+    VkDeviceSize stagingOffset = 0;
+    VkBuffer staging = stage(data, size, &stagingOffset);
+    openBatch();
+
+    VkBufferCopy copy;
+    copy.srcOffset = stagingOffset;
+    copy.dstOffset = dstOffset;
+    copy.size = size;
+    m_devFuncs->vkCmdCopyBuffer(m_open.cb, staging, dst, 1, &copy);
+
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = dst;
+    barrier.offset = dstOffset;
+    barrier.size = size;
+
+    Upload upload;
+    if (transfersOwnership()) {
+        barrier.srcQueueFamilyIndex = m_queueFamily;
+        barrier.dstQueueFamilyIndex = m_graphicsQueueFamily;
+        m_devFuncs->vkCmdPipelineBarrier(m_open.cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                         0, 0, nullptr, 1, &barrier, 0, nullptr);
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = dstAccess;
+        upload.bufferBarrier = barrier;
+        upload.dstStage = dstStage;
+    } else {
+        barrier.dstAccessMask = dstAccess;
+        m_devFuncs->vkCmdPipelineBarrier(m_open.cb, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage,
+                                         0, 0, nullptr, 1, &barrier, 0, nullptr);
+    }
+    return addUpload(upload);
+}
+
+void VulkanUploadService::submit()
+{
+    QMutexLocker lock(&m_mutex);
+    submitLocked();
+}
+
+void VulkanUploadService::submitLocked()
+{
+    if (!m_open.cb)
+        return;
+
+    VKQ_TRACE_SCOPE("VulkanUploadService::submit");
+    // Графическую очередь окна можно занимать только с потока, который
+    // отправляет в неё кадры (см. описание класса)
+    Q_ASSERT(m_ownQueue || QThread::currentThread() == m_queueThread);
+    m_devFuncs->vkEndCommandBuffer(m_open.cb);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_open.cb;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    if (m_timeline) {
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &m_open.value;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &m_timeline;
+    } else {
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkResult err = m_devFuncs->vkCreateFence(m_dev, &fenceInfo, nullptr, &m_open.fence);
+        if (err != VK_SUCCESS)
+            qFatal("Failed to create upload fence: %d", err);
+    }
+
+    VkResult err = m_devFuncs->vkQueueSubmit(m_queue, 1, &submitInfo, m_open.fence);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to submit uploads: %d", err);
+
+    m_pending.append(m_open);
+    m_open = Batch();
+    ++m_nextValue;
+}
+
+void VulkanUploadService::collectLocked()
+{
+    quint64 timelineValue = 0;
+    if (m_timeline)
+        m_getSemaphoreCounterValue(m_dev, m_timeline, &timelineValue);
+
+    // Пакеты уходят в одну очередь и завершаются по порядку
+    while (!m_pending.isEmpty()) {
+        Batch &batch(m_pending.first());
+        const bool done = m_timeline
+                ? batch.value <= timelineValue
+                : m_devFuncs->vkGetFenceStatus(m_dev, batch.fence) == VK_SUCCESS;
+        if (!done)
+            break;
+        for (const auto &staging : std::as_const(batch.staging)) {
+            m_devFuncs->vkDestroyBuffer(m_dev, staging.first, nullptr);
+            m_devFuncs->vkFreeMemory(m_dev, staging.second, nullptr);
+        }
+        m_devFuncs->vkFreeCommandBuffers(m_dev, m_cmdPool, 1, &batch.cb);
+        if (batch.fence)
+            m_devFuncs->vkDestroyFence(m_dev, batch.fence, nullptr);
+        m_ringUsed -= batch.ringBytes;
+        m_completedValue = batch.value;
+        m_pending.removeFirst();
+    }
+}
+
+quint64 VulkanUploadService::completedValueLocked()
+{
+    collectLocked();
+    return m_completedValue;
+}
+
+// Пакет value должен быть отправлен
+void VulkanUploadService::waitLocked(quint64 value)
+{
+    VKQ_TRACE_SCOPE("VulkanUploadService::wait");
+    if (m_timeline) {
+        VkSemaphoreWaitInfo waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &m_timeline;
+        waitInfo.pValues = &value;
+        VkResult err = m_waitSemaphores(m_dev, &waitInfo, UINT64_MAX);
+        if (err != VK_SUCCESS)
+            qFatal("Failed to wait for uploads: %d", err);
+    } else {
+        for (const Batch &batch : std::as_const(m_pending)) {
+            if (batch.value != value)
+                continue;
+            VkResult err = m_devFuncs->vkWaitForFences(m_dev, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+            if (err != VK_SUCCESS)
+                qFatal("Failed to wait for upload fence: %d", err);
+            break;
+        }
+    }
+    collectLocked();
+}
+
+bool VulkanUploadService::isComplete(quint64 upload)
+{
+    QMutexLocker lock(&m_mutex);
+    auto it = m_uploads.constFind(upload);
+    if (it == m_uploads.cend())
+        return true;
+    // Незакрытый пакет отправляется, иначе ожидание никогда не закончится
+    if (it->value == m_open.value && m_open.cb)
+        submitLocked();
+    return completedValueLocked() >= it->value;
+}
+
+bool VulkanUploadService::consume(quint64 upload, VkCommandBuffer cb)
+{
+    QMutexLocker lock(&m_mutex);
+    auto it = m_uploads.find(upload);
+    if (it == m_uploads.end())
+        return true;
+    if (it->value == m_open.value && m_open.cb)
+        submitLocked();
+    if (completedValueLocked() < it->value)
+        return false;
+
+    if (it->dstStage) {
+        // Acquire-часть передачи владения из семейства очереди передачи
+        if (it->isImage) {
+            m_devFuncs->vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, it->dstStage,
+                                             0, 0, nullptr, 0, nullptr, 1, &it->imageBarrier);
+        } else {
+            m_devFuncs->vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, it->dstStage,
+                                             0, 0, nullptr, 1, &it->bufferBarrier, 0, nullptr);
+        }
+    }
+    m_uploads.erase(it);
+    return true;
+}
+
+void VulkanUploadService::wait(quint64 upload)
+{
+    QMutexLocker lock(&m_mutex);
+    auto it = m_uploads.constFind(upload);
+    if (it == m_uploads.cend())
+        return;
+    if (it->value == m_open.value && m_open.cb)
+        submitLocked();
+    if (completedValueLocked() < it->value)
+        waitLocked(it->value);
+    m_uploads.remove(upload);
+}
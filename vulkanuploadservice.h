@@ -0,0 +1,139 @@
+// vulkanuploadservice.h
+#ifndef VULKANUPLOADSERVICE_H
+#define VULKANUPLOADSERVICE_H
+
+#include <QtQuick/QQuickWindow>
+#include <QVulkanInstance>
+#include <QVulkanFunctions>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+
+// Загрузка текстур и буферов вне командного буфера кадра.
+//
+// Копирования пишутся в собственные командные буферы сервиса и отправляются
+// отдельным submit, завершение отмечается timeline-семафором (или fence,
+// если timelineSemaphore не поддерживается). Кадр не ждёт загрузку: рендерер
+// каждый кадр вызывает consume() и начинает использовать ресурс, когда
+// значение семафора достигнуто. Если загрузки идут в отдельном семействе
+// очередей, consume() записывает в командный буфер кадра acquire-часть
+// передачи владения (release записывается в буфер загрузки).
+//
+// Сервис один на VkDevice и разделяется окнами, все методы потокобезопасны.
+// Собственная очередь регистрируется setTransferQueue() тем, кто создаёт
+// устройство сам (VulkanSharedDevice); к ней обращается только сервис, под
+// своим мьютексом. Это очередь семейства только с передачей, если оно есть,
+// иначе ещё одна очередь графического семейства - тогда передачи владения
+// не нужны. Без собственной очереди загрузки идут отдельными submit в графическую очередь
+// окна, и vkQueueSubmit должен идти с того же потока, что и submit Qt:
+// устройство, созданное Qt, принадлежит одному окну, а окна с общим
+// устройством без отдельной очереди рисуются в одном потоке (basic render
+// loop, см. VulkanSharedDevice). Очередь не ждётся целиком - ожидание идёт
+// по семафору или fence нужного пакета.
+//
+// Данные копируются в постоянно отображённое кольцо staging; место
+// освобождается по завершении пакетов. Загрузка больше кольца получает
+// собственный буфер на время пакета.
+class VulkanUploadService
+{
+public:
+    static VulkanUploadService *acquire(QQuickWindow *window);
+    static void release(VulkanUploadService *service);
+
+    static void setTransferQueue(VkDevice dev, uint32_t queueFamilyIndex, VkQueue queue);
+
+    // Возвращают номер загрузки. Данные копируются в staging сразу,
+    // исходный буфер после вызова не нужен. dst* - как ресурс будет
+    // использован после загрузки (для барьера и передачи владения).
+    quint64 uploadImage(const void *data, VkDeviceSize size, VkImage dst,
+                        const QList<VkBufferImageCopy> &regions, uint32_t mipLevels,
+                        VkImageLayout finalLayout, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+    quint64 uploadImage(const QImage &image, VkImage dst,
+                        VkImageLayout finalLayout, VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+    quint64 uploadBuffer(const void *data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset,
+                         VkAccessFlags dstAccess, VkPipelineStageFlags dstStage);
+
+    // Отправить накопленные загрузки одним submit
+    void submit();
+
+    bool isComplete(quint64 upload);
+    // true, если загрузка завершена и ресурс можно использовать в кадре,
+    // записанном в cb (командный буфер графической очереди вне render pass)
+    bool consume(quint64 upload, VkCommandBuffer cb);
+    // Блокирующее ожидание, для деструкторов: ресурс-приёмник нельзя
+    // уничтожать, пока в него идёт копирование
+    void wait(quint64 upload);
+
+    // Очередь только для загрузок, не очередь кадров какого-либо окна
+    bool hasOwnQueue() const { return m_ownQueue; }
+    // Очередь из другого семейства: ресурсы передаются графическому семейству
+    bool transfersOwnership() const { return m_queueFamily != m_graphicsQueueFamily; }
+
+private:
+    VulkanUploadService(QQuickWindow *window, VkDevice dev);
+    ~VulkanUploadService();
+
+    struct Batch {
+        quint64 value = 0;
+        VkCommandBuffer cb = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        // Занято в кольце staging, с пропуском до начала кольца
+        VkDeviceSize ringBytes = 0;
+        // Загрузки больше кольца
+        QList<QPair<VkBuffer, VkDeviceMemory>> staging;
+    };
+    struct Upload {
+        quint64 value = 0;
+        bool isImage = false;
+        VkImageMemoryBarrier imageBarrier {};
+        VkBufferMemoryBarrier bufferBarrier {};
+        VkPipelineStageFlags dstStage = 0;
+    };
+
+    void openBatch();
+    void submitLocked();
+    void collectLocked();
+    quint64 completedValueLocked();
+    void waitLocked(quint64 value);
+    bool allocateRing(VkDeviceSize size, VkDeviceSize *offset);
+    VkBuffer stage(const void *data, VkDeviceSize size, VkDeviceSize *offset);
+    quint64 addUpload(const Upload &upload);
+
+    QMutex m_mutex;
+    int m_refCount = 0;
+
+    VkDevice m_dev;
+    QVulkanDeviceFunctions *m_devFuncs = nullptr;
+    VkPhysicalDeviceMemoryProperties m_memProps;
+
+    uint32_t m_graphicsQueueFamily = 0;
+    uint32_t m_queueFamily = 0;
+    VkQueue m_queue = VK_NULL_HANDLE;
+    bool m_ownQueue = false;
+    // Поток рендеринга окна, чью графическую очередь делит сервис
+    QThread *m_queueThread = nullptr;
+    VkCommandPool m_cmdPool = VK_NULL_HANDLE;
+
+    VkSemaphore m_timeline = VK_NULL_HANDLE;
+    PFN_vkGetSemaphoreCounterValue m_getSemaphoreCounterValue = nullptr;
+    PFN_vkWaitSemaphores m_waitSemaphores = nullptr;
+
+    // Кольцо staging: m_ringHead - следующая запись, m_ringUsed - занято
+    // пакетами, которые ещё не завершены (освобождается по порядку)
+    VkBuffer m_ringBuf = VK_NULL_HANDLE;
+    VkDeviceMemory m_ringMem = VK_NULL_HANDLE;
+    char *m_ringPtr = nullptr;
+    VkDeviceSize m_ringHead = 0;
+    VkDeviceSize m_ringUsed = 0;
+
+    Batch m_open;
+    QList<Batch> m_pending;
+    quint64 m_nextValue = 1;
+    quint64 m_completedValue = 0;
+
+    quint64 m_nextUpload = 1;
+    QHash<quint64, Upload> m_uploads;
+};
+
+#endif
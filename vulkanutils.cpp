@@ -0,0 +1,84 @@
+// vulkanutils.cpp
+#include "vulkanutils.h"
+#include <cstring>
+
+namespace VulkanUtils {
+
+uint32_t findMemoryType(const VkPhysicalDeviceMemoryProperties &memProps,
+                        uint32_t memoryTypeBits, VkMemoryPropertyFlags flags)
+{
+    for (uint32_t i = 0; i < memProps.memoryTypeCount; ++i) {
+        if ((memoryTypeBits & (1u << i)) && (memProps.memoryTypes[i].propertyFlags & flags) == flags)
+            return i;
+    }
+    return uint32_t(-1);
+}
+
+void createBuffer(QVulkanDeviceFunctions *df, VkDevice dev,
+                  const VkPhysicalDeviceMemoryProperties &memProps,
+                  VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memFlags,
+                  VkBuffer *buf, VkDeviceMemory *mem, const char *what,
+                  VkMemoryPropertyFlags preferredFlags)
+{
+    VkBufferCreateInfo bufferInfo;
+    memset(&bufferInfo, 0, sizeof(bufferInfo));
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkResult err = df->vkCreateBuffer(dev, &bufferInfo, nullptr, buf);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create %s: %d", what, err);
+
+    VkMemoryRequirements memReq;
+    df->vkGetBufferMemoryRequirements(dev, *buf, &memReq);
+
+    uint32_t memTypeIndex = uint32_t(-1);
+    if (preferredFlags)
+        memTypeIndex = findMemoryType(memProps, memReq.memoryTypeBits, memFlags | preferredFlags);
+    if (memTypeIndex == uint32_t(-1))
+        memTypeIndex = findMemoryType(memProps, memReq.memoryTypeBits, memFlags);
+    if (memTypeIndex == uint32_t(-1))
+        qFatal("Failed to find memory type for %s", what);
+
+    VkMemoryAllocateInfo allocInfo;
+    memset(&allocInfo, 0, sizeof(allocInfo));
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memReq.size;
+    allocInfo.memoryTypeIndex = memTypeIndex;
+    err = df->vkAllocateMemory(dev, &allocInfo, nullptr, mem);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to allocate %s memory of size %u: %d", what, uint(allocInfo.allocationSize), err);
+
+    err = df->vkBindBufferMemory(dev, *buf, *mem, 0);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to bind %s memory: %d", what, err);
+}
+
+void destroyBuffer(QVulkanDeviceFunctions *df, VkDevice dev, VkBuffer *buf, VkDeviceMemory *mem)
+{
+    if (*buf != VK_NULL_HANDLE) {
+        df->vkDestroyBuffer(dev, *buf, nullptr);
+        *buf = VK_NULL_HANDLE;
+    }
+    if (*mem != VK_NULL_HANDLE) {
+        df->vkFreeMemory(dev, *mem, nullptr);
+        *mem = VK_NULL_HANDLE;
+    }
+}
+
+VkShaderModule createShaderModule(QVulkanDeviceFunctions *df, VkDevice dev, const QByteArray &spirv)
+{
+    VkShaderModuleCreateInfo shaderInfo;
+    memset(&shaderInfo, 0, sizeof(shaderInfo));
+    shaderInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    shaderInfo.codeSize = spirv.size();
+    shaderInfo.pCode = reinterpret_cast<const uint32_t *>(spirv.constData());
+    VkShaderModule module;
+    VkResult err = df->vkCreateShaderModule(dev, &shaderInfo, nullptr, &module);
+    if (err != VK_SUCCESS)
+        qFatal("Failed to create shader module: %d", err);
+    return module;
+}
+
+} // namespace VulkanUtils
@@ -0,0 +1,45 @@
+// vulkanutils.h
+#ifndef VULKANUTILS_H
+#define VULKANUTILS_H
+
+#include <QByteArray>
+#include <QVulkanInstance>
+#include <QVulkanFunctions>
+
+// Общие вспомогательные функции для рендереров элементов.
+// Ошибки Vulkan, как и в остальном коде, фатальны (qFatal).
+namespace VulkanUtils {
+
+inline VkDeviceSize aligned(VkDeviceSize v, VkDeviceSize byteAlign)
+{
+    return (v + byteAlign - 1) & ~(byteAlign - 1);
+}
+
+// uint32_t(-1), если подходящего типа памяти нет
+uint32_t findMemoryType(const VkPhysicalDeviceMemoryProperties &memProps,
+                        uint32_t memoryTypeBits, VkMemoryPropertyFlags flags);
+
+// Буфер с собственным выделением памяти; what - имя для сообщения об ошибке.
+// preferredFlags добавляются к memFlags, если такой тип памяти есть
+void createBuffer(QVulkanDeviceFunctions *df, VkDevice dev,
+                  const VkPhysicalDeviceMemoryProperties &memProps,
+                  VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memFlags,
+                  VkBuffer *buf, VkDeviceMemory *mem, const char *what,
+                  VkMemoryPropertyFlags preferredFlags = 0);
+
+void destroyBuffer(QVulkanDeviceFunctions *df, VkDevice dev, VkBuffer *buf, VkDeviceMemory *mem);
+
+// Буфер, ожидающий завершения кадров, которые ещё могут его читать;
+// frame - номер кадра рендерера, с которого его можно уничтожить
+struct RetiredBuffer
+{
+    VkBuffer buf;
+    VkDeviceMemory mem;
+    quint64 frame;
+};
+
+VkShaderModule createShaderModule(QVulkanDeviceFunctions *df, VkDevice dev, const QByteArray &spirv);
+
+} // namespace VulkanUtils
+
+#endif